@@ -541,6 +541,7 @@ template class async_result<stat_result_entry>;
 template class async_result<stat_count_result_entry>;
 template class async_result<exec_result_entry>;
 template class async_result<iterator_result_entry>;
+template class async_result<hash_tree_result_entry>;
 template class async_result<index_entry>;
 template class async_result<find_indexes_result_entry>;
 
@@ -551,6 +552,7 @@ template class async_result_handler<stat_result_entry>;
 template class async_result_handler<stat_count_result_entry>;
 template class async_result_handler<exec_result_entry>;
 template class async_result_handler<iterator_result_entry>;
+template class async_result_handler<hash_tree_result_entry>;
 template class async_result_handler<index_entry>;
 template class async_result_handler<find_indexes_result_entry>;
 } }
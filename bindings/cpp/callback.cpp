@@ -320,6 +320,34 @@ data_pointer iterator_result_entry::reply_data() const
 	DNET_DATA_END(sizeof(dnet_iterator_response));
 }
 
+hash_tree_result_entry::hash_tree_result_entry()
+{
+}
+
+hash_tree_result_entry::hash_tree_result_entry(const hash_tree_result_entry &other) : callback_result_entry(other)
+{
+}
+
+hash_tree_result_entry::~hash_tree_result_entry()
+{
+}
+
+hash_tree_result_entry &hash_tree_result_entry::operator =(const hash_tree_result_entry &other)
+{
+	callback_result_entry::operator =(other);
+	return *this;
+}
+
+dnet_hash_tree_reply *hash_tree_result_entry::reply() const
+{
+	return data<dnet_hash_tree_reply>();
+}
+
+uint64_t *hash_tree_result_entry::hashes() const
+{
+	return reply()->hashes;
+}
+
 //
 // Iterator container
 //
@@ -107,6 +107,19 @@ struct entry_converter
 		dnet_convert_iterator_response(entry.reply());
 	}
 
+	static void convert(hash_tree_result_entry &entry, callback_result_data *)
+	{
+		dnet_hash_tree_reply *reply = entry.reply();
+		dnet_convert_hash_tree_reply(reply);
+
+		if (entry.data().size() != sizeof(dnet_hash_tree_reply) + reply->num * sizeof(uint64_t))
+			throw_error(-EPROTO, "invalid hash tree reply: num: %llu, size: %zu",
+				static_cast<unsigned long long>(reply->num), entry.data().size());
+
+		for (uint64_t i = 0; i < reply->num; ++i)
+			reply->hashes[i] = dnet_bswap64(reply->hashes[i]);
+	}
+
 	static void convert(lookup_result_entry &entry, callback_result_data *)
 	{
 		dnet_convert_addr(entry.storage_address());
@@ -193,6 +206,38 @@ class default_callback
 			return (m_count == m_complete);
 		}
 
+		/*
+		 * Handles reply which packs several entries into its data, @entries are offsets and sizes of them.
+		 * Every entry is processed as if it was received in its own reply.
+		 */
+		bool handle_packed(struct dnet_net_state *state, struct dnet_cmd *cmd,
+				const std::vector<std::pair<uint64_t, uint64_t>> &entries)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			const char *payload = reinterpret_cast<const char *>(cmd + 1);
+
+			for (auto it = entries.begin(); it != entries.end(); ++it) {
+				auto data = std::make_shared<callback_result_data>();
+				data->data = data_pointer::allocate(sizeof(dnet_addr) + sizeof(dnet_cmd) + it->second);
+
+				memcpy(data->data.data(), dnet_state_addr(state), sizeof(dnet_addr));
+
+				dnet_cmd *entry_cmd = data->data.skip<dnet_addr>().data<dnet_cmd>();
+				*entry_cmd = *cmd;
+				entry_cmd->size = it->second;
+				entry_cmd->flags |= DNET_FLAGS_MORE;
+				memcpy(entry_cmd + 1, payload + it->first, it->second);
+
+				process(entry_cmd, data, data.get());
+			}
+
+			if (!(cmd->flags & DNET_FLAGS_MORE))
+				m_statuses.push_back(cmd->status);
+
+			return (m_count == m_complete);
+		}
+
 		void process(dnet_cmd *cmd, const callback_result_entry &default_entry, callback_result_data *data)
 		{
 			T entry = *static_cast<const T *>(&default_entry);
@@ -1480,7 +1525,8 @@ class iterator_callback
 	public:
 		typedef std::shared_ptr<iterator_callback> ptr;
 
-		iterator_callback(const session &sess, const async_iterator_result &result) : sess(sess), cb(sess, result)
+		iterator_callback(const session &sess, const async_iterator_result &result) :
+			sess(sess), batch(false), projection(false), data(false), fields(0), cb(sess, result)
 		{
 		}
 
@@ -1497,6 +1543,12 @@ class iterator_callback
 			ctl.complete = func;
 			ctl.priv = priv;
 
+			const dnet_iterator_request *req = request.data<dnet_iterator_request>();
+			batch = !!(req->flags & DNET_IFLAGS_BATCH);
+			projection = !!(req->flags & DNET_IFLAGS_PROJECTION);
+			data = !!(req->flags & DNET_IFLAGS_DATA);
+			fields = req->fields | (data ? DNET_IFIELD_SIZE : 0);
+
 			dnet_convert_iterator_request(request.data<dnet_iterator_request>());
 			ctl.data = request.data();
 			ctl.size = request.size();
@@ -1513,6 +1565,14 @@ class iterator_callback
 		bool handle(error_info *error, struct dnet_net_state *state, struct dnet_cmd *cmd, complete_func func, void *priv)
 		{
 			(void) error;
+
+			if (batch && !is_trans_destroyed(state, cmd) && cmd->status == 0 && cmd->size)
+				return handle_batch(state, cmd, func, priv);
+
+			if (projection && !is_trans_destroyed(state, cmd) && cmd->status == 0
+					&& (cmd->flags & DNET_FLAGS_MORE))
+				return handle_projected(state, cmd, func, priv);
+
 			return cb.handle(state, cmd, func, priv);
 		}
 
@@ -1524,7 +1584,199 @@ class iterator_callback
 		session sess;
 		struct dnet_id id; /* This ID is used to find out node which will handle iterator request */
 		data_pointer request;
+		bool batch; /* DNET_IFLAGS_BATCH is set: reply carries dnet_iterator_batch and many records */
+		bool projection; /* DNET_IFLAGS_PROJECTION is set: records carry only @fields of the response */
+		bool data; /* DNET_IFLAGS_DATA is set: records are followed by data */
+		uint64_t fields;
 		default_callback<iterator_result_entry> cb;
+
+	private:
+		/*
+		 * Finds @record_size of the record at @offset of @size bytes of @payload,
+		 * returns false if it does not fit
+		 */
+		bool find_record_size(const char *payload, uint64_t offset, uint64_t size,
+				bool with_data, bool packed, uint64_t &record_size) const
+		{
+			dnet_iterator_response response;
+			const uint64_t header_size = packed ? dnet_iterator_response_packed_size(fields) : sizeof(dnet_iterator_response);
+
+			if (size - offset < header_size)
+				return false;
+
+			record_size = header_size;
+			if (with_data) {
+				if (packed)
+					dnet_iterator_response_unpack(&response, payload + offset, fields);
+				else
+					memcpy(&response, payload + offset, sizeof(dnet_iterator_response));
+
+				if (response.size > size - offset - header_size)
+					return false;
+				record_size += response.size;
+			}
+
+			return true;
+		}
+
+		/*
+		 * Restores full responses of projected records in place of @entries,
+		 * @buffer holds command followed by restored records
+		 */
+		void unpack_records(const dnet_cmd *cmd, std::vector<std::pair<uint64_t, uint64_t>> &entries,
+				std::vector<char> &buffer) const
+		{
+			const char *payload = reinterpret_cast<const char *>(cmd + 1);
+			const uint64_t packed_size = dnet_iterator_response_packed_size(fields);
+			uint64_t offset = 0;
+
+			buffer.resize(sizeof(dnet_cmd) + cmd->size + entries.size() * sizeof(dnet_iterator_response));
+			char *records = buffer.data() + sizeof(dnet_cmd);
+
+			for (auto it = entries.begin(); it != entries.end(); ++it) {
+				const uint64_t dsize = it->second - packed_size;
+
+				dnet_iterator_response_unpack(reinterpret_cast<dnet_iterator_response *>(records + offset),
+						payload + it->first, fields);
+				memcpy(records + offset + sizeof(dnet_iterator_response), payload + it->first + packed_size, dsize);
+
+				it->first = offset;
+				it->second = sizeof(dnet_iterator_response) + dsize;
+				offset += it->second;
+			}
+
+			dnet_cmd *unpacked_cmd = reinterpret_cast<dnet_cmd *>(buffer.data());
+			*unpacked_cmd = *cmd;
+			unpacked_cmd->size = offset;
+		}
+
+		/*
+		 * Restores full response of the projected reply, malformed reply is reported as an -EPROTO entry
+		 */
+		bool handle_projected(struct dnet_net_state *state, struct dnet_cmd *cmd, complete_func func, void *priv)
+		{
+			const char *payload = reinterpret_cast<const char *>(cmd + 1);
+			std::vector<std::pair<uint64_t, uint64_t>> entries;
+			std::vector<char> buffer;
+
+			uint64_t size;
+
+			if (find_record_size(payload, 0, cmd->size, data, true, size) && size == cmd->size) {
+				entries.emplace_back(0, size);
+				unpack_records(cmd, entries, buffer);
+
+				return cb.handle(state, reinterpret_cast<dnet_cmd *>(buffer.data()), func, priv);
+			}
+
+			return handle_malformed(state, cmd, func, priv);
+		}
+
+		bool handle_malformed(struct dnet_net_state *state, struct dnet_cmd *cmd, complete_func func, void *priv)
+		{
+			sess.get_node().get_log().print(DNET_LOG_ERROR,
+					"%s: received invalid iterator reply, tid: %llu, size: %llu\n",
+					dnet_dump_id(&cmd->id),
+					static_cast<unsigned long long>(cmd->trans),
+					static_cast<unsigned long long>(cmd->size));
+
+			dnet_cmd error_cmd = *cmd;
+			error_cmd.status = -EPROTO;
+			error_cmd.size = 0;
+			return cb.handle(state, &error_cmd, func, priv);
+		}
+
+		/*
+		 * Splits batched reply into records, malformed reply is reported as an -EPROTO entry
+		 */
+		bool handle_batch(struct dnet_net_state *state, struct dnet_cmd *cmd, complete_func func, void *priv)
+		{
+			const char *payload = reinterpret_cast<const char *>(cmd + 1);
+			std::vector<std::pair<uint64_t, uint64_t>> entries;
+			dnet_iterator_batch header;
+			uint64_t offset = sizeof(dnet_iterator_batch);
+
+			if (cmd->size >= sizeof(dnet_iterator_batch)) {
+				memcpy(&header, payload, sizeof(dnet_iterator_batch));
+				dnet_convert_iterator_batch(&header);
+
+				entries.reserve(std::min<uint64_t>(header.num, cmd->size));
+
+				for (uint64_t i = 0; i < header.num; ++i) {
+					uint64_t size;
+
+					if (!find_record_size(payload, offset, cmd->size, header.flags & DNET_IFLAGS_DATA,
+								header.flags & DNET_IFLAGS_PROJECTION, size))
+						break;
+
+					entries.emplace_back(offset, size);
+					offset += size;
+				}
+
+				if (entries.size() == header.num && offset == cmd->size) {
+					if (!(header.flags & DNET_IFLAGS_PROJECTION))
+						return cb.handle_packed(state, cmd, entries);
+
+					std::vector<char> buffer;
+					unpack_records(cmd, entries, buffer);
+					return cb.handle_packed(state, reinterpret_cast<dnet_cmd *>(buffer.data()), entries);
+				}
+			}
+
+			return handle_malformed(state, cmd, func, priv);
+		}
+};
+
+class hash_tree_callback
+{
+	public:
+		typedef std::shared_ptr<hash_tree_callback> ptr;
+
+		hash_tree_callback(const session &sess, const async_hash_tree_result &result) :
+			sess(sess), cb(sess, result)
+		{
+		}
+
+		bool start(error_info *error, complete_func func, void *priv)
+		{
+			cb.set_count(unlimited);
+
+			dnet_trans_control ctl;
+			memset(&ctl, 0, sizeof(ctl));
+			memcpy(&ctl.id, &id, sizeof(id));
+			ctl.id.group_id = sess.get_groups().front();
+			ctl.cflags = sess.get_cflags() | DNET_FLAGS_NEED_ACK | DNET_FLAGS_NOLOCK;
+			ctl.cmd = DNET_CMD_HASH_TREE;
+			ctl.complete = func;
+			ctl.priv = priv;
+
+			dnet_convert_hash_tree_request(&request);
+			ctl.data = &request;
+			ctl.size = sizeof(request);
+
+			int err = dnet_trans_alloc_send(sess.get_native(), &ctl);
+			if (err < 0) {
+				*error = create_error(err, "failed to request hash tree");
+				return true;
+			}
+
+			return cb.set_count(1);
+		}
+
+		bool handle(error_info *error, struct dnet_net_state *state, struct dnet_cmd *cmd, complete_func func, void *priv)
+		{
+			(void) error;
+			return cb.handle(state, cmd, func, priv);
+		}
+
+		void finish(const error_info &exc)
+		{
+			cb.complete(exc);
+		}
+
+		session sess;
+		dnet_id id;
+		dnet_hash_tree_request request;
+		default_callback<hash_tree_result_entry> cb;
 };
 
 template <typename T>
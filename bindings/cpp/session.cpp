@@ -1318,6 +1318,26 @@ void session::transform(const data_pointer &data, dnet_id &id) const
 	trace_id = m_data->trace_id;
 }
 
+void session::transform(const std::vector<std::string> &data, std::vector<dnet_raw_id> &ids) const
+{
+	std::vector<const void *> src(data.size());
+	std::vector<uint64_t> size(data.size());
+
+	for (size_t i = 0; i < data.size(); ++i) {
+		src[i] = data[i].data();
+		size[i] = data[i].size();
+	}
+
+	ids.resize(data.size());
+	trace_id = m_data->trace_id;
+
+	if (!data.empty()) {
+		int err = dnet_transform_batch(m_data->session_ptr, src.data(), size.data(), data.size(), ids.data());
+		if (err)
+			throw_error(err, "Failed to transform %zu keys", data.size());
+	}
+}
+
 void session::transform(const key &id) const
 {
 	const_cast<key&>(id).transform(*this);
@@ -1411,6 +1431,25 @@ void session::update_status(const char *saddr, const int port, const int family,
 	}
 }
 
+void session::update_status(const char *saddr, const int port, const int family,
+	struct dnet_node_status *status, struct dnet_cache_control *cache)
+{
+	int err;
+	struct dnet_addr addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.addr_len = sizeof(addr.addr);
+	addr.family = family;
+
+	err = dnet_fill_addr(&addr, saddr, port, SOCK_STREAM, IPPROTO_TCP);
+	if (!err)
+		err = dnet_update_cache(m_data->session_ptr, &addr, NULL, status, cache);
+
+	if (err < 0) {
+		throw_error(err, "%s:%d: failed to request set status and cache %p", saddr, port, cache);
+	}
+}
+
 void session::update_status(const key &id, struct dnet_node_status *status)
 {
 	transform(id);
@@ -1772,20 +1811,47 @@ async_iterator_result session::start_iterator(const key &id, const std::vector<d
 								uint32_t type, uint64_t flags,
 								const dnet_time& time_begin, const dnet_time& time_end)
 {
-	auto ranges_size = ranges.size() * sizeof(ranges.front());
+	return start_iterator(id, ranges, std::vector<dnet_iterator_predicate_term>(), DNET_IFIELD_ALL,
+			type, flags, time_begin, time_end);
+}
 
-	data_pointer data = data_pointer::allocate(sizeof(dnet_iterator_request) + ranges_size);
+async_iterator_result session::start_iterator(const key &id, const std::vector<dnet_iterator_range>& ranges,
+								const std::vector<dnet_iterator_predicate_term> &predicate,
+								uint64_t fields, uint32_t type, uint64_t flags,
+								const dnet_time& time_begin, const dnet_time& time_end)
+{
+	auto ranges_size = ranges.size() * sizeof(dnet_iterator_range);
+	auto predicate_size = predicate.empty() ? 0 :
+		sizeof(dnet_iterator_predicate) + predicate.size() * sizeof(dnet_iterator_predicate_term);
+
+	data_pointer data = data_pointer::allocate(sizeof(dnet_iterator_request) + ranges_size + predicate_size);
 
 	auto req = data.data<dnet_iterator_request>();
+	memset(req, 0, sizeof(dnet_iterator_request));
 
 	req->action = DNET_ITERATOR_ACTION_START;
 	req->itype = type;
 	req->flags = flags;
+	req->fields = fields;
 	req->time_begin = time_begin;
 	req->time_end = time_end;
 	req->range_num = ranges.size();
 
-	memcpy(data.skip<dnet_iterator_request>().data(), &ranges.front(), ranges_size);
+	if (!ranges.empty())
+		memcpy(data.skip<dnet_iterator_request>().data(), &ranges.front(), ranges_size);
+
+	if (!predicate.empty()) {
+		req->flags |= DNET_IFLAGS_PREDICATE;
+
+		auto header = data.skip(sizeof(dnet_iterator_request) + ranges_size).data<dnet_iterator_predicate>();
+		memset(header, 0, sizeof(dnet_iterator_predicate));
+		header->num = predicate.size();
+		memcpy(header->terms, &predicate.front(), predicate.size() * sizeof(dnet_iterator_predicate_term));
+
+		for (uint64_t i = 0; i < header->num; ++i)
+			dnet_convert_iterator_predicate_term(&header->terms[i]);
+		dnet_convert_iterator_predicate(header);
+	}
 
 	return iterator(id, data);
 }
@@ -1823,6 +1889,77 @@ async_iterator_result session::cancel_iterator(const key &id, uint64_t iterator_
 	return iterator(id, data);
 }
 
+async_iterator_result session::read_iterator_result(const key &id, uint64_t result_id,
+								const std::vector<dnet_iterator_range> &ranges)
+{
+	auto ranges_size = ranges.size() * sizeof(dnet_iterator_range);
+
+	data_pointer data = data_pointer::allocate(sizeof(dnet_iterator_request) + ranges_size);
+	auto request = data.data<dnet_iterator_request>();
+	memset(request, 0, sizeof(dnet_iterator_request));
+	request->action = DNET_ITERATOR_ACTION_READ;
+	request->id = result_id;
+	/* Result is sent in batched replies */
+	request->flags = DNET_IFLAGS_BATCH;
+	request->range_num = ranges.size();
+
+	if (!ranges.empty()) {
+		request->flags |= DNET_IFLAGS_KEY_RANGE;
+		memcpy(data.skip<dnet_iterator_request>().data(), &ranges.front(), ranges_size);
+	}
+
+	return iterator(id, data);
+}
+
+async_iterator_result session::remove_iterator_result(const key &id, uint64_t result_id)
+{
+	data_pointer data = data_pointer::allocate(sizeof(dnet_iterator_request));
+	auto request = data.data<dnet_iterator_request>();
+	memset(request, 0, sizeof(dnet_iterator_request));
+	request->action = DNET_ITERATOR_ACTION_REMOVE;
+	request->id = result_id;
+
+	return iterator(id, data);
+}
+
+async_iterator_result session::resume_iterator(const key &id, const data_pointer &token)
+{
+	if (token.size() < sizeof(dnet_iterator_request) + sizeof(dnet_iterator_checkpoint)) {
+		error_info error = create_error(-EINVAL, "resume_iterator failed: invalid token size: %zu", token.size());
+		if (get_exceptions_policy() & throw_at_start) {
+			error.throw_error();
+		} else {
+			async_iterator_result result(*this);
+			async_result_handler<iterator_result_entry> handler(result);
+			handler.complete(error);
+			return result;
+		}
+	}
+
+	/* Token is sent in network byte order, request header is converted again on sending */
+	data_pointer data = data_pointer::copy(token.data(), token.size());
+	dnet_convert_iterator_request(data.data<dnet_iterator_request>());
+
+	return iterator(id, data);
+}
+
+async_hash_tree_result session::hash_tree(const key &id, const dnet_raw_id &start, const dnet_raw_id &end,
+								uint32_t level)
+{
+	transform(id);
+	async_hash_tree_result result(*this);
+	auto cb = createCallback<hash_tree_callback>(*this, result);
+	cb->id = id.id();
+
+	memset(&cb->request, 0, sizeof(dnet_hash_tree_request));
+	cb->request.start = start;
+	cb->request.end = end;
+	cb->request.level = level;
+
+	startCallback(cb);
+	return result;
+}
+
 async_exec_result session::exec(dnet_id *id, const std::string &event, const argument_data &data)
 {
 	return exec(id, -1, event, data);
@@ -1946,13 +2083,13 @@ async_read_result session::bulk_read(const std::vector<std::string> &keys)
 
 	io.flags = get_ioflags();
 
+	std::vector<dnet_raw_id> ids;
+	transform(keys, ids);
+
 	ios.reserve(keys.size());
 
 	for (size_t i = 0; i < keys.size(); ++i) {
-		struct dnet_id id;
-
-		transform(keys[i], id);
-		memcpy(io.id, id.id, sizeof(io.id));
+		memcpy(io.id, ids[i].id, sizeof(io.id));
 		ios.push_back(io);
 	}
 
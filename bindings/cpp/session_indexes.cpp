@@ -236,12 +236,13 @@ static async_set_indexes_result session_set_indexes(session &orig_sess, const ke
 static void session_convert_indexes(session &sess, std::vector<index_entry> &raw_indexes,
 	const std::vector<std::string> &indexes, const std::vector<data_pointer> &datas)
 {
-	dnet_id tmp;
+	std::vector<dnet_raw_id> ids;
+	sess.transform(indexes, ids);
+
 	raw_indexes.resize(indexes.size());
 
 	for (size_t i = 0; i < indexes.size(); ++i) {
-		sess.transform(indexes[i], tmp);
-		memcpy(raw_indexes[i].index.id, tmp.id, sizeof(tmp.id));
+		raw_indexes[i].index = ids[i];
 		raw_indexes[i].data = datas[i];
 	}
 }
@@ -249,11 +250,7 @@ static void session_convert_indexes(session &sess, std::vector<index_entry> &raw
 static std::vector<dnet_raw_id> session_convert_indexes(session &sess, const std::vector<std::string> &indexes)
 {
 	std::vector<dnet_raw_id> raw_indexes;
-	raw_indexes.resize(indexes.size());
-
-	for (size_t i = 0; i < indexes.size(); ++i) {
-		sess.transform(indexes[i], raw_indexes[i]);
-	}
+	sess.transform(indexes, raw_indexes);
 
 	return std::move(raw_indexes);
 }
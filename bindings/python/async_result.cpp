@@ -144,6 +144,7 @@ void init_async_results() {
 						stat_result_entry,
 						stat_count_result_entry,
 						iterator_result_entry,
+						hash_tree_result_entry,
 						exec_result_entry,
 						find_indexes_result_entry,
 						index_entry
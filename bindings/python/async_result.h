@@ -154,6 +154,7 @@ python_async_result<T> create_result(async_result<T> &&result)
 }
 
 typedef python_async_result<iterator_result_entry>		python_iterator_result;
+typedef python_async_result<hash_tree_result_entry>		python_hash_tree_result;
 typedef python_async_result<read_result_entry> 			python_read_result;
 typedef python_async_result<lookup_result_entry>		python_lookup_result;
 typedef python_async_result<write_result_entry>			python_write_result;
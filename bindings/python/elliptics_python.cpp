@@ -48,6 +48,31 @@ enum elliptics_iterator_flags {
 	iflag_data = DNET_IFLAGS_DATA,
 	iflag_key_range = DNET_IFLAGS_KEY_RANGE,
 	iflag_ts_range = DNET_IFLAGS_TS_RANGE,
+	iflag_batch = DNET_IFLAGS_BATCH,
+	iflag_predicate = DNET_IFLAGS_PREDICATE,
+	iflag_projection = DNET_IFLAGS_PROJECTION,
+	iflag_checkpoint = DNET_IFLAGS_CHECKPOINT,
+};
+
+enum elliptics_iterator_fields {
+	ifield_key = DNET_IFIELD_KEY,
+	ifield_timestamp = DNET_IFIELD_TIMESTAMP,
+	ifield_user_flags = DNET_IFIELD_USER_FLAGS,
+	ifield_size = DNET_IFIELD_SIZE,
+	ifield_all = DNET_IFIELD_ALL,
+};
+
+enum elliptics_iterator_predicate_ops {
+	iop_eq = DNET_IOP_EQ,
+	iop_ne = DNET_IOP_NE,
+	iop_lt = DNET_IOP_LT,
+	iop_le = DNET_IOP_LE,
+	iop_gt = DNET_IOP_GT,
+	iop_ge = DNET_IOP_GE,
+	iop_all = DNET_IOP_ALL,
+	iop_any = DNET_IOP_ANY,
+	iop_none = DNET_IOP_NONE,
+	iop_prefix = DNET_IOP_PREFIX,
 };
 
 enum elliptics_cflags {
@@ -355,17 +380,59 @@ BOOST_PYTHON_MODULE(core)
 	    "default\n    There no filtering should be while iteration. All keys will be presented\n"
 	    "data\n    Iteration results should also includes objects datas\n"
 	    "key_range\n    elliptics.Id ranges should be used for filtering keys on the node while iteration\n"
-	    "ts_range\n    Time range should be used for filtering keys on the node while iteration")
+	    "ts_range\n    Time range should be used for filtering keys on the node while iteration\n"
+	    "batch\n    Node packs many iteration results into one reply, it is much cheaper for small objects\n"
+	    "predicate\n    Node sends only keys which match predicate, it is set by start_iterator() with predicate\n"
+	    "projection\n    Node sends only requested elliptics.iterator_fields of the results\n"
+	    "checkpoint\n    Node periodically sends checkpoint which can be passed to session.resume_iterator()")
 		.value("default", iflag_default)
 		.value("data", iflag_data)
 		.value("key_range", iflag_key_range)
 		.value("ts_range", iflag_ts_range)
+		.value("batch", iflag_batch)
+		.value("predicate", iflag_predicate)
+		.value("projection", iflag_projection)
+		.value("checkpoint", iflag_checkpoint)
+	;
+
+	bp::enum_<elliptics_iterator_fields>("iterator_fields",
+	    "Fields of iteration results used by elliptics.PredicateTerm and projection:\n\n"
+	    "key\n    elliptics.Id of the key\n"
+	    "timestamp\n    Timestamp of the key\n"
+	    "user_flags\n    User flags of the key\n"
+	    "size\n    Size of the key's data\n"
+	    "all\n    All fields")
+		.value("key", ifield_key)
+		.value("timestamp", ifield_timestamp)
+		.value("user_flags", ifield_user_flags)
+		.value("size", ifield_size)
+		.value("all", ifield_all)
+	;
+
+	bp::enum_<elliptics_iterator_predicate_ops>("iterator_predicate_ops",
+	    "Operations of elliptics.PredicateTerm:\n\n"
+	    "eq, ne, lt, le, gt, ge\n    Compare timestamp, user flags or size with the term's value\n"
+	    "all\n    All bits of the value are set in user flags\n"
+	    "any\n    Any bit of the value is set in user flags\n"
+	    "none\n    No bits of the value are set in user flags\n"
+	    "prefix\n    First value bits of the key are equal to the term's key")
+		.value("eq", iop_eq)
+		.value("ne", iop_ne)
+		.value("lt", iop_lt)
+		.value("le", iop_le)
+		.value("gt", iop_gt)
+		.value("ge", iop_ge)
+		.value("all", iop_all)
+		.value("any", iop_any)
+		.value("none", iop_none)
+		.value("prefix", iop_prefix)
 	;
 
 	bp::enum_<elliptics_iterator_types>("iterator_types",
 	    "Flags which specifies how iteration results should be transmitted:\n\n"
-	    "disk\n    Iterator saves data chunks (index/metadata + (optionally) data)\n"
-	          "    locally on server to $root/iter/$id instead of sending chunks to client\n"
+	    "disk\n    Iterator saves responses sorted by key locally on server to $history/iter/$id\n"
+	          "    instead of sending them to client, data is not supported.\n"
+	          "    Result is read by session.read_iterator_result()\n"
 	    "network\n    Iterator sends data chunks to client")
 		.value("disk", itype_disk)
 		.value("network", itype_network)
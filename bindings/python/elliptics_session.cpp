@@ -141,6 +141,26 @@ void dnet_iterator_range_set_key_end(dnet_iterator_range *range, const elliptics
 	range->key_end = id.raw_id();
 }
 
+elliptics_id dnet_iterator_predicate_term_get_key(const dnet_iterator_predicate_term *term)
+{
+	return elliptics_id(term->key);
+}
+
+void dnet_iterator_predicate_term_set_key(dnet_iterator_predicate_term *term, const elliptics_id &id)
+{
+	term->key = id.raw_id();
+}
+
+elliptics_time dnet_iterator_predicate_term_get_time(const dnet_iterator_predicate_term *term)
+{
+	return elliptics_time(term->time);
+}
+
+void dnet_iterator_predicate_term_set_time(dnet_iterator_predicate_term *term, const elliptics_time &time)
+{
+	term->time = time.m_time;
+}
+
 class elliptics_session: public session, public bp::wrapper<session> {
 public:
 	elliptics_session(const node &n) : session(n) {}
@@ -427,6 +447,18 @@ public:
 		return create_result(std::move(session::start_iterator(elliptics_id::convert(id), std_ranges, type, flags, time_begin.m_time, time_end.m_time)));
 	}
 
+	python_iterator_result start_iterator_predicate(const bp::api::object &id, const bp::api::object &ranges,
+	                                                const bp::api::object &predicate, uint64_t fields,
+	                                                uint32_t type, uint64_t flags,
+	                                                const elliptics_time& time_begin = elliptics_time(0, 0),
+	                                                const elliptics_time& time_end = elliptics_time(-1, -1)) {
+		std::vector<dnet_iterator_range> std_ranges = convert_to_vector<dnet_iterator_range>(ranges);
+		std::vector<dnet_iterator_predicate_term> std_predicate = convert_to_vector<dnet_iterator_predicate_term>(predicate);
+
+		return create_result(std::move(session::start_iterator(elliptics_id::convert(id), std_ranges, std_predicate,
+		                                                       fields, type, flags, time_begin.m_time, time_end.m_time)));
+	}
+
 	python_iterator_result pause_iterator(const bp::api::object &id, const uint64_t &iterator_id) {
 		return create_result(std::move(session::pause_iterator(elliptics_id::convert(id), iterator_id)));
 	}
@@ -439,6 +471,31 @@ public:
 		return create_result(std::move(session::cancel_iterator(elliptics_id::convert(id), iterator_id)));
 	}
 
+	python_iterator_result read_iterator_result(const bp::api::object &id, const uint64_t &result_id,
+	                                            const bp::api::object &ranges) {
+		std::vector<dnet_iterator_range> std_ranges = convert_to_vector<dnet_iterator_range>(ranges);
+
+		return create_result(std::move(session::read_iterator_result(elliptics_id::convert(id), result_id, std_ranges)));
+	}
+
+	python_iterator_result remove_iterator_result(const bp::api::object &id, const uint64_t &result_id) {
+		return create_result(std::move(session::remove_iterator_result(elliptics_id::convert(id), result_id)));
+	}
+
+	python_iterator_result resume_iterator(const bp::api::object &id, const std::string &token) {
+		return create_result(std::move(session::resume_iterator(elliptics_id::convert(id), data_pointer::copy(token))));
+	}
+
+	python_hash_tree_result hash_tree(const bp::api::object &id, const bp::api::object &start,
+	                                  const bp::api::object &end, uint32_t level) {
+		auto start_id = elliptics_id::convert(start);
+		auto end_id = elliptics_id::convert(end);
+		session::transform(start_id);
+		session::transform(end_id);
+
+		return create_result(std::move(session::hash_tree(elliptics_id::convert(id), start_id.raw_id(), end_id.raw_id(), level)));
+	}
+
 	python_exec_result exec_src(const bp::api::object &id, const int src_key, const std::string &event, const std::string &data) {
 		dnet_id* raw_id = NULL;
 		dnet_id conv_id;
@@ -676,6 +733,28 @@ void init_elliptics_session() {
 		              "range.key_end = elliptics.Id([255] * 64, 1)")
 	;
 
+	bp::class_<dnet_iterator_predicate_term>("PredicateTerm",
+	    "Term of the iteration predicate, node sends only keys which match all terms.\n"
+	    "Timestamp is compared with time, key prefix is compared with key, the rest fields with value")
+		.def_readwrite("field", &dnet_iterator_predicate_term::field,
+		               "One of elliptics.iterator_fields except all\n\n"
+		               "term.field = elliptics.iterator_fields.user_flags")
+		.def_readwrite("op", &dnet_iterator_predicate_term::op,
+		               "One of elliptics.iterator_predicate_ops\n\n"
+		               "term.op = elliptics.iterator_predicate_ops.any")
+		.def_readwrite("value", &dnet_iterator_predicate_term::value,
+		               "Size, user flags or length of the key prefix in bits\n\n"
+		               "term.value = 0x4")
+		.add_property("time", dnet_iterator_predicate_term_get_time,
+		                      dnet_iterator_predicate_term_set_time,
+		              "elliptics.Time which timestamp is compared with\n\n"
+		              "term.time = elliptics.Time.now()")
+		.add_property("key", dnet_iterator_predicate_term_get_key,
+		                     dnet_iterator_predicate_term_set_key,
+		              "elliptics.Id which is prefix of the keys\n\n"
+		              "term.key = elliptics.Id([1, 2] + [0] * 62, 1)")
+	;
+
 	bp::class_<elliptics_session, boost::noncopyable>(
 	        "Session",
 	        "The main class which is used for executing operations with elliptics",
@@ -1296,6 +1375,29 @@ void init_elliptics_session() {
 		    "                       result.response.timestamp.tnsec,\n"
 		    "                       result.response_data))\n")
 
+		.def("start_iterator", &elliptics_session::start_iterator_predicate,
+		     bp::args("id", "ranges", "predicate", "fields", "type", "flags", "time_begin", "time_end"),
+		    "start_iterator(id, ranges, predicate, fields, type, flags, time_begin, time_end)\n"
+		    "    Start iterator which sends only keys matching all terms of @predicate.\n"
+		    "    If elliptics.iterator_flags.projection is set in @flags, only @fields of results are sent.\n"
+		    "    -- predicate - list of elliptics.PredicateTerm\n"
+		    "    -- fields - bits set of elliptics.iterator_fields\n"
+		    "    The rest arguments are the same as above\n\n"
+		    "    older = elliptics.PredicateTerm()\n"
+		    "    older.field = elliptics.iterator_fields.timestamp\n"
+		    "    older.op = elliptics.iterator_predicate_ops.lt\n"
+		    "    older.time = elliptics.Time(1388534400, 0)\n"
+		    "    flagged = elliptics.PredicateTerm()\n"
+		    "    flagged.field = elliptics.iterator_fields.user_flags\n"
+		    "    flagged.op = elliptics.iterator_predicate_ops.all\n"
+		    "    flagged.value = 0x4\n"
+		    "    iterator = session.start_iterator(id, [], [older, flagged],\n"
+		    "                                      elliptics.iterator_fields.key,\n"
+		    "                                      elliptics.iterator_types.network,\n"
+		    "                                      elliptics.iterator_flags.projection,\n"
+		    "                                      elliptics.Time(0, 0),\n"
+		    "                                      elliptics.Time(0, 0))\n")
+
 		.def("pause_iterator", &elliptics_session::pause_iterator,
 		     bp::args("id", "iterator_id"),
 		    "pause_iterator(id, iterator_id)\n"
@@ -1336,6 +1438,58 @@ void init_elliptics_session() {
 		    "    iterator = session.cancel_iterator(id, iterator_id)\n"
 		    "    iterator.wait()\n")
 
+		.def("read_iterator_result", &elliptics_session::read_iterator_result,
+		     bp::args("id", "result_id", "ranges"),
+		    "read_iterator_result(id, result_id, ranges)\n"
+		    "    Reads result of disk iterator from the node specified by @id.\n"
+		    "    Disk iterator reports @result_id in response.id of its replies,\n"
+		    "    result is sorted by key and can be read many times.\n"
+		    "    -- id - elliptics.Id of the node where disk iterator was run\n"
+		    "    -- result_id - integer ID of the result\n"
+		    "    -- ranges - list of elliptics.IteratorRange, only keys within them are read,\n"
+		    "                whole result is read if it is empty\n\n"
+		    "    id = session.routes.get_address_id(Address.from_host_port('host.com:1025'))\n"
+		    "    for result in session.read_iterator_result(id, result_id, []):\n"
+		    "        print result.response.key, result.response.timestamp\n")
+
+		.def("remove_iterator_result", &elliptics_session::remove_iterator_result,
+		     bp::args("id", "result_id"),
+		    "remove_iterator_result(id, result_id)\n"
+		    "    Removes result of disk iterator from the node specified by @id\n"
+		    "    -- id - elliptics.Id of the node where disk iterator was run\n"
+		    "    -- result_id - integer ID of the result\n\n"
+		    "    session.remove_iterator_result(id, result_id).wait()\n")
+
+		.def("resume_iterator", &elliptics_session::resume_iterator,
+		     bp::args("id", "token"),
+		    "resume_iterator(id, token)\n"
+		    "    Resumes iterator on the node specified by @id from the checkpoint.\n"
+		    "    Iterator started with elliptics.iterator_flags.checkpoint periodically sends\n"
+		    "    result with response.status 1, its response_data is a checkpoint token.\n"
+		    "    All results received before checkpoint do not have to be iterated again.\n"
+		    "    -- id - elliptics.Id of the node where iterator was run\n"
+		    "    -- token - string token of the last received checkpoint\n\n"
+		    "    for result in session.resume_iterator(id, token):\n"
+		    "        if result.response.status == 1:\n"
+		    "            token = result.response_data\n"
+		    "        else:\n"
+		    "            print result.response.key\n")
+
+		.def("hash_tree", &elliptics_session::hash_tree,
+		     bp::args("id", "start", "end", "level"),
+		    "hash_tree(id, start, end, level)\n"
+		    "    Reads hashes of @level of the hash tree of keys stored on the node specified by @id.\n"
+		    "    Level l splits key space into 2^l nodes by the first l bits of the key,\n"
+		    "    hash of the node is XOR of hashes of its keys and their timestamps,\n"
+		    "    so nodes of replicas with equal hashes store the same keys.\n"
+		    "    Level deeper than the tree is cut to its depth.\n"
+		    "    -- id - elliptics.Id of the node\n"
+		    "    -- start - elliptics.Id of the first key of the range\n"
+		    "    -- end - elliptics.Id of the last key of the range\n"
+		    "    -- level - integer level of the tree\n\n"
+		    "    for result in session.hash_tree(id, start, end, 8):\n"
+		    "        print result.level, result.first, result.hashes\n")
+
 // Index operations
 
 		.def("set_indexes", &elliptics_session::set_indexes,
@@ -59,6 +59,32 @@ std::string iterator_result_response_data(iterator_result_entry result)
 	return result.reply_data().to_string();
 }
 
+uint32_t hash_tree_result_depth(hash_tree_result_entry result)
+{
+	return result.reply()->depth;
+}
+
+uint32_t hash_tree_result_level(hash_tree_result_entry result)
+{
+	return result.reply()->level;
+}
+
+uint64_t hash_tree_result_first(hash_tree_result_entry result)
+{
+	return result.reply()->first;
+}
+
+bp::list hash_tree_result_hashes(hash_tree_result_entry result)
+{
+	bp::list ret;
+	const uint64_t *hashes = result.hashes();
+
+	for (uint64_t i = 0; i < result.reply()->num; ++i)
+		ret.append(hashes[i]);
+
+	return ret;
+}
+
 elliptics_id iterator_response_get_key(dnet_iterator_response *response)
 {
 	return elliptics_id(response->key);
@@ -79,6 +105,11 @@ uint64_t iterator_response_get_size(dnet_iterator_response *response)
 	return response->size;
 }
 
+int iterator_response_get_status(dnet_iterator_response *response)
+{
+	return response->status;
+}
+
 std::string read_result_get_data(read_result_entry &result)
 {
 	return result.file().to_string();
@@ -370,6 +401,21 @@ void init_result_entry() {
 		.add_property("error", result_entry_error<iterator_result_entry>)
 	;
 
+	bp::class_<hash_tree_result_entry>("HashTreeResultEntry")
+		.add_property("depth", hash_tree_result_depth,
+		              "Depth of the hash tree on the node")
+		.add_property("level", hash_tree_result_level,
+		              "Level of the returned hashes, it is not deeper than depth")
+		.add_property("first", hash_tree_result_first,
+		              "Index of the first returned node within the level")
+		.add_property("hashes", hash_tree_result_hashes,
+		              "List of integer hashes of the nodes starting with first")
+		.add_property("address", result_entry_address<hash_tree_result_entry>,
+		              "Address of node")
+		.add_property("group_id", result_entry_group_id<hash_tree_result_entry>)
+		.add_property("error", result_entry_error<hash_tree_result_entry>)
+	;
+
 	bp::class_<dnet_iterator_response>("IteratorResultResponse",
 			bp::no_init)
 		.add_property("key", iterator_response_get_key,
@@ -380,6 +426,8 @@ void init_result_entry() {
 		              "Custom user-defined flags of iterated key")
 		.add_property("size", iterator_response_get_size,
 		              "Size of iterated key data")
+		.add_property("status", iterator_response_get_status,
+		              "Status of iterated key, 1 if it is a checkpoint of iterator")
 	;
 
 	bp::class_<read_result_entry>("ReadResultEntry")
@@ -45,29 +45,37 @@ private:
 	const cache_manager	&m_manager;
 };
 
-cache_manager::cache_manager(struct dnet_node *n) {
+cache_manager::cache_manager(struct dnet_node *n) :
+	m_node(n),
+	m_writeback(n->cache_sync_concurrency > 0 ? n->cache_sync_concurrency : 1),
+	m_snapshot_path(n->cache_snapshot),
+	m_snapshot_interval(n->cache_snapshot_interval),
+	m_snapshot_loaded(false) {
 	size_t caches_number = n->caches_number;
 	m_cache_pages_number = n->cache_pages_number;
 	m_max_cache_size = n->cache_size;
-	size_t max_size = m_max_cache_size / caches_number;
+	m_adaptive = n->cache_adaptive && m_cache_pages_number > 1;
 
-	size_t proportionsSum = 0;
-	for (size_t i = 0; i < m_cache_pages_number; ++i) {
-		proportionsSum += n->cache_pages_proportions[i];
+	std::vector<size_t> pages_max_sizes = get_pages_max_sizes(m_max_cache_size / caches_number);
+
+	for (size_t i = 0; i < caches_number; ++i) {
+		m_caches.emplace_back(std::make_shared<slru_cache_t>(n, pages_max_sizes, m_writeback));
 	}
 
-	std::vector<size_t> pages_max_sizes(m_cache_pages_number);
-	for (size_t i = 0; i < m_cache_pages_number; ++i) {
-		pages_max_sizes[i] = max_size * (n->cache_pages_proportions[i] * 1.0 / proportionsSum);
+	if (n->cache_negative_size && n->cache_negative_ttl) {
+		m_negative_cache.reset(new negative_cache(n->cache_negative_size, n->cache_negative_ttl));
 	}
 
-	for (size_t i = 0; i < caches_number; ++i) {
-		m_caches.emplace_back(std::make_shared<slru_cache_t>(n, pages_max_sizes));
+	if (n->cache_mrc_sampling) {
+		m_miss_ratio_curve.reset(new miss_ratio_curve(n->cache_mrc_sampling));
 	}
 
 	stop = false;
 	m_dump_stats = std::thread(std::bind(&cache_manager::dump_stats, this));
 
+	if (!m_snapshot_path.empty())
+		m_snapshot = std::thread(std::bind(&cache_manager::snapshot_loop, this));
+
 	auto real_monitor = static_cast<ioremap::monitor::monitor*>(n->monitor);
 	if (real_monitor)
 		real_monitor->get_statistics().add_provider(new cache_stat_provider(*this), "cache");
@@ -80,17 +88,54 @@ cache_manager::~cache_manager() {
 	}
 	stop = true;
 	m_dump_stats.join();
+
+	if (m_snapshot.joinable()) {
+		m_snapshot.join();
+
+		// Snapshot which has not been loaded completely is still better than the partially loaded cache
+		if (m_snapshot_loaded)
+			save_snapshot();
+	}
 }
 
 int cache_manager::write(const unsigned char *id, dnet_net_state *st, dnet_cmd *cmd, dnet_io_attr *io, const char *data) {
+	if (m_miss_ratio_curve)
+		m_miss_ratio_curve->access(id, io->offset + io->size);
+
 	return m_caches[idx(id)]->write(id, st, cmd, io, data);
 }
 
-std::shared_ptr<raw_data_t> cache_manager::read(const unsigned char *id, dnet_cmd *cmd, dnet_io_attr *io) {
-	return m_caches[idx(id)]->read(id, cmd, io);
+raw_data_ptr cache_manager::read(const unsigned char *id, dnet_cmd *cmd, dnet_io_attr *io, int *err) {
+	raw_data_ptr data = m_caches[idx(id)]->read(id, cmd, io, err);
+
+	if (m_miss_ratio_curve && data)
+		m_miss_ratio_curve->access(id, data->size());
+
+	return data;
+}
+
+raw_data_ptr cache_manager::read_range(const unsigned char *id, dnet_io_attr *io, size_t *data_offset, int *err) {
+	raw_data_ptr data = m_caches[idx(id)]->read_range(id, io, data_offset, err);
+
+	// Only requested range takes space in the cache
+	if (m_miss_ratio_curve && data)
+		m_miss_ratio_curve->access(id, io->size);
+
+	return data;
+}
+
+bool cache_manager::chunked(const unsigned char *id) {
+	return m_caches[idx(id)]->chunked(id);
+}
+
+bool cache_manager::read_by_chunks(const unsigned char *id, const dnet_io_attr *io) {
+	return m_caches[idx(id)]->read_by_chunks(id, io);
 }
 
 int cache_manager::remove(const unsigned char *id, dnet_io_attr *io) {
+	if (m_miss_ratio_curve)
+		m_miss_ratio_curve->remove(id);
+
 	return m_caches[idx(id)]->remove(id, io);
 }
 
@@ -98,22 +143,199 @@ int cache_manager::lookup(const unsigned char *id, dnet_net_state *st, dnet_cmd
 	return m_caches[idx(id)]->lookup(id, st, cmd);
 }
 
-int cache_manager::indexes_find(dnet_cmd *cmd, dnet_indexes_request *request) {
-	(void) cmd;
-	(void) request;
-	return -ENOTSUP;
+int cache_manager::indexes_find(dnet_net_state *st, dnet_cmd *cmd, dnet_indexes_request *request) {
+	bool first = true;
+	int err = -1;
+
+	while (request) {
+		bool more = (request->flags & DNET_INDEXES_FLAGS_MORE);
+		int ret = find_indexes(st, cmd, first ? cmd->id : request->id, request, more);
+		first = false;
+
+		if (err == -1)
+			err = ret;
+		else if (!ret)
+			err = ret;
+
+		if (!more) {
+			break;
+		}
+
+		char *data = reinterpret_cast<char *>(request + 1);
+		for (size_t i = 0; i < request->entries_count; ++i) {
+			auto entry = reinterpret_cast<dnet_indexes_request_entry *>(data);
+			data += sizeof(*entry) + entry->size;
+		}
+		request = reinterpret_cast<dnet_indexes_request *>(data);
+	}
+
+	return err;
 }
 
-int cache_manager::indexes_update(dnet_cmd *cmd, dnet_indexes_request *request) {
+int cache_manager::indexes_update(dnet_net_state *st, dnet_cmd *cmd, dnet_indexes_request *request) {
+	(void) st;
 	(void) cmd;
 	(void) request;
+
+	// Update sends changes of every index to the node which owns it, those which are local
+	// come back as DNET_CMD_INDEXES_INTERNAL commands and are applied to the cached tables
 	return -ENOTSUP;
 }
 
-int cache_manager::indexes_internal(dnet_cmd *cmd, dnet_indexes_request *request) {
-	(void) cmd;
-	(void) request;
-	return -ENOTSUP;
+int cache_manager::indexes_internal(dnet_net_state *st, dnet_cmd *cmd, dnet_indexes_request *request) {
+	using namespace ioremap::elliptics;
+
+	// Elliptics sends a single index per internal command, anything else is left to the backend path
+	if (request->entries_count != 1)
+		return -ENOTSUP;
+
+	dnet_indexes_request_entry &entry = request->entries[0];
+
+	const uint32_t action = entry.flags & (DNET_INDEXES_FLAGS_INTERNAL_INSERT
+		| DNET_INDEXES_FLAGS_INTERNAL_REMOVE | DNET_INDEXES_FLAGS_INTERNAL_REMOVE_ALL);
+	if (action != DNET_INDEXES_FLAGS_INTERNAL_INSERT && action != DNET_INDEXES_FLAGS_INTERNAL_REMOVE)
+		return -ENOTSUP;
+
+	const data_pointer data = data_pointer::from_raw(entry.data, entry.size);
+
+	int err = m_caches[idx(entry.id.id)]->update_index(entry.id.id, *request, data, action);
+	if (err)
+		return err;
+
+	data_buffer buffer(sizeof(dnet_indexes_reply) + sizeof(dnet_indexes_reply_entry));
+
+	dnet_indexes_reply reply;
+	memset(&reply, 0, sizeof(reply));
+	reply.entries_count = 1;
+	buffer.write(reply);
+
+	dnet_indexes_reply_entry reply_entry;
+	memset(&reply_entry, 0, sizeof(reply_entry));
+	reply_entry.id = entry.id;
+	reply_entry.status = 0;
+	buffer.write(reply_entry);
+
+	data_pointer reply_data = std::move(buffer);
+
+	cmd->flags &= (DNET_FLAGS_NEED_ACK | DNET_FLAGS_MORE);
+	dnet_send_reply(st, cmd, reply_data.data(), reply_data.size(), 0);
+
+	return 0;
+}
+
+int cache_manager::find_indexes(dnet_net_state *st, dnet_cmd *cmd, const dnet_id &request_id, dnet_indexes_request *request, bool more) {
+	using namespace ioremap::elliptics;
+
+	const bool intersection = request->flags & DNET_INDEXES_FLAGS_INTERSECT;
+	const bool unite = request->flags & DNET_INDEXES_FLAGS_UNITE;
+
+	if ((intersection && unite) || !(intersection || unite)) {
+		return -EINVAL;
+	}
+
+	std::vector<find_indexes_result_entry> result;
+	std::map<dnet_raw_id, size_t, dnet_raw_id_less_than<> > result_map;
+
+	int err = -1;
+
+	size_t data_offset = 0;
+	char *data_start = reinterpret_cast<char *>(request->entries);
+	for (uint64_t i = 0; i < request->entries_count; ++i) {
+		dnet_indexes_request_entry &request_entry = *reinterpret_cast<dnet_indexes_request_entry *>(data_start + data_offset);
+		data_offset += sizeof(dnet_indexes_request_entry) + request_entry.size;
+
+		int ret = 0;
+		std::shared_ptr<const dnet_indexes> table = m_caches[idx(request_entry.id.id)]->find_index(request_entry.id.id, &ret);
+
+		if (ret) {
+			dnet_log(m_node, DNET_LOG_DEBUG, "%s: CACHE: INDEXES_FIND, err: %d\n",
+				 dnet_dump_id_str(request_entry.id.id), ret);
+		}
+
+		if (ret && unite) {
+			if (err == -1)
+				err = ret;
+			continue;
+		} else if (ret && intersection) {
+			return ret;
+		}
+		err = 0;
+
+		const std::vector<index_entry> &indexes = table->indexes;
+
+		if (unite) {
+			for (auto entry = indexes.begin(); entry != indexes.end(); ++entry) {
+				auto it = result_map.find(entry->index);
+				if (it == result_map.end()) {
+					it = result_map.insert(std::make_pair(entry->index, result.size())).first;
+					result.resize(result.size() + 1);
+					result.back().id = entry->index;
+				}
+
+				result[it->second].indexes.push_back(index_entry(request_entry.id, entry->data));
+			}
+		} else if (i == 0) {
+			result.resize(indexes.size());
+			for (size_t j = 0; j < indexes.size(); ++j) {
+				result[j].id = indexes[j].index;
+				result[j].indexes.push_back(index_entry(request_entry.id, indexes[j].data));
+			}
+		} else {
+			// Cached table is shared, so objects missing in it are dropped from result in one pass
+			// instead of intersecting table in place, both lists are sorted by object id
+			auto jt = indexes.begin();
+			auto out = result.begin();
+
+			for (auto kt = result.begin(); kt != result.end(); ++kt) {
+				jt = std::lower_bound(jt, indexes.end(), kt->id, dnet_raw_id_less_than<skip_data>());
+				if (jt == indexes.end())
+					break;
+				if (!(jt->index == kt->id))
+					continue;
+
+				kt->indexes.push_back(index_entry(request_entry.id, jt->data));
+				if (out != kt)
+					*out = std::move(*kt);
+				++out;
+			}
+
+			result.erase(out, result.end());
+		}
+	}
+
+	if (err != 0)
+		return err;
+
+	dnet_log(m_node, DNET_LOG_DEBUG, "%s: CACHE: INDEXES_FIND: result of find: %zu objects\n",
+		dnet_dump_id(&request_id), result.size());
+
+	msgpack::sbuffer buffer;
+	msgpack::pack(&buffer, result);
+
+	if (!more) {
+		// Positive reply is the last one, so there is no need in the separate acknowledge
+		cmd->flags &= ~DNET_FLAGS_NEED_ACK;
+	}
+	dnet_cmd cmd_copy = *cmd;
+	dnet_setup_id(&cmd_copy.id, cmd->id.group_id, request_id.id);
+	dnet_send_reply(st, &cmd_copy, buffer.data(), buffer.size(), more);
+
+	return err;
+}
+
+bool cache_manager::check_missing(const unsigned char *id) {
+	return m_negative_cache && m_negative_cache->contains(id);
+}
+
+void cache_manager::insert_missing(const unsigned char *id, uint64_t start) {
+	// Cached object may be not written to the disk yet, so backend miss does not mean it is missing
+	if (m_negative_cache && !m_caches[idx(id)]->contains(id))
+		m_negative_cache->insert(id, start);
+}
+
+void cache_manager::remove_missing(const unsigned char *id) {
+	if (m_negative_cache)
+		m_negative_cache->remove(id);
 }
 
 void cache_manager::clear() {
@@ -127,6 +349,36 @@ size_t cache_manager::cache_size() const
 	return m_max_cache_size;
 }
 
+void cache_manager::resize(size_t size)
+{
+	std::lock_guard<std::mutex> guard(m_control_lock);
+
+	dnet_log(m_node, DNET_LOG_INFO, "CACHE: resize: %zu -> %zu bytes\n", m_max_cache_size.load(), size);
+
+	std::vector<size_t> pages_max_sizes = get_pages_max_sizes(size / m_caches.size());
+	m_max_cache_size = size;
+
+	for (size_t i = 0; i < m_caches.size(); ++i) {
+		m_caches[i]->resize(pages_max_sizes);
+	}
+}
+
+void cache_manager::set_adaptive(bool adaptive)
+{
+	std::lock_guard<std::mutex> guard(m_control_lock);
+
+	m_adaptive = adaptive && m_cache_pages_number > 1;
+
+	for (size_t i = 0; i < m_caches.size(); ++i) {
+		m_caches[i]->set_adaptive(m_adaptive);
+	}
+}
+
+bool cache_manager::adaptive() const
+{
+	return m_adaptive;
+}
+
 size_t cache_manager::cache_pages_number() const
 {
 	return m_cache_pages_number;
@@ -149,12 +401,21 @@ cache_stats cache_manager::get_total_cache_stats() const {
 		stats.total_remove_time += page_stats.total_remove_time;
 		stats.total_lookup_time += page_stats.total_lookup_time;
 		stats.total_resize_time += page_stats.total_resize_time;
+		stats.number_of_hits += page_stats.number_of_hits;
+		stats.number_of_misses += page_stats.number_of_misses;
+		stats.number_of_rejected_objects += page_stats.number_of_rejected_objects;
+		stats.size_of_mapped_memory += page_stats.size_of_mapped_memory;
 
 		for (size_t j = 0; j < m_cache_pages_number; ++j) {
 			stats.pages_sizes[j] += page_stats.pages_sizes[j];
 			stats.pages_max_sizes[j] += page_stats.pages_max_sizes[j];
 		}
 	}
+
+	if (m_negative_cache) {
+		stats.number_of_negative_hits = m_negative_cache->hits();
+		stats.number_of_negative_misses = m_negative_cache->misses();
+	}
 	return stats;
 }
 
@@ -185,7 +446,13 @@ void cache_manager::dump_stats() const
 				<< "total_read_time " << stat.total_read_time << "\n"
 				<< "total_remove_time " << stat.total_remove_time << "\n"
 				<< "total_lookup_time " << stat.total_lookup_time << "\n"
-				<< "total_resize_time " << stat.total_resize_time << "\n";
+				<< "total_resize_time " << stat.total_resize_time << "\n"
+				<< "number_of_hits " << stat.number_of_hits << "\n"
+				<< "number_of_misses " << stat.number_of_misses << "\n"
+				<< "number_of_rejected_objects " << stat.number_of_rejected_objects << "\n"
+				<< "number_of_negative_hits " << stat.number_of_negative_hits << "\n"
+				<< "number_of_negative_misses " << stat.number_of_negative_misses << "\n"
+				<< "size_of_mapped_memory " << stat.size_of_mapped_memory << "\n";
 			os << "\n";
 		}
 
@@ -202,7 +469,11 @@ void cache_manager::dump_stats() const
 				<< "total_read_time " << stat.total_read_time << "\n"
 				<< "total_remove_time " << stat.total_remove_time << "\n"
 				<< "total_lookup_time " << stat.total_lookup_time << "\n"
-				<< "total_resize_time " << stat.total_resize_time << "\n";
+				<< "total_resize_time " << stat.total_resize_time << "\n"
+				<< "number_of_hits " << stat.number_of_hits << "\n"
+				<< "number_of_misses " << stat.number_of_misses << "\n"
+				<< "number_of_rejected_objects " << stat.number_of_rejected_objects << "\n"
+				<< "size_of_mapped_memory " << stat.size_of_mapped_memory << "\n";
 			os << "\n";
 		}
 		os.close();
@@ -220,7 +491,11 @@ inline void dump_cache_stat(rapidjson::Value &value, rapidjson::Document::Alloca
 	     .AddMember("total_read_time ", stats.total_read_time, allocator)
 	     .AddMember("total_remove_time ", stats.total_remove_time, allocator)
 	     .AddMember("total_lookup_time ", stats.total_lookup_time, allocator)
-	     .AddMember("total_resize_time ", stats.total_resize_time, allocator);
+	     .AddMember("total_resize_time ", stats.total_resize_time, allocator)
+	     .AddMember("number_of_hits", stats.number_of_hits, allocator)
+	     .AddMember("number_of_misses", stats.number_of_misses, allocator)
+	     .AddMember("number_of_rejected_objects", stats.number_of_rejected_objects, allocator)
+	     .AddMember("size_of_mapped_memory", stats.size_of_mapped_memory, allocator);
 }
 
 std::string cache_manager::stat_json() const {
@@ -230,6 +505,30 @@ std::string cache_manager::stat_json() const {
 
 	auto stat = get_total_cache_stats();
 	dump_cache_stat(doc, allocator, stat);
+	doc.AddMember("number_of_negative_hits", stat.number_of_negative_hits, allocator)
+	   .AddMember("number_of_negative_misses", stat.number_of_negative_misses, allocator);
+
+	if (m_miss_ratio_curve) {
+		static const double multipliers[] = {0.5, 1, 2, 4};
+		const size_t size = cache_size();
+
+		rapidjson::Value estimations(rapidjson::kArrayType);
+		for (size_t i = 0; i < sizeof(multipliers) / sizeof(multipliers[0]); ++i) {
+			const size_t estimated_size = size * multipliers[i];
+
+			rapidjson::Value estimation(rapidjson::kObjectType);
+			estimation.AddMember("size", estimated_size, allocator)
+			          .AddMember("hit_ratio", m_miss_ratio_curve->hit_ratio(estimated_size), allocator);
+			estimations.PushBack(estimation, allocator);
+		}
+
+		rapidjson::Value curve(rapidjson::kObjectType);
+		curve.AddMember("sampling", m_miss_ratio_curve->sampling(), allocator)
+		     .AddMember("sampled_accesses", m_miss_ratio_curve->sampled_accesses(), allocator)
+		     .AddMember("estimations", estimations, allocator);
+
+		doc.AddMember("miss_ratio_curve", curve, allocator);
+	}
 
 	auto stats = get_caches_stats();
 	rapidjson::Value caches(rapidjson::kArrayType);
@@ -247,6 +546,108 @@ std::string cache_manager::stat_json() const {
 	return buffer.GetString();
 }
 
+/*
+ * Snapshot is loaded in background while node serves requests, objects are put into the cache
+ * only if they are still absent there and there is free space for them.
+ * Snapshot is saved only after it has been loaded, otherwise not yet loaded objects would be lost.
+ */
+void cache_manager::snapshot_loop()
+{
+	load_snapshot();
+	m_snapshot_loaded = !stop;
+
+	time_t next_save = time(NULL) + m_snapshot_interval;
+
+	while (!stop && m_snapshot_interval) {
+		if (time(NULL) >= next_save) {
+			save_snapshot();
+			next_save = time(NULL) + m_snapshot_interval;
+		}
+		sleep(1);
+	}
+}
+
+void cache_manager::load_snapshot()
+{
+	if (access(m_snapshot_path.c_str(), F_OK)) {
+		dnet_log(m_node, DNET_LOG_NOTICE, "CACHE: snapshot: '%s' does not exist, starting with empty cache\n",
+			m_snapshot_path.c_str());
+		return;
+	}
+
+	elliptics_timer timer;
+	size_t records_number = 0;
+	size_t restored_number = 0;
+
+	try {
+		snapshot_reader reader(m_snapshot_path);
+
+		const snapshot_record *record;
+		const char *data;
+
+		while (!stop && reader.next(record, data)) {
+			++records_number;
+			if (m_caches[idx(record->id)]->restore(*record, data))
+				++restored_number;
+		}
+	} catch (const std::exception &e) {
+		dnet_log(m_node, DNET_LOG_ERROR, "CACHE: snapshot: load failed: %s\n", e.what());
+	}
+
+	dnet_log(m_node, DNET_LOG_INFO, "CACHE: snapshot: restored %zu of %zu objects from '%s': %lld ms\n",
+		restored_number, records_number, m_snapshot_path.c_str(), timer.elapsed());
+}
+
+void cache_manager::save_snapshot()
+{
+	elliptics_timer timer;
+
+	snapshot_header header;
+	memset(&header, 0, sizeof(header));
+	header.magic = snapshot_magic;
+	header.version = snapshot_version;
+	header.pages_number = m_cache_pages_number;
+	dnet_current_time(&header.timestamp);
+
+	try {
+		snapshot_writer writer(m_snapshot_path, header);
+		std::vector<snapshot_entry> entries;
+
+		// Shards are written one by one, so only single shard's metadata is kept in memory
+		for (size_t i = 0; i < m_caches.size(); ++i) {
+			entries.clear();
+			m_caches[i]->snapshot(entries);
+
+			for (auto it = entries.begin(); it != entries.end(); ++it) {
+				writer.write(it->record, it->data->data());
+			}
+		}
+
+		entries.clear();
+		writer.commit();
+
+		dnet_log(m_node, DNET_LOG_INFO, "CACHE: snapshot: saved %zu objects to '%s': %lld ms\n",
+			writer.records_number(), m_snapshot_path.c_str(), timer.elapsed());
+	} catch (const std::exception &e) {
+		dnet_log(m_node, DNET_LOG_ERROR, "CACHE: snapshot: save failed: %s\n", e.what());
+	}
+}
+
+std::vector<size_t> cache_manager::get_pages_max_sizes(size_t cache_size) const
+{
+	size_t proportions_sum = 0;
+	for (size_t i = 0; i < m_cache_pages_number; ++i) {
+		proportions_sum += m_node->cache_pages_proportions[i];
+	}
+
+	std::vector<size_t> pages_max_sizes(m_cache_pages_number);
+	for (size_t i = 0; i < m_cache_pages_number; ++i) {
+		pages_max_sizes[i] = cache_size * (m_node->cache_pages_proportions[i] * 1.0 / proportions_sum);
+	}
+
+	return pages_max_sizes;
+}
+
 size_t cache_manager::idx(const unsigned char *id) {
 	size_t i = *(size_t *)id;
 	size_t j = *(size_t *)(id + DNET_ID_SIZE - sizeof(size_t));
@@ -270,7 +671,8 @@ int dnet_cmd_cache_io(struct dnet_net_state *st, struct dnet_cmd *cmd, struct dn
 	}
 
 	cache_manager *cache = (cache_manager *)n->cache;
-	std::shared_ptr<raw_data_t> d;
+	raw_data_ptr d;
+	size_t data_offset = 0;
 
 	try {
 		switch (cmd->cmd) {
@@ -278,13 +680,26 @@ int dnet_cmd_cache_io(struct dnet_net_state *st, struct dnet_cmd *cmd, struct dn
 				err = cache->write(io->id, st, cmd, io, data);
 				break;
 			case DNET_CMD_READ:
-				d = cache->read(io->id, cmd, io);
+				// Ranges smaller than the object cache only chunks covering them,
+				// other reads cache the whole object
+				if (n->cache_chunk_size
+						&& (io->flags & DNET_IO_FLAGS_CACHE) && !(io->flags & DNET_IO_FLAGS_CACHE_ONLY)
+						&& cache->read_by_chunks(io->id, io)) {
+					d = cache->read_range(io->id, io, &data_offset, &err);
+					if (!d) {
+						break;
+					}
+
+					cmd->flags &= ~DNET_FLAGS_NEED_ACK;
+					err = dnet_send_read_data(st, cmd, io, d->data() + data_offset, -1, io->offset, 0);
+					break;
+				}
+
+				d = cache->read(io->id, cmd, io, &err);
 				if (!d) {
-					if (!(io->flags & DNET_IO_FLAGS_CACHE)) {
+					if (err == -ENOTSUP) {
 						return -ENOTSUP;
 					}
-
-					err = -ENOENT;
 					break;
 				}
 
@@ -302,7 +717,7 @@ int dnet_cmd_cache_io(struct dnet_net_state *st, struct dnet_cmd *cmd, struct dn
 					io->size = d->size() - io->offset;
 
 				cmd->flags &= ~DNET_FLAGS_NEED_ACK;
-				err = dnet_send_read_data(st, cmd, io, (char *)d->data().data() + io->offset, -1, io->offset, 0);
+				err = dnet_send_read_data(st, cmd, io, d->data() + io->offset, -1, io->offset, 0);
 				break;
 			case DNET_CMD_DEL:
 				err = cache->remove(cmd->id.id, io);
@@ -322,8 +737,8 @@ int dnet_cmd_cache_indexes(struct dnet_net_state *st, struct dnet_cmd *cmd, stru
 	struct dnet_node *n = st->n;
 	int err = -ENOTSUP;
 
+	// Indexes are processed by the backend path on nodes without cache
 	if (!n->cache) {
-		dnet_log(n, DNET_LOG_ERROR, "%s: cache is not supported\n", dnet_dump_id(&cmd->id));
 		return -ENOTSUP;
 	}
 
@@ -332,13 +747,13 @@ int dnet_cmd_cache_indexes(struct dnet_net_state *st, struct dnet_cmd *cmd, stru
 	try {
 		switch (cmd->cmd) {
 			case DNET_CMD_INDEXES_FIND:
-				err = cache->indexes_find(cmd, request);
+				err = cache->indexes_find(st, cmd, request);
 				break;
 			case DNET_CMD_INDEXES_UPDATE:
-				err = cache->indexes_update(cmd, request);
+				err = cache->indexes_update(st, cmd, request);
 				break;
 			case DNET_CMD_INDEXES_INTERNAL:
-				err = cache->indexes_internal(cmd, request);
+				err = cache->indexes_internal(st, cmd, request);
 				break;
 		}
 	} catch (const std::exception &e) {
@@ -373,6 +788,56 @@ int dnet_cmd_cache_lookup(struct dnet_net_state *st, struct dnet_cmd *cmd)
 	return err;
 }
 
+int dnet_cache_check_missing(struct dnet_node *n, const unsigned char *id)
+{
+	if (!n->cache)
+		return 0;
+
+	return ((cache_manager *)n->cache)->check_missing(id);
+}
+
+void dnet_cache_insert_missing(struct dnet_node *n, const unsigned char *id, const struct timeval *start)
+{
+	if (!n->cache)
+		return;
+
+	((cache_manager *)n->cache)->insert_missing(id, start->tv_sec * 1000000ULL + start->tv_usec);
+}
+
+void dnet_cache_remove_missing(struct dnet_node *n, const unsigned char *id)
+{
+	if (!n->cache)
+		return;
+
+	((cache_manager *)n->cache)->remove_missing(id);
+}
+
+int dnet_cache_control(struct dnet_node *n, struct dnet_cache_control *ctl)
+{
+	if (!n->cache) {
+		dnet_log(n, DNET_LOG_ERROR, "cache control: cache is not supported\n");
+		return -ENOTSUP;
+	}
+
+	cache_manager *cache = (cache_manager *)n->cache;
+
+	try {
+		if (ctl->size)
+			cache->resize(ctl->size);
+
+		if (ctl->adaptive != -1)
+			cache->set_adaptive(ctl->adaptive);
+	} catch (const std::exception &e) {
+		dnet_log_raw(n, DNET_LOG_ERROR, "cache control failed: %s\n", e.what());
+		return -ENOMEM;
+	}
+
+	ctl->size = cache->cache_size();
+	ctl->adaptive = cache->adaptive();
+	ctl->pages_number = cache->cache_pages_number();
+	return 0;
+}
+
 int dnet_cache_init(struct dnet_node *n)
 {
 	if (!n->cache_size)
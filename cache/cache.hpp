@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <mutex>
+#include <condition_variable>
 #include <thread>
 #include <cstdio>
 #include <unordered_map>
@@ -14,6 +15,8 @@
 #endif
 
 #include <boost/intrusive/list.hpp>
+#include <boost/intrusive/set.hpp>
+#include <boost/intrusive_ptr.hpp>
 
 #include "../library/elliptics.h"
 #include "../indexes/local_session.h"
@@ -21,27 +24,113 @@
 #include "elliptics/packet.h"
 #include "elliptics/interface.h"
 
-#include "treap.hpp"
+#include "frequency_sketch.hpp"
+#include "hash_table.hpp"
+#include "miss_ratio_curve.hpp"
+#include "negative_cache.hpp"
+#include "slab_allocator.hpp"
+#include "timer_wheel.hpp"
 
 namespace ioremap { namespace cache {
 
+class raw_data_t;
+
+typedef boost::intrusive_ptr<raw_data_t> raw_data_ptr;
+
+/*
+ * Object payload. Header and data are placed in a single slab chunk,
+ * capacity is the whole chunk except the header, so appends which fit
+ * into the size class rounding don't reallocate anything.
+ *
+ * Payload is shared between cache and readers which are sending it,
+ * so it must not be modified in place if it is not unique.
+ */
 class raw_data_t {
 public:
-	raw_data_t(const char *data, size_t size) {
-		m_data.reserve(size);
-		m_data.insert(m_data.begin(), data, data + size);
+	static raw_data_ptr create(slab_allocator &allocator, const char *data, size_t size, size_t capacity) {
+		capacity = std::max(size, capacity);
+		const size_t allocated = slab_allocator::allocated_size(sizeof(raw_data_t) + capacity);
+
+		raw_data_t *raw = new (allocator.allocate(allocated)) raw_data_t(allocator, allocated - sizeof(raw_data_t));
+		if (size) {
+			memcpy(raw->data(), data, size);
+		}
+		raw->m_size = size;
+
+		return raw_data_ptr(raw);
 	}
 
-	std::vector<char> &data(void) {
-		return m_data;
+	raw_data_t(const raw_data_t &) = delete;
+	raw_data_t &operator =(const raw_data_t &) = delete;
+
+	char *data(void) {
+		return reinterpret_cast<char *>(this + 1);
 	}
 
-	size_t size(void) {
-		return m_data.size();
+	const char *data(void) const {
+		return reinterpret_cast<const char *>(this + 1);
+	}
+
+	size_t size(void) const {
+		return m_size;
+	}
+
+	void set_size(size_t size) {
+		m_size = size;
+	}
+
+	size_t capacity(void) const {
+		return m_capacity;
+	}
+
+	size_t allocated_size(void) const {
+		return sizeof(raw_data_t) + m_capacity;
+	}
+
+	bool unique(void) const {
+		return m_refcnt == 1;
+	}
+
+	/*
+	 * Grows unique payload to @capacity bytes, large payloads are remapped instead of copied
+	 */
+	static raw_data_ptr grow(raw_data_ptr &&raw, size_t capacity) {
+		raw_data_t *ptr = raw.detach();
+		slab_allocator &allocator = ptr->m_allocator;
+
+		const size_t allocated = slab_allocator::allocated_size(sizeof(raw_data_t) + capacity);
+		ptr = static_cast<raw_data_t *>(allocator.reallocate(ptr, ptr->allocated_size(), allocated));
+		ptr->m_capacity = allocated - sizeof(raw_data_t);
+
+		return raw_data_ptr(ptr, false);
+	}
+
+	friend void intrusive_ptr_add_ref(raw_data_t *raw) {
+		++raw->m_refcnt;
+	}
+
+	friend void intrusive_ptr_release(raw_data_t *raw) {
+		if (--raw->m_refcnt == 0) {
+			slab_allocator &allocator = raw->m_allocator;
+			const size_t allocated = raw->allocated_size();
+
+			raw->~raw_data_t();
+			allocator.deallocate(raw, allocated);
+		}
 	}
 
 private:
-	std::vector<char> m_data;
+	raw_data_t(slab_allocator &allocator, size_t capacity) :
+		m_allocator(allocator), m_refcnt(0), m_size(0), m_capacity(capacity) {
+	}
+
+	~raw_data_t() {
+	}
+
+	slab_allocator &m_allocator;
+	std::atomic<int> m_refcnt;
+	size_t m_size;
+	size_t m_capacity;
 };
 
 struct data_lru_tag_t;
@@ -49,22 +138,22 @@ typedef boost::intrusive::list_base_hook<boost::intrusive::tag<data_lru_tag_t>,
 boost::intrusive::link_mode<boost::intrusive::safe_link>, boost::intrusive::optimize_size<true>
 > lru_list_base_hook_t;
 
-class data_t : public lru_list_base_hook_t, public treap_node_t<data_t> {
-public:
-	data_t(const unsigned char *id) {
-		memcpy(m_id.id, id, DNET_ID_SIZE);
-	}
+struct data_timer_tag_t;
+typedef boost::intrusive::list_base_hook<boost::intrusive::tag<data_timer_tag_t>,
+boost::intrusive::link_mode<boost::intrusive::auto_unlink>
+> timer_wheel_base_hook_t;
 
-	data_t(const unsigned char *id, size_t lifetime, const char *data, size_t size, bool remove_from_disk) :
-		m_lifetime(0), m_synctime(0), m_user_flags(0),
-		m_remove_from_disk(remove_from_disk), m_remove_from_cache(false), m_only_append(false) {
+class data_t : public lru_list_base_hook_t, public timer_wheel_base_hook_t {
+public:
+	data_t(const unsigned char *id, size_t lifetime, const raw_data_ptr &data, bool remove_from_disk) :
+		m_lifetime(0), m_synctime(0), m_timer_deadline(0), m_user_flags(0), m_chunk(0),
+		m_remove_from_disk(remove_from_disk), m_remove_from_cache(false), m_only_append(false), m_index_table(false), m_promoted(false),
+		m_data(data) {
 		memcpy(m_id.id, id, DNET_ID_SIZE);
 		dnet_empty_time(&m_timestamp);
 
 		if (lifetime)
 			m_lifetime = lifetime + time(NULL);
-
-		m_data.reset(new raw_data_t(data, size));
 	}
 
 	data_t(const data_t &other) = delete;
@@ -77,10 +166,18 @@ public:
 		return m_id;
 	}
 
-	std::shared_ptr<raw_data_t> data(void) const {
+	const raw_data_ptr &data(void) const {
 		return m_data;
 	}
 
+	void set_data(raw_data_ptr &&data) {
+		m_data = std::move(data);
+	}
+
+	raw_data_ptr release_data(void) {
+		return std::move(m_data);
+	}
+
 	size_t lifetime(void) const {
 		return m_lifetime;
 	}
@@ -97,6 +194,21 @@ public:
 		m_synctime = synctime;
 	}
 
+	bool has_eventtime() const {
+		return m_lifetime || m_synctime;
+	}
+
+	/*
+	 * Time in milliseconds when object is due in the timer wheel
+	 */
+	uint64_t timer_deadline() const {
+		return m_timer_deadline;
+	}
+
+	void set_timer_deadline(uint64_t deadline) {
+		m_timer_deadline = deadline;
+	}
+
 	size_t eventtime() const {
         size_t time = 0;
 		if (!time || (lifetime() && time > lifetime()))
@@ -162,16 +274,56 @@ public:
 		m_only_append = only_append;
 	}
 
+	/*
+	 * Object is a secondary index table which is also kept decoded by the cache
+	 */
+	bool index_table() const {
+		return m_index_table;
+	}
+
+	void set_index_table(bool index_table) {
+		m_index_table = index_table;
+	}
+
+	/*
+	 * Object has been moved out of the last page at least once
+	 */
+	bool promoted() const {
+		return m_promoted;
+	}
+
+	void set_promoted(bool promoted) {
+		m_promoted = promoted;
+	}
+
+	/*
+	 * Chunk number plus one for objects holding a chunk of some bigger object, 0 for whole objects
+	 */
+	uint64_t chunk() const {
+		return m_chunk;
+	}
+
+	void set_chunk(uint64_t chunk) {
+		m_chunk = chunk;
+	}
+
+	/*
+	 * Number of bytes charged to the cache for the object, it includes its share of slab pages
+	 */
 	size_t size(void) const {
-		return capacity() + overhead_size();
+		return node_size() + slab_allocator::charged_size(m_data->allocated_size());
 	}
 
 	size_t overhead_size(void) const {
-		return sizeof(*this) + sizeof(*m_data);
+		return node_size() + sizeof(raw_data_t);
 	}
 
 	size_t capacity(void) const {
-		return m_data->data().capacity();
+		return m_data->capacity();
+	}
+
+	static size_t node_size(void) {
+		return slab_allocator::charged_size(sizeof(data_t));
 	}
 
 	friend bool operator< (const data_t &a, const data_t &b) {
@@ -189,26 +341,60 @@ public:
 private:
 	size_t m_lifetime;
 	size_t m_synctime;
+	uint64_t m_timer_deadline;
 	dnet_time m_timestamp;
 	uint64_t m_user_flags;
+	uint64_t m_chunk;
 	bool m_remove_from_disk;
 	bool m_remove_from_cache;
 	bool m_only_append;
+	bool m_index_table;
+	bool m_promoted;
 	char m_cache_page_number;
 	struct dnet_raw_id m_id;
-	std::shared_ptr<raw_data_t> m_data;
+	raw_data_ptr m_data;
 };
 
 typedef boost::intrusive::list<data_t, boost::intrusive::base_hook<lru_list_base_hook_t> > lru_list_t;
 
-struct eventtime_less {
-	bool operator() (const data_t &x, const data_t &y) const {
-		return x.eventtime() < y.eventtime()
-				|| (x.eventtime() == y.eventtime() && ((&x) < (&y)));
+/*
+ * Only objects with lifetime or synctime are placed here,
+ * objects which never expire don't cost anything in the wheel
+ */
+typedef timer_wheel<data_t, timer_wheel_base_hook_t> timer_wheel_t;
+
+typedef hash_table<data_t> hash_table_t;
+
+/*
+ * Ids are already uniformly distributed hashes,
+ * so their first bytes are good enough as a hash value
+ */
+struct raw_id_hash {
+	size_t operator() (const dnet_raw_id &id) const {
+		size_t hash;
+		memcpy(&hash, id.id, sizeof(hash));
+		return hash;
 	}
 };
 
-typedef treap<data_t> treap_t;
+struct raw_id_equal {
+	bool operator() (const dnet_raw_id &x, const dnet_raw_id &y) const {
+		return memcmp(x.id, y.id, DNET_ID_SIZE) == 0;
+	}
+};
+
+/*
+ * Chunk of the object is cached under the object id with first 8 bytes mixed with the chunk number.
+ * Transformation is an involution, so applying it to the chunk id gives the object id back.
+ */
+inline void chunk_id(const unsigned char *id, uint64_t chunk, unsigned char *result) {
+	uint64_t prefix;
+
+	memcpy(result, id, DNET_ID_SIZE);
+	memcpy(&prefix, id, sizeof(prefix));
+	prefix ^= (chunk + 1) * 0x9e3779b97f4a7c15ULL;
+	memcpy(result, &prefix, sizeof(prefix));
+}
 
 struct atomic_cache_stats {
 	atomic_cache_stats():
@@ -217,7 +403,8 @@ struct atomic_cache_stats {
 		total_lifecheck_time(0),
 		total_write_time(0),
 		total_read_time(0),
-		total_remove_time(0), total_lookup_time(0), total_resize_time(0) {}
+		total_remove_time(0), total_lookup_time(0), total_resize_time(0),
+		number_of_hits(0), number_of_misses(0), number_of_rejected_objects(0) {}
 
 	std::atomic_size_t number_of_objects;
 	std::atomic_size_t size_of_objects;
@@ -230,6 +417,10 @@ struct atomic_cache_stats {
 	std::atomic_size_t total_remove_time;
 	std::atomic_size_t total_lookup_time;
 	std::atomic_size_t total_resize_time;
+
+	std::atomic_size_t number_of_hits;
+	std::atomic_size_t number_of_misses;
+	std::atomic_size_t number_of_rejected_objects;
 };
 
 struct cache_stats {
@@ -243,14 +434,22 @@ struct cache_stats {
 		total_read_time(stats.total_read_time),
 		total_remove_time(stats.total_remove_time),
 		total_lookup_time(stats.total_lookup_time),
-		total_resize_time(stats.total_resize_time)
+		total_resize_time(stats.total_resize_time),
+		number_of_hits(stats.number_of_hits),
+		number_of_misses(stats.number_of_misses),
+		number_of_rejected_objects(stats.number_of_rejected_objects),
+		number_of_negative_hits(0), number_of_negative_misses(0),
+		size_of_mapped_memory(0)
 	{}
 
 	cache_stats():
 		number_of_objects(0), size_of_objects(0),
 		number_of_objects_marked_for_deletion(0), size_of_objects_marked_for_deletion(0),
 		total_lifecheck_time(0), total_write_time(0), total_read_time(0),
-		total_remove_time(0), total_lookup_time(0), total_resize_time(0) {}
+		total_remove_time(0), total_lookup_time(0), total_resize_time(0),
+		number_of_hits(0), number_of_misses(0), number_of_rejected_objects(0),
+		number_of_negative_hits(0), number_of_negative_misses(0),
+		size_of_mapped_memory(0) {}
 
 	size_t number_of_objects;
 	size_t size_of_objects;
@@ -264,10 +463,62 @@ struct cache_stats {
 	size_t total_lookup_time;
 	size_t total_resize_time;
 
+	/* Reads served from the cache and reads of objects which were not there */
+	size_t number_of_hits;
+	size_t number_of_misses;
+	/* Missed objects which were not put into the cache by admission policy */
+	size_t number_of_rejected_objects;
+
+	/* Reads and lookups answered by the negative cache and those which went further, only in total stats */
+	size_t number_of_negative_hits;
+	size_t number_of_negative_misses;
+
+	/* Memory taken by cache allocator from the system */
+	size_t size_of_mapped_memory;
+
 	std::vector<size_t> pages_sizes;
 	std::vector<size_t> pages_max_sizes;
 };
 
+/*
+ * Limits number of caches writing dirty objects back to the disk at the same time,
+ * satisfies Lockable requirements, so it can be used with std::lock_guard
+ */
+class writeback_limiter {
+public:
+	writeback_limiter(size_t concurrency) : m_available(concurrency) {}
+
+	writeback_limiter(const writeback_limiter &) = delete;
+	writeback_limiter &operator =(const writeback_limiter &) = delete;
+
+	void lock() {
+		std::unique_lock<std::mutex> guard(m_lock);
+		m_wait.wait(guard, [this] () { return m_available > 0; });
+		--m_available;
+	}
+
+	bool try_lock() {
+		std::unique_lock<std::mutex> guard(m_lock);
+		if (!m_available)
+			return false;
+		--m_available;
+		return true;
+	}
+
+	void unlock() {
+		{
+			std::unique_lock<std::mutex> guard(m_lock);
+			++m_available;
+		}
+		m_wait.notify_one();
+	}
+
+private:
+	std::mutex m_lock;
+	std::condition_variable m_wait;
+	size_t m_available;
+};
+
 class slru_cache_t;
 
 class cache_manager {
@@ -278,20 +529,44 @@ class cache_manager {
 
 		int write(const unsigned char *id, dnet_net_state *st, dnet_cmd *cmd, dnet_io_attr *io, const char *data);
 
-		std::shared_ptr<raw_data_t> read(const unsigned char *id, dnet_cmd *cmd, dnet_io_attr *io);
+		raw_data_ptr read(const unsigned char *id, dnet_cmd *cmd, dnet_io_attr *io, int *err);
+
+		raw_data_ptr read_range(const unsigned char *id, dnet_io_attr *io, size_t *data_offset, int *err);
+
+		bool chunked(const unsigned char *id);
+
+		bool read_by_chunks(const unsigned char *id, const dnet_io_attr *io);
 
 		int remove(const unsigned char *id, dnet_io_attr *io);
 
 		int lookup(const unsigned char *id, dnet_net_state *st, dnet_cmd *cmd);
 
-		int indexes_find(dnet_cmd *cmd, dnet_indexes_request *request);
+		/*
+		 * Index commands return -ENOTSUP if they should be processed by the backend path
+		 */
+		int indexes_find(dnet_net_state *st, dnet_cmd *cmd, dnet_indexes_request *request);
+
+		int indexes_update(dnet_net_state *st, dnet_cmd *cmd, dnet_indexes_request *request);
 
-		int indexes_update(dnet_cmd *cmd, dnet_indexes_request *request);
+		int indexes_internal(dnet_net_state *st, dnet_cmd *cmd, dnet_indexes_request *request);
 
-		int indexes_internal(dnet_cmd *cmd, dnet_indexes_request *request);
+		bool check_missing(const unsigned char *id);
+
+		void insert_missing(const unsigned char *id, uint64_t start);
+
+		void remove_missing(const unsigned char *id);
 
 		void clear();
 
+		/*
+		 * Changes total size of the cache, number of shards and proportions of pages are kept
+		 */
+		void resize(size_t size);
+
+		void set_adaptive(bool adaptive);
+
+		bool adaptive() const;
+
 		size_t cache_size() const;
 
 		size_t cache_pages_number() const;
@@ -304,39 +579,62 @@ class cache_manager {
 
 		std::string stat_json() const;
 
+		/*
+		 * Restores objects of the snapshot which are still valid on the disk,
+		 * snapshot thread calls it once on start
+		 */
+		void load_snapshot();
+
+		/*
+		 * Writes the whole cache into the new snapshot which replaces the old one
+		 */
+		void save_snapshot();
+
 	private:
+		struct dnet_node *m_node;
+		/* Must outlive caches, they use it until their threads are stopped */
+		writeback_limiter m_writeback;
 		std::vector<std::shared_ptr<slru_cache_t>> m_caches;
-		size_t m_max_cache_size;
+		/* NULL if negative cache is disabled */
+		std::unique_ptr<negative_cache> m_negative_cache;
+		/* NULL if hit ratio estimation is disabled */
+		std::unique_ptr<miss_ratio_curve> m_miss_ratio_curve;
+		std::atomic_size_t m_max_cache_size;
 		size_t m_cache_pages_number;
+		/* Serializes resize() and set_adaptive() */
+		std::mutex m_control_lock;
+		bool m_adaptive;
 		std::thread m_dump_stats;
+		std::string m_snapshot_path;
+		size_t m_snapshot_interval;
+		bool m_snapshot_loaded;
+		std::thread m_snapshot;
 		bool stop;
 
 		size_t idx(const unsigned char *id);
+
+		/*
+		 * Splits shard of the cache of @cache_size bytes into pages by cache_pages_proportions
+		 */
+		std::vector<size_t> get_pages_max_sizes(size_t cache_size) const;
+
+		int find_indexes(dnet_net_state *st, dnet_cmd *cmd, const dnet_id &request_id, dnet_indexes_request *request, bool more);
+
+		void snapshot_loop();
 };
 
 template <typename T>
 class elliptics_unique_lock
 {
 public:
-	elliptics_unique_lock(T &mutex, dnet_node *node, const char *format, ...) __attribute__ ((format(printf, 4, 5)))
-		: m_node(node)
+	/*
+	 * Lock is accounted to @site in the lock profiler, @id only names the lock in the log
+	 * when it was waited for or held for too long
+	 */
+	elliptics_unique_lock(T &mutex, dnet_node *node, dnet_lock_site *site, const unsigned char *id = NULL)
+		: m_guard(mutex, std::defer_lock), m_node(node), m_site(site), m_id(id), m_sampled(false), m_locked_at(0)
 	{
-		va_list args;
-		va_start(args, format);
-
-		vsnprintf(m_name, sizeof(m_name), format, args);
-
-		va_end(args);
-
-		long vatime = m_timer.elapsed();
-		m_guard = std::move(std::unique_lock<T>(mutex));
-		int level = DNET_LOG_DEBUG;
-
-		if (m_timer.elapsed() > 100)
-			level = DNET_LOG_ERROR;
-
-		dnet_log(m_node, level, "%s: cache lock: constructor: vatime: %ld, total: %lld ms\n", m_name, vatime, m_timer.elapsed());
-		m_timer.restart();
+		lock();
 	}
 
 	~elliptics_unique_lock()
@@ -350,34 +648,58 @@ public:
 		return m_guard.owns_lock();
 	}
 
+	/*
+	 * Hold time of every acquisition is checked by the coarse clock,
+	 * only sampled ones are measured precisely and put into the histogram
+	 */
 	void lock()
 	{
+		m_sampled = dnet_lock_profile_sample(m_site);
+
+		if (m_guard.try_lock()) {
+			m_locked_at = m_sampled ? dnet_lock_profile_time() : dnet_lock_profile_coarse_time();
+			return;
+		}
+
+		const uint64_t start = dnet_lock_profile_time();
 		m_guard.lock();
-		int level = DNET_LOG_DEBUG;
+		const uint64_t now = dnet_lock_profile_wait(m_site, start);
 
-		if (m_timer.elapsed() > 100)
-			level = DNET_LOG_ERROR;
-		dnet_log(m_node, level, "%s: cache lock: lock: %lld ms\n", m_name, m_timer.elapsed());
-		m_timer.restart();
+		m_locked_at = m_sampled ? now : dnet_lock_profile_coarse_time();
+		report("wait", now - start);
 	}
 
 	void unlock()
 	{
+		const uint64_t locked_at = m_locked_at;
 		m_guard.unlock();
 
-		int level = DNET_LOG_DEBUG;
-
-		if (m_timer.elapsed() > 100)
-			level = DNET_LOG_ERROR;
-		dnet_log(m_node, level, "%s: cache lock: unlock: %lld ms\n", m_name, m_timer.elapsed());
-		m_timer.restart();
+		if (m_sampled)
+			report("hold", dnet_lock_profile_hold(m_site, locked_at));
+		else
+			report("hold", dnet_lock_profile_coarse_time() - locked_at);
 	}
 
 private:
+	enum {
+		/* Waits and holds longer than this are logged, microseconds */
+		slow_time = 100000
+	};
+
+	void report(const char *action, uint64_t time)
+	{
+		if (time > slow_time) {
+			dnet_log(m_node, DNET_LOG_ERROR, "%s: %s: cache lock: %s: %llu ms\n",
+				m_id ? dnet_dump_id_str(m_id) : "-", m_site->name, action, (unsigned long long)time / 1000);
+		}
+	}
+
 	std::unique_lock<T> m_guard;
 	dnet_node *m_node;
-	char m_name[256];
-	elliptics_timer m_timer;
+	dnet_lock_site *m_site;
+	const unsigned char *m_id;
+	bool m_sampled;
+	uint64_t m_locked_at;
 };
 
 }}
@@ -0,0 +1,190 @@
+#ifndef FREQUENCY_SKETCH_HPP
+#define FREQUENCY_SKETCH_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "elliptics/packet.h"
+
+namespace ioremap { namespace cache {
+
+/*
+ * Approximate access frequency of keys used by TinyLFU admission policy.
+ *
+ * Frequencies are kept in count-min sketch of 4-bit counters, 4 rows.
+ * Keys seen only once during the current period are remembered in a small bloom filter
+ * (doorkeeper) instead, so one-hit wonders of scans do not pollute the sketch.
+ * After a period of sample_size additions all counters are halved and the doorkeeper
+ * is cleared, so frequencies reflect recent history only.
+ */
+class frequency_sketch {
+public:
+	enum {
+		min_width = 1024,
+		max_width = 1 << 22,
+		rows_number = 4,
+		max_frequency = 15
+	};
+
+	/*
+	 * @capacity is the expected number of distinct keys in the cache
+	 */
+	frequency_sketch(size_t capacity) : m_additions(0) {
+		size_t width = min_width;
+		while (width < capacity && width < max_width)
+			width <<= 1;
+
+		m_mask = width - 1;
+		m_sample_size = 10 * width;
+		m_counters.assign(rows_number * width / counters_per_word, 0);
+		m_doorkeeper.assign(width * doorkeeper_bits_per_key / bits_per_word, 0);
+	}
+
+	frequency_sketch(const frequency_sketch &) = delete;
+	frequency_sketch &operator =(const frequency_sketch &) = delete;
+
+	/*
+	 * Records single access to the key
+	 */
+	void increment(const unsigned char *id) {
+		hashes_t hashes(id);
+
+		// Counters are incremented only for keys which have already passed the doorkeeper
+		if (doorkeeper_insert(hashes)) {
+			for (size_t row = 0; row < rows_number; ++row) {
+				increment_counter(row, counter_index(hashes, row));
+			}
+		}
+
+		if (++m_additions >= m_sample_size) {
+			reset();
+		}
+	}
+
+	size_t estimate(const unsigned char *id) const {
+		hashes_t hashes(id);
+
+		size_t frequency = max_frequency;
+		for (size_t row = 0; row < rows_number; ++row) {
+			frequency = std::min(frequency, counter(row, counter_index(hashes, row)));
+		}
+
+		return frequency + (doorkeeper_contains(hashes) ? 1 : 0);
+	}
+
+	/*
+	 * Number of bytes used by the sketch
+	 */
+	size_t memory_usage() const {
+		return (m_counters.capacity() + m_doorkeeper.capacity()) * sizeof(uint64_t);
+	}
+
+private:
+	enum {
+		bits_per_word = 64,
+		counters_per_word = 16,
+		doorkeeper_bits_per_key = 8
+	};
+
+	/*
+	 * Ids are hashes already, but they may be set by users,
+	 * so their words are mixed once more before use
+	 */
+	struct hashes_t {
+		hashes_t(const unsigned char *id) {
+			uint64_t words[4];
+			memcpy(words, id, sizeof(words));
+
+			counter_hash = mix(words[0]);
+			counter_step = mix(words[1]) | 1;
+			doorkeeper_hash[0] = mix(words[2]);
+			doorkeeper_hash[1] = mix(words[3]);
+		}
+
+		static uint64_t mix(uint64_t hash) {
+			hash ^= hash >> 33;
+			hash *= 0xff51afd7ed558ccdULL;
+			hash ^= hash >> 33;
+			hash *= 0xc4ceb9fe1a85ec53ULL;
+			hash ^= hash >> 33;
+			return hash;
+		}
+
+		uint64_t counter_hash;
+		uint64_t counter_step;
+		uint64_t doorkeeper_hash[2];
+	};
+
+	size_t counter_index(const hashes_t &hashes, size_t row) const {
+		return (hashes.counter_hash + row * hashes.counter_step) & m_mask;
+	}
+
+	size_t counter(size_t row, size_t index) const {
+		const size_t position = row * (m_mask + 1) + index;
+		const size_t shift = (position % counters_per_word) * 4;
+		return (m_counters[position / counters_per_word] >> shift) & 0xf;
+	}
+
+	void increment_counter(size_t row, size_t index) {
+		const size_t position = row * (m_mask + 1) + index;
+		const size_t shift = (position % counters_per_word) * 4;
+		uint64_t &word = m_counters[position / counters_per_word];
+
+		if (((word >> shift) & 0xf) < max_frequency) {
+			word += uint64_t(1) << shift;
+		}
+	}
+
+	bool doorkeeper_contains(const hashes_t &hashes) const {
+		const size_t bits = m_doorkeeper.size() * bits_per_word;
+
+		for (size_t i = 0; i < 2; ++i) {
+			const size_t bit = hashes.doorkeeper_hash[i] % bits;
+			if (!(m_doorkeeper[bit / bits_per_word] & (uint64_t(1) << (bit % bits_per_word))))
+				return false;
+		}
+
+		return true;
+	}
+
+	/*
+	 * Returns true if the key has already been in the doorkeeper
+	 */
+	bool doorkeeper_insert(const hashes_t &hashes) {
+		const size_t bits = m_doorkeeper.size() * bits_per_word;
+		bool contains = true;
+
+		for (size_t i = 0; i < 2; ++i) {
+			const size_t bit = hashes.doorkeeper_hash[i] % bits;
+			uint64_t &word = m_doorkeeper[bit / bits_per_word];
+			const uint64_t mask = uint64_t(1) << (bit % bits_per_word);
+
+			if (!(word & mask)) {
+				contains = false;
+				word |= mask;
+			}
+		}
+
+		return contains;
+	}
+
+	void reset() {
+		for (auto it = m_counters.begin(); it != m_counters.end(); ++it) {
+			*it = (*it >> 1) & 0x7777777777777777ULL;
+		}
+
+		std::fill(m_doorkeeper.begin(), m_doorkeeper.end(), 0);
+		m_additions /= 2;
+	}
+
+	std::vector<uint64_t> m_counters;
+	std::vector<uint64_t> m_doorkeeper;
+	size_t m_mask;
+	size_t m_sample_size;
+	size_t m_additions;
+};
+
+}}
+
+#endif // FREQUENCY_SKETCH_HPP
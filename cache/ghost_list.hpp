@@ -0,0 +1,109 @@
+#ifndef GHOST_LIST_HPP
+#define GHOST_LIST_HPP
+
+#include <cstring>
+#include <list>
+#include <unordered_map>
+
+#include "elliptics/packet.h"
+
+namespace ioremap { namespace cache {
+
+/*
+ * Ids of objects recently evicted from the cache together with their sizes, no data is kept.
+ *
+ * List is bounded by the total size of remembered objects, the oldest ids are forgotten first.
+ * Ids are hashes already, so only their first bytes are stored, rare collisions
+ * only make adaptation slightly less precise.
+ */
+class ghost_list {
+public:
+	ghost_list() : m_size(0), m_max_size(0) {
+	}
+
+	ghost_list(const ghost_list &) = delete;
+	ghost_list &operator =(const ghost_list &) = delete;
+
+	void insert(const unsigned char *id, size_t size) {
+		const uint64_t key = fingerprint(id);
+
+		auto it = m_index.find(key);
+		if (it != m_index.end()) {
+			m_size -= it->second->size;
+			m_entries.erase(it->second);
+			m_index.erase(it);
+		}
+
+		m_entries.push_back(entry_t(key, size));
+		m_index.insert(std::make_pair(key, std::prev(m_entries.end())));
+		m_size += size;
+
+		shrink();
+	}
+
+	/*
+	 * Returns true if id was remembered, its size is stored in @size
+	 */
+	bool erase(const unsigned char *id, size_t *size) {
+		auto it = m_index.find(fingerprint(id));
+		if (it == m_index.end())
+			return false;
+
+		*size = it->second->size;
+		m_size -= *size;
+		m_entries.erase(it->second);
+		m_index.erase(it);
+		return true;
+	}
+
+	void set_max_size(size_t max_size) {
+		m_max_size = max_size;
+		shrink();
+	}
+
+	void clear() {
+		m_entries.clear();
+		m_index.clear();
+		m_size = 0;
+	}
+
+	/*
+	 * Total size of remembered objects
+	 */
+	size_t size() const {
+		return m_size;
+	}
+
+private:
+	struct entry_t {
+		entry_t(uint64_t key, size_t size) : key(key), size(size) {}
+
+		uint64_t key;
+		size_t size;
+	};
+
+	typedef std::list<entry_t> entries_t;
+
+	static uint64_t fingerprint(const unsigned char *id) {
+		uint64_t key;
+		memcpy(&key, id, sizeof(key));
+		return key;
+	}
+
+	void shrink() {
+		while (m_size > m_max_size && !m_entries.empty()) {
+			m_size -= m_entries.front().size;
+			m_index.erase(m_entries.front().key);
+			m_entries.pop_front();
+		}
+	}
+
+	entries_t m_entries;
+	std::unordered_map<uint64_t, entries_t::iterator> m_index;
+	size_t m_size;
+	size_t m_max_size;
+};
+
+}}
+
+#endif // GHOST_LIST_HPP
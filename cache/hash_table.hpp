@@ -0,0 +1,158 @@
+#ifndef HASH_TABLE_HPP
+#define HASH_TABLE_HPP
+
+#include <cstring>
+#include <vector>
+#include <stdexcept>
+
+#include "elliptics/packet.h"
+
+namespace ioremap { namespace cache {
+
+/*
+ * Open addressing hash table with linear probing used for key lookups in cache.
+ *
+ * Ids are uniformly distributed, so first 8 bytes of the id are used as a hash.
+ * Slots store this prefix next to the node pointer, so probing does not touch
+ * the nodes themselves and full id comparison is only done on prefix match.
+ * Removal uses backward shift deletion, so there are no tombstones.
+ */
+template<typename node_type>
+class hash_table {
+public:
+	typedef node_type* p_node_type;
+	typedef const unsigned char * key_type;
+
+	hash_table(): m_size(0), m_mask(0) {
+		rehash(min_capacity);
+	}
+
+	hash_table(const hash_table &) = delete;
+	hash_table &operator =(const hash_table &) = delete;
+
+	void insert(p_node_type node) {
+		if (!node) {
+			throw std::logic_error("insert: can't insert NULL");
+		}
+
+		if ((m_size + 1) * max_load_denominator > m_slots.size() * max_load_numerator) {
+			rehash(m_slots.size() * 2);
+		}
+
+		insert_nocheck(prefix(get_key(node)), node);
+		++m_size;
+	}
+
+	p_node_type find(const key_type &key) const {
+		const uint64_t hash = prefix(key);
+
+		for (size_t i = hash & m_mask; m_slots[i].node; i = (i + 1) & m_mask) {
+			if (m_slots[i].hash == hash && !key_compare(get_key(m_slots[i].node), key)) {
+				return m_slots[i].node;
+			}
+		}
+
+		return NULL;
+	}
+
+	void erase(p_node_type node) {
+		const uint64_t hash = prefix(get_key(node));
+
+		size_t i = hash & m_mask;
+		while (m_slots[i].node != node) {
+			if (!m_slots[i].node) {
+				throw std::logic_error("erase: element does not exist");
+			}
+			i = (i + 1) & m_mask;
+		}
+
+		// Move following elements of the cluster back if their home slot allows it
+		for (size_t j = (i + 1) & m_mask; m_slots[j].node; j = (j + 1) & m_mask) {
+			const size_t home = m_slots[j].hash & m_mask;
+			if (((j - home) & m_mask) >= ((j - i) & m_mask)) {
+				m_slots[i] = m_slots[j];
+				i = j;
+			}
+		}
+
+		m_slots[i] = slot_t();
+		--m_size;
+
+		if (m_slots.size() > min_capacity && m_size * 8 < m_slots.size()) {
+			rehash(m_slots.size() / 2);
+		}
+	}
+
+	size_t size() const {
+		return m_size;
+	}
+
+	bool empty() const {
+		return !m_size;
+	}
+
+	/*
+	 * Number of bytes used by the table itself
+	 */
+	size_t memory_usage() const {
+		return m_slots.capacity() * sizeof(slot_t);
+	}
+
+private:
+	enum {
+		min_capacity = 16,
+		max_load_numerator = 7,
+		max_load_denominator = 10
+	};
+
+	struct slot_t {
+		slot_t(): hash(0), node(NULL) {}
+
+		uint64_t hash;
+		p_node_type node;
+	};
+
+	static uint64_t prefix(key_type key) {
+		uint64_t hash;
+		memcpy(&hash, key, sizeof(hash));
+		return hash;
+	}
+
+	static key_type get_key(p_node_type node) {
+		return node->id().id;
+	}
+
+	static int key_compare(const key_type &lhs, const key_type &rhs) {
+		return memcmp(lhs, rhs, DNET_ID_SIZE);
+	}
+
+	void insert_nocheck(uint64_t hash, p_node_type node) {
+		size_t i = hash & m_mask;
+		while (m_slots[i].node) {
+			i = (i + 1) & m_mask;
+		}
+
+		m_slots[i].hash = hash;
+		m_slots[i].node = node;
+	}
+
+	void rehash(size_t capacity) {
+		std::vector<slot_t> slots(capacity);
+		m_slots.swap(slots);
+		m_mask = capacity - 1;
+
+		for (auto it = slots.begin(); it != slots.end(); ++it) {
+			if (it->node) {
+				insert_nocheck(it->hash, it->node);
+			}
+		}
+	}
+
+	std::vector<slot_t> m_slots;
+	size_t m_size;
+	size_t m_mask;
+};
+
+}}
+
+#endif // HASH_TABLE_HPP
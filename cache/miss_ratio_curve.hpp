@@ -0,0 +1,306 @@
+#ifndef MISS_RATIO_CURVE_HPP
+#define MISS_RATIO_CURVE_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <vector>
+#if __GNUC__ == 4 && __GNUC_MINOR__ < 5
+#  include <cstdatomic>
+#else
+#  include <atomic>
+#endif
+
+#include "elliptics/packet.h"
+
+namespace ioremap { namespace cache {
+
+/*
+ * Estimation of the cache hit ratio for different cache sizes (SHARDS).
+ *
+ * Only accesses of ids whose hash is below the threshold are tracked, initially it takes
+ * 1/sampling of the hash space, so every tracked id sees all its accesses. For them LRU reuse
+ * distance in bytes is computed: total size of the distinct tracked objects accessed since
+ * the previous access of the id, scaled back by the sampling rate. LRU cache of size C hits
+ * the access if its reuse distance is below C, so histogram of distances gives hit ratio for any size.
+ *
+ * Distances are summed by Fenwick tree over access times, every tracked id keeps its size
+ * at the time of its last access. At most max_keys ids are tracked: when there are more of them
+ * the threshold is lowered to the largest tracked hash and this id is forgotten, so the sample
+ * stays uniform (fixed-size SHARDS). Histogram is rescaled by the change of the sampling rate,
+ * so counts collected at the higher rate are comparable with the new ones.
+ * Histogram is halved every aging_period accesses, so estimation follows the current workload.
+ */
+class miss_ratio_curve {
+public:
+	enum {
+		max_keys = 1 << 16,
+		buckets_per_octave = 8,
+		octaves_number = 64,
+		aging_period = 1 << 20
+	};
+
+	/*
+	 * One of @sampling ids is tracked
+	 */
+	miss_ratio_curve(size_t sampling) :
+		m_threshold(std::numeric_limits<uint64_t>::max() / std::max<size_t>(1, sampling)),
+		m_time(0), m_tree(tree_size + 1, 0),
+		m_histogram(buckets_per_octave * octaves_number, 0),
+		m_cold_accesses(0), m_accesses(0) {
+	}
+
+	miss_ratio_curve(const miss_ratio_curve &) = delete;
+	miss_ratio_curve &operator =(const miss_ratio_curve &) = delete;
+
+	/*
+	 * Records access to the object of @size bytes, it is cheap for ids which are not sampled
+	 */
+	void access(const unsigned char *id, size_t size) {
+		const uint64_t key = hash(id);
+		if (key >= m_threshold)
+			return;
+
+		std::lock_guard<std::mutex> guard(m_lock);
+
+		// Threshold could be lowered while we were waiting for the lock
+		if (key >= m_threshold)
+			return;
+
+		auto it = m_keys.find(key);
+		if (it != m_keys.end()) {
+			const uint64_t distance = uint64_t((sum(m_time) - sum(it->second.time + 1)) * scale()) + size;
+			++m_histogram[bucket(distance)];
+
+			forget(it);
+		} else {
+			if (m_keys.size() >= max_keys) {
+				lower_threshold();
+
+				if (key >= m_threshold)
+					return;
+			}
+
+			++m_cold_accesses;
+		}
+
+		if (++m_accesses >= aging_period)
+			age();
+
+		if (m_time >= tree_size)
+			compact();
+
+		key_info &info = m_keys[key];
+		info.time = m_time++;
+		info.size = size;
+
+		m_order.insert(std::make_pair(info.time, key));
+		add(info.time, size);
+	}
+
+	/*
+	 * Removed object does not take space anymore, its next access is a cold miss
+	 */
+	void remove(const unsigned char *id) {
+		const uint64_t key = hash(id);
+		if (key >= m_threshold)
+			return;
+
+		std::lock_guard<std::mutex> guard(m_lock);
+
+		auto it = m_keys.find(key);
+		if (it != m_keys.end())
+			forget(it);
+	}
+
+	/*
+	 * Returns estimated hit ratio of LRU cache of @cache_size bytes
+	 */
+	double hit_ratio(size_t cache_size) const {
+		std::lock_guard<std::mutex> guard(m_lock);
+
+		if (!m_accesses)
+			return 0;
+
+		double hits = 0;
+		for (size_t i = 0; i < m_histogram.size(); ++i) {
+			const uint64_t lower = bucket_lower_bound(i);
+			const uint64_t upper = bucket_lower_bound(i + 1);
+
+			if (upper <= cache_size) {
+				hits += m_histogram[i];
+			} else {
+				// Distances are assumed to be spread evenly over the bucket
+				if (lower < cache_size)
+					hits += m_histogram[i] * (cache_size - lower) * 1.0 / (upper - lower);
+				break;
+			}
+		}
+
+		return hits / m_accesses;
+	}
+
+	size_t sampled_accesses() const {
+		std::lock_guard<std::mutex> guard(m_lock);
+		return m_accesses;
+	}
+
+	/*
+	 * Current sampling, it only grows when there are too many tracked ids
+	 */
+	size_t sampling() const {
+		return size_t(scale());
+	}
+
+private:
+	enum {
+		tree_size = 4 * max_keys
+	};
+
+	struct key_info {
+		uint64_t time;
+		size_t size;
+	};
+
+	/* Ordered by hash, so the id with the largest one is dropped when threshold is lowered */
+	typedef std::map<uint64_t, key_info> keys_t;
+
+	/*
+	 * Ids may be set by users, so they are mixed once more before sampling
+	 */
+	static uint64_t hash(const unsigned char *id) {
+		uint64_t hash;
+		memcpy(&hash, id, sizeof(hash));
+
+		hash ^= hash >> 33;
+		hash *= 0xff51afd7ed558ccdULL;
+		hash ^= hash >> 33;
+		hash *= 0xc4ceb9fe1a85ec53ULL;
+		hash ^= hash >> 33;
+		return hash;
+	}
+
+	static size_t bucket(uint64_t distance) {
+		if (!distance)
+			return 0;
+
+		const size_t octave = 63 - __builtin_clzll(distance);
+		const size_t sub_bucket = octave >= 3 ?
+			(distance >> (octave - 3)) & (buckets_per_octave - 1) :
+			(distance << (3 - octave)) & (buckets_per_octave - 1);
+
+		return octave * buckets_per_octave + sub_bucket;
+	}
+
+	static uint64_t bucket_lower_bound(size_t bucket) {
+		if (bucket >= buckets_per_octave * octaves_number)
+			return std::numeric_limits<uint64_t>::max();
+
+		const size_t octave = bucket / buckets_per_octave;
+		const uint64_t mantissa = buckets_per_octave + bucket % buckets_per_octave;
+
+		return octave >= 3 ? mantissa << (octave - 3) : mantissa >> (3 - octave);
+	}
+
+	/*
+	 * Total size of objects last accessed before @time
+	 */
+	uint64_t sum(uint64_t time) const {
+		uint64_t result = 0;
+		for (uint64_t i = time; i > 0; i -= i & -i) {
+			result += m_tree[i];
+		}
+		return result;
+	}
+
+	void add(uint64_t time, int64_t size) {
+		for (uint64_t i = time + 1; i <= tree_size; i += i & -i) {
+			m_tree[i] += size;
+		}
+	}
+
+	void forget(keys_t::iterator it) {
+		add(it->second.time, -int64_t(it->second.size));
+		m_order.erase(it->second.time);
+		m_keys.erase(it);
+	}
+
+	/*
+	 * Inverse of the sampling rate
+	 */
+	double scale() const {
+		return std::numeric_limits<uint64_t>::max() * 1.0 / m_threshold;
+	}
+
+	/*
+	 * Stops tracking the id with the largest hash and lowers threshold to its hash
+	 */
+	void lower_threshold() {
+		auto last = std::prev(m_keys.end());
+		const uint64_t threshold = last->first;
+		const double ratio = threshold * 1.0 / m_threshold;
+
+		forget(last);
+		m_threshold = threshold;
+
+		for (auto it = m_histogram.begin(); it != m_histogram.end(); ++it) {
+			*it *= ratio;
+		}
+
+		m_cold_accesses *= ratio;
+		m_accesses *= ratio;
+	}
+
+	/*
+	 * Renumbers access times of tracked ids from zero, so the tree never overflows
+	 */
+	void compact() {
+		std::fill(m_tree.begin(), m_tree.end(), 0);
+		std::map<uint64_t, uint64_t> order;
+
+		m_time = 0;
+		for (auto it = m_order.begin(); it != m_order.end(); ++it) {
+			key_info &info = m_keys[it->second];
+			info.time = m_time++;
+
+			order.insert(order.end(), std::make_pair(info.time, it->second));
+			add(info.time, info.size);
+		}
+
+		m_order.swap(order);
+	}
+
+	void age() {
+		for (auto it = m_histogram.begin(); it != m_histogram.end(); ++it) {
+			*it /= 2;
+		}
+
+		m_cold_accesses /= 2;
+		m_accesses = m_cold_accesses;
+		for (auto it = m_histogram.begin(); it != m_histogram.end(); ++it) {
+			m_accesses += *it;
+		}
+	}
+
+	/* Only ids with smaller hashes are tracked, it is checked without the lock */
+	std::atomic<uint64_t> m_threshold;
+	mutable std::mutex m_lock;
+
+	keys_t m_keys;
+	/* Tracked ids by the time of their last access */
+	std::map<uint64_t, uint64_t> m_order;
+	uint64_t m_time;
+	std::vector<int64_t> m_tree;
+
+	/* Counts are rescaled when sampling rate changes, so they are fractional */
+	std::vector<double> m_histogram;
+	double m_cold_accesses;
+	double m_accesses;
+};
+
+}}
+
+#endif // MISS_RATIO_CURVE_HPP
@@ -0,0 +1,163 @@
+#ifndef NEGATIVE_CACHE_HPP
+#define NEGATIVE_CACHE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+#include <sys/time.h>
+
+#include "elliptics/packet.h"
+
+namespace ioremap { namespace cache {
+
+/*
+ * Bounded set of ids which were recently not found by the backend.
+ *
+ * Table is set associative: id selects a set of ways_number entries, the oldest entry
+ * of the set is replaced when it is full, so memory is fixed and there is no eviction work.
+ * Entries expire after ttl.
+ *
+ * Write to the id removes it and remembers the time of invalidation in its set.
+ * Backend miss which started before that time is not remembered, so the miss
+ * of the read racing with a write never hides the written object.
+ */
+class negative_cache {
+public:
+	enum {
+		ways_number = 4,
+		locks_number = 256
+	};
+
+	/*
+	 * @size is the maximum number of remembered ids, @ttl is in milliseconds
+	 */
+	negative_cache(size_t size, uint64_t ttl) :
+		m_sets_number(std::max<size_t>(1, (size + ways_number - 1) / ways_number)),
+		m_ttl(ttl * 1000),
+		m_sets(new set_t[m_sets_number]),
+		m_hits(0), m_misses(0) {
+		memset(m_sets.get(), 0, m_sets_number * sizeof(set_t));
+	}
+
+	negative_cache(const negative_cache &) = delete;
+	negative_cache &operator =(const negative_cache &) = delete;
+
+	/*
+	 * Returns true if id was not found by the backend less than ttl ago
+	 */
+	bool contains(const unsigned char *id) {
+		const size_t index = set_index(id);
+		const uint64_t now = current_time();
+
+		std::lock_guard<std::mutex> guard(m_locks[index % locks_number]);
+
+		set_t &set = m_sets[index];
+		for (size_t i = 0; i < ways_number; ++i) {
+			entry_t &entry = set.entries[i];
+
+			if (entry.expires > now && !memcmp(entry.id.id, id, DNET_ID_SIZE)) {
+				++m_hits;
+				return true;
+			}
+		}
+
+		++m_misses;
+		return false;
+	}
+
+	/*
+	 * Remembers id which was not found by the backend request started at @start (microseconds)
+	 */
+	void insert(const unsigned char *id, uint64_t start) {
+		const size_t index = set_index(id);
+		const uint64_t now = current_time();
+
+		std::lock_guard<std::mutex> guard(m_locks[index % locks_number]);
+
+		set_t &set = m_sets[index];
+		if (set.invalidated >= start)
+			return;
+
+		entry_t *victim = &set.entries[0];
+		for (size_t i = 0; i < ways_number; ++i) {
+			entry_t &entry = set.entries[i];
+
+			if (!memcmp(entry.id.id, id, DNET_ID_SIZE)) {
+				victim = &entry;
+				break;
+			}
+
+			if (entry.expires < victim->expires)
+				victim = &entry;
+		}
+
+		memcpy(victim->id.id, id, DNET_ID_SIZE);
+		victim->expires = now + m_ttl;
+	}
+
+	void remove(const unsigned char *id) {
+		const size_t index = set_index(id);
+		const uint64_t now = current_time();
+
+		std::lock_guard<std::mutex> guard(m_locks[index % locks_number]);
+
+		set_t &set = m_sets[index];
+		set.invalidated = now;
+
+		for (size_t i = 0; i < ways_number; ++i) {
+			entry_t &entry = set.entries[i];
+
+			if (!memcmp(entry.id.id, id, DNET_ID_SIZE))
+				entry.expires = 0;
+		}
+	}
+
+	size_t hits() const {
+		return m_hits;
+	}
+
+	size_t misses() const {
+		return m_misses;
+	}
+
+	/*
+	 * Time in microseconds, the same clock is used by callers for @start of insert()
+	 */
+	static uint64_t current_time() {
+		struct timeval tv;
+		gettimeofday(&tv, NULL);
+		return tv.tv_sec * 1000000ULL + tv.tv_usec;
+	}
+
+private:
+	struct entry_t {
+		dnet_raw_id id;
+		uint64_t expires;
+	};
+
+	struct set_t {
+		entry_t entries[ways_number];
+		uint64_t invalidated;
+	};
+
+	size_t set_index(const unsigned char *id) const {
+		uint64_t hash;
+		memcpy(&hash, id, sizeof(hash));
+		return hash % m_sets_number;
+	}
+
+	const size_t m_sets_number;
+	const uint64_t m_ttl;
+	std::unique_ptr<set_t[]> m_sets;
+	std::mutex m_locks[locks_number];
+
+	std::atomic_size_t m_hits;
+	std::atomic_size_t m_misses;
+};
+
+}}
+
+#endif // NEGATIVE_CACHE_HPP
@@ -0,0 +1,291 @@
+#include "slab_allocator.hpp"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#include <stdint.h>
+
+namespace ioremap { namespace cache {
+
+static size_t align_up(size_t size, size_t alignment)
+{
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+static size_t page_size()
+{
+	static const size_t size = sysconf(_SC_PAGESIZE);
+	return size;
+}
+
+slab_allocator::slab_allocator(bool hugepages) :
+	m_hugepages(hugepages),
+	m_spare_slab(NULL),
+	m_partial_slabs(size_classes().size()),
+	m_mapped_size(0),
+	m_used_size(0),
+	m_charged_size(0)
+{
+}
+
+slab_allocator::~slab_allocator()
+{
+	// Objects still in use at this point are leaked on purpose, their slabs are released anyway
+	for (auto it = m_partial_slabs.begin(); it != m_partial_slabs.end(); ++it) {
+		while (!it->empty()) {
+			slab_t *slab = &it->front();
+			it->pop_front();
+			unmap(slab, slab_size);
+		}
+	}
+
+	while (!m_full_slabs.empty()) {
+		slab_t *slab = &m_full_slabs.front();
+		m_full_slabs.pop_front();
+		unmap(slab, slab_size);
+	}
+
+	if (m_spare_slab)
+		unmap(m_spare_slab, slab_size);
+}
+
+const std::vector<size_t> &slab_allocator::size_classes()
+{
+	static const std::vector<size_t> classes = [] {
+		std::vector<size_t> result;
+		for (size_t size = min_chunk_size; size < max_chunk_size; size = align_up(size + size / 4, 16)) {
+			result.push_back(size);
+		}
+		result.push_back(max_chunk_size);
+		return result;
+	}();
+
+	return classes;
+}
+
+size_t slab_allocator::size_class(size_t size)
+{
+	const std::vector<size_t> &classes = size_classes();
+	return std::lower_bound(classes.begin(), classes.end(), size) - classes.begin();
+}
+
+size_t slab_allocator::large_size(size_t size)
+{
+	return align_up(size, page_size());
+}
+
+size_t slab_allocator::slab_header_size()
+{
+	return align_up(sizeof(slab_t), 64);
+}
+
+size_t slab_allocator::allocated_size(size_t size)
+{
+	if (size > max_chunk_size)
+		return large_size(size);
+
+	return size_classes()[size_class(size)];
+}
+
+size_t slab_allocator::charged_size(size_t size)
+{
+	if (size > max_chunk_size)
+		return large_size(size);
+
+	const size_t chunks = (slab_size - slab_header_size()) / size_classes()[size_class(size)];
+	return (slab_size + chunks - 1) / chunks;
+}
+
+size_t slab_allocator::min_slab_limit()
+{
+	return (size_classes().size() + 1) * slab_size;
+}
+
+void *slab_allocator::allocate(size_t size)
+{
+	if (size > max_chunk_size) {
+		const size_t mapped = large_size(size);
+		void *ptr = map(mapped, page_size());
+		m_used_size += mapped;
+		m_charged_size += mapped;
+		return ptr;
+	}
+
+	const size_t index = size_class(size);
+	const size_t chunk_size = size_classes()[index];
+
+	std::lock_guard<std::mutex> guard(m_lock);
+
+	slab_list_t &partial = m_partial_slabs[index];
+	slab_t *slab = partial.empty() ? create_slab(index) : &partial.front();
+
+	void *ptr;
+	if (slab->free) {
+		ptr = slab->free;
+		slab->free = *reinterpret_cast<void **>(ptr);
+	} else {
+		ptr = slab->unused;
+		slab->unused += chunk_size;
+	}
+
+	if (++slab->used == slab->total) {
+		partial.erase(partial.iterator_to(*slab));
+		m_full_slabs.push_front(*slab);
+	}
+
+	m_used_size += chunk_size;
+	m_charged_size += charged_size(chunk_size);
+	return ptr;
+}
+
+void slab_allocator::deallocate(void *ptr, size_t size)
+{
+	if (!ptr)
+		return;
+
+	if (size > max_chunk_size) {
+		const size_t mapped = large_size(size);
+		unmap(ptr, mapped);
+		m_used_size -= mapped;
+		m_charged_size -= mapped;
+		return;
+	}
+
+	slab_t *slab = reinterpret_cast<slab_t *>(reinterpret_cast<uintptr_t>(ptr) & ~(uintptr_t(slab_size) - 1));
+
+	std::lock_guard<std::mutex> guard(m_lock);
+
+	slab_list_t &partial = m_partial_slabs[slab->size_class];
+
+	*reinterpret_cast<void **>(ptr) = slab->free;
+	slab->free = ptr;
+
+	m_used_size -= size_classes()[slab->size_class];
+	m_charged_size -= charged_size(size_classes()[slab->size_class]);
+
+	if (slab->used-- == slab->total) {
+		m_full_slabs.erase(m_full_slabs.iterator_to(*slab));
+		partial.push_front(*slab);
+	}
+
+	if (!slab->used) {
+		partial.erase(partial.iterator_to(*slab));
+		slab->~slab_t();
+
+		// Keep one free slab around to avoid mapping and unmapping it on every allocation
+		if (m_spare_slab) {
+			unmap(slab, slab_size);
+		} else {
+			m_spare_slab = slab;
+		}
+	}
+}
+
+void *slab_allocator::reallocate(void *ptr, size_t old_size, size_t new_size)
+{
+	if (allocated_size(old_size) == allocated_size(new_size))
+		return ptr;
+
+#ifdef MREMAP_MAYMOVE
+	if (old_size > max_chunk_size && new_size > max_chunk_size) {
+		const size_t old_mapped = large_size(old_size);
+		const size_t new_mapped = large_size(new_size);
+
+		void *result = mremap(ptr, old_mapped, new_mapped, MREMAP_MAYMOVE);
+		if (result == MAP_FAILED)
+			throw std::bad_alloc();
+
+		m_mapped_size += new_mapped;
+		m_mapped_size -= old_mapped;
+		m_used_size += new_mapped;
+		m_used_size -= old_mapped;
+		m_charged_size += new_mapped;
+		m_charged_size -= old_mapped;
+		return result;
+	}
+#endif
+
+	void *result = allocate(new_size);
+	memcpy(result, ptr, std::min(old_size, new_size));
+	deallocate(ptr, old_size);
+	return result;
+}
+
+slab_allocator::slab_t *slab_allocator::create_slab(size_t size_class)
+{
+	const size_t chunk_size = size_classes()[size_class];
+	const size_t header_size = slab_header_size();
+
+	void *memory = m_spare_slab;
+	m_spare_slab = NULL;
+
+	if (!memory)
+		memory = map(slab_size, slab_size);
+
+	slab_t *slab = new (memory) slab_t;
+	slab->size_class = size_class;
+	slab->used = 0;
+	slab->total = (slab_size - header_size) / chunk_size;
+	slab->unused = reinterpret_cast<char *>(slab) + header_size;
+	slab->free = NULL;
+
+	m_partial_slabs[size_class].push_front(*slab);
+	return slab;
+}
+
+void *slab_allocator::map(size_t size, size_t alignment)
+{
+	const int prot = PROT_READ | PROT_WRITE;
+	const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+	void *ptr;
+
+#ifdef MAP_HUGETLB
+	if (m_hugepages && size == slab_size) {
+		ptr = mmap(NULL, size, prot, flags | MAP_HUGETLB, -1, 0);
+		if (ptr != MAP_FAILED) {
+			m_mapped_size += size;
+			return ptr;
+		}
+	}
+#endif
+
+	if (alignment <= page_size()) {
+		ptr = mmap(NULL, size, prot, flags, -1, 0);
+		if (ptr == MAP_FAILED)
+			throw std::bad_alloc();
+	} else {
+		// Map more than needed and cut unaligned head and tail
+		char *raw = reinterpret_cast<char *>(mmap(NULL, size + alignment, prot, flags, -1, 0));
+		if (raw == MAP_FAILED)
+			throw std::bad_alloc();
+
+		char *aligned = reinterpret_cast<char *>(align_up(reinterpret_cast<uintptr_t>(raw), alignment));
+		if (aligned != raw)
+			munmap(raw, aligned - raw);
+		if (aligned + size != raw + size + alignment)
+			munmap(aligned + size, raw + size + alignment - aligned - size);
+
+		ptr = aligned;
+	}
+
+#ifdef MADV_HUGEPAGE
+	if (m_hugepages)
+		madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+
+	m_mapped_size += size;
+	return ptr;
+}
+
+void slab_allocator::unmap(void *ptr, size_t size)
+{
+	munmap(ptr, size);
+	m_mapped_size -= size;
+}
+
+}} /* namespace ioremap::cache */
@@ -0,0 +1,141 @@
+#ifndef SLAB_ALLOCATOR_HPP
+#define SLAB_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+#if __GNUC__ == 4 && __GNUC_MINOR__ < 5
+#  include <cstdatomic>
+#else
+#  include <atomic>
+#endif
+
+#include <boost/intrusive/list.hpp>
+
+namespace ioremap { namespace cache {
+
+/*
+ * Size-classed slab allocator used for cache objects.
+ *
+ * Memory is taken from the system by aligned slabs of slab_size bytes,
+ * every slab is cut into chunks of a single size class.
+ * Size classes grow geometrically, so rounding waste is bounded by growth factor.
+ * Slab header lives at the beginning of the slab, so the slab of any chunk
+ * is found by masking its address, and completely free slabs are returned to the system.
+ *
+ * Requests bigger than the largest size class are mapped directly and rounded up to the page size.
+ *
+ * If hugepages are requested slabs are mapped with MAP_HUGETLB,
+ * and if there are no reserved hugepages transparent hugepages are advised instead.
+ */
+class slab_allocator {
+public:
+	enum {
+		slab_size = 2 * 1024 * 1024,
+		min_chunk_size = 32,
+		max_chunk_size = slab_size / 8
+	};
+
+	slab_allocator(bool hugepages);
+	~slab_allocator();
+
+	slab_allocator(const slab_allocator &) = delete;
+	slab_allocator &operator =(const slab_allocator &) = delete;
+
+	void *allocate(size_t size);
+
+	/*
+	 * @size must be the same as passed to allocate()
+	 */
+	void deallocate(void *ptr, size_t size);
+
+	/*
+	 * Moves allocation to the new size preserving min(@old_size, @new_size) bytes of data.
+	 * Large allocations are remapped without copying.
+	 */
+	void *reallocate(void *ptr, size_t old_size, size_t new_size);
+
+	/*
+	 * Number of bytes really consumed by allocation of @size bytes
+	 */
+	static size_t allocated_size(size_t size);
+
+	/*
+	 * Share of the mapped memory charged for allocation of @size bytes:
+	 * slab header and the tail which does not fit a whole chunk are spread among chunks of the slab,
+	 * so full slab is charged exactly slab_size bytes
+	 */
+	static size_t charged_size(size_t size);
+
+	/*
+	 * Smallest memory limit which can be enforced in whole slabs: a slab of every size class and the spare one
+	 */
+	static size_t min_slab_limit();
+
+	/*
+	 * Number of bytes currently mapped by allocator
+	 */
+	size_t mapped_size() const {
+		return m_mapped_size;
+	}
+
+	/*
+	 * Number of bytes currently given out to users (rounded up to the size classes)
+	 */
+	size_t used_size() const {
+		return m_used_size;
+	}
+
+	/*
+	 * Number of bytes of the mapped memory not charged to any allocation by charged_size():
+	 * free chunks of partly used slabs and the spare slab.
+	 * Charges of all allocations plus this cover every slab the allocator holds.
+	 */
+	size_t slack_size() const {
+		const size_t mapped = m_mapped_size, charged = m_charged_size;
+		return mapped > charged ? mapped - charged : 0;
+	}
+
+private:
+	struct slab_tag_t;
+	typedef boost::intrusive::list_base_hook<boost::intrusive::tag<slab_tag_t>,
+		boost::intrusive::link_mode<boost::intrusive::safe_link> > slab_hook_t;
+
+	struct slab_t : public slab_hook_t {
+		size_t size_class;
+		size_t used;
+		size_t total;
+		/* Chunks which were never given out start here */
+		char *unused;
+		/* List of released chunks */
+		void *free;
+	};
+
+	typedef boost::intrusive::list<slab_t, boost::intrusive::base_hook<slab_hook_t> > slab_list_t;
+
+	static const std::vector<size_t> &size_classes();
+	static size_t size_class(size_t size);
+	static size_t large_size(size_t size);
+	static size_t slab_header_size();
+
+	void *map(size_t size, size_t alignment);
+	void unmap(void *ptr, size_t size);
+
+	slab_t *create_slab(size_t size_class);
+
+	bool m_hugepages;
+	std::mutex m_lock;
+	void *m_spare_slab;
+	/* Slabs which have free chunks, by size classes */
+	std::vector<slab_list_t> m_partial_slabs;
+	/* Slabs without free chunks, they are kept only to be released on destruction */
+	slab_list_t m_full_slabs;
+	std::atomic_size_t m_mapped_size;
+	std::atomic_size_t m_used_size;
+	/* Sum of charged_size() of all allocations */
+	std::atomic_size_t m_charged_size;
+};
+
+}}
+
+#endif // SLAB_ALLOCATOR_HPP
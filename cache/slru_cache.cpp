@@ -3,15 +3,39 @@
 
 namespace ioremap { namespace cache {
 
+static uint64_t current_time_ms() {
+	return std::chrono::duration_cast<std::chrono::milliseconds>(
+		std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
 // public:
 
-slru_cache_t::slru_cache_t(struct dnet_node *n, const std::vector<size_t> &cache_pages_max_sizes) :
+slru_cache_t::slru_cache_t(struct dnet_node *n, const std::vector<size_t> &cache_pages_max_sizes, writeback_limiter &writeback) :
 	m_need_exit(false),
 	m_node(n),
+	m_writeback(writeback),
+	m_allocator(n->cache_hugepages),
 	m_cache_pages_number(cache_pages_max_sizes.size()),
 	m_cache_pages_max_sizes(cache_pages_max_sizes),
+	m_cache_pages_base_sizes(cache_pages_max_sizes),
 	m_cache_pages_sizes(m_cache_pages_number, 0),
-	m_cache_pages_lru(new lru_list_t[m_cache_pages_number]) {
+	m_cache_pages_lru(new lru_list_t[m_cache_pages_number]),
+	m_timer_wheel(current_time_ms()),
+	m_lifecheck_deadline(0),
+	m_adaptive(false),
+	m_last_page_target(cache_pages_max_sizes.back()) {
+	if (n->cache_admission == DNET_CACHE_ADMISSION_TINYLFU) {
+		size_t max_size = 0;
+		for (size_t i = 0; i < m_cache_pages_number; ++i) {
+			max_size += m_cache_pages_max_sizes[i];
+		}
+
+		// Sketch is sized for the number of 1 KB objects fitting into the cache
+		m_sketch.reset(new frequency_sketch(max_size / 1024));
+	}
+
+	set_adaptive(n->cache_adaptive);
+
 	m_lifecheck = std::thread(std::bind(&slru_cache_t::life_check, this));
 }
 
@@ -23,6 +47,7 @@ slru_cache_t::~slru_cache_t() {
 
 void slru_cache_t::stop() {
 	m_need_exit = true;
+	m_lifecheck_wait.notify_all();
 }
 
 struct write_timer
@@ -114,13 +139,23 @@ int slru_cache_t::write_(const unsigned char *id, dnet_net_state *st, dnet_cmd *
 
 	write_timer timer(m_node, id);
 
-	elliptics_unique_lock<std::mutex> guard(m_lock, m_node, "%s: CACHE WRITE: %p", dnet_dump_id_str(id), this);
+	elliptics_unique_lock<std::mutex> guard(m_lock, m_node, DNET_LOCK_SITE("cache: write"), id);
 	timer.lock = timer.restart();
 
-	data_t* it = m_treap.find(id);
+	data_t* it = m_hash_table.find(id);
 
 	timer.find = timer.restart();
+
+	if (m_sketch) {
+		m_sketch->increment(id);
+	}
+
+	// Cached chunks are outdated by any change of the object
+	invalidate_chunks(id);
+
 	if (!it && !cache) {
+		// Object is going to be written directly to the disk, so data being read or restored now is outdated
+		invalidate_populate(id, false);
 
 		dnet_log(m_node, DNET_LOG_DEBUG, "%s: CACHE: not a cache call\n", dnet_dump_id_str(id));
 		return -ENOTSUP;
@@ -142,11 +177,10 @@ int slru_cache_t::write_(const unsigned char *id, dnet_net_state *st, dnet_cmd *
 
 				timer.create = timer.restart();
 				if (previous_eventtime != it->eventtime()) {
-					m_treap.decrease_key(it);
+					update_eventtime(it);
 				}
 			}
 
-			auto &raw = it->data()->data();
 			size_t page_number = it->cache_page_number();
 			size_t new_page_number = page_number;
 			size_t new_size = it->size() + io->size;
@@ -161,7 +195,7 @@ int slru_cache_t::write_(const unsigned char *id, dnet_net_state *st, dnet_cmd *
 			resize_page(id, new_page_number, 2 * new_size);
 
 			m_cache_stats.size_of_objects -= it->size();
-			raw.insert(raw.end(), data, data + io->size);
+			append_data(it, data, io->size);
 			m_cache_stats.size_of_objects += it->size();
 
 			insert_data_into_page(id, new_page_number, &*it);
@@ -175,6 +209,9 @@ int slru_cache_t::write_(const unsigned char *id, dnet_net_state *st, dnet_cmd *
 		} else if (it && it->only_append()) {
 			timer.type = write_timer::write_after_append_only;
 
+			// Object is going to be modified directly on the disk
+			invalidate_populate(id, false);
+
 			sync_after_append(guard, false, &*it);
 			timer.sync_after_append = timer.restart();
 
@@ -214,14 +251,14 @@ int slru_cache_t::write_(const unsigned char *id, dnet_net_state *st, dnet_cmd *
 		}
 	}
 
-	raw_data_t &raw = *it->data();
+	const raw_data_t &raw = *it->data();
 
 	if (io->flags & DNET_IO_FLAGS_COMPARE_AND_SWAP) {
 		// Data is already in memory, so it's free to use it
 		// raw.size() is zero only if there is no such file on the server
 		if (raw.size() != 0) {
 			struct dnet_raw_id csum;
-			dnet_transform_node(m_node, raw.data().data(), raw.size(), csum.id, sizeof(csum.id));
+			dnet_transform_node(m_node, raw.data(), raw.size(), csum.id, sizeof(csum.id));
 
 			if (memcmp(csum.id, io->parent, DNET_ID_SIZE)) {
 				timer.cas = timer.restart();
@@ -258,10 +295,16 @@ int slru_cache_t::write_(const unsigned char *id, dnet_net_state *st, dnet_cmd *
 
 	m_cache_stats.size_of_objects -= it->size();
 	if (append) {
-		raw.data().insert(raw.data().end(), data, data + size);
+		append_data(it, data, size);
 	} else {
-		raw.data().resize(new_data_size);
-		memcpy(raw.data().data() + io->offset, data, size);
+		const size_t old_size = it->data()->size();
+
+		prepare_data(it, new_data_size, std::min<size_t>(io->offset, old_size), false);
+		if (old_size < io->offset) {
+			memset(it->data()->data() + old_size, 0, io->offset - old_size);
+		}
+		memcpy(it->data()->data() + io->offset, data, size);
+		it->data()->set_size(new_data_size);
 	}
 	timer.modify = timer.restart();
 	m_cache_stats.size_of_objects += it->size();
@@ -286,7 +329,7 @@ int slru_cache_t::write_(const unsigned char *id, dnet_net_state *st, dnet_cmd *
 	}
 
 	if (previous_eventtime != it->eventtime()) {
-		m_treap.decrease_key(it);
+		update_eventtime(it);
 	}
 	timer.lifeset_update = timer.restart();
 
@@ -294,7 +337,7 @@ int slru_cache_t::write_(const unsigned char *id, dnet_net_state *st, dnet_cmd *
 	it->set_user_flags(io->user_flags);
 
 	cmd->flags &= ~DNET_FLAGS_NEED_ACK;
-	return dnet_send_file_info_ts_without_fd(st, cmd, raw.data().data() + io->offset, io->size, &io->timestamp);
+	return dnet_send_file_info_ts_without_fd(st, cmd, it->data()->data() + io->offset, io->size, &io->timestamp);
 }
 
 struct read_timer
@@ -335,27 +378,34 @@ struct read_timer
 	long long int add_to_page;
 };
 
-std::shared_ptr<raw_data_t> slru_cache_t::read(const unsigned char *id, dnet_cmd *cmd, dnet_io_attr *io) {
+raw_data_ptr slru_cache_t::read(const unsigned char *id, dnet_cmd *cmd, dnet_io_attr *io, int *err) {
 	elliptics_timer timer;
-	auto result = read_(id, cmd, io);
+	auto result = read_(id, cmd, io, err);
 	m_cache_stats.total_read_time += timer.elapsed<std::chrono::microseconds>();
 	return result;
 }
 
-std::shared_ptr<raw_data_t> slru_cache_t::read_(const unsigned char *id, dnet_cmd *cmd, dnet_io_attr *io) {
+raw_data_ptr slru_cache_t::read_(const unsigned char *id, dnet_cmd *cmd, dnet_io_attr *io, int *err) {
 	const bool cache = (io->flags & DNET_IO_FLAGS_CACHE);
 	const bool cache_only = (io->flags & DNET_IO_FLAGS_CACHE_ONLY);
 	(void) cmd;
 
+	*err = cache ? -ENOENT : -ENOTSUP;
+
 	read_timer timer(m_node, id);
 
-	elliptics_unique_lock<std::mutex> guard(m_lock, m_node, "%s: CACHE READ: %p", dnet_dump_id_str(id), this);
+	elliptics_unique_lock<std::mutex> guard(m_lock, m_node, DNET_LOCK_SITE("cache: read"), id);
 	timer.lock = timer.restart();
 
 	bool new_page = false;
 
-	data_t* it = m_treap.find(id);
+	data_t* it = m_hash_table.find(id);
 	timer.find = timer.restart();
+
+	if (m_sketch) {
+		m_sketch->increment(id);
+	}
+
 	if (it && it->only_append()) {
 
 		sync_after_append(guard, true, &*it);
@@ -364,11 +414,31 @@ std::shared_ptr<raw_data_t> slru_cache_t::read_(const unsigned char *id, dnet_cm
 		it = NULL;
 	}
 
+	if (it) {
+		++m_cache_stats.number_of_hits;
+	} else {
+		++m_cache_stats.number_of_misses;
+	}
+
 	if (!it && cache && !cache_only) {
-		int err = 0;
-		it = populate_from_disk(guard, id, false, &err);
+		if (!admit(id)) {
+			++m_cache_stats.number_of_rejected_objects;
+			*err = -ENOTSUP;
+			return raw_data_ptr();
+		}
+
+		int populate_err = 0;
+		it = populate_from_disk(guard, id, false, &populate_err);
 		new_page = true;
 		timer.populate = timer.restart();
+
+		if (!it) {
+			*err = populate_err;
+			return raw_data_ptr();
+		}
+
+		// Whole object is cached now, its chunks only waste space
+		invalidate_chunks(id);
 	}
 
 	if (it) {
@@ -388,10 +458,283 @@ std::shared_ptr<raw_data_t> slru_cache_t::read_(const unsigned char *id, dnet_cm
 
 		io->timestamp = it->timestamp();
 		io->user_flags = it->user_flags();
+		*err = 0;
 		return it->data();
 	}
 
-	return std::shared_ptr<raw_data_t>();
+	return raw_data_ptr();
+}
+
+raw_data_ptr slru_cache_t::read_range(const unsigned char *id, dnet_io_attr *io, size_t *data_offset, int *err) {
+	elliptics_timer timer;
+	auto result = read_range_(id, io, data_offset, err);
+	m_cache_stats.total_read_time += timer.elapsed<std::chrono::microseconds>();
+	return result;
+}
+
+bool slru_cache_t::chunked(const unsigned char *id) {
+	elliptics_unique_lock<std::mutex> guard(m_lock, m_node, DNET_LOCK_SITE("cache: chunked"), id);
+
+	dnet_raw_id key;
+	memcpy(key.id, id, DNET_ID_SIZE);
+
+	return m_chunked_objects.find(key) != m_chunked_objects.end();
+}
+
+/*
+ * Whole object is read if it is requested or already cached. Size of the object is known once
+ * some of its chunks are read: range within the object is cached by chunks only if the object
+ * is bigger than one chunk and chunks covering the range take less than the whole object.
+ * Size of the object which was never read is unknown, so its range is read by chunks,
+ * chunks never take more than the range rounded to the chunk size.
+ */
+bool slru_cache_t::read_by_chunks(const unsigned char *id, const dnet_io_attr *io) {
+	const uint64_t chunk_size = m_node->cache_chunk_size;
+
+	if (!io->size) {
+		return false;
+	}
+
+	elliptics_unique_lock<std::mutex> guard(m_lock, m_node, DNET_LOCK_SITE("cache: read by chunks"), id);
+
+	if (m_hash_table.find(id)) {
+		return false;
+	}
+
+	dnet_raw_id key;
+	memcpy(key.id, id, DNET_ID_SIZE);
+
+	auto object = m_chunked_objects.find(key);
+	if (object == m_chunked_objects.end() || !object->second.total_size) {
+		return true;
+	}
+
+	// Only chunked read clips range by the end of the object like the backend does
+	const uint64_t total_size = object->second.total_size;
+	if (io->offset + io->size > total_size) {
+		return true;
+	}
+
+	if (total_size <= chunk_size) {
+		return false;
+	}
+
+	const uint64_t begin = io->offset / chunk_size * chunk_size;
+	const uint64_t end = std::min<uint64_t>((io->offset + io->size + chunk_size - 1) / chunk_size * chunk_size, total_size);
+
+	return end - begin < total_size;
+}
+
+bool slru_cache_t::contains(const unsigned char *id) {
+	elliptics_unique_lock<std::mutex> guard(m_lock, m_node, DNET_LOCK_SITE("cache: contains"), id);
+
+	dnet_raw_id key;
+	memcpy(key.id, id, DNET_ID_SIZE);
+
+	return m_hash_table.find(id) || m_chunked_objects.find(key) != m_chunked_objects.end();
+}
+
+raw_data_ptr slru_cache_t::read_range_(const unsigned char *id, dnet_io_attr *io, size_t *data_offset, int *err) {
+	const uint64_t chunk_size = m_node->cache_chunk_size;
+	const uint64_t first_chunk = io->offset / chunk_size;
+	const uint64_t last_chunk = (io->offset + io->size - 1) / chunk_size;
+
+	*err = -ENOTSUP;
+
+	elliptics_unique_lock<std::mutex> guard(m_lock, m_node, DNET_LOCK_SITE("cache: read range"), id);
+
+	if (m_sketch) {
+		m_sketch->increment(id);
+	}
+
+	data_t* it = m_hash_table.find(id);
+	if (it && it->only_append()) {
+		sync_after_append(guard, true, it);
+		it = NULL;
+	}
+
+	// Whole object is in the cache, there is nothing to do with chunks
+	if (it) {
+		++m_cache_stats.number_of_hits;
+
+		it->set_remove_from_cache(false);
+		move_data_between_pages(id, it->cache_page_number(), get_next_page_number(it->cache_page_number()), it);
+
+		if (io->offset >= it->data()->size()) {
+			*err = -E2BIG;
+			return raw_data_ptr();
+		}
+
+		io->size = std::min<uint64_t>(io->size, it->data()->size() - io->offset);
+		io->timestamp = it->timestamp();
+		io->user_flags = it->user_flags();
+		io->total_size = it->data()->size();
+		*data_offset = io->offset;
+		*err = 0;
+		return it->data();
+	}
+
+	dnet_raw_id key;
+	memcpy(key.id, id, DNET_ID_SIZE);
+
+	unsigned char key_chunk[DNET_ID_SIZE];
+	std::vector<raw_data_ptr> chunks(last_chunk - first_chunk + 1);
+	bool missing = false;
+
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		chunk_id(id, first_chunk + i, key_chunk);
+
+		data_t *chunk = m_hash_table.find(key_chunk);
+		if (chunk) {
+			move_data_between_pages(key_chunk, chunk->cache_page_number(),
+					get_next_page_number(chunk->cache_page_number()), chunk);
+			chunks[i] = chunk->data();
+		} else {
+			missing = true;
+		}
+	}
+
+	uint64_t total_size = 0;
+	uint64_t user_flags = 0;
+	dnet_time timestamp;
+	dnet_empty_time(&timestamp);
+
+	if (!missing) {
+		++m_cache_stats.number_of_hits;
+
+		// Chunks are never cached without their object
+		auto object = m_chunked_objects.find(key);
+		total_size = object->second.total_size;
+		user_flags = object->second.user_flags;
+		timestamp = object->second.timestamp;
+	} else {
+		++m_cache_stats.number_of_misses;
+
+		if (!admit(id)) {
+			++m_cache_stats.number_of_rejected_objects;
+			return raw_data_ptr();
+		}
+
+		chunked_object &object = m_chunked_objects[key];
+		const uint64_t generation = object.generation;
+		++object.pending_reads;
+
+		guard.unlock();
+
+		local_session sess(m_node);
+		sess.set_ioflags(DNET_IO_FLAGS_NOCACHE);
+
+		dnet_id raw_id;
+		memset(&raw_id, 0, sizeof(raw_id));
+		memcpy(raw_id.id, id, DNET_ID_SIZE);
+
+		std::vector<raw_data_ptr> fetched(chunks.size());
+		int fetch_err = 0;
+
+		// Every run of missing chunks is read by a single backend request
+		for (size_t begin = 0; begin < chunks.size() && !fetch_err;) {
+			if (chunks[begin]) {
+				++begin;
+				continue;
+			}
+
+			size_t end = begin;
+			while (end < chunks.size() && !chunks[end]) {
+				++end;
+			}
+
+			ioremap::elliptics::data_pointer data = sess.read(raw_id,
+					(first_chunk + begin) * chunk_size, (end - begin) * chunk_size,
+					&user_flags, &timestamp, &total_size, &fetch_err);
+
+			// Requested range is clipped by the end of the object
+			if (fetch_err == -E2BIG && begin > 0) {
+				fetch_err = 0;
+				chunks.resize(begin);
+				break;
+			}
+
+			for (size_t i = begin; i < end && !fetch_err; ++i) {
+				const size_t offset = (i - begin) * chunk_size;
+				if (offset >= data.size()) {
+					chunks.resize(i);
+					break;
+				}
+
+				const size_t size = std::min<size_t>(chunk_size, data.size() - offset);
+				fetched[i] = raw_data_t::create(m_allocator, data.data<char>() + offset, size, size);
+				chunks[i] = fetched[i];
+			}
+
+			begin = end;
+		}
+
+		guard.lock();
+
+		// Object is kept in the map by our pending read
+		chunked_object &current = m_chunked_objects.find(key)->second;
+		const bool valid = !fetch_err && current.generation == generation;
+
+		if (valid) {
+			current.total_size = total_size;
+			current.user_flags = user_flags;
+			current.timestamp = timestamp;
+
+			for (size_t i = 0; i < std::min(chunks.size(), fetched.size()); ++i) {
+				chunk_id(id, first_chunk + i, key_chunk);
+
+				if (fetched[i] && !m_hash_table.find(key_chunk)) {
+					create_chunk(id, first_chunk + i, fetched[i]);
+				}
+			}
+		}
+
+		--current.pending_reads;
+		release_chunked_object(key);
+
+		if (fetch_err) {
+			*err = fetch_err;
+			return raw_data_ptr();
+		}
+
+		// Object was changed while chunks were being read, cached chunks could be of the older version
+		if (!valid) {
+			return raw_data_ptr();
+		}
+	}
+
+	guard.unlock();
+
+	const size_t begin = io->offset - first_chunk * chunk_size;
+	raw_data_ptr result;
+
+	if (chunks.size() == 1) {
+		result = chunks.front();
+	} else if (!chunks.empty()) {
+		size_t size = 0;
+		for (auto chunk = chunks.begin(); chunk != chunks.end(); ++chunk) {
+			size += (*chunk)->size();
+		}
+
+		result = raw_data_t::create(m_allocator, NULL, 0, size);
+		for (auto chunk = chunks.begin(); chunk != chunks.end(); ++chunk) {
+			memcpy(result->data() + result->size(), (*chunk)->data(), (*chunk)->size());
+			result->set_size(result->size() + (*chunk)->size());
+		}
+	}
+
+	if (!result || begin >= result->size()) {
+		*err = -E2BIG;
+		return raw_data_ptr();
+	}
+
+	io->size = std::min<uint64_t>(io->size, result->size() - begin);
+	io->timestamp = timestamp;
+	io->user_flags = user_flags;
+	io->total_size = total_size;
+	*data_offset = begin;
+	*err = 0;
+	return result;
 }
 
 struct remove_timer
@@ -444,10 +787,10 @@ int slru_cache_t::remove_(const unsigned char *id, dnet_io_attr *io) {
 
 	remove_timer timer(m_node, id);
 
-	elliptics_unique_lock<std::mutex> guard(m_lock, m_node, "%s: CACHE REMOVE: %p", dnet_dump_id_str(id), this);
+	elliptics_unique_lock<std::mutex> guard(m_lock, m_node, DNET_LOCK_SITE("cache: remove"), id);
 	timer.lock = timer.restart();
 
-	data_t* it = m_treap.find(id);
+	data_t* it = m_hash_table.find(id);
 	timer.find = timer.restart();
 	if (it) {
 
@@ -459,7 +802,7 @@ int slru_cache_t::remove_(const unsigned char *id, dnet_io_attr *io) {
 			it->clear_synctime();
 
 			if (previous_eventtime != it->eventtime()) {
-				m_treap.decrease_key(it);
+				update_eventtime(it);
 			}
 		}
 		erase_element(&(*it));
@@ -467,6 +810,13 @@ int slru_cache_t::remove_(const unsigned char *id, dnet_io_attr *io) {
 		timer.erase = timer.restart();
 	}
 
+	invalidate_chunks(id);
+
+	// Data which is being read from the disk right now must not get into the cache after removal
+	if (remove_from_disk) {
+		invalidate_populate(id, true);
+	}
+
 	guard.unlock();
 
 	if (remove_from_disk) {
@@ -529,20 +879,64 @@ int slru_cache_t::lookup(const unsigned char *id, dnet_net_state *st, dnet_cmd *
 
 void slru_cache_t::clear()
 {
-	std::vector<size_t> cache_pages_max_sizes = m_cache_pages_max_sizes;
+	elliptics_unique_lock<std::mutex> guard(m_lock, m_node, DNET_LOCK_SITE("cache: clear"));
 
-	elliptics_unique_lock<std::mutex> guard(m_lock, m_node, "CACHE CLEAR: %p", this);
+	std::vector<size_t> cache_pages_max_sizes = m_cache_pages_max_sizes;
 
 	for (size_t page_number = 0; page_number < m_cache_pages_number; ++page_number) {
 		m_cache_pages_max_sizes[page_number] = 0;
 		resize_page((unsigned char *) "", page_number, 0);
 	}
 
-	while (!m_treap.empty()) {
-		erase_element(m_treap.top());
+	for (size_t page_number = 0; page_number < m_cache_pages_number; ++page_number) {
+		while (!m_cache_pages_lru[page_number].empty()) {
+			erase_element(&m_cache_pages_lru[page_number].front());
+		}
 	}
 
 	m_cache_pages_max_sizes = cache_pages_max_sizes;
+	m_recency_ghosts.clear();
+	m_frequency_ghosts.clear();
+}
+
+void slru_cache_t::resize(const std::vector<size_t> &cache_pages_max_sizes)
+{
+	elliptics_unique_lock<std::mutex> guard(m_lock, m_node, DNET_LOCK_SITE("cache: resize"));
+
+	size_t old_size = 0, new_size = 0;
+	for (size_t i = 0; i < m_cache_pages_number; ++i) {
+		old_size += m_cache_pages_base_sizes[i];
+		new_size += cache_pages_max_sizes[i];
+	}
+
+	// Adaptive split learned so far is kept in proportion to the new size
+	if (old_size)
+		m_last_page_target = m_last_page_target * (new_size * 1.0 / old_size);
+	else
+		m_last_page_target = cache_pages_max_sizes.back();
+
+	m_cache_pages_base_sizes = cache_pages_max_sizes;
+	apply_pages_sizes();
+
+	dnet_log(m_node, DNET_LOG_INFO, "CACHE: resize: %p: %zu -> %zu bytes, objects: %zu\n",
+		this, old_size, new_size, m_cache_stats.number_of_objects.load());
+}
+
+void slru_cache_t::set_adaptive(bool adaptive)
+{
+	elliptics_unique_lock<std::mutex> guard(m_lock, m_node, DNET_LOCK_SITE("cache: set adaptive"));
+
+	// Single page has nothing to adapt
+	adaptive = adaptive && m_cache_pages_number > 1;
+	if (adaptive == m_adaptive)
+		return;
+
+	m_adaptive = adaptive;
+	m_last_page_target = m_cache_pages_base_sizes.back();
+	m_recency_ghosts.clear();
+	m_frequency_ghosts.clear();
+
+	apply_pages_sizes();
 }
 
 int slru_cache_t::lookup_(const unsigned char *id, dnet_net_state *st, dnet_cmd *cmd) {
@@ -550,10 +944,10 @@ int slru_cache_t::lookup_(const unsigned char *id, dnet_net_state *st, dnet_cmd
 
 	lookup_timer timer(m_node, id);
 
-	elliptics_unique_lock<std::mutex> guard(m_lock, m_node, "%s: CACHE LOOKUP: %p", dnet_dump_id_str(id), this);
+	elliptics_unique_lock<std::mutex> guard(m_lock, m_node, DNET_LOCK_SITE("cache: lookup"), id);
 	timer.lock = timer.restart();
 
-	data_t* it = m_treap.find(id);
+	data_t* it = m_hash_table.find(id);
 	timer.find = timer.restart();
 	if (!it) {
 
@@ -586,14 +980,250 @@ int slru_cache_t::lookup_(const unsigned char *id, dnet_net_state *st, dnet_cmd
 	return dnet_send_reply(st, cmd, data.data(), data.size(), 0);
 }
 
+int slru_cache_t::update_index(const unsigned char *id, const dnet_indexes_request &request,
+		const ioremap::elliptics::data_pointer &data, uint32_t action) {
+	using namespace ioremap::elliptics;
+
+	elliptics_timer timer;
+
+	elliptics_unique_lock<std::mutex> guard(m_lock, m_node, DNET_LOCK_SITE("cache: index update"), id);
+
+	data_t *it = NULL;
+	int err = 0;
+	index_table *table = load_index_table(guard, id, action == DNET_INDEXES_FLAGS_INTERNAL_INSERT, &it, &err);
+	if (!table) {
+		// There is nothing to remove from index which does not exist
+		return err == -ENOENT ? 0 : err;
+	}
+
+	dnet_raw_id object_id;
+	memcpy(object_id.id, request.id.id, DNET_ID_SIZE);
+
+	auto position = std::lower_bound(table->indexes->indexes.begin(), table->indexes->indexes.end(),
+		object_id, dnet_raw_id_less_than<skip_data>());
+	const bool found = (position != table->indexes->indexes.end() && position->index == object_id);
+
+	if (action == DNET_INDEXES_FLAGS_INTERNAL_INSERT ? (found && position->data == data) : !found) {
+		m_cache_stats.total_write_time += timer.elapsed<std::chrono::microseconds>();
+		return 0;
+	}
+
+	// Table may be used by find requests right now, they expect it to be unchanged
+	if (!table->indexes.unique()) {
+		const size_t offset = position - table->indexes->indexes.begin();
+		table->indexes = std::make_shared<dnet_indexes>(*table->indexes);
+		position = table->indexes->indexes.begin() + offset;
+	}
+
+	if (action == DNET_INDEXES_FLAGS_INTERNAL_REMOVE) {
+		table->indexes->indexes.erase(position);
+	} else if (found) {
+		position->data = data_pointer::copy(data);
+	} else {
+		table->indexes->indexes.insert(position, index_entry(object_id, data_pointer::copy(data)));
+	}
+
+	table->indexes->shard_id = request.shard_id;
+	table->indexes->shard_count = request.shard_count;
+
+	// Packing is much cheaper than unpacking, so cached object is always kept up to date
+	// and is synced by the usual write-back
+	static const uint64_t magic = dnet_bswap64(DNET_INDEX_TABLE_MAGIC);
+
+	msgpack::sbuffer buffer;
+	buffer.write(reinterpret_cast<const char *>(&magic), DNET_INDEX_TABLE_MAGIC_SIZE);
+	msgpack::pack(&buffer, *table->indexes);
+
+	raw_data_ptr payload = raw_data_t::create(m_allocator, buffer.data(), buffer.size(), buffer.size());
+	table->source = payload;
+
+	const size_t page_number = it->cache_page_number();
+	const size_t new_page_number = get_next_page_number(page_number);
+
+	remove_data_from_page(id, page_number, it);
+	resize_page(id, new_page_number, 2 * (payload->size() + it->overhead_size()));
+
+	m_cache_stats.size_of_objects -= it->size();
+	it->set_data(std::move(payload));
+	m_cache_stats.size_of_objects += it->size();
+
+	it->set_remove_from_cache(false);
+	insert_data_into_page(id, new_page_number, it);
+
+	const size_t previous_eventtime = it->eventtime();
+
+	if (!it->synctime()) {
+		it->set_synctime(time(NULL) + m_node->cache_sync_timeout);
+	}
+
+	if (previous_eventtime != it->eventtime()) {
+		update_eventtime(it);
+	}
+
+	dnet_time timestamp;
+	dnet_current_time(&timestamp);
+	it->set_timestamp(timestamp);
+
+	m_cache_stats.total_write_time += timer.elapsed<std::chrono::microseconds>();
+	return 0;
+}
+
+std::shared_ptr<const ioremap::elliptics::dnet_indexes> slru_cache_t::find_index(const unsigned char *id, int *err) {
+	elliptics_timer timer;
+
+	elliptics_unique_lock<std::mutex> guard(m_lock, m_node, DNET_LOCK_SITE("cache: index find"), id);
+
+	data_t *it = NULL;
+	index_table *table = load_index_table(guard, id, false, &it, err);
+	if (!table) {
+		m_cache_stats.total_read_time += timer.elapsed<std::chrono::microseconds>();
+		return std::shared_ptr<const ioremap::elliptics::dnet_indexes>();
+	}
+
+	const size_t page_number = it->cache_page_number();
+	move_data_between_pages(id, page_number, get_next_page_number(page_number), it);
+
+	m_cache_stats.total_read_time += timer.elapsed<std::chrono::microseconds>();
+	return table->indexes;
+}
+
 cache_stats slru_cache_t::get_cache_stats() const
 {
 	cache_stats stats(m_cache_stats);
 	stats.pages_sizes = m_cache_pages_sizes;
 	stats.pages_max_sizes = m_cache_pages_max_sizes;
+	stats.size_of_mapped_memory = m_allocator.mapped_size();
 	return stats;
 }
 
+void slru_cache_t::snapshot(std::vector<snapshot_entry> &entries) {
+	elliptics_unique_lock<std::mutex> guard(m_lock, m_node, DNET_LOCK_SITE("cache: snapshot"));
+
+	entries.reserve(entries.size() + m_hash_table.size());
+
+	for (size_t page_number = 0; page_number < m_cache_pages_number; ++page_number) {
+		lru_list_t &page = m_cache_pages_lru[page_number];
+
+		for (auto it = page.begin(); it != page.end(); ++it) {
+			// Chunks are cheap to read once again, snapshot keeps whole objects only
+			if (it->chunk()) {
+				continue;
+			}
+
+			snapshot_entry entry;
+			snapshot_record &record = entry.record;
+
+			memset(&record, 0, sizeof(record));
+			memcpy(record.id, it->id().id, DNET_ID_SIZE);
+			record.timestamp = it->timestamp();
+			record.user_flags = it->user_flags();
+			record.lifetime = it->lifetime();
+			record.size = it->data()->size();
+			record.page = page_number;
+
+			if (it->synctime())
+				record.flags |= snapshot_record_dirty;
+			if (it->only_append())
+				record.flags |= snapshot_record_only_append;
+			if (it->remove_from_disk())
+				record.flags |= snapshot_record_remove_from_disk;
+
+			entry.data = it->data();
+			entries.push_back(std::move(entry));
+		}
+	}
+}
+
+bool slru_cache_t::restore(const snapshot_record &record, const char *data) {
+	const unsigned char *id = record.id;
+	const size_t now = time(NULL);
+
+	if (record.lifetime && record.lifetime <= now)
+		return false;
+
+	dnet_raw_id key;
+	memcpy(key.id, id, DNET_ID_SIZE);
+
+	const size_t page_number = std::min<size_t>(record.page, m_cache_pages_number - 1);
+	const size_t size = data_t::node_size() +
+		slab_allocator::charged_size(slab_allocator::allocated_size(sizeof(raw_data_t) + record.size));
+
+	elliptics_unique_lock<std::mutex> guard(m_lock, m_node, DNET_LOCK_SITE("cache: restore"), id);
+
+	// Restored objects must never push out objects which are used right now
+	if (m_hash_table.find(id) || m_populating.count(key)
+			|| page_charge(page_number) + size > m_cache_pages_max_sizes[page_number]) {
+		return false;
+	}
+
+	// Reads of this key wait for the restore the same way they wait for the concurrent read
+	std::shared_ptr<populate_request> request = std::make_shared<populate_request>();
+	m_populating.insert(std::make_pair(key, request));
+
+	guard.unlock();
+
+	dnet_cmd cmd;
+	memset(&cmd, 0, sizeof(cmd));
+	memcpy(cmd.id.id, id, DNET_ID_SIZE);
+	cmd.cmd = DNET_CMD_LOOKUP;
+	cmd.flags = DNET_FLAGS_NOCACHE;
+
+	local_session sess(m_node);
+
+	int err = 0;
+	ioremap::elliptics::data_pointer info = sess.lookup(cmd, &err);
+
+	// Snapshot copy is compared with the disk one by the object timestamp, which is set by the writer,
+	// so it does not depend on the clock of the node. Clean copy must match the disk object exactly,
+	// dirty one must not be older than it. Object missing on the disk could have been removed, so it is dropped.
+	bool valid = false;
+	if (!err) {
+		dnet_file_info *file_info = info.skip<dnet_addr>().data<dnet_file_info>();
+		const int cmp = dnet_time_cmp(&file_info->mtime, &record.timestamp);
+
+		if (record.flags & snapshot_record_dirty)
+			valid = cmp <= 0;
+		else
+			valid = cmp == 0 && file_info->size == record.size;
+	}
+
+	guard.lock();
+
+	m_populating.erase(key);
+
+	valid = valid && !request->invalidated && !m_hash_table.find(id)
+		&& page_charge(page_number) + size <= m_cache_pages_max_sizes[page_number];
+
+	if (valid) {
+		raw_data_ptr payload = raw_data_t::create(m_allocator, data, record.size, record.size);
+		data_t *obj = new (m_allocator.allocate(sizeof(data_t))) data_t(id, 0, payload,
+				record.flags & snapshot_record_remove_from_disk);
+
+		obj->set_lifetime(record.lifetime);
+		obj->set_timestamp(record.timestamp);
+		obj->set_user_flags(record.user_flags);
+		obj->set_only_append(record.flags & snapshot_record_only_append);
+
+		// Data which was not synced before restart is written to the disk once again
+		if (record.flags & snapshot_record_dirty)
+			obj->set_synctime(now + m_node->cache_sync_timeout);
+
+		insert_data_into_page(id, page_number, obj);
+
+		++m_cache_stats.number_of_objects;
+		m_cache_stats.size_of_objects += obj->size();
+		m_hash_table.insert(obj);
+		update_eventtime(obj);
+	}
+
+	// Waiters read the key by themselves if it was not restored
+	request->invalidated = !valid;
+	request->done = true;
+	m_populate_wait.notify_all();
+
+	return valid;
+}
+
 // private:
 
 void slru_cache_t::insert_data_into_page(const unsigned char *id, size_t page_number, data_t *data)
@@ -602,12 +1232,15 @@ void slru_cache_t::insert_data_into_page(const unsigned char *id, size_t page_nu
 	size_t size = data->size();
 
 	// Recalc used space, free enough space for new data, move object to the end of the queue
-	if (m_cache_pages_sizes[page_number] + size > m_cache_pages_max_sizes[page_number]) {
+	if (page_charge(page_number) + size > m_cache_pages_max_sizes[page_number]) {
 		dnet_log(m_node, DNET_LOG_DEBUG, "%s: CACHE: resize called: %lld ms\n", dnet_dump_id_str(id), timer.restart());
 		resize_page(id, page_number, size);
 		dnet_log(m_node, DNET_LOG_DEBUG, "%s: CACHE: resize finished: %lld ms\n", dnet_dump_id_str(id), timer.restart());
 	}
 
+	if (page_number + 1 < m_cache_pages_number)
+		data->set_promoted(true);
+
 	data->set_cache_page_number(page_number);
 	m_cache_pages_lru[page_number].push_back(*data);
 	m_cache_pages_sizes[page_number] += size;
@@ -631,20 +1264,22 @@ void slru_cache_t::move_data_between_pages(const unsigned char *id, size_t sourc
 data_t* slru_cache_t::create_data(const unsigned char *id, const char *data, size_t size, bool remove_from_disk) {
 	size_t last_page_number = m_cache_pages_number - 1;
 
-	data_t *raw = new data_t(id, 0, data, size, remove_from_disk);
+	raw_data_ptr payload = raw_data_t::create(m_allocator, data, size, size);
+	data_t *raw = new (m_allocator.allocate(sizeof(data_t))) data_t(id, 0, payload, remove_from_disk);
 
+	adapt(id);
 	insert_data_into_page(id, last_page_number, raw);
 
 	++m_cache_stats.number_of_objects;
 	m_cache_stats.size_of_objects += raw->size();
-	m_treap.insert(raw);
+	m_hash_table.insert(raw);
 	return raw;
 }
 
 struct populate_timer
 {
 	populate_timer(dnet_node *node, const unsigned char *id) :
-		node(node), id(id), init(0), local_read(0), lock(-1), create(-1)
+		node(node), id(id), wait(-1), init(0), local_read(0), lock(-1), create(-1)
 	{
 	}
 
@@ -653,9 +1288,9 @@ struct populate_timer
 		const unsigned long long total = total_timer.elapsed();
 		const int level = total > 100 ? DNET_LOG_ERROR : DNET_LOG_DEBUG;
 
-		dnet_log(node, level, "%s: CACHE: populate, init: %lld ms, local_read: %lld ms, "
+		dnet_log(node, level, "%s: CACHE: populate, wait: %lld ms, init: %lld ms, local_read: %lld ms, "
 			"lock: %lld ms, create: %lld ms, last: %lld ms, total: %lld ms\n",
-			dnet_dump_id_str(id), init, local_read, lock, create, timer.elapsed(), total);
+			dnet_dump_id_str(id), wait, init, local_read, lock, create, timer.elapsed(), total);
 	}
 
 	inline long long int restart()
@@ -668,18 +1303,59 @@ struct populate_timer
 
 	dnet_node *node;
 	const unsigned char *id;
+	long long int wait;
 	long long int init;
 	long long int local_read;
 	long long int lock;
 	long long int create;
 };
 
+/*
+ * Reads object from the backend and puts it into the cache.
+ * Shard lock is released for the time of the backend read, so misses don't block other keys in the shard.
+ * If there is already a read of the same key in progress we wait for its completion instead of issuing another one.
+ * Read overwritten on the disk meanwhile is repeated, if the key keeps changing -ENOTSUP is returned,
+ * so the request is served by the backend. Only removal of the key results in -ENOENT.
+ * Guard is always locked on exit.
+ */
 data_t* slru_cache_t::populate_from_disk(elliptics_unique_lock<std::mutex> &guard, const unsigned char *id, bool remove_from_disk, int *err) {
-	if (guard.owns_lock()) {
-		guard.unlock();
+	populate_timer timer(m_node, id);
+
+	if (!guard.owns_lock()) {
+		guard.lock();
 	}
 
-	populate_timer timer(m_node, id);
+	dnet_raw_id key;
+	memcpy(key.id, id, DNET_ID_SIZE);
+
+	std::shared_ptr<populate_request> request;
+
+	while (!request) {
+		// Somebody could have put the key into the cache while the guard was unlocked
+		data_t *it = m_hash_table.find(id);
+		if (it) {
+			*err = 0;
+			return it;
+		}
+
+		auto pending = m_populating.find(key);
+		if (pending == m_populating.end()) {
+			request = std::make_shared<populate_request>();
+			m_populating.insert(std::make_pair(key, request));
+			break;
+		}
+
+		std::shared_ptr<populate_request> other = pending->second;
+
+		m_populate_wait.wait(guard, [&other] { return other->done; });
+		timer.wait = timer.restart();
+
+		// Data read by the other request is outdated, read it once again
+		if (!other->invalidated) {
+			*err = other->err;
+			return m_hash_table.find(id);
+		}
+	}
 
 	local_session sess(m_node);
 	sess.set_ioflags(DNET_IO_FLAGS_NOCACHE);
@@ -690,28 +1366,226 @@ data_t* slru_cache_t::populate_from_disk(elliptics_unique_lock<std::mutex> &guar
 
 	uint64_t user_flags = 0;
 	dnet_time timestamp;
-	dnet_empty_time(&timestamp);
+	ioremap::elliptics::data_pointer data;
+	data_t *it = NULL;
+
+	for (int attempt = 0; attempt < populate_max_attempts; ++attempt) {
+		request->invalidated = false;
 
-	timer.init = timer.restart();
+		guard.unlock();
 
-	ioremap::elliptics::data_pointer data = sess.read(raw_id, &user_flags, &timestamp, err);
+		user_flags = 0;
+		dnet_empty_time(&timestamp);
 
-	timer.local_read = timer.restart();
+		timer.init = timer.restart();
 
-	guard.lock();
+		data = sess.read(raw_id, &user_flags, &timestamp, err);
 
-	timer.lock = timer.restart();
+		timer.local_read = timer.restart();
 
-	if (*err == 0) {
-		auto it = create_data(id, reinterpret_cast<char *>(data.data()), data.size(), remove_from_disk);
+		guard.lock();
+
+		timer.lock = timer.restart();
+
+		// Key was written while we were reading it, cached data is newer than the disk one
+		it = m_hash_table.find(id);
+		if (it || !request->invalidated || request->removed)
+			break;
+	}
+
+	m_populating.erase(key);
+
+	if (it) {
+		*err = 0;
+	} else if (request->removed) {
+		*err = -ENOENT;
+	} else if (request->invalidated) {
+		*err = -ENOTSUP;
+	} else if (*err == 0) {
+		it = create_data(id, reinterpret_cast<char *>(data.data()), data.size(), remove_from_disk);
 		it->set_user_flags(user_flags);
 		it->set_timestamp(timestamp);
 
 		timer.create = timer.restart();
-		return it;
 	}
 
-	return NULL;
+	request->err = *err;
+	request->done = true;
+	m_populate_wait.notify_all();
+
+	return it;
+}
+
+void slru_cache_t::invalidate_populate(const unsigned char *id, bool removed) {
+	dnet_raw_id key;
+	memcpy(key.id, id, DNET_ID_SIZE);
+
+	auto pending = m_populating.find(key);
+	if (pending != m_populating.end()) {
+		pending->second->invalidated = true;
+		pending->second->removed |= removed;
+	}
+}
+
+/*
+ * TinyLFU admission: object read from the disk goes to the coldest page, so it is admitted
+ * only if it is estimated to be accessed more frequently than the object it is going to evict.
+ * Objects which are being read by somebody else are admitted anyway, their readers wait for them.
+ */
+bool slru_cache_t::admit(const unsigned char *id) {
+	if (!m_sketch) {
+		return true;
+	}
+
+	dnet_raw_id key;
+	memcpy(key.id, id, DNET_ID_SIZE);
+
+	if (m_populating.count(key)) {
+		return true;
+	}
+
+	const size_t last_page_number = m_cache_pages_number - 1;
+	const lru_list_t &page = m_cache_pages_lru[last_page_number];
+
+	// There is free space, so nothing is going to be evicted
+	if (page.empty() || page_charge(last_page_number) < m_cache_pages_max_sizes[last_page_number]) {
+		return true;
+	}
+
+	const data_t &victim = page.front();
+
+	// Frequencies are counted for whole objects, chunks are as popular as their objects
+	unsigned char victim_id[DNET_ID_SIZE];
+	if (victim.chunk()) {
+		chunk_id(victim.id().id, victim.chunk() - 1, victim_id);
+	} else {
+		memcpy(victim_id, victim.id().id, DNET_ID_SIZE);
+	}
+
+	return m_sketch->estimate(id) > m_sketch->estimate(victim_id);
+}
+
+/*
+ * Removes all cached chunks of the object and makes chunks being read now outdated
+ */
+void slru_cache_t::invalidate_chunks(const unsigned char *id) {
+	dnet_raw_id key;
+	memcpy(key.id, id, DNET_ID_SIZE);
+
+	auto object = m_chunked_objects.find(key);
+	if (object == m_chunked_objects.end()) {
+		return;
+	}
+
+	++object->second.generation;
+	const uint64_t max_chunk = object->second.max_chunk;
+
+	unsigned char key_chunk[DNET_ID_SIZE];
+	for (uint64_t chunk = 0; chunk <= max_chunk; ++chunk) {
+		chunk_id(id, chunk, key_chunk);
+
+		data_t *obj = m_hash_table.find(key_chunk);
+		if (obj) {
+			erase_element(obj);
+		}
+	}
+}
+
+void slru_cache_t::release_chunked_object(const dnet_raw_id &key) {
+	auto object = m_chunked_objects.find(key);
+	if (object != m_chunked_objects.end() && !object->second.chunks_number && !object->second.pending_reads) {
+		m_chunked_objects.erase(object);
+	}
+}
+
+data_t* slru_cache_t::create_chunk(const unsigned char *id, uint64_t chunk, const raw_data_ptr &payload) {
+	dnet_raw_id key;
+	memcpy(key.id, id, DNET_ID_SIZE);
+
+	chunked_object &object = m_chunked_objects[key];
+	++object.chunks_number;
+	object.max_chunk = std::max(object.max_chunk, chunk);
+
+	unsigned char key_chunk[DNET_ID_SIZE];
+	chunk_id(id, chunk, key_chunk);
+
+	data_t *raw = new (m_allocator.allocate(sizeof(data_t))) data_t(key_chunk, 0, payload, false);
+	raw->set_chunk(chunk + 1);
+
+	insert_data_into_page(key_chunk, m_cache_pages_number - 1, raw);
+
+	++m_cache_stats.number_of_objects;
+	m_cache_stats.size_of_objects += raw->size();
+	m_hash_table.insert(raw);
+	return raw;
+}
+
+slru_cache_t::index_table *slru_cache_t::load_index_table(elliptics_unique_lock<std::mutex> &guard,
+		const unsigned char *id, bool create, data_t **obj, int *err) {
+	dnet_raw_id key;
+	memcpy(key.id, id, DNET_ID_SIZE);
+
+	while (true) {
+		data_t *it = m_hash_table.find(id);
+
+		if (it && it->only_append()) {
+			sync_after_append(guard, true, it);
+			it = NULL;
+		}
+
+		if (!it) {
+			*err = 0;
+			it = populate_from_disk(guard, id, false, err);
+
+			if (!it) {
+				if (*err != -ENOENT || !create)
+					return NULL;
+
+				it = create_data(id, 0, 0, false);
+			}
+		}
+
+		auto table = m_index_tables.find(key);
+		if (table != m_index_tables.end() && table->second.source == it->data()) {
+			*obj = it;
+			*err = 0;
+			return &table->second;
+		}
+
+		// Holding the source makes any other write copy the payload, so outdated table is always detected
+		raw_data_ptr source = it->data();
+		auto indexes = std::make_shared<ioremap::elliptics::dnet_indexes>();
+		indexes->shard_id = 0;
+		indexes->shard_count = 0;
+
+		if (source->size()) {
+			guard.unlock();
+
+			dnet_id raw_id;
+			memset(&raw_id, 0, sizeof(raw_id));
+			memcpy(raw_id.id, id, DNET_ID_SIZE);
+
+			ioremap::elliptics::indexes_unpack(m_node, &raw_id,
+				ioremap::elliptics::data_pointer::from_raw(source->data(), source->size()),
+				indexes.get(), "cache_load_index_table");
+
+			guard.lock();
+
+			// Object was changed or evicted while it was unpacked
+			it = m_hash_table.find(id);
+			if (!it || it->data() != source)
+				continue;
+		}
+
+		index_table &entry = m_index_tables[key];
+		entry.source = source;
+		entry.indexes = indexes;
+		it->set_index_table(true);
+
+		*obj = it;
+		*err = 0;
+		return &entry;
+	}
 }
 
 bool slru_cache_t::have_enough_space(const unsigned char *id, size_t page_number, size_t reserve) {
@@ -719,6 +1593,23 @@ bool slru_cache_t::have_enough_space(const unsigned char *id, size_t page_number
 	return m_cache_pages_max_sizes[page_number] >= reserve;
 }
 
+size_t slru_cache_t::page_charge(size_t page_number) const {
+	size_t charge = m_cache_pages_sizes[page_number];
+
+	if (page_number != m_cache_pages_number - 1)
+		return charge;
+
+	size_t cache_size = 0;
+	for (size_t i = 0; i < m_cache_pages_number; ++i) {
+		cache_size += m_cache_pages_base_sizes[i];
+	}
+
+	if (cache_size >= slab_allocator::min_slab_limit())
+		charge += m_allocator.slack_size();
+
+	return charge;
+}
+
 void slru_cache_t::resize_page(const unsigned char *id, size_t page_number, size_t reserve) {
 	elliptics_timer timer;
 	elliptics_timer total_timer;
@@ -728,8 +1619,11 @@ void slru_cache_t::resize_page(const unsigned char *id, size_t page_number, size
 	size_t &max_cache_size = m_cache_pages_max_sizes[page_number];
 	size_t previous_page_number = get_previous_page_number(page_number);
 
+	// Freed chunks stay in their slabs, so slack is charged as it was before the eviction
+	const size_t slack = page_charge(page_number) - cache_size;
+
 	for (auto it = m_cache_pages_lru[page_number].begin(); it != m_cache_pages_lru[page_number].end();) {
-		if (max_cache_size + removed_size >= cache_size + reserve)
+		if (max_cache_size + removed_size >= cache_size + slack + reserve)
 			break;
 
 		data_t *raw = &*it;
@@ -748,6 +1642,7 @@ void slru_cache_t::resize_page(const unsigned char *id, size_t page_number, size
 		} else {
 			if (raw->synctime() || raw->remove_from_cache()) {
 				if (!raw->remove_from_cache()) {
+					remember_evicted(raw);
 					m_cache_stats.number_of_objects_marked_for_deletion++;
 					m_cache_stats.size_of_objects_marked_for_deletion += raw->size();
 					raw->set_remove_from_cache(true);
@@ -755,7 +1650,7 @@ void slru_cache_t::resize_page(const unsigned char *id, size_t page_number, size
 					size_t previous_eventtime = raw->eventtime();
 					raw->set_synctime(1);
 					if (previous_eventtime != raw->eventtime()) {
-						m_treap.decrease_key(raw);
+						update_eventtime(raw);
 					}
 				}
 				auto sync = timer.restart();
@@ -763,6 +1658,7 @@ void slru_cache_t::resize_page(const unsigned char *id, size_t page_number, size
 				dnet_log(m_node, DNET_LOG_DEBUG, "%s: CACHE: resize, inc: %lld ms, syncset: %lld ms\n",
 					dnet_dump_id_str(id), inc, sync);
 			} else {
+				remember_evicted(raw);
 				erase_element(raw);
 				auto erase = timer.restart();
 				dnet_log(m_node, DNET_LOG_DEBUG, "%s: CACHE: resize, inc: %lld ms, erase: %lld ms\n",
@@ -777,6 +1673,103 @@ void slru_cache_t::resize_page(const unsigned char *id, size_t page_number, size
 	dnet_log(m_node, level, "%s: CACHE: resize, total: %lld ms\n", dnet_dump_id_str(id), total_timer.restart());
 }
 
+void slru_cache_t::apply_pages_sizes() {
+	const size_t last_page_number = m_cache_pages_number - 1;
+
+	size_t cache_size = 0;
+	for (size_t i = 0; i < m_cache_pages_number; ++i) {
+		cache_size += m_cache_pages_base_sizes[i];
+	}
+
+	if (!m_adaptive) {
+		m_cache_pages_max_sizes = m_cache_pages_base_sizes;
+	} else {
+		const size_t min_size = cache_size * adaptive_min_share / 100;
+		m_last_page_target = std::max(min_size, std::min(m_last_page_target, cache_size - min_size));
+		m_cache_pages_max_sizes[last_page_number] = m_last_page_target;
+
+		// Other pages share the rest in configured proportions
+		const size_t others_size = cache_size - m_last_page_target;
+		const size_t others_base_size = cache_size - m_cache_pages_base_sizes[last_page_number];
+		for (size_t i = 0; i < last_page_number; ++i) {
+			m_cache_pages_max_sizes[i] = others_base_size ?
+				others_size * (m_cache_pages_base_sizes[i] * 1.0 / others_base_size) :
+				others_size / last_page_number;
+		}
+	}
+
+	// Ghosts cover as much as the whole cache, as in ARC
+	m_recency_ghosts.set_max_size(m_adaptive ? cache_size : 0);
+	m_frequency_ghosts.set_max_size(m_adaptive ? cache_size : 0);
+
+	// Overflow of every page is moved to the next one, the last page evicts it
+	for (size_t i = 0; i < m_cache_pages_number; ++i) {
+		if (page_charge(i) > m_cache_pages_max_sizes[i])
+			resize_page((unsigned char *) "", i, 0);
+	}
+}
+
+/*
+ * ARC-like adaptation: miss on the object which was evicted from the last page without
+ * being accessed again means the last page is too small, miss on the object which had been
+ * accessed repeatedly means the other pages are too small. Step is bigger when the ghost
+ * list which was hit is smaller than the other one.
+ */
+void slru_cache_t::adapt(const unsigned char *id) {
+	if (!m_adaptive)
+		return;
+
+	size_t size = 0;
+	if (m_recency_ghosts.erase(id, &size)) {
+		const size_t ghosts_size = m_recency_ghosts.size() + size;
+		const size_t delta = std::max<size_t>(size, size * (m_frequency_ghosts.size() * 1.0 / ghosts_size));
+
+		m_last_page_target += delta;
+	} else if (m_frequency_ghosts.erase(id, &size)) {
+		const size_t ghosts_size = m_frequency_ghosts.size() + size;
+		const size_t delta = std::max<size_t>(size, size * (m_recency_ghosts.size() * 1.0 / ghosts_size));
+
+		m_last_page_target -= std::min(delta, m_last_page_target);
+	} else {
+		return;
+	}
+
+	apply_pages_sizes();
+}
+
+void slru_cache_t::remember_evicted(data_t *obj) {
+	// Chunks are created by ranged reads only, their misses do not go through adapt()
+	if (!m_adaptive || obj->chunk())
+		return;
+
+	if (obj->promoted())
+		m_frequency_ghosts.insert(obj->id().id, obj->size());
+	else
+		m_recency_ghosts.insert(obj->id().id, obj->size());
+}
+
+void slru_cache_t::update_eventtime(data_t *obj) {
+	if (timer_wheel_t::is_linked(obj)) {
+		m_timer_wheel.erase(obj);
+	}
+
+	if (obj->has_eventtime()) {
+		// Event times have one second resolution, objects due in the same second
+		// are spread over it by their ids, so they are not handled in one burst
+		uint64_t jitter;
+		memcpy(&jitter, obj->id().id, sizeof(jitter));
+
+		const uint64_t deadline = obj->eventtime() * 1000 + jitter % 1000;
+		m_timer_wheel.insert(obj, deadline);
+
+		// Life check thread sleeps until the previous earliest deadline, it has to handle this one before
+		if (deadline < m_lifecheck_deadline) {
+			m_lifecheck_deadline = deadline;
+			m_lifecheck_wait.notify_one();
+		}
+	}
+}
+
 void slru_cache_t::erase_element(data_t *obj) {
 	elliptics_timer timer;
 
@@ -786,7 +1779,10 @@ void slru_cache_t::erase_element(data_t *obj) {
 	size_t page_number = obj->cache_page_number();
 	m_cache_pages_sizes[page_number] -= obj->size();
 	m_cache_pages_lru[page_number].erase(m_cache_pages_lru[page_number].iterator_to(*obj));
-	m_treap.erase(obj);
+	m_hash_table.erase(obj);
+	if (timer_wheel_t::is_linked(obj)) {
+		m_timer_wheel.erase(obj);
+	}
 
 	if (obj->eventtime()) {
 		if (obj->synctime()) {
@@ -795,6 +1791,21 @@ void slru_cache_t::erase_element(data_t *obj) {
 		}
 	}
 
+	if (obj->chunk()) {
+		dnet_raw_id key;
+		chunk_id(obj->id().id, obj->chunk() - 1, key.id);
+
+		auto object = m_chunked_objects.find(key);
+		if (object != m_chunked_objects.end()) {
+			--object->second.chunks_number;
+			release_chunked_object(key);
+		}
+	}
+
+	if (obj->index_table()) {
+		m_index_tables.erase(obj->id());
+	}
+
 	if (obj->remove_from_cache())
 	{
 		m_cache_stats.number_of_objects_marked_for_deletion--;
@@ -803,14 +1814,45 @@ void slru_cache_t::erase_element(data_t *obj) {
 
 	dnet_log(m_node, DNET_LOG_DEBUG, "%s: CACHE: erased element: %lld ms\n", dnet_dump_id_str(obj->id().id), timer.restart());
 
-	delete obj;
+	destroy_data(obj);
+}
+
+void slru_cache_t::destroy_data(data_t *obj) {
+	obj->~data_t();
+	m_allocator.deallocate(obj, sizeof(data_t));
 }
 
-void slru_cache_t::sync_element(const dnet_id &raw, bool after_append, const std::vector<char> &data, uint64_t user_flags, const dnet_time &timestamp) {
+void slru_cache_t::prepare_data(data_t *obj, size_t size, size_t keep, bool append) {
+	const raw_data_ptr &raw = obj->data();
+
+	if (!raw->unique()) {
+		// Somebody is sending this payload right now, so it is copied instead of being changed
+		obj->set_data(raw_data_t::create(m_allocator, raw->data(), std::min(keep, raw->size()), size));
+	} else if (raw->capacity() < size) {
+		size_t capacity = size;
+
+		// Grow appended objects geometrically, so series of appends does not copy data every time
+		if (append) {
+			capacity = std::max(size, raw->capacity() + raw->capacity() / 2);
+		}
+
+		obj->set_data(raw_data_t::grow(obj->release_data(), capacity));
+	}
+}
+
+void slru_cache_t::append_data(data_t *obj, const char *data, size_t size) {
+	const size_t old_size = obj->data()->size();
+
+	prepare_data(obj, old_size + size, old_size, true);
+	memcpy(obj->data()->data() + old_size, data, size);
+	obj->data()->set_size(old_size + size);
+}
+
+void slru_cache_t::sync_element(const dnet_id &raw, bool after_append, const raw_data_ptr &data, uint64_t user_flags, const dnet_time &timestamp, uint32_t ioflags) {
 	local_session sess(m_node);
-	sess.set_ioflags(DNET_IO_FLAGS_NOCACHE | (after_append ? DNET_IO_FLAGS_APPEND : 0));
+	sess.set_ioflags(DNET_IO_FLAGS_NOCACHE | ioflags | (after_append ? DNET_IO_FLAGS_APPEND : 0));
 
-	int err = sess.write(raw, data.data(), data.size(), user_flags, timestamp);
+	int err = sess.write(raw, data->data(), data->size(), user_flags, timestamp);
 	if (err) {
 		dnet_log(m_node, DNET_LOG_ERROR, "%s: CACHE: forced to sync to disk, err: %d\n", dnet_dump_id_str(raw.id), err);
 	} else {
@@ -823,15 +1865,13 @@ void slru_cache_t::sync_element(data_t *obj) {
 	memset(&raw, 0, sizeof(struct dnet_id));
 	memcpy(raw.id, obj->id().id, DNET_ID_SIZE);
 
-	auto &data = obj->data()->data();
-
-	sync_element(raw, obj->only_append(), data, obj->user_flags(), obj->timestamp());
+	sync_element(raw, obj->only_append(), obj->data(), obj->user_flags(), obj->timestamp(), 0);
 }
 
 void slru_cache_t::sync_after_append(elliptics_unique_lock<std::mutex> &guard, bool lock_guard, data_t *obj) {
 	elliptics_timer timer;
 
-	std::shared_ptr<raw_data_t> raw_data = obj->data();
+	raw_data_ptr raw_data = obj->data();
 
 	obj->clear_synctime();
 
@@ -853,11 +1893,9 @@ void slru_cache_t::sync_after_append(elliptics_unique_lock<std::mutex> &guard, b
 	local_session sess(m_node);
 	sess.set_ioflags(DNET_IO_FLAGS_NOCACHE | DNET_IO_FLAGS_APPEND);
 
-	auto &raw = raw_data->data();
-
 	const auto timer_before_write = timer.restart();
 
-	int err = sess.write(id, raw.data(), raw.size(), user_flags, timestamp);
+	int err = sess.write(id, raw_data->data(), raw_data->size(), user_flags, timestamp);
 
 	const auto timer_after_write = timer.restart();
 
@@ -875,38 +1913,80 @@ struct record_info {
 	record_info(data_t* obj)
 	{
 		only_append = obj->only_append();
+		memset(&id, 0, sizeof(id));
 		memcpy(id.id, obj->id().id, DNET_ID_SIZE);
-		data = obj->data()->data();
+		data = obj->data();
 		user_flags = obj->user_flags();
 		timestamp = obj->timestamp();
 	}
 
 	bool only_append;
 	dnet_id id;
-	std::vector<char> data;
+	raw_data_ptr data;
 	uint64_t user_flags;
 	dnet_time timestamp;
 };
 
+void slru_cache_t::write_back(std::vector<record_info> &records) {
+	if (records.empty())
+		return;
+
+	elliptics_timer timer;
+
+	// Backends keep their indexes ordered by key, so sorted batch touches them sequentially
+	std::sort(records.begin(), records.end(), [] (const record_info &first, const record_info &second) {
+		return memcmp(first.id.id, second.id.id, DNET_ID_SIZE) < 0;
+	});
+
+	std::lock_guard<writeback_limiter> guard(m_writeback);
+
+	const auto timer_wait = timer.restart();
+
+	for (auto it = records.begin(); it != records.end(); ++it) {
+		dnet_oplock(m_node, &it->id);
+
+		// sync_element uses local_session which always uses DNET_FLAGS_NOLOCK
+		sync_element(it->id, it->only_append, it->data, it->user_flags, it->timestamp, DNET_IO_FLAGS_NOSYNC);
+
+		dnet_opunlock(m_node, &it->id);
+	}
+
+	const auto timer_write = timer.restart();
+
+	// Whole batch is synced once instead of every object
+	if (m_node->cb->sync) {
+		int err = m_node->cb->sync(m_node->cb->command_private);
+		if (err) {
+			dnet_log(m_node, DNET_LOG_ERROR, "CACHE: write-back: failed to sync %zu objects, err: %d\n",
+				records.size(), err);
+		}
+	}
+
+	dnet_log(m_node, DNET_LOG_DEBUG, "CACHE: write-back: %zu objects, wait: %lld ms, write: %lld ms, sync: %lld ms\n",
+		records.size(), timer_wait, timer_write, timer.restart());
+}
+
 void slru_cache_t::life_check(void) {
 	elliptics_timer lifecheck_timer;
+	std::vector<data_t *> expired;
+	expired.reserve(life_check_batch_size);
+
 	while (!m_need_exit) {
 		(void) lifecheck_timer.restart();
 		std::deque<struct dnet_id> remove;
-		std::deque<record_info> elements_for_sync;
+		std::vector<record_info> elements_for_sync;
+		bool more_expired = false;
 
 		{
-			elliptics_unique_lock<std::mutex> guard(m_lock, m_node, "CACHE LIFE: %p", this);
+			elliptics_unique_lock<std::mutex> guard(m_lock, m_node, DNET_LOCK_SITE("cache: life"));
 
-			while (!m_need_exit && !m_treap.empty()) {
-				size_t time = ::time(NULL);
+			// Only bounded batch of due objects is handled under the lock,
+			// the rest is taken on the next iteration right after the I/O is done
+			expired.clear();
+			more_expired = m_timer_wheel.advance(current_time_ms(), expired, life_check_batch_size);
 
-				if (m_treap.empty())
-					break;
-
-				data_t* it = m_treap.top();
-				if (it->eventtime() > time)
-					break;
+			for (auto obj = expired.begin(); obj != expired.end(); ++obj) {
+				data_t *it = *obj;
 
 				if (it->eventtime() == it->lifetime())
 				{
@@ -929,24 +2009,38 @@ void slru_cache_t::life_check(void) {
 
 					if (it->only_append() || it->remove_from_cache()) {
 						erase_element(&*it);
+					} else {
+						update_eventtime(it);
 					}
 				}
+				else
+				{
+					update_eventtime(it);
+				}
 			}
 		}
-		for (auto it = elements_for_sync.begin(); it != elements_for_sync.end(); ++it) {
-			dnet_oplock(m_node, &it->id);
-
-			// sync_element uses local_session which always uses DNET_FLAGS_NOLOCK
-			sync_element(it->id, it->only_append, it->data, it->user_flags, it->timestamp);
-
-			dnet_opunlock(m_node, &it->id);
-		}
+		write_back(elements_for_sync);
 		for (std::deque<struct dnet_id>::iterator it = remove.begin(); it != remove.end(); ++it) {
 			dnet_remove_local(m_node, &(*it));
 		}
 
 		m_cache_stats.total_lifecheck_time += lifecheck_timer.elapsed<std::chrono::microseconds>();
-		sleep(1);
+
+		if (!more_expired) {
+			elliptics_unique_lock<std::mutex> guard(m_lock, m_node, DNET_LOCK_SITE("cache: life wait"));
+
+			uint64_t now = current_time_ms();
+			m_lifecheck_deadline = std::min<uint64_t>(m_timer_wheel.next_deadline(), now + life_check_max_sleep);
+
+			while (!m_need_exit && m_lifecheck_deadline > now) {
+				if (m_lifecheck_wait.wait_for(guard, std::chrono::milliseconds(m_lifecheck_deadline - now))
+						== std::cv_status::timeout)
+					break;
+				now = current_time_ms();
+			}
+
+			m_lifecheck_deadline = 0;
+		}
 	}
 }
 
@@ -2,12 +2,25 @@
 #define SLRU_CACHE_HPP
 
 #include "cache.hpp"
+#include "ghost_list.hpp"
+#include "snapshot.hpp"
 
 namespace ioremap { namespace cache {
 
+/*
+ * Object metadata collected for the snapshot, payload is shared with the cache,
+ * so it can be written without holding the cache lock
+ */
+struct snapshot_entry {
+	snapshot_record record;
+	raw_data_ptr data;
+};
+
+struct record_info;
+
 class slru_cache_t {
 public:
-	slru_cache_t(struct dnet_node *n, const std::vector<size_t> &cache_pages_max_sizes);
+	slru_cache_t(struct dnet_node *n, const std::vector<size_t> &cache_pages_max_sizes, writeback_limiter &writeback);
 
 	~slru_cache_t();
 
@@ -15,35 +28,180 @@ public:
 
 	int write(const unsigned char *id, dnet_net_state *st, dnet_cmd *cmd, dnet_io_attr *io, const char *data);
 
-	std::shared_ptr<raw_data_t> read(const unsigned char *id, dnet_cmd *cmd, dnet_io_attr *io);
+	/*
+	 * @err is set to -ENOTSUP if object should be read from the backend directly
+	 */
+	raw_data_ptr read(const unsigned char *id, dnet_cmd *cmd, dnet_io_attr *io, int *err);
+
+	/*
+	 * Reads range of the object by chunks of cache_chunk_size bytes, only missing chunks are read from the backend.
+	 * Requested range starts at @data_offset of the returned data.
+	 */
+	raw_data_ptr read_range(const unsigned char *id, dnet_io_attr *io, size_t *data_offset, int *err);
+
+	/*
+	 * Returns true if object has some of its chunks cached or being read
+	 */
+	bool chunked(const unsigned char *id);
+
+	/*
+	 * Returns true if requested range should be cached by chunks instead of the whole object
+	 */
+	bool read_by_chunks(const unsigned char *id, const dnet_io_attr *io);
+
+	/*
+	 * Returns true if object or some of its chunks are cached, object may be not on the disk yet
+	 */
+	bool contains(const unsigned char *id);
 
 	int remove(const unsigned char *id, dnet_io_attr *io);
 
 	int lookup(const unsigned char *id, dnet_net_state *st, dnet_cmd *cmd);
 
+	/*
+	 * Applies DNET_INDEXES_FLAGS_INTERNAL_INSERT or DNET_INDEXES_FLAGS_INTERNAL_REMOVE @action of object
+	 * @request.id with @data to the index table @id. Table is kept decoded in memory,
+	 * changed table is synced to the disk as any other dirty object.
+	 */
+	int update_index(const unsigned char *id, const dnet_indexes_request &request,
+		const ioremap::elliptics::data_pointer &data, uint32_t action);
+
+	/*
+	 * Returns decoded index table, it is never changed after it has been returned.
+	 * @err is set to -ENOENT if there is no such index.
+	 */
+	std::shared_ptr<const ioremap::elliptics::dnet_indexes> find_index(const unsigned char *id, int *err);
+
 	void clear();
 
+	/*
+	 * Sets new maximum sizes of pages, objects which do not fit anymore are evicted at once,
+	 * dirty ones are removed after they are written back as on usual eviction
+	 */
+	void resize(const std::vector<size_t> &cache_pages_max_sizes);
+
+	/*
+	 * In adaptive mode page sizes set by resize() are only an initial split,
+	 * capacity is moved between the last page and the others by hits of recently evicted objects
+	 */
+	void set_adaptive(bool adaptive);
+
 	cache_stats get_cache_stats() const;
 
+	/*
+	 * Appends all objects of the cache to @entries in the snapshot order
+	 */
+	void snapshot(std::vector<snapshot_entry> &entries);
+
+	/*
+	 * Puts object from the snapshot into the cache if it is still valid.
+	 * Objects already present in the cache are newer, so they are left intact.
+	 * Returns true if object was restored.
+	 */
+	bool restore(const snapshot_record &record, const char *data);
+
 private:
 
 	int write_(const unsigned char *id, dnet_net_state *st, dnet_cmd *cmd, dnet_io_attr *io, const char *data);
 
-	std::shared_ptr<raw_data_t> read_(const unsigned char *id, dnet_cmd *cmd, dnet_io_attr *io);
+	raw_data_ptr read_(const unsigned char *id, dnet_cmd *cmd, dnet_io_attr *io, int *err);
+
+	raw_data_ptr read_range_(const unsigned char *id, dnet_io_attr *io, size_t *data_offset, int *err);
 
 	int remove_(const unsigned char *id, dnet_io_attr *io);
 
 	int lookup_(const unsigned char *id, dnet_net_state *st, dnet_cmd *cmd);
 
+	/*
+	 * Backend read which is currently in progress for some key.
+	 * Concurrent misses on the same key wait for it instead of issuing their own read.
+	 */
+	struct populate_request {
+		populate_request() : done(false), invalidated(false), removed(false), err(0) {}
+
+		bool done;
+		/* Key was changed on the disk while backend read was in progress, so read data is stale */
+		bool invalidated;
+		/* Change was a removal, so the key does not exist anymore */
+		bool removed;
+		int err;
+	};
+
+	typedef std::unordered_map<dnet_raw_id, std::shared_ptr<populate_request>, raw_id_hash, raw_id_equal> populate_map_t;
+
+	enum {
+		/* Maximum number of due objects processed under the lock at once */
+		life_check_batch_size = 1000,
+		/* Life check thread wakes up at least this often even if nothing is due, milliseconds */
+		life_check_max_sleep = 1000,
+		/* Backend reads of the key overwritten meanwhile are repeated this many times before giving up */
+		populate_max_attempts = 3,
+		/* Minimum share of the cache in percents left to the last page and to the others in adaptive mode */
+		adaptive_min_share = 10
+	};
+
+	/*
+	 * Object which has some of its chunks cached.
+	 * Every change of the object increments generation, so chunks which were being read
+	 * from the backend at that moment are not put into the cache.
+	 */
+	struct chunked_object {
+		chunked_object() : chunks_number(0), pending_reads(0), max_chunk(0), generation(0),
+			total_size(0), user_flags(0) {
+			dnet_empty_time(&timestamp);
+		}
+
+		size_t chunks_number;
+		size_t pending_reads;
+		uint64_t max_chunk;
+		uint64_t generation;
+		uint64_t total_size;
+		uint64_t user_flags;
+		dnet_time timestamp;
+	};
+
+	typedef std::unordered_map<dnet_raw_id, chunked_object, raw_id_hash, raw_id_equal> chunked_objects_t;
+
+	/*
+	 * Decoded content of the cached index table object
+	 */
+	struct index_table {
+		/* Payload table was decoded from, table is outdated if object has another one */
+		raw_data_ptr source;
+		std::shared_ptr<ioremap::elliptics::dnet_indexes> indexes;
+	};
+
+	typedef std::unordered_map<dnet_raw_id, index_table, raw_id_hash, raw_id_equal> index_tables_t;
+
 	bool m_need_exit;
 	struct dnet_node *m_node;
+	writeback_limiter &m_writeback;
+	slab_allocator m_allocator;
 	std::mutex m_lock;
 	size_t m_cache_pages_number;
 	std::vector<size_t> m_cache_pages_max_sizes;
+	/* Page sizes set by configuration or resize(), max sizes differ from them only in adaptive mode */
+	std::vector<size_t> m_cache_pages_base_sizes;
 	std::vector<size_t> m_cache_pages_sizes;
 	std::unique_ptr<lru_list_t[]> m_cache_pages_lru;
 	std::thread m_lifecheck;
-	treap_t m_treap;
+	hash_table_t m_hash_table;
+	timer_wheel_t m_timer_wheel;
+	/* Time life check thread sleeps until, 0 if it is running, milliseconds */
+	uint64_t m_lifecheck_deadline;
+	std::condition_variable_any m_lifecheck_wait;
+	populate_map_t m_populating;
+	std::condition_variable_any m_populate_wait;
+	chunked_objects_t m_chunked_objects;
+	index_tables_t m_index_tables;
+	/* Access frequencies for TinyLFU admission, NULL if every missed object is admitted */
+	std::unique_ptr<frequency_sketch> m_sketch;
+	bool m_adaptive;
+	/* Size of the last page in adaptive mode */
+	size_t m_last_page_target;
+	/* Objects evicted from the last page: those which were never moved out of it and the others */
+	ghost_list m_recency_ghosts;
+	ghost_list m_frequency_ghosts;
 	std::size_t finds_number;
 	std::size_t total_find_time;
 	mutable atomic_cache_stats m_cache_stats;
@@ -72,20 +230,67 @@ private:
 
 	data_t* create_data(const unsigned char *id, const char *data, size_t size, bool remove_from_disk);
 
+	void destroy_data(data_t *obj);
+
+	void prepare_data(data_t *obj, size_t size, size_t keep, bool append);
+
+	void append_data(data_t *obj, const char *data, size_t size);
+
 	data_t* populate_from_disk(elliptics_unique_lock<std::mutex> &guard, const unsigned char *id, bool remove_from_disk, int *err);
 
+	void invalidate_populate(const unsigned char *id, bool removed);
+
+	bool admit(const unsigned char *id);
+
+	void invalidate_chunks(const unsigned char *id);
+
+	void release_chunked_object(const dnet_raw_id &key);
+
+	data_t* create_chunk(const unsigned char *id, uint64_t chunk, const raw_data_ptr &payload);
+
 	bool have_enough_space(const unsigned char *id, size_t page_number, size_t reserve);
 
+	/*
+	 * Bytes charged to the page: charges of its objects, the last page is charged also
+	 * for slab memory not given to any object, so the cache never holds more slabs than its size.
+	 * Shard smaller than slab_allocator::min_slab_limit() would be emptied by a single partly
+	 * used slab, it is charged for its objects only.
+	 */
+	size_t page_charge(size_t page_number) const;
+
 	void resize_page(const unsigned char *id, size_t page_number, size_t reserve);
 
+	/*
+	 * Recalculates max sizes of pages from base ones and the adaptive target, pages which became smaller are shrunk
+	 */
+	void apply_pages_sizes();
+
+	/*
+	 * Moves capacity towards the page object @id was evicted from, if it is remembered
+	 */
+	void adapt(const unsigned char *id);
+
+	void remember_evicted(data_t *obj);
+
+	/*
+	 * Returns decoded table of index object @id, object is read from the disk if it is not cached.
+	 * If there is no such index, empty one is created if @create is set, otherwise @err is set to -ENOENT.
+	 * Guard is always locked on exit.
+	 */
+	index_table *load_index_table(elliptics_unique_lock<std::mutex> &guard, const unsigned char *id, bool create, data_t **obj, int *err);
+
+	void update_eventtime(data_t *obj);
+
 	void erase_element(data_t *obj);
 
-	void sync_element(const dnet_id &raw, bool after_append, const std::vector<char> &data, uint64_t user_flags, const dnet_time &timestamp);
+	void sync_element(const dnet_id &raw, bool after_append, const raw_data_ptr &data, uint64_t user_flags, const dnet_time &timestamp, uint32_t ioflags);
 
 	void sync_element(data_t *obj);
 
 	void sync_after_append(elliptics_unique_lock<std::mutex> &guard, bool lock_guard, data_t *obj);
 
+	void write_back(std::vector<record_info> &records);
+
 	void life_check(void);
 };
 
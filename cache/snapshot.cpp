@@ -0,0 +1,192 @@
+#include "snapshot.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+namespace ioremap { namespace cache {
+
+static size_t padded_size(size_t size)
+{
+	return (size + snapshot_alignment - 1) / snapshot_alignment * snapshot_alignment;
+}
+
+static std::runtime_error snapshot_error(const std::string &message, const std::string &path, int err)
+{
+	return std::runtime_error(message + " '" + path + "': " + strerror(err));
+}
+
+snapshot_writer::snapshot_writer(const std::string &path, const snapshot_header &header) :
+	m_path(path),
+	m_temporary_path(path + ".tmp"),
+	m_fd(-1),
+	m_records_number(0)
+{
+	m_fd = open(m_temporary_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (m_fd < 0)
+		throw snapshot_error("could not create cache snapshot", m_temporary_path, errno);
+
+	m_buffer.reserve(1024 * 1024);
+
+	try {
+		append(&header, sizeof(header));
+	} catch (...) {
+		close(m_fd);
+		unlink(m_temporary_path.c_str());
+		throw;
+	}
+}
+
+snapshot_writer::~snapshot_writer()
+{
+	// Snapshot was not committed, old one is still valid
+	if (m_fd >= 0) {
+		close(m_fd);
+		unlink(m_temporary_path.c_str());
+	}
+}
+
+void snapshot_writer::write(const snapshot_record &record, const char *data)
+{
+	static const char padding[snapshot_alignment] = {0};
+
+	append(&record, sizeof(record));
+	append(data, record.size);
+	append(padding, padded_size(record.size) - record.size);
+
+	++m_records_number;
+}
+
+void snapshot_writer::commit()
+{
+	snapshot_footer footer;
+	footer.magic = snapshot_footer_magic;
+	footer.records_number = m_records_number;
+
+	append(&footer, sizeof(footer));
+	flush();
+
+	if (fsync(m_fd))
+		throw snapshot_error("could not sync cache snapshot", m_temporary_path, errno);
+
+	close(m_fd);
+	m_fd = -1;
+
+	if (rename(m_temporary_path.c_str(), m_path.c_str())) {
+		int err = errno;
+		unlink(m_temporary_path.c_str());
+		throw snapshot_error("could not replace cache snapshot", m_path, err);
+	}
+}
+
+void snapshot_writer::append(const void *data, size_t size)
+{
+	if (m_buffer.size() + size > m_buffer.capacity())
+		flush();
+
+	// Big payloads are written directly, there is no point to copy them
+	if (size >= m_buffer.capacity()) {
+		write_all(data, size);
+		return;
+	}
+
+	const char *begin = reinterpret_cast<const char *>(data);
+	m_buffer.insert(m_buffer.end(), begin, begin + size);
+}
+
+void snapshot_writer::flush()
+{
+	write_all(m_buffer.data(), m_buffer.size());
+	m_buffer.clear();
+}
+
+void snapshot_writer::write_all(const void *data, size_t size)
+{
+	const char *position = reinterpret_cast<const char *>(data);
+
+	while (size) {
+		ssize_t written = ::write(m_fd, position, size);
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+			throw snapshot_error("could not write cache snapshot", m_temporary_path, errno);
+		}
+
+		position += written;
+		size -= written;
+	}
+}
+
+snapshot_reader::snapshot_reader(const std::string &path) :
+	m_begin(NULL), m_end(NULL), m_position(NULL), m_size(0), m_records_number(0), m_header(NULL)
+{
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		throw snapshot_error("could not open cache snapshot", path, errno);
+
+	struct stat st;
+	if (fstat(fd, &st)) {
+		int err = errno;
+		close(fd);
+		throw snapshot_error("could not stat cache snapshot", path, err);
+	}
+
+	m_size = st.st_size;
+	if (m_size < sizeof(snapshot_header) + sizeof(snapshot_footer)) {
+		close(fd);
+		throw std::runtime_error("cache snapshot '" + path + "' is truncated");
+	}
+
+	void *map = mmap(NULL, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	int err = errno;
+	close(fd);
+
+	if (map == MAP_FAILED)
+		throw snapshot_error("could not map cache snapshot", path, err);
+
+	madvise(map, m_size, MADV_SEQUENTIAL);
+
+	m_begin = reinterpret_cast<const char *>(map);
+	m_header = reinterpret_cast<const snapshot_header *>(m_begin);
+
+	const snapshot_footer *footer = reinterpret_cast<const snapshot_footer *>(m_begin + m_size - sizeof(snapshot_footer));
+
+	if (m_header->magic != snapshot_magic || m_header->version != snapshot_version
+			|| footer->magic != snapshot_footer_magic) {
+		munmap(map, m_size);
+		throw std::runtime_error("cache snapshot '" + path + "' is broken or was not completely written");
+	}
+
+	m_records_number = footer->records_number;
+	m_position = m_begin + sizeof(snapshot_header);
+	m_end = m_begin + m_size - sizeof(snapshot_footer);
+}
+
+snapshot_reader::~snapshot_reader()
+{
+	munmap(const_cast<char *>(m_begin), m_size);
+}
+
+bool snapshot_reader::next(const snapshot_record *&record, const char *&data)
+{
+	if (static_cast<size_t>(m_end - m_position) < sizeof(snapshot_record))
+		return false;
+
+	record = reinterpret_cast<const snapshot_record *>(m_position);
+
+	const size_t left = m_end - m_position - sizeof(snapshot_record);
+	if (record->size > left || padded_size(record->size) > left)
+		return false;
+
+	data = m_position + sizeof(snapshot_record);
+	m_position = data + padded_size(record->size);
+
+	return true;
+}
+
+}} /* namespace ioremap::cache */
@@ -0,0 +1,132 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <string>
+#include <vector>
+
+#include "elliptics/packet.h"
+
+namespace ioremap { namespace cache {
+
+/*
+ * Cache snapshot file layout:
+ *
+ *	snapshot_header
+ *	snapshot_record, data padded to 8 bytes
+ *	...
+ *	snapshot_footer
+ *
+ * Records are streamed from the hottest page to the coldest one, every page is
+ * written from its least recently used object, so loading records in file order
+ * and appending them to their pages restores the original placement.
+ *
+ * Snapshot is written into temporary file which is renamed over the old one
+ * only after it has been completely written and synced, so crash during
+ * snapshot never leaves broken file behind. File without footer is ignored.
+ */
+static const uint64_t snapshot_magic = 0x74736e7363656c65ULL;
+static const uint64_t snapshot_footer_magic = 0x646e6573636e7365ULL;
+static const uint32_t snapshot_version = 1;
+static const size_t snapshot_alignment = 8;
+
+enum snapshot_record_flags {
+	/* Object was not synced to the disk when snapshot was taken */
+	snapshot_record_dirty = 1 << 0,
+	snapshot_record_only_append = 1 << 1,
+	snapshot_record_remove_from_disk = 1 << 2
+};
+
+struct snapshot_header {
+	uint64_t		magic;
+	uint32_t		version;
+	uint32_t		pages_number;
+	/* Time the snapshot was written at */
+	struct dnet_time	timestamp;
+};
+
+struct snapshot_record {
+	uint8_t			id[DNET_ID_SIZE];
+	struct dnet_time	timestamp;
+	uint64_t		user_flags;
+	/* Absolute expiration time, 0 if object never expires */
+	uint64_t		lifetime;
+	uint64_t		size;
+	uint32_t		page;
+	uint32_t		flags;
+};
+
+struct snapshot_footer {
+	uint64_t		magic;
+	uint64_t		records_number;
+};
+
+class snapshot_writer {
+public:
+	/*
+	 * Throws std::runtime_error if temporary file can not be created
+	 */
+	snapshot_writer(const std::string &path, const snapshot_header &header);
+	~snapshot_writer();
+
+	snapshot_writer(const snapshot_writer &) = delete;
+	snapshot_writer &operator =(const snapshot_writer &) = delete;
+
+	void write(const snapshot_record &record, const char *data);
+
+	/*
+	 * Writes footer, syncs the file and replaces old snapshot by the new one
+	 */
+	void commit();
+
+	size_t records_number() const {
+		return m_records_number;
+	}
+
+private:
+	void append(const void *data, size_t size);
+	void flush();
+	void write_all(const void *data, size_t size);
+
+	std::string m_path;
+	std::string m_temporary_path;
+	int m_fd;
+	size_t m_records_number;
+	std::vector<char> m_buffer;
+};
+
+class snapshot_reader {
+public:
+	/*
+	 * Throws std::runtime_error if file can not be mapped or it is not complete snapshot
+	 */
+	snapshot_reader(const std::string &path);
+	~snapshot_reader();
+
+	snapshot_reader(const snapshot_reader &) = delete;
+	snapshot_reader &operator =(const snapshot_reader &) = delete;
+
+	const snapshot_header &header() const {
+		return *m_header;
+	}
+
+	size_t records_number() const {
+		return m_records_number;
+	}
+
+	/*
+	 * Returns false when there are no more records
+	 */
+	bool next(const snapshot_record *&record, const char *&data);
+
+private:
+	const char *m_begin;
+	const char *m_end;
+	const char *m_position;
+	size_t m_size;
+	size_t m_records_number;
+	const snapshot_header *m_header;
+};
+
+}}
+
+#endif // SNAPSHOT_HPP
@@ -0,0 +1,203 @@
+#ifndef TIMER_WHEEL_HPP
+#define TIMER_WHEEL_HPP
+
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <boost/intrusive/list.hpp>
+
+#include <stdint.h>
+
+namespace ioremap { namespace cache {
+
+/*
+ * Hierarchical timer wheel used for object expiration and sync scheduling.
+ *
+ * Level 0 has a slot per tick, every next level has a slot per full rotation of the previous one.
+ * Insertion and removal are O(1), nodes of a higher level slot are moved to lower levels
+ * when wheel reaches this slot. Nodes which are due further than the whole wheel covers
+ * are put into the farthest slot and are placed once again when it is reached.
+ *
+ * Node must be derived from @hook_type, which must be auto unlink list hook,
+ * and provide timer_deadline()/set_timer_deadline() to store its deadline in milliseconds.
+ */
+template<typename node_type, typename hook_type>
+class timer_wheel {
+public:
+	typedef node_type* p_node_type;
+
+	enum {
+		tick = 10, /* milliseconds */
+		slot_bits = 6,
+		slots_number = 1 << slot_bits,
+		levels_number = 5
+	};
+
+	timer_wheel(uint64_t now) :
+		m_current(now / tick), m_size(0), m_slots(new slot_t[levels_number * slots_number]) {
+	}
+
+	timer_wheel(const timer_wheel &) = delete;
+	timer_wheel &operator =(const timer_wheel &) = delete;
+
+	void insert(p_node_type node, uint64_t deadline) {
+		node->set_timer_deadline(deadline);
+		place(node);
+		++m_size;
+	}
+
+	void erase(p_node_type node) {
+		node->hook_type::unlink();
+		--m_size;
+	}
+
+	static bool is_linked(p_node_type node) {
+		return node->hook_type::is_linked();
+	}
+
+	/*
+	 * Moves wheel up to @now and takes at most @limit nodes which are due from it.
+	 * Returns false if there are no more due nodes.
+	 */
+	bool advance(uint64_t now, std::vector<p_node_type> &expired, size_t limit) {
+		const uint64_t target = now / tick;
+
+		while (m_current <= target) {
+			slot_t &slot = get_slot(0, m_current & slot_mask);
+
+			while (!slot.empty()) {
+				if (expired.size() >= limit)
+					return true;
+
+				p_node_type node = &slot.front();
+				slot.pop_front();
+
+				if (deadline_ticks(node) <= target) {
+					expired.push_back(node);
+					--m_size;
+				} else {
+					place(node);
+				}
+			}
+
+			if (m_current == target)
+				break;
+
+			++m_current;
+			if (!(m_current & slot_mask))
+				cascade(1);
+		}
+
+		return false;
+	}
+
+	/*
+	 * Returns time in milliseconds by which advance() has to be called next time:
+	 * the nearest non-empty slot of the lowest level or the nearest cascade of a non-empty higher level slot.
+	 * It is never later than the earliest deadline rounded up to the tick, but may be earlier.
+	 * Returns maximum uint64_t value if wheel is empty.
+	 */
+	uint64_t next_deadline() const {
+		uint64_t result = std::numeric_limits<uint64_t>::max();
+
+		if (!m_size)
+			return result;
+
+		for (size_t i = 0; i < slots_number; ++i) {
+			if (!get_slot(0, (m_current + i) & slot_mask).empty()) {
+				result = (m_current + i) * tick;
+				break;
+			}
+		}
+
+		for (size_t level = 1; level < levels_number; ++level) {
+			const uint64_t current = m_current >> (slot_bits * level);
+
+			for (size_t i = 1; i <= slots_number; ++i) {
+				if (!get_slot(level, (current + i) & slot_mask).empty()) {
+					result = std::min(result, ((current + i) << (slot_bits * level)) * tick);
+					break;
+				}
+			}
+		}
+
+		return result;
+	}
+
+	size_t size() const {
+		return m_size;
+	}
+
+	bool empty() const {
+		return !m_size;
+	}
+
+private:
+	enum {
+		slot_mask = slots_number - 1
+	};
+
+	typedef boost::intrusive::list<node_type, boost::intrusive::base_hook<hook_type>,
+		boost::intrusive::constant_time_size<false> > slot_t;
+
+	/*
+	 * Deadlines are rounded up, so nodes are never taken before their deadline
+	 */
+	static uint64_t deadline_ticks(p_node_type node) {
+		return (node->timer_deadline() + tick - 1) / tick;
+	}
+
+	slot_t &get_slot(size_t level, size_t index) {
+		return m_slots[level * slots_number + index];
+	}
+
+	const slot_t &get_slot(size_t level, size_t index) const {
+		return m_slots[level * slots_number + index];
+	}
+
+	void place(p_node_type node) {
+		uint64_t ticks = deadline_ticks(node);
+		if (ticks < m_current)
+			ticks = m_current;
+
+		uint64_t delta = ticks - m_current;
+		size_t level = 0;
+
+		while (level < levels_number - 1 && delta >= (uint64_t(1) << (slot_bits * (level + 1))))
+			++level;
+
+		// Too far deadlines wait in the farthest slot
+		if (delta >= (uint64_t(1) << (slot_bits * levels_number))) {
+			ticks = m_current + (uint64_t(1) << (slot_bits * levels_number)) - 1;
+		}
+
+		get_slot(level, (ticks >> (slot_bits * level)) & slot_mask).push_back(*node);
+	}
+
+	void cascade(size_t level) {
+		if (level >= levels_number)
+			return;
+
+		const size_t index = (m_current >> (slot_bits * level)) & slot_mask;
+		if (!index)
+			cascade(level + 1);
+
+		slot_t nodes;
+		nodes.splice(nodes.end(), get_slot(level, index));
+
+		while (!nodes.empty()) {
+			p_node_type node = &nodes.front();
+			nodes.pop_front();
+			place(node);
+		}
+	}
+
+	uint64_t m_current;
+	size_t m_size;
+	std::unique_ptr<slot_t[]> m_slots;
+};
+
+}}
+
+#endif // TIMER_WHEEL_HPP
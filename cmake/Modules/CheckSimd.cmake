@@ -0,0 +1,36 @@
+# Check whether AVX2 and AVX-512 code can be built, it is used by multi-buffer SHA-512
+# Sets variables:
+#  HAVE_AVX2_SUPPORT - whether sources built with -mavx2 are supported
+#  HAVE_AVX512_SUPPORT - whether sources built with -mavx512f are supported
+
+include(CheckCSourceCompiles)
+
+set(CMAKE_REQUIRED_FLAGS -mavx2)
+check_c_source_compiles("#include <immintrin.h>
+int main()
+{
+    __m256i x = _mm256_set1_epi64x(1);
+    x = _mm256_add_epi64(x, _mm256_srli_epi64(x, 1));
+    return _mm256_movemask_epi8(x) + __builtin_cpu_supports(\"avx2\");
+}" HAVE_AVX2_SUPPORT)
+unset(CMAKE_REQUIRED_FLAGS)
+
+set(CMAKE_REQUIRED_FLAGS -mavx512f)
+check_c_source_compiles("#include <immintrin.h>
+int main()
+{
+    __m512i x = _mm512_set1_epi64(1);
+    x = _mm512_ternarylogic_epi64(_mm512_ror_epi64(x, 1), x, x, 0x96);
+    return _mm512_reduce_add_epi64(x) + __builtin_cpu_supports(\"avx512f\");
+}" HAVE_AVX512_SUPPORT)
+unset(CMAKE_REQUIRED_FLAGS)
+
+if(HAVE_AVX2_SUPPORT)
+    add_definitions(-DHAVE_AVX2_SUPPORT=1)
+endif()
+if(HAVE_AVX512_SUPPORT)
+    add_definitions(-DHAVE_AVX512_SUPPORT=1)
+endif()
+
+message(STATUS "AVX2 support: ${HAVE_AVX2_SUPPORT}")
+message(STATUS "AVX-512 support: ${HAVE_AVX512_SUPPORT}")
@@ -116,6 +116,24 @@ static int dnet_simple_set(struct dnet_config_backend *b __unused, char *key, ch
 		dnet_cur_cfg_data->cfg_state.indexes_shard_count = value;
 	else if (!strcmp(key, "monitor_port"))
 		dnet_cur_cfg_data->cfg_state.monitor_port = value;
+	else if (!strcmp(key, "cache_hugepages"))
+		dnet_cur_cfg_data->cfg_state.cache_hugepages = value;
+	else if (!strcmp(key, "cache_snapshot_interval"))
+		dnet_cur_cfg_data->cfg_state.cache_snapshot_interval = value;
+	else if (!strcmp(key, "cache_admission"))
+		dnet_cur_cfg_data->cfg_state.cache_admission = value;
+	else if (!strcmp(key, "cache_chunk_size"))
+		dnet_cur_cfg_data->cfg_state.cache_chunk_size = value;
+	else if (!strcmp(key, "cache_sync_concurrency"))
+		dnet_cur_cfg_data->cfg_state.cache_sync_concurrency = value;
+	else if (!strcmp(key, "cache_negative_size"))
+		dnet_cur_cfg_data->cfg_state.cache_negative_size = value;
+	else if (!strcmp(key, "cache_negative_ttl"))
+		dnet_cur_cfg_data->cfg_state.cache_negative_ttl = value;
+	else if (!strcmp(key, "cache_adaptive"))
+		dnet_cur_cfg_data->cfg_state.cache_adaptive = value;
+	else if (!strcmp(key, "cache_mrc_sampling"))
+		dnet_cur_cfg_data->cfg_state.cache_mrc_sampling = value;
 	else
 		return -1;
 
@@ -336,6 +354,12 @@ static int dnet_set_history_env(struct dnet_config_backend *b __unused, char *ke
 	return 0;
 }
 
+static int dnet_set_cache_snapshot(struct dnet_config_backend *b __unused, char *key __unused, char *value)
+{
+	snprintf(dnet_cur_cfg_data->cfg_state.cache_snapshot, sizeof(dnet_cur_cfg_data->cfg_state.cache_snapshot), "%s", value);
+	return 0;
+}
+
 static int dnet_set_cache_size(struct dnet_config_backend *b __unused, char *key __unused, char *value)
 {
 	dnet_cur_cfg_data->cfg_state.cache_size = strtoull(value, NULL, 0);
@@ -416,6 +440,16 @@ static struct dnet_config_entry dnet_cfg_entries[] = {
 	{"cache_size", dnet_set_cache_size},
 	{"caches_number", dnet_set_caches_number},
 	{"cache_pages_proportions", dnet_set_cache_pages_proportions},
+	{"cache_hugepages", dnet_simple_set},
+	{"cache_snapshot", dnet_set_cache_snapshot},
+	{"cache_snapshot_interval", dnet_simple_set},
+	{"cache_admission", dnet_simple_set},
+	{"cache_chunk_size", dnet_simple_set},
+	{"cache_sync_concurrency", dnet_simple_set},
+	{"cache_negative_size", dnet_simple_set},
+	{"cache_negative_ttl", dnet_simple_set},
+	{"cache_adaptive", dnet_simple_set},
+	{"cache_mrc_sampling", dnet_simple_set},
 	{"indexes_shard_count", dnet_simple_set},
 	{"monitor_port", dnet_simple_set},
 };
@@ -528,6 +562,14 @@ struct dnet_node *dnet_parse_config(const char *file, int mon)
 	if (err)
 		goto err_out_module_exit;
 
+	err = dnet_memory_backend_init();
+	if (err)
+		goto err_out_eblob_exit;
+
+	err = dnet_logstore_backend_init();
+	if (err)
+		goto err_out_memory_exit;
+
 	while (1) {
 		ptr = fgets(buf, buf_size, f);
 		if (!ptr) {
@@ -660,7 +702,10 @@ err_out_free:
 	if (dnet_cur_cfg_data)
 		free(dnet_cur_cfg_data->cfg_remotes);
 
-//err_out_eblob_exit:
+	dnet_logstore_backend_exit();
+err_out_memory_exit:
+	dnet_memory_backend_exit();
+err_out_eblob_exit:
 	dnet_eblob_backend_exit();
 err_out_module_exit:
 #ifdef HAVE_MODULE_BACKEND_SUPPORT
@@ -57,39 +57,60 @@
 #endif
 
 
-struct eblob_read_params {
-	int			fd;
-	int			pad;
-	uint64_t		offset;
-};
+/*
+ * Access pattern of every blob file is tracked separately: reads of the file are sampled
+ * into its ring without locks, every BLOB_RA_SAMPLES reads the thread which filled the ring
+ * classifies them and switches readahead policy of the file if needed.
+ *
+ * Statistics live in a table indexed by descriptor, descriptor reused by another blob
+ * or colliding with one in the same slot starts statistics over.
+ */
+#define BLOB_RA_FILES			1024
+#define BLOB_RA_SAMPLES			64
 
-static int eblob_read_params_compare(const void *p1, const void *p2)
-{
-	const struct eblob_read_params *r1 = p1;
-	const struct eblob_read_params *r2 = p2;
-	int ret;
+/* Read starting at most this far past the end of the previous one continues sequential stream */
+#define BLOB_RA_SEQUENTIAL_GAP		(1024 * 1024)
 
-	ret = r1->fd - r2->fd;
-	if (ret != 0)
-		return ret;
+/* Sequentially read files are advised to be read this far ahead of the reader */
+#define BLOB_RA_WINDOW			(4 * 1024 * 1024)
 
-	if (r1->offset > r2->offset)
-		return 1;
-	if (r1->offset < r2->offset)
-		return -1;
+enum blob_ra_policy {
+	BLOB_RA_NORMAL = 0,
+	BLOB_RA_SEQUENTIAL,		/* POSIX_FADV_SEQUENTIAL and WILLNEED ahead of the reader */
+	BLOB_RA_RANDOM,			/* POSIX_FADV_RANDOM and DONTNEED of the sent data */
+};
 
-	return 0;
-}
+static const char *blob_ra_policy_names[] = {"normal", "sequential", "random"};
+
+struct blob_ra_file {
+	int			fd;		/* -1 if slot is not used */
+	int			policy;
+	uint64_t		reads;
+	uint64_t		switches;
+	uint64_t		readahead_end;	/* end of the range already advised with WILLNEED */
+	uint64_t		working_set;	/* span of the file covered by the last samples */
+	int			sequential;	/* percent of the last samples following the previous ones */
+	uint64_t		samples[BLOB_RA_SAMPLES];
+	uint64_t		sizes[BLOB_RA_SAMPLES];
+};
+
+/*
+ * Hash tree update needs timestamp of the key before the change, so reading it, changing the key
+ * and updating the tree are serialized for keys sharing one of these locks
+ */
+#define BLOB_HASH_TREE_LOCKS		256
 
 struct eblob_backend_config {
 	struct eblob_config		data;
 	struct eblob_backend		*eblob;
 
-	pthread_mutex_t			last_read_lock;
-	int64_t				vm_total;		/* squared in bytes */
-	int				random_access;
-	int				last_read_index;
-	struct eblob_read_params	last_reads[100];
+	/* Hash tree of stored keys and their timestamps, negative depth disables it */
+	int				hash_tree_depth;
+	struct dnet_hash_tree		*hash_tree;
+	pthread_mutex_t			hash_tree_locks[BLOB_HASH_TREE_LOCKS];
+
+	uint64_t			ra_cache_size;		/* page cache reads may count on, in bytes */
+	struct blob_ra_file		*ra_files;
 };
 
 /* Pre-callback that formats arguments and calls ictl->callback */
@@ -146,7 +167,106 @@ static int blob_iterate(struct eblob_backend_config *c, struct dnet_iterator_ctl
 	return eblob_iterate(b, &eictl);
 }
 
-static int blob_write(struct eblob_backend_config *c, void *state,
+static pthread_mutex_t *blob_hash_tree_lock(struct eblob_backend_config *c, const unsigned char *id)
+{
+	return &c->hash_tree_locks[id[0] % BLOB_HASH_TREE_LOCKS];
+}
+
+/*
+ * Reads timestamp of the stored key from its extended header, records without one have empty timestamp
+ */
+static int blob_hash_tree_timestamp(struct eblob_backend_config *c, const unsigned char *id, struct dnet_time *ts)
+{
+	struct eblob_write_control wc;
+	struct dnet_ext_list_hdr ehdr;
+	struct dnet_ext_list elist;
+	struct eblob_key key;
+	int err;
+
+	memcpy(key.id, id, EBLOB_ID_SIZE);
+
+	err = eblob_read_return(c->eblob, &key, EBLOB_READ_NOCSUM, &wc);
+	if (err)
+		return err;
+
+	dnet_empty_time(ts);
+
+	if (wc.flags & BLOB_DISK_CTL_EXTHDR) {
+		err = dnet_ext_hdr_read(&ehdr, wc.data_fd, wc.data_offset);
+		if (err)
+			return err;
+
+		dnet_ext_list_init(&elist);
+		dnet_ext_hdr_to_list(&ehdr, &elist);
+		*ts = elist.timestamp;
+		dnet_ext_list_destroy(&elist);
+	}
+
+	return 0;
+}
+
+/*
+ * Replaces hash of the key with @old_ts (NULL if the key did not exist) in the tree by the hash
+ * of its current state. State is read back from the blob, so the tree follows what is really stored
+ * whichever way the change failed or succeeded.
+ */
+static void blob_hash_tree_update(struct eblob_backend_config *c, const unsigned char *id,
+		const struct dnet_time *old_ts)
+{
+	struct dnet_time ts;
+	int err;
+
+	err = blob_hash_tree_timestamp(c, id, &ts);
+	dnet_hash_tree_update(c->hash_tree, id, old_ts, err ? NULL : &ts);
+}
+
+static int blob_hash_tree_build_callback(struct eblob_disk_control *dc,
+		struct eblob_ram_control *rctl __unused,
+		void *data, void *priv, void *thread_priv __unused)
+{
+	struct eblob_backend_config *c = priv;
+	struct dnet_ext_list elist;
+	uint64_t size = dc->data_size;
+	int err;
+
+	if (dc->flags & BLOB_DISK_CTL_REMOVE)
+		return 0;
+
+	dnet_ext_list_init(&elist);
+
+	if (dc->flags & BLOB_DISK_CTL_EXTHDR) {
+		err = dnet_ext_list_extract((void *)&data, &size, &elist, DNET_EXT_DONT_FREE_ON_DESTROY);
+		if (err)
+			goto err_out_destroy;
+	}
+
+	dnet_hash_tree_update(c->hash_tree, dc->key.id, NULL, &elist.timestamp);
+	err = 0;
+
+err_out_destroy:
+	dnet_ext_list_destroy(&elist);
+	return err;
+}
+
+/*
+ * Hashes every stored key into the tree, it is called before the backend serves any request
+ */
+static int blob_hash_tree_build(struct eblob_backend_config *c)
+{
+	struct eblob_iterate_control eictl = {
+		.priv = c,
+		.b = c->eblob,
+		.log = c->data.log,
+		.flags = EBLOB_ITERATE_FLAGS_ALL | EBLOB_ITERATE_FLAGS_READONLY,
+		.iterator_cb = {
+			.iterator = blob_hash_tree_build_callback,
+		},
+	};
+
+	return eblob_iterate(c->eblob, &eictl);
+}
+
+static int blob_write_data(struct eblob_backend_config *c, void *state,
 		struct dnet_cmd *cmd, void *data)
 {
 	struct dnet_ext_list elist;
@@ -272,26 +392,71 @@ err_out_exit:
 	return err;
 }
 
+static int blob_write(struct eblob_backend_config *c, void *state, struct dnet_cmd *cmd, void *data)
+{
+	struct dnet_io_attr *io = data;
+	unsigned char id[DNET_ID_SIZE];
+	struct dnet_time old_ts;
+	pthread_mutex_t *lock;
+	int err, exists;
+
+	if (!c->hash_tree)
+		return blob_write_data(c, state, cmd, data);
 
-static int blob_read(struct eblob_backend_config *c, void *state, struct dnet_cmd *cmd, void *data, int last)
+	memcpy(id, io->id, DNET_ID_SIZE);
+	lock = blob_hash_tree_lock(c, id);
+
+	pthread_mutex_lock(lock);
+	exists = !blob_hash_tree_timestamp(c, id, &old_ts);
+	err = blob_write_data(c, state, cmd, data);
+	blob_hash_tree_update(c, id, exists ? &old_ts : NULL);
+	pthread_mutex_unlock(lock);
+
+	return err;
+}
+
+static int blob_remove(struct eblob_backend_config *c, const unsigned char *id)
+{
+	struct eblob_key key;
+	struct dnet_time old_ts;
+	pthread_mutex_t *lock;
+	int err, exists;
+
+	memcpy(key.id, id, EBLOB_ID_SIZE);
+
+	if (!c->hash_tree)
+		return eblob_remove(c->eblob, &key);
+
+	lock = blob_hash_tree_lock(c, id);
+
+	pthread_mutex_lock(lock);
+	exists = !blob_hash_tree_timestamp(c, id, &old_ts);
+	err = eblob_remove(c->eblob, &key);
+	blob_hash_tree_update(c, id, exists ? &old_ts : NULL);
+	pthread_mutex_unlock(lock);
+
+	return err;
+}
+
+
+/*
+ * Finds the object and reads its extended header, fills @io with object's attributes
+ * and the size of the data to be read. On success @fdp and @offsetp point to the data.
+ */
+static int blob_read_lookup(struct eblob_backend_config *c, struct dnet_io_attr *io,
+		enum eblob_read_flavour csum, int *fdp, uint64_t *offsetp)
 {
 	struct dnet_ext_list elist;
-	struct dnet_io_attr *io = data;
 	struct eblob_backend *b = c->eblob;
 	struct eblob_key key;
 	struct eblob_write_control wc;
 	uint64_t offset = 0, size = 0;
-	enum eblob_read_flavour csum = EBLOB_READ_CSUM;
-	int err, fd = -1, on_close = 0;
+	int err, fd = -1;
 
 	dnet_ext_list_init(&elist);
-	dnet_convert_io_attr(io);
 
 	memcpy(key.id, io->id, EBLOB_ID_SIZE);
 
-	if (io->flags & DNET_IO_FLAGS_NOCSUM)
-		csum = EBLOB_READ_NOCSUM;
-
 	err = eblob_read_return(b, &key, csum, &wc);
 	if (err == 0) {
 		/* Existing entry */
@@ -335,79 +500,350 @@ static int blob_read(struct eblob_backend_config *c, void *state, struct dnet_cm
 	else
 		io->size = size;
 
-	if (size && last)
-		cmd->flags &= ~DNET_FLAGS_NEED_ACK;
+	*fdp = fd;
+	*offsetp = offset;
 
-	if (fd >= 0) {
-		struct eblob_read_params *p, *prev;
-		int i;
+err_out_exit:
+	dnet_ext_list_destroy(&elist);
+	return err;
+}
 
-		pthread_mutex_lock(&c->last_read_lock);
-		p = &c->last_reads[c->last_read_index];
+/*
+ * Classifies the last samples of the file and switches its policy.
+ * Samples may be overwritten by concurrent readers meanwhile, which only adds noise.
+ *
+ * Ring is full when this is called, so its samples are in arrival order. Read is sequential
+ * if it starts within the gap past the end of the previous one: sorting would make random
+ * reads of a small blob look like a stream.
+ */
+static void blob_ra_update(struct eblob_backend_config *c, struct blob_ra_file *f, int fd)
+{
+	uint64_t samples[BLOB_RA_SAMPLES], sizes[BLOB_RA_SAMPLES];
+	uint64_t start = ~0ULL, end, max_end = 0;
+	int i, close = 0, policy, advice;
 
-		if (++c->last_read_index >= (int)ARRAY_SIZE(c->last_reads)) {
-			int64_t tmp;
-			int64_t mult = 1;
-			int64_t mean = 0;
-			int old_ra;
+	memcpy(samples, f->samples, sizeof(samples));
+	memcpy(sizes, f->sizes, sizeof(sizes));
 
-			qsort(c->last_reads, ARRAY_SIZE(c->last_reads), sizeof(struct eblob_read_params), eblob_read_params_compare);
+	for (i = 0; i < BLOB_RA_SAMPLES; ++i) {
+		end = samples[i] + sizes[i];
 
-			prev = &c->last_reads[0];
-			tmp = prev->offset;
+		if (samples[i] < start)
+			start = samples[i];
+		if (end > max_end)
+			max_end = end;
 
-			for (i = 1; i < (int)ARRAY_SIZE(c->last_reads); ++i) {
-				p = &c->last_reads[i];
+		if (i + 1 < BLOB_RA_SAMPLES && samples[i + 1] >= end &&
+				samples[i + 1] - end <= BLOB_RA_SEQUENTIAL_GAP)
+			close++;
+	}
 
-				if (p->fd != prev->fd)
-					mult++;
+	f->working_set = max_end - start;
+	f->sequential = close * 100 / (BLOB_RA_SAMPLES - 1);
+
+	/*
+	 * Reads mostly following each other are a stream worth reading ahead.
+	 * Reads mostly jumping around a range which does not fit into the page cache
+	 * will not hit it anyway: readahead only wastes disk bandwidth and sent data
+	 * evicts pages other files could use. Anything in between, or random reads of
+	 * a range small enough to stay cached, keeps the default policy.
+	 */
+	if (f->sequential >= 75)
+		policy = BLOB_RA_SEQUENTIAL;
+	else if (f->sequential <= 25 && f->working_set > c->ra_cache_size)
+		policy = BLOB_RA_RANDOM;
+	else
+		policy = BLOB_RA_NORMAL;
 
-				tmp += p->offset * mult;
-				prev = p;
-			}
+	if (policy == f->policy)
+		return;
 
-			/* found mean offset */
-			mean = tmp / ARRAY_SIZE(c->last_reads);
+	switch (policy) {
+		case BLOB_RA_SEQUENTIAL:
+			advice = POSIX_FADV_SEQUENTIAL;
+			break;
+		case BLOB_RA_RANDOM:
+			advice = POSIX_FADV_RANDOM;
+			break;
+		default:
+			advice = POSIX_FADV_NORMAL;
+			break;
+	}
 
-			/* calculating mean squared error */
-			tmp = 0;
-			for (i = 0; i < (int)ARRAY_SIZE(c->last_reads); ++i) {
-				p = &c->last_reads[i];
+	posix_fadvise(fd, 0, 0, advice);
 
-				tmp += ((int64_t)p->offset - mean) * ((int64_t)p->offset - mean);
-			}
-			tmp /= ARRAY_SIZE(c->last_reads);
-
-			/*
-			 * tmp and vm_total are squared, so if this check is true,
-			 * mean offset difference (error) is more than 25% of RAM
-			 */
-			old_ra = c->random_access;
-			if (tmp > c->vm_total / 16)
-				c->random_access = 1;
-			else
-				c->random_access = 0;
-
-			if (old_ra != c->random_access) {
-				dnet_backend_log(DNET_LOG_ERROR, "EBLOB: switch RA %d -> %d, offset MSE: %llu, squared VM total: %llu\n",
-						old_ra, c->random_access, (unsigned long long)tmp, (unsigned long long)c->vm_total);
+	dnet_backend_log(DNET_LOG_INFO, "EBLOB: fd: %d: readahead policy %s -> %s, working set: %llu, "
+			"sequential: %d%%, reads: %llu\n",
+			fd, blob_ra_policy_names[f->policy], blob_ra_policy_names[policy],
+			(unsigned long long)f->working_set, f->sequential, (unsigned long long)f->reads);
+
+	f->policy = policy;
+	f->readahead_end = 0;
+	f->switches++;
+}
+
+/*
+ * Accounts read of @size bytes at @offset in the access pattern statistics of the file.
+ * Returns flags which drop sent data from the page cache if access to the file is random.
+ */
+static int blob_read_account(struct eblob_backend_config *c, int fd, uint64_t offset, uint64_t size)
+{
+	struct blob_ra_file *f;
+	uint64_t n, end, start;
+	int slot_fd, policy;
+
+	if (fd < 0)
+		return 0;
+
+	f = &c->ra_files[fd % BLOB_RA_FILES];
+
+	slot_fd = f->fd;
+	if (slot_fd != fd) {
+		if (!__sync_bool_compare_and_swap(&f->fd, slot_fd, fd))
+			return 0;
+
+		f->policy = BLOB_RA_NORMAL;
+		f->reads = 0;
+		f->readahead_end = 0;
+	}
+
+	n = __sync_fetch_and_add(&f->reads, 1);
+	f->samples[n % BLOB_RA_SAMPLES] = offset;
+	f->sizes[n % BLOB_RA_SAMPLES] = size;
+
+	if (n % BLOB_RA_SAMPLES == BLOB_RA_SAMPLES - 1)
+		blob_ra_update(c, f, fd);
+
+	policy = f->policy;
+	if (policy == BLOB_RA_RANDOM)
+		return DNET_IO_REQ_FLAGS_CACHE_FORGET;
+
+	if (policy == BLOB_RA_SEQUENTIAL) {
+		/* Window is extended when reader gets to its second half, reader far behind restarts it */
+		end = offset + size;
+		if (end + BLOB_RA_WINDOW / 2 > f->readahead_end || end + BLOB_RA_WINDOW < f->readahead_end) {
+			start = f->readahead_end;
+			if (start < offset || start > end + BLOB_RA_WINDOW)
+				start = offset;
+
+			f->readahead_end = end + BLOB_RA_WINDOW;
+			posix_fadvise(fd, start, end + BLOB_RA_WINDOW - start, POSIX_FADV_WILLNEED);
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Reports readahead state of every tracked blob file for the monitor
+ */
+static char *eblob_backend_stat_json(void *priv)
+{
+	struct eblob_backend_config *c = priv;
+	struct blob_ra_file *f;
+	size_t size = 4096, len = 0;
+	char *json, *tmp;
+	int i, first = 1, ret;
+
+	json = malloc(size);
+	if (!json)
+		return NULL;
+
+	len = snprintf(json, size, "{\"readahead\":{\"window\":%d,\"files\":[", BLOB_RA_WINDOW);
+
+	for (i = 0; i < BLOB_RA_FILES; ++i) {
+		f = &c->ra_files[i];
+		if (f->fd < 0)
+			continue;
+
+		while (1) {
+			ret = snprintf(json + len, size - len,
+					"%s{\"fd\":%d,\"policy\":\"%s\",\"reads\":%llu,\"switches\":%llu,"
+					"\"working_set\":%llu,\"sequential_percent\":%d}",
+					first ? "" : ",", f->fd, blob_ra_policy_names[f->policy],
+					(unsigned long long)f->reads, (unsigned long long)f->switches,
+					(unsigned long long)f->working_set, f->sequential);
+			if (ret + 3 < (int)(size - len))
+				break;
+
+			size *= 2;
+			tmp = realloc(json, size);
+			if (!tmp) {
+				free(json);
+				return NULL;
 			}
+			json = tmp;
+		}
+
+		len += ret;
+		first = 0;
+	}
+
+	snprintf(json + len, size - len, "]}}");
+	return json;
+}
+
+static int blob_read(struct eblob_backend_config *c, void *state, struct dnet_cmd *cmd, void *data, int last)
+{
+	struct dnet_io_attr *io = data;
+	uint64_t offset = 0;
+	enum eblob_read_flavour csum = EBLOB_READ_CSUM;
+	int err, fd = -1, on_close;
+
+	dnet_convert_io_attr(io);
+
+	if (io->flags & DNET_IO_FLAGS_NOCSUM)
+		csum = EBLOB_READ_NOCSUM;
+
+	err = blob_read_lookup(c, io, csum, &fd, &offset);
+	if (err)
+		return err;
+
+	if (io->size && last)
+		cmd->flags &= ~DNET_FLAGS_NEED_ACK;
+
+	on_close = blob_read_account(c, fd, offset, io->size);
+
+	return dnet_send_read_data(state, cmd, io, NULL, fd, offset, on_close);
+}
+
+/*
+ * Extents of bulk read which are closer than this are read ahead as a single range,
+ * reading the gap is cheaper than a seek
+ */
+#define BLOB_BULK_READ_MAX_GAP		(128 * 1024)
+
+struct blob_bulk_read_entry {
+	struct dnet_io_attr	*io;
+	int			fd;
+	int			err;
+	uint64_t		offset;
+};
+
+static int blob_bulk_read_compare(const void *p1, const void *p2)
+{
+	const struct blob_bulk_read_entry *e1 = p1;
+	const struct blob_bulk_read_entry *e2 = p2;
+
+	if (e1->fd != e2->fd)
+		return e1->fd - e2->fd;
+
+	if (e1->offset > e2->offset)
+		return 1;
+	if (e1->offset < e2->offset)
+		return -1;
 
-			c->last_read_index = 0;
+	return 0;
+}
+
+/*
+ * Reads all requested objects in disk order instead of request order.
+ *
+ * All keys are looked up first, then they are sorted by blob and offset, close extents
+ * are read ahead as one range and replies are queued in that order, so sendfile() of
+ * every next object mostly hits the page cache. Checksums are verified in the same order
+ * by the second lookup of the key, which also gives the location its data is sent from.
+ * Every object is sent as a separate READ reply with DNET_FLAGS_MORE, failed ones as
+ * an empty reply with error status, exactly like recursive per-key processing does.
+ */
+static int blob_bulk_read(struct eblob_backend_config *c, void *state, struct dnet_cmd *cmd, void *data)
+{
+	struct dnet_io_attr *io = data;
+	struct dnet_io_attr *ios = io + 1;
+	struct blob_bulk_read_entry *entries, *e, *next;
+	struct dnet_cmd read_cmd;
+	uint64_t count, sent = 0, i, j, start, end;
+	int err = 0, ret, on_close;
+
+	dnet_convert_io_attr(io);
+	count = io->size / sizeof(struct dnet_io_attr);
+
+	if (!count || cmd->size < sizeof(struct dnet_io_attr) * (count + 1))
+		return -EINVAL;
+
+	entries = malloc(count * sizeof(struct blob_bulk_read_entry));
+	if (!entries)
+		return -ENOMEM;
+
+	for (i = 0; i < count; ++i) {
+		e = &entries[i];
+
+		e->io = &ios[i];
+		e->fd = -1;
+		e->offset = 0;
+
+		dnet_convert_io_attr(e->io);
+
+		/* Checksums are verified later when objects are read in disk order */
+		e->err = blob_read_lookup(c, e->io, EBLOB_READ_NOCSUM, &e->fd, &e->offset);
+	}
+
+	qsort(entries, count, sizeof(struct blob_bulk_read_entry), blob_bulk_read_compare);
+
+	for (i = 0; i < count; i = j) {
+		e = &entries[i];
+
+		start = e->offset;
+		end = e->offset + e->io->size;
+
+		for (j = i + 1; j < count; ++j) {
+			next = &entries[j];
+
+			if (e->err || next->err || next->fd != e->fd || next->offset > end + BLOB_BULK_READ_MAX_GAP)
+				break;
+
+			if (next->offset + next->io->size > end)
+				end = next->offset + next->io->size;
 		}
 
-		p->fd = fd;
-		p->offset = offset;
-		pthread_mutex_unlock(&c->last_read_lock);
+		if (!e->err && end > start)
+			posix_fadvise(e->fd, start, end - start, POSIX_FADV_WILLNEED);
 	}
 
-	if (c->random_access)
-		on_close = DNET_IO_REQ_FLAGS_CACHE_FORGET;
+	read_cmd = *cmd;
+	read_cmd.cmd = DNET_CMD_READ;
+	read_cmd.size = sizeof(struct dnet_io_attr);
+	read_cmd.flags |= DNET_FLAGS_MORE;
+	read_cmd.flags &= ~DNET_FLAGS_NEED_ACK;
+
+	for (i = 0; i < count; ++i) {
+		e = &entries[i];
+
+		/*
+		 * Verifying lookup returns location of the record it has checked, data is sent
+		 * from there: if the key was rewritten after the first lookup, old location
+		 * would send data nobody has verified
+		 */
+		if (!e->err && !(e->io->flags & DNET_IO_FLAGS_NOCSUM))
+			e->err = blob_read_lookup(c, e->io, EBLOB_READ_CSUM, &e->fd, &e->offset);
+
+		if (e->err) {
+			read_cmd.status = e->err;
+			dnet_send_reply(state, &read_cmd, NULL, 0, 1);
+			read_cmd.status = 0;
+
+			if (!err)
+				err = e->err;
+			continue;
+		}
 
-	err = dnet_send_read_data(state, cmd, io, NULL, fd, offset, on_close);
+		on_close = blob_read_account(c, e->fd, e->offset, e->io->size);
 
-err_out_exit:
-	dnet_ext_list_destroy(&elist);
+		ret = dnet_send_read_data(state, &read_cmd, e->io, NULL, e->fd, e->offset, on_close);
+		if (!ret)
+			sent++;
+		else if (!err)
+			err = ret;
+	}
+
+	/* Like recursive processing, request succeeds if at least one object was sent */
+	if (sent)
+		err = 0;
+
+	dnet_backend_log(DNET_LOG_NOTICE, "%s: EBLOB: blob-bulk-read: keys: %llu, sent: %llu, err: %d\n",
+			dnet_dump_id(&cmd->id), (unsigned long long)count, (unsigned long long)sent, err);
+
+	free(entries);
 	return err;
 }
 
@@ -480,16 +916,14 @@ err_out_exit:
 	return err;
 }
 
-static int blob_del_range_callback(struct eblob_range_request *req)
+static int blob_del_range_callback(struct eblob_backend_config *c, struct eblob_range_request *req)
 {
-	struct eblob_key key;
 	int err;
 
 	dnet_backend_log(DNET_LOG_DEBUG, "%s: EBLOB: blob-read-range: DEL\n",
 			dnet_dump_id_str(req->record_key));
 
-	memcpy(key.id, req->record_key, EBLOB_ID_SIZE);
-	err = eblob_remove(req->back, &key);
+	err = blob_remove(c, req->record_key);
 	if (err) {
 		dnet_backend_log(DNET_LOG_DEBUG, "%s: EBLOB: blob-read-range: DEL: err: %d\n",
 				dnet_dump_id_str(req->record_key), err);
@@ -607,7 +1041,7 @@ static int blob_read_range(struct eblob_backend_config *c, void *state, struct d
 			case DNET_CMD_DEL_RANGE:
 				dnet_backend_log(DNET_LOG_DEBUG, "%s: EBLOB: blob-read-range: DEL\n",
 						dnet_dump_id_str(p.keys[i].record_key));
-				err = blob_del_range_callback(&p.keys[i]);
+				err = blob_del_range_callback(c, &p.keys[i]);
 				break;
 		}
 
@@ -637,12 +1071,9 @@ err_out_exit:
 
 static int blob_del(struct eblob_backend_config *c, struct dnet_cmd *cmd)
 {
-	struct eblob_key key;
 	int err;
 
-	memcpy(key.id, cmd->id.id, EBLOB_ID_SIZE);
-
-	err = eblob_remove(c->eblob, &key);
+	err = blob_remove(c, cmd->id.id);
 	if (err) {
 		dnet_backend_log(DNET_LOG_ERROR, "%s: EBLOB: blob-del: REMOVE: %d: %s\n",
 			dnet_dump_id_str(cmd->id.id), err, strerror(-err));
@@ -790,6 +1221,9 @@ static int eblob_backend_command_handler(void *state, void *priv, struct dnet_cm
 		case DNET_CMD_READ:
 			err = blob_read(c, state, cmd, data, 1);
 			break;
+		case DNET_CMD_BULK_READ:
+			err = blob_bulk_read(c, state, cmd, data);
+			break;
 		case DNET_CMD_READ_RANGE:
 		case DNET_CMD_DEL_RANGE:
 			err = blob_read_range(c, state, cmd, data);
@@ -880,7 +1314,17 @@ static int dnet_blob_set_blob_size(struct dnet_config_backend *b, char *key, cha
 		c->data.blob_size = val;
 	else if (!strcmp(key, "blob_size_limit"))
 		c->data.blob_size_limit = val;
+	else if (!strcmp(key, "readahead_cache_size"))
+		c->ra_cache_size = val;
+
+	return 0;
+}
+
+static int dnet_blob_set_hash_tree_depth(struct dnet_config_backend *b, char *key __unused, char *value)
+{
+	struct eblob_backend_config *c = b->data;
 
+	c->hash_tree_depth = atoi(value);
 	return 0;
 }
 
@@ -988,10 +1432,20 @@ int eblob_backend_storage_stat(void *priv, struct dnet_stat *st)
 static void eblob_backend_cleanup(void *priv)
 {
 	struct eblob_backend_config *c = priv;
+	int i;
 
 	eblob_cleanup(c->eblob);
 
-	pthread_mutex_destroy(&c->last_read_lock);
+	if (c->hash_tree) {
+		for (i = 0; i < BLOB_HASH_TREE_LOCKS; ++i)
+			pthread_mutex_destroy(&c->hash_tree_locks[i]);
+
+		dnet_hash_tree_destroy(c->hash_tree);
+		c->hash_tree = NULL;
+	}
+
+	free(c->ra_files);
+	c->ra_files = NULL;
 	free(c->data.file);
 }
 
@@ -1005,7 +1459,7 @@ static int dnet_blob_config_init(struct dnet_config_backend *b, struct dnet_conf
 {
 	struct eblob_backend_config *c = b->data;
 	struct dnet_stat st;
-	int err = 0;
+	int err = 0, i;
 
 	if (!c->data.file) {
 		dnet_backend_log(DNET_LOG_ERROR, "blob: no data file present. Exiting.\n");
@@ -1015,25 +1469,53 @@ static int dnet_blob_config_init(struct dnet_config_backend *b, struct dnet_conf
 
 	c->data.log = (struct eblob_log *)b->log;
 
-	err = pthread_mutex_init(&c->last_read_lock, NULL);
-	if (err) {
-		err = -err;
-		dnet_backend_log(DNET_LOG_ERROR, "blob: could not create last-read lock: %d.\n", err);
+	c->ra_files = malloc(BLOB_RA_FILES * sizeof(struct blob_ra_file));
+	if (!c->ra_files) {
+		err = -ENOMEM;
+		dnet_backend_log(DNET_LOG_ERROR, "blob: could not allocate readahead statistics.\n");
 		goto err_out_exit;
 	}
 
+	memset(c->ra_files, 0, BLOB_RA_FILES * sizeof(struct blob_ra_file));
+	for (i = 0; i < BLOB_RA_FILES; ++i)
+		c->ra_files[i].fd = -1;
+
 	c->eblob = eblob_init(&c->data);
 	if (!c->eblob) {
 		err = -EINVAL;
-		goto err_out_last_read_lock_destroy;
+		goto err_out_free_ra_files;
 	}
 
 	memset(&st, 0, sizeof(struct dnet_stat));
 	err = eblob_backend_storage_stat(c, &st);
 	if (err)
-		goto err_out_last_read_lock_destroy;
+		goto err_out_cleanup_eblob;
+
+	if (!c->ra_cache_size)
+		c->ra_cache_size = st.vm_total * 1024;
+
+	if (!c->hash_tree_depth)
+		c->hash_tree_depth = DNET_HASH_TREE_DEFAULT_DEPTH;
+
+	if (c->hash_tree_depth > 0) {
+		c->hash_tree = dnet_hash_tree_create(c->hash_tree_depth);
+		if (!c->hash_tree) {
+			dnet_backend_log(DNET_LOG_ERROR, "blob: failed to create hash tree of depth %d\n",
+					c->hash_tree_depth);
+			err = -EINVAL;
+			goto err_out_cleanup_eblob;
+		}
 
-	c->vm_total = st.vm_total * st.vm_total * 1024 * 1024;
+		for (i = 0; i < BLOB_HASH_TREE_LOCKS; ++i)
+			pthread_mutex_init(&c->hash_tree_locks[i], NULL);
+
+		err = blob_hash_tree_build(c);
+		if (err) {
+			dnet_backend_log(DNET_LOG_ERROR, "blob: failed to build hash tree: %s %d\n",
+					strerror(-err), err);
+			goto err_out_free_tree;
+		}
+	}
 
 	cfg->cb = &b->cb;
 	cfg->storage_size = b->storage_size;
@@ -1046,11 +1528,25 @@ static int dnet_blob_config_init(struct dnet_config_backend *b, struct dnet_conf
 	b->cb.checksum = eblob_backend_checksum;
 
 	b->cb.iterator = dnet_eblob_iterator;
+	b->cb.stat_json = eblob_backend_stat_json;
+	b->cb.hash_tree = c->hash_tree;
+
+	dnet_backend_log(DNET_LOG_INFO, "blob: initialized: hash tree depth: %d\n", c->hash_tree_depth);
 
 	return 0;
 
-err_out_last_read_lock_destroy:
-	pthread_mutex_destroy(&c->last_read_lock);
+err_out_free_tree:
+	for (i = 0; i < BLOB_HASH_TREE_LOCKS; ++i)
+		pthread_mutex_destroy(&c->hash_tree_locks[i]);
+
+	dnet_hash_tree_destroy(c->hash_tree);
+	c->hash_tree = NULL;
+err_out_cleanup_eblob:
+	eblob_cleanup(c->eblob);
+	c->eblob = NULL;
+err_out_free_ra_files:
+	free(c->ra_files);
+	c->ra_files = NULL;
 err_out_exit:
 	return err;
 }
@@ -1074,8 +1570,10 @@ static struct dnet_config_entry dnet_cfg_entries_blobsystem[] = {
 	{"defrag_splay", dnet_blob_set_defrag_splay},
 	{"defrag_percentage", dnet_blob_set_defrag_percentage},
 	{"blob_size_limit", dnet_blob_set_blob_size},
+	{"readahead_cache_size", dnet_blob_set_blob_size},
 	{"index_block_size", dnet_blob_set_index_block_size},
 	{"index_block_bloom_length", dnet_blob_set_index_block_bloom_length},
+	{"hash_tree_depth", dnet_blob_set_hash_tree_depth},
 };
 
 static struct dnet_config_backend dnet_eblob_backend = {
@@ -17,18 +17,23 @@
  * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
 #define _XOPEN_SOURCE 600
 
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/socket.h>
 #include <sys/mman.h>
+#include <sys/time.h>
 #include <sys/wait.h>
 
 #include <ctype.h>
 #include <dirent.h>
 #include <fcntl.h>
 #include <limits.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -41,8 +46,14 @@
 
 #include "common.h"
 
+#include "../library/list.h"
+
 #ifndef __unused
 #define __unused	__attribute__ ((unused))
+
+/* Metadata eblob lives in this directory of the root, its blobs and indexes are named meta.* */
+#define FILE_BACKEND_META_DIR		"history"
+#define FILE_BACKEND_META_NAME		"meta"
 #endif
 
 struct file_backend_root
@@ -60,8 +71,116 @@ struct file_backend_root
 
 	struct eblob_log	log;
 	struct eblob_backend	*meta;
+
+	/* LRU cache of open object files, zero size disables it */
+	int			fd_cache_size;
+	int			fd_cached;
+	int			fd_hash_size;
+	struct list_head	*fd_hash;
+	struct list_head	fd_lru;
+	pthread_mutex_t		fd_lock;
+
+	/*
+	 * Group commit: writes which have to be synced wait for the commit thread,
+	 * which syncs files of all of them at once every commit_interval milliseconds
+	 * or as soon as commit_bytes are written. Zero interval disables it.
+	 */
+	int			commit_interval;
+	uint64_t		commit_bytes;
+	pthread_t		commit_tid;
+	int			commit_started;
+	int			commit_need_exit;
+	pthread_mutex_t		commit_lock;
+	pthread_cond_t		commit_wait;
+	pthread_cond_t		commit_done_wait;
+	uint64_t		commit_pending_bytes;
+	/* Files written by the current batch, they are referenced by their waiting writers */
+	struct file_backend_fd	**commit_files;
+	int			commit_files_num;
+	int			commit_files_size;
+	uint64_t		commit_seq;		/* batch new writes join */
+	uint64_t		commit_done;		/* last synced batch */
+	uint64_t		commit_failed;		/* last batch which failed to sync */
+	int			commit_err;
 };
 
+/*
+ * Open file of the object.
+ * Entry is held by the cache and by every user, file is closed when the last reference is dropped.
+ */
+struct file_backend_fd {
+	struct list_head	hash_entry;
+	struct list_head	lru_entry;
+	unsigned char		id[DNET_ID_SIZE];
+	int			fd;
+	int			writable;
+	int			cached;
+	int			refcnt;
+};
+
+static int file_backend_fd_sync(struct file_backend_root *r, struct file_backend_fd *f)
+{
+	char id_str[2*DNET_ID_SIZE+1];
+	int err;
+
+	err = fdatasync(f->fd);
+	if (err) {
+		err = -errno;
+		dnet_backend_log(DNET_LOG_ERROR, "%s: FILE: %s: SYNC: %s.\n",
+				dnet_dump_id_len_raw(f->id, DNET_ID_SIZE, id_str), r->root, strerror(-err));
+	}
+
+	return err;
+}
+
+/*
+ * Syncs all files of the metadata eblob, so ext headers written by the batch are durable with its objects.
+ * Files removed meanwhile by defragmentation are skipped.
+ */
+static int file_backend_meta_sync(struct file_backend_root *r)
+{
+	char path[PATH_MAX];
+	struct dirent *ent;
+	DIR *dir;
+	int fd, err = 0;
+
+	dir = opendir(FILE_BACKEND_META_DIR);
+	if (!dir) {
+		err = -errno;
+		dnet_backend_log(DNET_LOG_ERROR, "FILE: %s: meta-sync: opendir: %s.\n", r->root, strerror(-err));
+		return err;
+	}
+
+	while ((ent = readdir(dir)) != NULL) {
+		if (strncmp(ent->d_name, FILE_BACKEND_META_NAME ".", sizeof(FILE_BACKEND_META_NAME ".") - 1))
+			continue;
+
+		snprintf(path, sizeof(path), "%s/%s", FILE_BACKEND_META_DIR, ent->d_name);
+
+		fd = open(path, O_RDONLY | O_CLOEXEC);
+		if (fd < 0) {
+			if (errno == ENOENT)
+				continue;
+
+			err = -errno;
+			dnet_backend_log(DNET_LOG_ERROR, "FILE: %s: meta-sync: open: %s: %s.\n",
+					r->root, path, strerror(-err));
+			continue;
+		}
+
+		if (fdatasync(fd)) {
+			err = -errno;
+			dnet_backend_log(DNET_LOG_ERROR, "FILE: %s: meta-sync: %s: %s.\n",
+					r->root, path, strerror(-err));
+		}
+
+		close(fd);
+	}
+
+	closedir(dir);
+	return err;
+}
+
 static inline void file_backend_setup_file(struct file_backend_root *r, char *file,
 		unsigned int size, const unsigned char *id)
 {
@@ -119,57 +238,414 @@ static void dnet_remove_file_local(struct file_backend_root *r, struct dnet_io_a
 	remove(file);
 }
 
-static int file_write_raw(struct file_backend_root *r, struct dnet_io_attr *io)
+static struct list_head *file_backend_fd_bucket(struct file_backend_root *r, const unsigned char *id)
+{
+	uint64_t hash;
+
+	memcpy(&hash, id, sizeof(hash));
+	return &r->fd_hash[hash % r->fd_hash_size];
+}
+
+static struct file_backend_fd *file_backend_fd_search(struct file_backend_root *r, const unsigned char *id)
+{
+	struct list_head *bucket = file_backend_fd_bucket(r, id);
+	struct file_backend_fd *f;
+
+	list_for_each_entry(f, bucket, hash_entry) {
+		if (!memcmp(f->id, id, DNET_ID_SIZE))
+			return f;
+	}
+
+	return NULL;
+}
+
+static void file_backend_fd_release(struct file_backend_fd *f)
+{
+	close(f->fd);
+	free(f);
+}
+
+/*
+ * Removes entry from the cache and drops cache's reference, must be called with fd_lock held
+ */
+static void file_backend_fd_unhash(struct file_backend_root *r, struct file_backend_fd *f)
+{
+	list_del_init(&f->hash_entry);
+	list_del_init(&f->lru_entry);
+	f->cached = 0;
+	r->fd_cached--;
+
+	if (--f->refcnt == 0)
+		file_backend_fd_release(f);
+}
+
+static void file_backend_fd_put(struct file_backend_root *r, struct file_backend_fd *f)
+{
+	int last;
+
+	pthread_mutex_lock(&r->fd_lock);
+	last = (--f->refcnt == 0);
+	pthread_mutex_unlock(&r->fd_lock);
+
+	if (last)
+		file_backend_fd_release(f);
+}
+
+/*
+ * Returns open file of the object, file is created if @writable is set.
+ * Returned entry must be put by file_backend_fd_put().
+ */
+static struct file_backend_fd *file_backend_fd_get(struct file_backend_root *r, const unsigned char *id,
+		const char *file, int writable, int *errp)
+{
+	struct file_backend_fd *f, *old;
+	int oflags = writable ? O_RDWR | O_CREAT | O_LARGEFILE | O_CLOEXEC : O_RDONLY | O_CLOEXEC;
+
+	if (r->fd_cache_size) {
+		pthread_mutex_lock(&r->fd_lock);
+		f = file_backend_fd_search(r, id);
+		if (f && (f->writable || !writable)) {
+			f->refcnt++;
+			list_move(&f->lru_entry, &r->fd_lru);
+			pthread_mutex_unlock(&r->fd_lock);
+			return f;
+		}
+
+		/* Read-only file is reopened for writing */
+		if (f)
+			file_backend_fd_unhash(r, f);
+		pthread_mutex_unlock(&r->fd_lock);
+	}
+
+	f = malloc(sizeof(struct file_backend_fd));
+	if (!f) {
+		*errp = -ENOMEM;
+		return NULL;
+	}
+
+	f->fd = open(file, oflags, 0644);
+	if (f->fd < 0) {
+		*errp = -errno;
+		free(f);
+		return NULL;
+	}
+
+	memcpy(f->id, id, DNET_ID_SIZE);
+	INIT_LIST_HEAD(&f->hash_entry);
+	INIT_LIST_HEAD(&f->lru_entry);
+	f->writable = writable;
+	f->cached = 0;
+	f->refcnt = 1;
+
+	if (r->fd_cache_size) {
+		pthread_mutex_lock(&r->fd_lock);
+
+		/* Another thread could open the same file meanwhile, the newest one wins */
+		old = file_backend_fd_search(r, id);
+		if (old)
+			file_backend_fd_unhash(r, old);
+
+		list_add(&f->hash_entry, file_backend_fd_bucket(r, id));
+		list_add(&f->lru_entry, &r->fd_lru);
+		f->cached = 1;
+		f->refcnt++;
+		r->fd_cached++;
+
+		while (r->fd_cached > r->fd_cache_size) {
+			old = list_entry(r->fd_lru.prev, struct file_backend_fd, lru_entry);
+			file_backend_fd_unhash(r, old);
+		}
+
+		pthread_mutex_unlock(&r->fd_lock);
+	}
+
+	return f;
+}
+
+/*
+ * Forgets cached file of the object, it has to be called when file is removed
+ */
+static void file_backend_fd_remove(struct file_backend_root *r, const unsigned char *id)
+{
+	struct file_backend_fd *f;
+
+	if (!r->fd_cache_size)
+		return;
+
+	pthread_mutex_lock(&r->fd_lock);
+	f = file_backend_fd_search(r, id);
+	if (f)
+		file_backend_fd_unhash(r, f);
+	pthread_mutex_unlock(&r->fd_lock);
+}
+
+static int file_backend_fd_init(struct file_backend_root *r)
+{
+	int i;
+
+	INIT_LIST_HEAD(&r->fd_lru);
+	r->fd_cached = 0;
+
+	if (!r->fd_cache_size)
+		return 0;
+
+	r->fd_hash_size = r->fd_cache_size;
+	r->fd_hash = malloc(r->fd_hash_size * sizeof(struct list_head));
+	if (!r->fd_hash)
+		return -ENOMEM;
+
+	for (i = 0; i < r->fd_hash_size; ++i)
+		INIT_LIST_HEAD(&r->fd_hash[i]);
+
+	return 0;
+}
+
+static void file_backend_fd_cleanup(struct file_backend_root *r)
+{
+	struct file_backend_fd *f, *tmp;
+
+	if (!r->fd_hash)
+		return;
+
+	list_for_each_entry_safe(f, tmp, &r->fd_lru, lru_entry) {
+		file_backend_fd_unhash(r, f);
+	}
+
+	free(r->fd_hash);
+	r->fd_hash = NULL;
+}
+
+static void *file_backend_commit_thread(void *data)
+{
+	struct file_backend_root *r = data;
+	struct timeval tv;
+	struct timespec ts;
+	struct file_backend_fd **files;
+	uint64_t seq;
+	int i, files_num, err, need_exit = 0;
+
+	pthread_mutex_lock(&r->commit_lock);
+	while (!need_exit) {
+		if (!r->commit_need_exit && (!r->commit_bytes || r->commit_pending_bytes < r->commit_bytes)) {
+			gettimeofday(&tv, NULL);
+			ts.tv_sec = tv.tv_sec + r->commit_interval / 1000;
+			ts.tv_nsec = tv.tv_usec * 1000 + (r->commit_interval % 1000) * 1000000;
+			if (ts.tv_nsec >= 1000000000) {
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000;
+			}
+
+			pthread_cond_timedwait(&r->commit_wait, &r->commit_lock, &ts);
+		}
+
+		/* Writes which are already waiting are synced before exit */
+		need_exit = r->commit_need_exit;
+
+		if (!r->commit_files_num)
+			continue;
+
+		seq = r->commit_seq++;
+		files = r->commit_files;
+		files_num = r->commit_files_num;
+		r->commit_pending_bytes = 0;
+		r->commit_files = NULL;
+		r->commit_files_num = 0;
+		r->commit_files_size = 0;
+		pthread_mutex_unlock(&r->commit_lock);
+
+		/*
+		 * Only files of the batch and the metadata eblob are synced, not the whole filesystem.
+		 * Writers are woken up only after both of them are durable.
+		 */
+		err = 0;
+		for (i = 0; i < files_num; ++i) {
+			int sync_err = file_backend_fd_sync(r, files[i]);
+			if (sync_err)
+				err = sync_err;
+		}
+		free(files);
+
+		i = file_backend_meta_sync(r);
+		if (i)
+			err = i;
+
+		pthread_mutex_lock(&r->commit_lock);
+		r->commit_done = seq;
+		if (err) {
+			r->commit_failed = seq;
+			r->commit_err = err;
+		}
+		pthread_cond_broadcast(&r->commit_done_wait);
+	}
+	pthread_mutex_unlock(&r->commit_lock);
+
+	return NULL;
+}
+
+/*
+ * Waits until @size bytes just written by the caller to @f are synced together with other writes.
+ * Caller holds reference to @f until this function returns.
+ */
+static int file_backend_commit_wait(struct file_backend_root *r, struct file_backend_fd *f, uint64_t size)
+{
+	struct file_backend_fd **files;
+	uint64_t seq;
+	int err = 0;
+
+	pthread_mutex_lock(&r->commit_lock);
+	if (r->commit_need_exit)
+		goto err_out_sync;
+
+	if (r->commit_files_num == r->commit_files_size) {
+		int files_size = r->commit_files_size ? r->commit_files_size * 2 : 64;
+
+		files = realloc(r->commit_files, files_size * sizeof(struct file_backend_fd *));
+		if (!files)
+			goto err_out_sync;
+
+		r->commit_files = files;
+		r->commit_files_size = files_size;
+	}
+
+	seq = r->commit_seq;
+	r->commit_pending_bytes += size;
+	r->commit_files[r->commit_files_num++] = f;
+
+	if (r->commit_bytes && r->commit_pending_bytes >= r->commit_bytes)
+		pthread_cond_signal(&r->commit_wait);
+
+	while (r->commit_done < seq)
+		pthread_cond_wait(&r->commit_done_wait, &r->commit_lock);
+
+	/* Failure of the later batch may mean dirty pages of this one were lost too */
+	if (r->commit_failed >= seq)
+		err = r->commit_err;
+	pthread_mutex_unlock(&r->commit_lock);
+
+	return err;
+
+err_out_sync:
+	pthread_mutex_unlock(&r->commit_lock);
+
+	err = file_backend_fd_sync(r, f);
+	if (!err)
+		err = file_backend_meta_sync(r);
+	return err;
+}
+
+static int file_backend_commit_init(struct file_backend_root *r)
+{
+	int err;
+
+	r->commit_seq = 1;
+	r->commit_done = 0;
+	r->commit_failed = 0;
+
+	if (!r->commit_interval)
+		return 0;
+
+	err = pthread_create(&r->commit_tid, NULL, file_backend_commit_thread, r);
+	if (err) {
+		dnet_backend_log(DNET_LOG_ERROR, "FILE: failed to start group commit thread: %s.\n", strerror(err));
+		return -err;
+	}
+
+	r->commit_started = 1;
+	return 0;
+}
+
+static void file_backend_commit_cleanup(struct file_backend_root *r)
+{
+	if (!r->commit_started)
+		return;
+
+	pthread_mutex_lock(&r->commit_lock);
+	r->commit_need_exit = 1;
+	pthread_cond_signal(&r->commit_wait);
+	pthread_mutex_unlock(&r->commit_lock);
+
+	pthread_join(r->commit_tid, NULL);
+	r->commit_started = 0;
+
+	free(r->commit_files);
+	r->commit_files = NULL;
+}
+
+static struct file_backend_fd *file_write_raw(struct file_backend_root *r, struct dnet_io_attr *io, int *errp)
 {
 	/* null byte + maximum directory length (32 bits in hex) + '/' directory prefix */
 	char file[DNET_ID_SIZE * 2 + 8 + 8 + 2];
-	int oflags = O_RDWR | O_CREAT | O_LARGEFILE | O_CLOEXEC;
+	struct file_backend_fd *f;
 	void *data = io + 1;
-	int fd;
+	uint64_t offset = io->offset;
+	struct stat st;
 	ssize_t err;
 
 	file_backend_setup_file(r, file, sizeof(file), io->id);
 
-	if (io->flags & DNET_IO_FLAGS_APPEND)
-		oflags |= O_APPEND;
-	else if (!io->offset)
-		oflags |= O_TRUNC;
-	
-	fd = open(file, oflags, 0644);
-	if (fd < 0) {
-		err = -errno;
+	f = file_backend_fd_get(r, io->id, file, 1, errp);
+	if (!f) {
+		err = *errp;
 		dnet_backend_log(DNET_LOG_ERROR, "%s: FILE: %s: OPEN: %zd: %s.\n",
 				dnet_dump_id_str(io->id), file, err, strerror(-err));
 		goto err_out_exit;
 	}
 
-	err = pwrite(fd, data, io->size, io->offset);
+	/* Cached file is shared, so append and truncate are done explicitly instead of open flags */
+	if (io->flags & DNET_IO_FLAGS_APPEND) {
+		err = fstat(f->fd, &st);
+		if (err) {
+			err = -errno;
+			dnet_backend_log(DNET_LOG_ERROR, "%s: FILE: %s: append-stat: %zd: %s.\n",
+					dnet_dump_id_str(io->id), file, err, strerror(-err));
+			goto err_out_put;
+		}
+
+		offset = st.st_size;
+	}
+
+	err = pwrite(f->fd, data, io->size, offset);
 	if (err != (ssize_t)io->size) {
 		err = -errno;
 		dnet_backend_log(DNET_LOG_ERROR, "%s: FILE: %s: WRITE: %zd: offset: %llu, size: %llu: %s.\n",
 			dnet_dump_id_str(io->id), file, err,
-			(unsigned long long)io->offset, (unsigned long long)io->size,
+			(unsigned long long)offset, (unsigned long long)io->size,
 			strerror(-err));
-		goto err_out_close;
+		goto err_out_remove;
+	}
+
+	if (!(io->flags & DNET_IO_FLAGS_APPEND) && !io->offset) {
+		err = ftruncate(f->fd, io->size);
+		if (err) {
+			err = -errno;
+			dnet_backend_log(DNET_LOG_ERROR, "%s: FILE: %s: truncate: %zd: size: %llu: %s.\n",
+					dnet_dump_id_str(io->id), file, err, (unsigned long long)io->size, strerror(-err));
+			goto err_out_remove;
+		}
 	}
 
-	if (!r->sync)
-		fsync(fd);
+	/* Group commit syncs the file together with its metadata */
+	if (!r->sync && !r->commit_interval && !(io->flags & DNET_IO_FLAGS_NOSYNC))
+		fsync(f->fd);
 
-	return fd;
+	return f;
 
-err_out_close:
+err_out_remove:
+	file_backend_fd_remove(r, io->id);
 	dnet_remove_file_if_empty_raw(file);
-	close(fd);
+err_out_put:
+	file_backend_fd_put(r, f);
 err_out_exit:
-	return err;
+	*errp = err;
+	return NULL;
 }
 
 static int file_write(struct file_backend_root *r, void *state __unused, struct dnet_cmd *cmd, void *data)
 {
-	int err, fd;
+	int err;
 	char dir[2*DNET_ID_SIZE+1];
 	struct dnet_io_attr *io = data;
+	struct file_backend_fd *f;
 	struct eblob_key key;
 	struct dnet_ext_list elist;
 	static const size_t ehdr_size = sizeof(struct dnet_ext_list_hdr);
@@ -196,12 +672,10 @@ static int file_write(struct file_backend_root *r, void *state __unused, struct
 		}
 	}
 
-	err = file_write_raw(r, io);
-	if (err < 0)
+	f = file_write_raw(r, io, &err);
+	if (!f)
 		goto err_out_check_remove;
 
-	fd = err;
-
 	/* Copy data from elist to ehdr */
 	dnet_ext_list_to_hdr(&elist, &ehdr);
 
@@ -213,28 +687,38 @@ static int file_write(struct file_backend_root *r, void *state __unused, struct
 		goto err_out_remove;
 	}
 
+	if (!r->sync && r->commit_interval && !(io->flags & DNET_IO_FLAGS_NOSYNC)) {
+		err = file_backend_commit_wait(r, f, io->size + ehdr_size);
+		if (err) {
+			dnet_backend_log(DNET_LOG_ERROR, "%s: FILE: %s: group commit: %d: %s.\n",
+					dnet_dump_id(&cmd->id), dir, err, strerror(-err));
+			goto err_out_put;
+		}
+	}
+
 	dnet_backend_log(DNET_LOG_INFO, "%s: FILE: %s: WRITE: Ok: offset: %llu, size: %llu.\n",
 			dnet_dump_id(&cmd->id), dir, (unsigned long long)io->offset, (unsigned long long)io->size);
 
 	if (io->flags & DNET_IO_FLAGS_WRITE_NO_FILE_INFO) {
 		cmd->flags |= DNET_FLAGS_NEED_ACK;
 		err = 0;
-		goto err_out_close;
+	} else {
+		/* Object is written already, failure to reply must not remove it */
+		err = dnet_send_file_info(state, cmd, f->fd, 0, -1);
 	}
 
-	err = dnet_send_file_info(state, cmd, fd, 0, -1);
-	if (err)
-		goto err_out_close;
-
-	close(fd);
+	file_backend_fd_put(r, f);
+	dnet_ext_list_destroy(&elist);
 
-	return 0;
+	return err;
 
 err_out_remove:
+	file_backend_fd_remove(r, io->id);
 	dnet_remove_file_local(r, io);
-err_out_close:
-	close(fd);
+err_out_put:
+	file_backend_fd_put(r, f);
 err_out_check_remove:
+	file_backend_fd_remove(r, io->id);
 	dnet_remove_file_if_empty(r, io);
 err_out_exit:
 	dnet_ext_list_destroy(&elist);
@@ -244,6 +728,7 @@ err_out_exit:
 static int file_read(struct file_backend_root *r, void *state, struct dnet_cmd *cmd, void *data)
 {
 	struct dnet_io_attr *io = data;
+	struct file_backend_fd *f;
 	int fd, err;
 	ssize_t size;
 	char file[DNET_ID_SIZE * 2 + 8 + 8 + 2];
@@ -255,9 +740,8 @@ static int file_read(struct file_backend_root *r, void *state, struct dnet_cmd *
 
 	file_backend_setup_file(r, file, sizeof(file), io->id);
 
-	fd = open(file, O_RDONLY | O_CLOEXEC, 0644);
-	if (fd < 0) {
-		err = -errno;
+	f = file_backend_fd_get(r, io->id, file, 0, &err);
+	if (!f) {
 		dnet_backend_log(DNET_LOG_ERROR, "%s: FILE: %s: READ: %d: %s.\n",
 				dnet_dump_id(&cmd->id), file, err, strerror(-err));
 		goto err_out_exit;
@@ -265,20 +749,30 @@ static int file_read(struct file_backend_root *r, void *state, struct dnet_cmd *
 
 	size = io->size;
 
-	err = fstat(fd, &st);
+	err = fstat(f->fd, &st);
 	if (err) {
 		err = -errno;
 		dnet_backend_log(DNET_LOG_ERROR, "%s: FILE: %s: read-stat: %d: %s.\n",
 				dnet_dump_id(&cmd->id), file, err, strerror(-err));
-		goto err_out_close_fd;
+		goto err_out_put;
 	}
 
 	size = dnet_backend_check_get_size(io, st.st_size);
 	if (size <= 0) {
 		err = size;
-		goto err_out_close_fd;
+		goto err_out_put;
 	}
 
+	/* Data is sent asynchronously and its descriptor is closed after that, so cached file is duplicated */
+	fd = dup(f->fd);
+	if (fd < 0) {
+		err = -errno;
+		dnet_backend_log(DNET_LOG_ERROR, "%s: FILE: %s: read-dup: %d: %s.\n",
+				dnet_dump_id(&cmd->id), file, err, strerror(-err));
+		goto err_out_put;
+	}
+	file_backend_fd_put(r, f);
+
 	io->total_size = st.st_size;
 	io->size = size;
 	err = dnet_send_read_data(state, cmd, io, NULL, fd, io->offset, 1);
@@ -288,6 +782,10 @@ static int file_read(struct file_backend_root *r, void *state, struct dnet_cmd *
 
 err_out_close_fd:
 	close(fd);
+	return err;
+
+err_out_put:
+	file_backend_fd_put(r, f);
 err_out_exit:
 	return err;
 }
@@ -304,6 +802,7 @@ static int file_del(struct file_backend_root *r, void *state __unused, struct dn
 
 	snprintf(file, sizeof(file), "%s/%s",
 		dir, dnet_dump_id_len_raw(cmd->id.id, DNET_ID_SIZE, id));
+	file_backend_fd_remove(r, cmd->id.id);
 	remove(file);
 
 	eblob_remove(r->meta, &key);
@@ -316,7 +815,8 @@ static int file_info(struct file_backend_root *r, void *state, struct dnet_cmd *
 	char file[DNET_ID_SIZE * 2 + 2*DNET_ID_SIZE + 2]; /* file + dir + suffix + slash + 0-byte */
 	char dir[2*DNET_ID_SIZE+1];
 	char id[2*DNET_ID_SIZE+1];
-	int fd, err;
+	struct file_backend_fd *f;
+	int err;
 	struct eblob_write_control wc;
 	struct eblob_key key;
 	struct dnet_ext_list elist;
@@ -331,14 +831,12 @@ static int file_info(struct file_backend_root *r, void *state, struct dnet_cmd *
 	snprintf(file, sizeof(file), "%s/%s",
 		dir, dnet_dump_id_len_raw(cmd->id.id, DNET_ID_SIZE, id));
 
-	err = open(file, O_RDONLY | O_CLOEXEC);
-	if (err < 0) {
-		err = -errno;
+	f = file_backend_fd_get(r, cmd->id.id, file, 0, &err);
+	if (!f) {
 		dnet_backend_log(DNET_LOG_ERROR, "%s: FILE: %s: info-stat-open-csum: %d: %s.\n",
 			dnet_dump_id(&cmd->id), file, err, strerror(-err));
 		goto err_out_exit;
 	}
-	fd = err;
 
 	err = eblob_read_return(r->meta, &key, EBLOB_READ_NOCSUM, &wc);
 
@@ -362,14 +860,14 @@ static int file_info(struct file_backend_root *r, void *state, struct dnet_cmd *
 		}
 	}
 
-	err = dnet_send_file_info_ts(state, cmd, fd, 0, -1, &elist.timestamp);
+	err = dnet_send_file_info_ts(state, cmd, f->fd, 0, -1, &elist.timestamp);
 	if (err)
-		goto err_out_close;
+		goto err_out_put;
 	
 	err = 0;
 
-err_out_close:
-	close(fd);
+err_out_put:
+	file_backend_fd_put(r, f);
 err_out_exit:
 	dnet_ext_list_destroy(&elist);
 	return err;
@@ -423,9 +921,8 @@ static int dnet_file_set_records_in_blob(struct dnet_config_backend *b, char *ke
 	return 0;
 }
 
-static int dnet_file_set_blob_size(struct dnet_config_backend *b, char *key __unused, char *value)
+static uint64_t dnet_file_parse_size(const char *value)
 {
-	struct file_backend_root *r = b->data;
 	uint64_t val = strtoul(value, NULL, 0);
 
 	if (strchr(value, 'T'))
@@ -437,7 +934,14 @@ static int dnet_file_set_blob_size(struct dnet_config_backend *b, char *key __un
 	else if (strchr(value, 'K'))
 		val *= 1024;
 
-	r->blob_size = val;
+	return val;
+}
+
+static int dnet_file_set_blob_size(struct dnet_config_backend *b, char *key __unused, char *value)
+{
+	struct file_backend_root *r = b->data;
+
+	r->blob_size = dnet_file_parse_size(value);
 	return 0;
 }
 
@@ -465,6 +969,34 @@ static int dnet_file_set_sync(struct dnet_config_backend *b, char *key __unused,
 	return 0;
 }
 
+static int dnet_file_set_fd_cache_size(struct dnet_config_backend *b, char *key __unused, char *value)
+{
+	struct file_backend_root *r = b->data;
+
+	r->fd_cache_size = atoi(value);
+	if (r->fd_cache_size < 0)
+		r->fd_cache_size = 0;
+	return 0;
+}
+
+static int dnet_file_set_group_commit_interval(struct dnet_config_backend *b, char *key __unused, char *value)
+{
+	struct file_backend_root *r = b->data;
+
+	r->commit_interval = atoi(value);
+	if (r->commit_interval < 0)
+		r->commit_interval = 0;
+	return 0;
+}
+
+static int dnet_file_set_group_commit_bytes(struct dnet_config_backend *b, char *key __unused, char *value)
+{
+	struct file_backend_root *r = b->data;
+
+	r->commit_bytes = dnet_file_parse_size(value);
+	return 0;
+}
+
 static int dnet_file_set_root(struct dnet_config_backend *b, char *key __unused, char *root)
 {
 	struct file_backend_root *r = b->data;
@@ -533,10 +1065,11 @@ static int dnet_file_db_init(struct file_backend_root *r, struct dnet_config *c,
 	struct eblob_config ecfg;
 	int err = 0;
 
-	snprintf(meta_path, sizeof(meta_path), "%s/meta", path);
+	snprintf(meta_path, sizeof(meta_path), "%s/" FILE_BACKEND_META_NAME, path);
 
 	memset(&ecfg, 0, sizeof(ecfg));
 	ecfg.file = meta_path;
+	/* Group commit syncs metadata files together with the object files of its batch */
 	ecfg.sync = r->sync;
 	ecfg.blob_flags = EBLOB_NO_FREE_SPACE_CHECK | EBLOB_AUTO_DATASORT;
 	ecfg.records_in_blob = r->records_in_blob;
@@ -558,11 +1091,18 @@ static void file_backend_cleanup(void *priv)
 {
 	struct file_backend_root *r = priv;
 
+	file_backend_commit_cleanup(r);
+	file_backend_fd_cleanup(r);
+
 	dnet_file_db_cleanup(r);
 	close(r->rootfd);
 	free(r->root);
 }
 
+/*
+ * Checksum is not stored in the metadata eblob: writes update object files in place at any offset,
+ * so the stored value would have to be rehashed from the whole file on every partial write anyway
+ */
 static int file_backend_checksum(struct dnet_node *n, void *priv, struct dnet_id *id, void *csum, int *csize)
 {
 	struct file_backend_root *r = priv;
@@ -573,6 +1113,21 @@ static int file_backend_checksum(struct dnet_node *n, void *priv, struct dnet_id
 	return dnet_checksum_file(n, file, 0, 0, csum, *csize);
 }
 
+static int file_backend_sync(void *priv)
+{
+	struct file_backend_root *r = priv;
+	int err;
+
+	/* Explicit sync of the backend covers every object file, so the whole filesystem is synced at once */
+	err = syncfs(r->rootfd);
+	if (err) {
+		err = -errno;
+		dnet_backend_log(DNET_LOG_ERROR, "FILE: %s: SYNC: %s.\n", r->root, strerror(-err));
+	}
+
+	return err;
+}
+
 static int dnet_file_config_init(struct dnet_config_backend *b, struct dnet_config *c)
 {
 	struct file_backend_root *r = b->data;
@@ -590,13 +1145,33 @@ static int dnet_file_config_init(struct dnet_config_backend *b, struct dnet_conf
 
 	b->cb.storage_stat = file_backend_storage_stat;
 	b->cb.backend_cleanup = file_backend_cleanup;
+	b->cb.sync = file_backend_sync;
 
-	mkdir("history", 0755);
-	err = dnet_file_db_init(r, c, "history");
+	pthread_mutex_init(&r->fd_lock, NULL);
+	pthread_mutex_init(&r->commit_lock, NULL);
+	pthread_cond_init(&r->commit_wait, NULL);
+	pthread_cond_init(&r->commit_done_wait, NULL);
+
+	err = file_backend_fd_init(r);
 	if (err)
 		return err;
 
+	mkdir(FILE_BACKEND_META_DIR, 0755);
+	err = dnet_file_db_init(r, c, FILE_BACKEND_META_DIR);
+	if (err)
+		goto err_out_fd_cleanup;
+
+	err = file_backend_commit_init(r);
+	if (err)
+		goto err_out_db_cleanup;
+
 	return 0;
+
+err_out_db_cleanup:
+	dnet_file_db_cleanup(r);
+err_out_fd_cleanup:
+	file_backend_fd_cleanup(r);
+	return err;
 }
 
 static void dnet_file_config_cleanup(struct dnet_config_backend *b)
@@ -614,6 +1189,9 @@ static struct dnet_config_entry dnet_cfg_entries_filesystem[] = {
 	{"blob_size", dnet_file_set_blob_size},
 	{"defrag_timeout", dnet_file_set_defrag_timeout},
 	{"defrag_percentage", dnet_file_set_defrag_percentage},
+	{"fd_cache_size", dnet_file_set_fd_cache_size},
+	{"group_commit_interval", dnet_file_set_group_commit_interval},
+	{"group_commit_bytes", dnet_file_set_group_commit_bytes},
 };
 
 static struct dnet_config_backend dnet_file_backend = {
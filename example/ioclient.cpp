@@ -52,6 +52,8 @@ static void dnet_usage(char *p)
 			" -z                   - request VFS IO stats from node\n"
 			" -a                   - request stats from all connected nodes\n"
 			" -U status            - update server status: 1 - elliptics exits, 2 - goes RO\n"
+			" -E size              - resize cache of the server to given number of bytes, number of its shards is kept\n"
+			" -Y adaptive          - 1 - adapt cache pages sizes to the workload, 0 - use fixed proportions\n"
 			" -R file              - read given file from the network into the local storage\n"
 			" -I id                - transaction id (used to read data)\n"
 			" -g groups            - group IDs to connect\n"
@@ -96,6 +98,8 @@ int main(int argc, char *argv[])
 	int io_counter_stat = 0, vfs_stat = 0, single_node_stat = 1;
 	struct dnet_node_status node_status;
 	int update_status = 0;
+	struct dnet_cache_control cache_control;
+	int update_cache = 0;
 	struct dnet_config cfg;
 	char *remote_addr = NULL;
 	int port = -1;
@@ -117,6 +121,7 @@ int main(int argc, char *argv[])
 	int exec_src_key = -1;
 
 	memset(&node_status, 0, sizeof(struct dnet_node_status));
+	memset(&cache_control, 0, sizeof(struct dnet_cache_control));
 	memset(&cfg, 0, sizeof(struct dnet_config));
 
 	cfg.indexes_shard_count = 10;
@@ -125,12 +130,14 @@ int main(int argc, char *argv[])
 	node_status.status_flags = -1;
 	node_status.log_level = ~0U;
 
+	cache_control.adaptive = -1;
+
 	size = offset = 0;
 
 	cfg.wait_timeout = 60;
 	int log_level = DNET_LOG_ERROR;
 
-	while ((ch = getopt(argc, argv, "i:d:C:A:F:M:N:g:u:O:S:m:zsU:aL:w:l:c:k:I:r:W:R:D:hH")) != -1) {
+	while ((ch = getopt(argc, argv, "i:d:C:A:F:M:N:g:u:O:S:m:zsU:E:Y:aL:w:l:c:k:I:r:W:R:D:hH")) != -1) {
 		switch (ch) {
 			case 'i':
 				ioflags = strtoull(optarg, NULL, 0);
@@ -172,6 +179,14 @@ int main(int argc, char *argv[])
 				node_status.status_flags = strtol(optarg, NULL, 0);
 				update_status = 1;
 				break;
+			case 'E':
+				cache_control.size = strtoull(optarg, NULL, 0);
+				update_cache = 1;
+				break;
+			case 'Y':
+				cache_control.adaptive = atoi(optarg);
+				update_cache = 1;
+				break;
 			case 'z':
 				vfs_stat = 1;
 				break;
@@ -455,7 +470,13 @@ int main(int argc, char *argv[])
 			}
 		}
 
-		if (update_status) {
+		if (update_cache) {
+			s.update_status(remote_addr, port, family, &node_status, &cache_control);
+
+			std::cout << "cache size: " << cache_control.size
+				<< ", pages: " << cache_control.pages_number
+				<< ", adaptive: " << cache_control.adaptive << std::endl;
+		} else if (update_status) {
 			s.update_status(remote_addr, port, family, &node_status);
 		}
 
@@ -169,6 +169,7 @@ int main(int argc, char *argv[]) {
 	("key-end,K", boost::program_options::value<std::string>(), "End key of range for iterating")
 	("time-begin,t", boost::program_options::value<std::string>(), "Begin timestamp of time range for iterating")
 	("time-end,T", boost::program_options::value<std::string>(), "End timestamp of time range for iterating")
+	("batch,b", "packs many results into one reply")
 	("nodes,n", "Iterate nodes")
 	("groups,G", "Iterate nodes in groups")
 	("help,h", "this help");
@@ -206,6 +207,8 @@ int main(int argc, char *argv[]) {
 			ctx.time_end = parse_time(vm["time-end"].as<std::string>());
 			ctx.iflags |= DNET_IFLAGS_TS_RANGE;
 		}
+		if (vm.count("batch"))
+			ctx.iflags |= DNET_IFLAGS_BATCH;
 		if (vm.count("groups"))
 			iter_groups = true;
 		if (vm.count("nodes"))
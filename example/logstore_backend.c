@@ -0,0 +1,2188 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Log-structured backend.
+ *
+ * Every write and remove appends a record (header followed by data) to the active segment,
+ * which is a plain file in the data directory named by its sequence number. When the active
+ * segment reaches segment_size it is sealed: list of its records (footer) is written after
+ * the data, and new segment is started. Writes are synced in batches by the commit thread.
+ *
+ * Location of the last version of every key is kept in memory hash index. On start it is
+ * rebuilt from footers of the sealed segments, so only the last unsealed segment is scanned
+ * record by record. Segments are applied in order, so newer records override older ones.
+ *
+ * Rewritten and removed records are garbage, compaction thread copies live records of the
+ * segments with too much garbage into the active segment limiting its IO rate and removes
+ * those segments. Remove records are copied too until there are no older segments which
+ * may contain removed key.
+ */
+
+#define _XOPEN_SOURCE 600
+#define _BSD_SOURCE
+#define _DEFAULT_SOURCE
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "elliptics/packet.h"
+#include "elliptics/interface.h"
+#include "elliptics/backends.h"
+
+#include "common.h"
+
+#include "../library/list.h"
+#include "../library/crypto/sha512.h"
+
+#ifndef __unused
+#define __unused	__attribute__ ((unused))
+#endif
+
+#define LOGSTORE_RECORD_MAGIC		0x64726f6365726c73ULL	/* "slrecord" */
+#define LOGSTORE_FOOTER_MAGIC		0x7265746f6f666c73ULL	/* "slfooter" */
+#define LOGSTORE_FOOTER_VERSION		1
+
+#define LOGSTORE_RECORD_REMOVED		(1ULL<<0)
+#define LOGSTORE_RECORD_CHECKSUM	(1ULL<<1)	/* checksum of the data is stored in the header */
+
+#define LOGSTORE_DEFAULT_SEGMENT_SIZE		(1024 * 1024 * 1024ULL)
+#define LOGSTORE_DEFAULT_COMPACTION_INTERVAL	60		/* seconds */
+#define LOGSTORE_DEFAULT_COMPACTION_RATIO	50		/* percents of garbage */
+#define LOGSTORE_DEFAULT_COMPACTION_RATE	(10 * 1024 * 1024ULL)	/* bytes per second */
+#define LOGSTORE_INITIAL_HASH_SIZE		(64 * 1024)
+#define LOGSTORE_ITERATE_SENDFILE_SIZE		(64 * 1024ULL)	/* larger objects are iterated with sendfile() */
+
+/* On-disk record header, data follows it, records are 8 bytes aligned */
+struct logstore_record {
+	uint64_t		magic;
+	struct dnet_raw_id	id;
+	uint64_t		flags;
+	uint64_t		size;
+	uint64_t		user_flags;
+	struct dnet_time	timestamp;
+	unsigned char		checksum[DNET_ID_SIZE];
+};
+
+/* Footer of the sealed segment is an array of entries followed by the trailer */
+struct logstore_footer_entry {
+	struct dnet_raw_id	id;
+	uint64_t		offset;
+	uint64_t		size;
+	uint64_t		flags;
+	struct dnet_time	timestamp;
+};
+
+struct logstore_footer {
+	uint64_t		magic;
+	uint64_t		count;
+	uint64_t		offset;		/* start of the entries, equals to data size */
+	uint64_t		version;
+};
+
+struct logstore_segment {
+	struct list_head	segment_entry;
+	uint64_t		number;
+	int			fd;
+	int			refcnt;
+	int			sealed;
+
+	uint64_t		size;		/* data size, footer is not accounted */
+	uint64_t		live;		/* size of the records index points to */
+
+	/* Entries of the future footer of the active segment */
+	struct logstore_footer_entry	*footer;
+	uint64_t		footer_num;
+	uint64_t		footer_size;
+};
+
+/* Index entry, record is at @offset in @segment */
+struct logstore_key {
+	struct hlist_node	hash_entry;
+	struct dnet_raw_id	id;
+	struct logstore_segment	*segment;
+	uint64_t		offset;
+	uint64_t		size;
+	struct dnet_time	timestamp;
+};
+
+struct logstore_backend {
+	char			*data_dir;
+	uint64_t		segment_size;
+
+	/* Protects index, list of segments, their sizes and reference counters */
+	pthread_mutex_t		lock;
+	struct hlist_head	*hash;
+	uint64_t		hash_size;
+	uint64_t		keys;
+	struct list_head	segments;
+
+	/* Serializes appends to the active segment */
+	pthread_mutex_t		write_lock;
+	struct logstore_segment	*active;
+
+	/*
+	 * Group commit: writers wait for the commit thread, which syncs the active segment
+	 * every commit_interval milliseconds or as soon as commit_bytes are written.
+	 * Zero interval means every write is synced by itself.
+	 */
+	int			commit_interval;
+	uint64_t		commit_bytes;
+	pthread_t		commit_tid;
+	int			commit_started;
+	int			commit_need_exit;
+	pthread_mutex_t		commit_lock;
+	pthread_cond_t		commit_wait;
+	pthread_cond_t		commit_done_wait;
+	uint64_t		commit_pending_bytes;
+	int			commit_pending_writes;
+	uint64_t		commit_seq;
+	uint64_t		commit_done;
+	uint64_t		commit_failed;
+	int			commit_err;
+
+	/* Segments with at least compaction_ratio percents of garbage are compacted at compaction_rate bytes/s */
+	int			compaction_interval;
+	int			compaction_ratio;
+	uint64_t		compaction_rate;
+	pthread_t		compaction_tid;
+	int			compaction_started;
+	int			compaction_need_exit;
+	pthread_mutex_t		compaction_lock;
+	pthread_cond_t		compaction_wait;
+	uint64_t		compacted_segments;
+
+	/* Hash tree of indexed keys and their timestamps, negative depth disables it */
+	int			hash_tree_depth;
+	struct dnet_hash_tree	*hash_tree;
+};
+
+static uint64_t logstore_record_size(uint64_t size)
+{
+	return ALIGN(sizeof(struct logstore_record) + size, 8);
+}
+
+static void logstore_segment_path(struct logstore_backend *b, uint64_t number, char *path, int size)
+{
+	snprintf(path, size, "%s/segment-%016llx", b->data_dir, (unsigned long long)number);
+}
+
+static uint64_t logstore_id_hash(const unsigned char *id)
+{
+	uint64_t hash;
+
+	memcpy(&hash, id, sizeof(uint64_t));
+	return hash;
+}
+
+static struct hlist_head *logstore_bucket(struct logstore_backend *b, const unsigned char *id)
+{
+	return &b->hash[logstore_id_hash(id) & (b->hash_size - 1)];
+}
+
+/*
+ * Index routines must be called with backend lock held
+ */
+static struct logstore_key *logstore_search(struct logstore_backend *b, const unsigned char *id)
+{
+	struct hlist_head *bucket = logstore_bucket(b, id);
+	struct hlist_node *pos;
+	struct logstore_key *k;
+
+	hlist_for_each_entry(k, pos, bucket, hash_entry) {
+		if (!memcmp(k->id.id, id, DNET_ID_SIZE))
+			return k;
+	}
+
+	return NULL;
+}
+
+/*
+ * Doubles the number of buckets, failure to grow only makes chains longer
+ */
+static void logstore_hash_grow(struct logstore_backend *b)
+{
+	struct hlist_head *old = b->hash;
+	uint64_t old_size = b->hash_size, i;
+	struct hlist_node *pos, *tmp;
+	struct logstore_key *k;
+
+	b->hash = malloc(old_size * 2 * sizeof(struct hlist_head));
+	if (!b->hash) {
+		b->hash = old;
+		return;
+	}
+
+	b->hash_size = old_size * 2;
+	for (i = 0; i < b->hash_size; ++i)
+		INIT_HLIST_HEAD(&b->hash[i]);
+
+	for (i = 0; i < old_size; ++i) {
+		hlist_for_each_safe(pos, tmp, &old[i]) {
+			k = hlist_entry(pos, struct logstore_key, hash_entry);
+			hlist_del(&k->hash_entry);
+			hlist_add_head(&k->hash_entry, logstore_bucket(b, k->id.id));
+		}
+	}
+
+	free(old);
+}
+
+static void logstore_index_remove(struct logstore_backend *b, struct logstore_key *k)
+{
+	k->segment->live -= logstore_record_size(k->size);
+	dnet_hash_tree_update(b->hash_tree, k->id.id, &k->timestamp, NULL);
+
+	hlist_del(&k->hash_entry);
+	b->keys--;
+	free(k);
+}
+
+static int logstore_index_set(struct logstore_backend *b, const struct dnet_raw_id *id,
+		struct logstore_segment *seg, uint64_t offset, uint64_t size, const struct dnet_time *ts)
+{
+	struct logstore_key *k;
+
+	k = logstore_search(b, id->id);
+	if (k) {
+		k->segment->live -= logstore_record_size(k->size);
+		dnet_hash_tree_update(b->hash_tree, id->id, &k->timestamp, ts);
+	} else {
+		k = malloc(sizeof(struct logstore_key));
+		if (!k)
+			return -ENOMEM;
+
+		k->id = *id;
+		hlist_add_head(&k->hash_entry, logstore_bucket(b, id->id));
+
+		if (++b->keys > b->hash_size)
+			logstore_hash_grow(b);
+
+		dnet_hash_tree_update(b->hash_tree, id->id, NULL, ts);
+	}
+
+	k->segment = seg;
+	k->offset = offset;
+	k->size = size;
+	k->timestamp = *ts;
+
+	seg->live += logstore_record_size(size);
+	return 0;
+}
+
+/*
+ * Applies record to the index, record has to be newer than already indexed version of the key
+ */
+static int logstore_index_apply(struct logstore_backend *b, struct logstore_segment *seg,
+		const struct logstore_footer_entry *fe)
+{
+	struct logstore_key *k;
+
+	if (fe->flags & LOGSTORE_RECORD_REMOVED) {
+		k = logstore_search(b, fe->id.id);
+		if (k)
+			logstore_index_remove(b, k);
+
+		seg->live += logstore_record_size(0);
+		return 0;
+	}
+
+	return logstore_index_set(b, &fe->id, seg, fe->offset, fe->size, &fe->timestamp);
+}
+
+static void logstore_segment_get(struct logstore_segment *seg)
+{
+	seg->refcnt++;
+}
+
+static void logstore_segment_free(struct logstore_segment *seg)
+{
+	if (seg->fd >= 0)
+		close(seg->fd);
+	free(seg->footer);
+	free(seg);
+}
+
+/*
+ * Drops reference to the segment, must be called with backend lock held
+ */
+static void logstore_segment_put_locked(struct logstore_segment *seg)
+{
+	if (--seg->refcnt == 0)
+		logstore_segment_free(seg);
+}
+
+static void logstore_segment_put(struct logstore_backend *b, struct logstore_segment *seg)
+{
+	pthread_mutex_lock(&b->lock);
+	logstore_segment_put_locked(seg);
+	pthread_mutex_unlock(&b->lock);
+}
+
+static int logstore_pread(int fd, void *data, uint64_t size, uint64_t offset)
+{
+	ssize_t err;
+
+	while (size) {
+		err = pread(fd, data, size, offset);
+		if (err < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		if (err == 0)
+			return -EIO;
+
+		data += err;
+		size -= err;
+		offset += err;
+	}
+
+	return 0;
+}
+
+static int logstore_pwritev(int fd, struct iovec *iov, int iovcnt, uint64_t offset)
+{
+	ssize_t err;
+
+	while (iovcnt) {
+		err = pwritev(fd, iov, iovcnt, offset);
+		if (err < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+
+		offset += err;
+		while (iovcnt && (size_t)err >= iov->iov_len) {
+			err -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+
+		if (iovcnt) {
+			iov->iov_base += err;
+			iov->iov_len -= err;
+		}
+	}
+
+	return 0;
+}
+
+static int logstore_footer_add(struct logstore_segment *seg, const struct dnet_raw_id *id,
+		uint64_t offset, uint64_t size, uint64_t flags, const struct dnet_time *ts)
+{
+	struct logstore_footer_entry *fe;
+
+	if (seg->footer_num == seg->footer_size) {
+		uint64_t footer_size = seg->footer_size ? seg->footer_size * 2 : 1024;
+
+		fe = realloc(seg->footer, footer_size * sizeof(struct logstore_footer_entry));
+		if (!fe)
+			return -ENOMEM;
+
+		seg->footer = fe;
+		seg->footer_size = footer_size;
+	}
+
+	fe = &seg->footer[seg->footer_num++];
+	fe->id = *id;
+	fe->offset = offset;
+	fe->size = size;
+	fe->flags = flags;
+	fe->timestamp = *ts;
+	return 0;
+}
+
+/*
+ * Writes footer after the data of the segment and syncs it.
+ * Trailer is written only after entries reached the disk, so torn footer is never trusted.
+ */
+static int logstore_segment_seal(struct logstore_segment *seg)
+{
+	struct logstore_footer footer;
+	struct iovec iov;
+	uint64_t size = seg->footer_num * sizeof(struct logstore_footer_entry);
+	int err;
+
+	iov.iov_base = seg->footer;
+	iov.iov_len = size;
+
+	err = logstore_pwritev(seg->fd, &iov, 1, seg->size);
+	if (err)
+		goto err_out_exit;
+
+	err = fdatasync(seg->fd);
+	if (err) {
+		err = -errno;
+		goto err_out_exit;
+	}
+
+	memset(&footer, 0, sizeof(struct logstore_footer));
+	footer.magic = LOGSTORE_FOOTER_MAGIC;
+	footer.count = seg->footer_num;
+	footer.offset = seg->size;
+	footer.version = LOGSTORE_FOOTER_VERSION;
+
+	iov.iov_base = &footer;
+	iov.iov_len = sizeof(struct logstore_footer);
+
+	err = logstore_pwritev(seg->fd, &iov, 1, seg->size + size);
+	if (err)
+		goto err_out_exit;
+
+	err = fdatasync(seg->fd);
+	if (err) {
+		err = -errno;
+		goto err_out_exit;
+	}
+
+	seg->sealed = 1;
+	free(seg->footer);
+	seg->footer = NULL;
+	seg->footer_num = seg->footer_size = 0;
+	return 0;
+
+err_out_exit:
+	dnet_backend_log(DNET_LOG_ERROR, "LOGSTORE: segment %llu: failed to write footer: %s %d\n",
+			(unsigned long long)seg->number, strerror(-err), err);
+	return err;
+}
+
+static struct logstore_segment *logstore_segment_open(struct logstore_backend *b, uint64_t number, int flags, int *errp)
+{
+	struct logstore_segment *seg;
+	char path[PATH_MAX];
+	int err;
+
+	seg = calloc(1, sizeof(struct logstore_segment));
+	if (!seg) {
+		err = -ENOMEM;
+		goto err_out_exit;
+	}
+
+	logstore_segment_path(b, number, path, sizeof(path));
+
+	seg->fd = open(path, O_RDWR | O_CLOEXEC | flags, 0644);
+	if (seg->fd < 0) {
+		err = -errno;
+		dnet_backend_log(DNET_LOG_ERROR, "LOGSTORE: %s: failed to open segment: %s %d\n",
+				path, strerror(-err), err);
+		goto err_out_free;
+	}
+
+	seg->number = number;
+	seg->refcnt = 1;
+	return seg;
+
+err_out_free:
+	free(seg);
+err_out_exit:
+	*errp = err;
+	return NULL;
+}
+
+/*
+ * Syncs the data directory, so created and removed segments survive a crash
+ */
+static int logstore_sync_dir(struct logstore_backend *b)
+{
+	int fd, err = 0;
+
+	fd = open(b->data_dir, O_RDONLY | O_DIRECTORY);
+	if (fd < 0) {
+		err = -errno;
+		goto err_out_log;
+	}
+
+	if (fsync(fd))
+		err = -errno;
+
+	close(fd);
+
+err_out_log:
+	if (err)
+		dnet_backend_log(DNET_LOG_ERROR, "LOGSTORE: %s: failed to sync data directory: %s %d\n",
+				b->data_dir, strerror(-err), err);
+	return err;
+}
+
+/*
+ * Seals the active segment and starts the new one, must be called with both locks held
+ */
+static int logstore_rotate(struct logstore_backend *b)
+{
+	struct logstore_segment *seg, *active = b->active;
+	char path[PATH_MAX];
+	int err;
+
+	/* New segment is created first, so failure leaves the active one writable */
+	seg = logstore_segment_open(b, active->number + 1, O_CREAT | O_EXCL, &err);
+	if (!seg)
+		return err;
+
+	err = logstore_sync_dir(b);
+	if (!err)
+		err = logstore_segment_seal(active);
+	if (err) {
+		logstore_segment_path(b, seg->number, path, sizeof(path));
+		unlink(path);
+		logstore_segment_free(seg);
+		return err;
+	}
+
+	list_add_tail(&seg->segment_entry, &b->segments);
+	b->active = seg;
+
+	dnet_backend_log(DNET_LOG_INFO, "LOGSTORE: segment %llu sealed: size: %llu, live: %llu\n",
+			(unsigned long long)active->number, (unsigned long long)active->size,
+			(unsigned long long)active->live);
+	return 0;
+}
+
+/*
+ * Appends record to the active segment, @iov has to have 2 spare elements at the beginning
+ * for the header and one at the end for alignment. Must be called with write lock held.
+ * Index is not updated, location of the record is returned in @segp and @offsetp.
+ */
+static int logstore_append(struct logstore_backend *b, struct logstore_record *rec,
+		struct iovec *iov, int iovcnt, struct logstore_segment **segp, uint64_t *offsetp)
+{
+	static uint64_t zeroes;
+	uint64_t rsize = logstore_record_size(rec->size);
+	struct logstore_segment *seg;
+	int err;
+
+	if (b->active->size && b->active->size + rsize > b->segment_size) {
+		pthread_mutex_lock(&b->lock);
+		err = logstore_rotate(b);
+		pthread_mutex_unlock(&b->lock);
+		if (err)
+			return err;
+	}
+
+	seg = b->active;
+
+	iov[0].iov_base = rec;
+	iov[0].iov_len = sizeof(struct logstore_record);
+	iov[iovcnt - 1].iov_base = &zeroes;
+	iov[iovcnt - 1].iov_len = rsize - sizeof(struct logstore_record) - rec->size;
+
+	err = logstore_pwritev(seg->fd, iov, iovcnt, seg->size);
+	if (err)
+		return err;
+
+	err = logstore_footer_add(seg, &rec->id, seg->size, rec->size, rec->flags, &rec->timestamp);
+	if (err)
+		return err;
+
+	*segp = seg;
+	*offsetp = seg->size;
+
+	pthread_mutex_lock(&b->lock);
+	seg->size += rsize;
+	pthread_mutex_unlock(&b->lock);
+
+	return 0;
+}
+
+static int logstore_sync(void *priv)
+{
+	struct logstore_backend *b = priv;
+	struct logstore_segment *seg;
+	int err;
+
+	/* Sealed segments are synced when sealed, so only the active one may have unsynced data */
+	pthread_mutex_lock(&b->write_lock);
+	pthread_mutex_lock(&b->lock);
+	seg = b->active;
+	logstore_segment_get(seg);
+	pthread_mutex_unlock(&b->lock);
+	pthread_mutex_unlock(&b->write_lock);
+
+	err = fdatasync(seg->fd);
+	if (err)
+		err = -errno;
+
+	logstore_segment_put(b, seg);
+	return err;
+}
+
+static void *logstore_commit_thread(void *data)
+{
+	struct logstore_backend *b = data;
+	struct timeval tv;
+	struct timespec ts;
+	uint64_t seq;
+	int err, need_exit = 0;
+
+	pthread_mutex_lock(&b->commit_lock);
+	while (!need_exit) {
+		if (!b->commit_need_exit && (!b->commit_bytes || b->commit_pending_bytes < b->commit_bytes)) {
+			gettimeofday(&tv, NULL);
+			ts.tv_sec = tv.tv_sec + b->commit_interval / 1000;
+			ts.tv_nsec = tv.tv_usec * 1000 + (b->commit_interval % 1000) * 1000000;
+			if (ts.tv_nsec >= 1000000000) {
+				ts.tv_sec++;
+				ts.tv_nsec -= 1000000000;
+			}
+
+			pthread_cond_timedwait(&b->commit_wait, &b->commit_lock, &ts);
+		}
+
+		need_exit = b->commit_need_exit;
+
+		if (!b->commit_pending_writes)
+			continue;
+
+		seq = b->commit_seq++;
+		b->commit_pending_bytes = 0;
+		b->commit_pending_writes = 0;
+		pthread_mutex_unlock(&b->commit_lock);
+
+		err = logstore_sync(b);
+
+		pthread_mutex_lock(&b->commit_lock);
+		b->commit_done = seq;
+		if (err) {
+			b->commit_failed = seq;
+			b->commit_err = err;
+		}
+		pthread_cond_broadcast(&b->commit_done_wait);
+	}
+	pthread_mutex_unlock(&b->commit_lock);
+
+	return NULL;
+}
+
+/*
+ * Waits until @size bytes just appended by the caller are synced
+ */
+static int logstore_commit_wait(struct logstore_backend *b, uint64_t size)
+{
+	uint64_t seq;
+	int err = 0;
+
+	if (!b->commit_started)
+		return logstore_sync(b);
+
+	pthread_mutex_lock(&b->commit_lock);
+	if (b->commit_need_exit) {
+		pthread_mutex_unlock(&b->commit_lock);
+		return logstore_sync(b);
+	}
+
+	seq = b->commit_seq;
+	b->commit_pending_bytes += size;
+	b->commit_pending_writes++;
+
+	if (b->commit_bytes && b->commit_pending_bytes >= b->commit_bytes)
+		pthread_cond_signal(&b->commit_wait);
+
+	while (b->commit_done < seq)
+		pthread_cond_wait(&b->commit_done_wait, &b->commit_lock);
+
+	if (b->commit_failed >= seq)
+		err = b->commit_err;
+	pthread_mutex_unlock(&b->commit_lock);
+
+	return err;
+}
+
+/*
+ * Reads the whole record into @buf of at least @size bytes
+ */
+static int logstore_read_record(struct logstore_segment *seg, uint64_t offset, uint64_t size, void *buf)
+{
+	struct logstore_record *rec = buf;
+	int err;
+
+	err = logstore_pread(seg->fd, buf, sizeof(struct logstore_record) + size, offset);
+	if (err)
+		return err;
+
+	if (rec->magic != LOGSTORE_RECORD_MAGIC || rec->size != size)
+		return -EILSEQ;
+
+	return 0;
+}
+
+/*
+ * Copies data of the indexed object into @buf, must be called with write lock held,
+ * so object can not be changed or moved.
+ */
+static int logstore_read_old(struct logstore_backend *b, const unsigned char *id,
+		void *buf, uint64_t size, uint64_t *old_size)
+{
+	struct logstore_segment *seg = NULL;
+	struct logstore_key *k;
+	uint64_t offset = 0;
+	int err = 0;
+
+	pthread_mutex_lock(&b->lock);
+	k = logstore_search(b, id);
+	if (k) {
+		seg = k->segment;
+		offset = k->offset;
+		*old_size = k->size;
+		logstore_segment_get(seg);
+	}
+	pthread_mutex_unlock(&b->lock);
+
+	if (!seg)
+		return 0;
+
+	if (size > *old_size)
+		size = *old_size;
+
+	if (size)
+		err = logstore_pread(seg->fd, buf, size, offset + sizeof(struct logstore_record));
+
+	logstore_segment_put(b, seg);
+	return err;
+}
+
+static uint64_t logstore_object_size(struct logstore_backend *b, const unsigned char *id, int *exists)
+{
+	struct logstore_key *k;
+	uint64_t size = 0;
+
+	pthread_mutex_lock(&b->lock);
+	k = logstore_search(b, id);
+	*exists = !!k;
+	if (k)
+		size = k->size;
+	pthread_mutex_unlock(&b->lock);
+
+	return size;
+}
+
+static int logstore_write(struct logstore_backend *b, void *state, struct dnet_cmd *cmd, void *data)
+{
+	struct dnet_io_attr *io = data;
+	struct logstore_segment *seg;
+	struct logstore_record rec;
+	struct iovec iov[3];
+	uint64_t offset, old_size, new_size, rec_offset;
+	void *buf = NULL;
+	int err, exists, whole, hashed = 0;
+
+	dnet_convert_io_attr(io);
+	data += sizeof(struct dnet_io_attr);
+
+	if (io->flags & DNET_IO_FLAGS_COMPRESS)
+		return -ENOTSUP;
+
+	memset(&rec, 0, sizeof(struct logstore_record));
+	rec.magic = LOGSTORE_RECORD_MAGIC;
+	memcpy(rec.id.id, io->id, DNET_ID_SIZE);
+	rec.user_flags = io->user_flags;
+	rec.timestamp = io->timestamp;
+
+	/*
+	 * Every write stores the whole object, so its checksum is computed once here instead of every read.
+	 * Write which replaces the whole object does not depend on its old data, so it is hashed
+	 * before the lock and concurrent writers wait only for the append.
+	 */
+	whole = !io->offset && !(io->flags & (DNET_IO_FLAGS_APPEND | DNET_IO_FLAGS_PLAIN_WRITE));
+	if (whole && io->size && !(io->flags & DNET_IO_FLAGS_NOCSUM)) {
+		err = dnet_checksum_data(dnet_get_node_from_state(state), data, io->size,
+				rec.checksum, sizeof(rec.checksum));
+		if (err)
+			goto err_out_exit;
+
+		hashed = 1;
+	}
+
+	pthread_mutex_lock(&b->write_lock);
+
+	old_size = logstore_object_size(b, io->id, &exists);
+
+	offset = io->offset;
+	if (io->flags & DNET_IO_FLAGS_APPEND)
+		offset = old_size;
+
+	/* Write from the beginning replaces the object unless it is a part of prepared one */
+	new_size = offset + io->size;
+	if ((offset || (io->flags & DNET_IO_FLAGS_PLAIN_WRITE)) && new_size < old_size)
+		new_size = old_size;
+
+	if ((io->flags & DNET_IO_FLAGS_COMMIT) && (io->flags & DNET_IO_FLAGS_PLAIN_WRITE))
+		new_size = io->num;
+
+	rec.size = new_size;
+
+	if (!offset && new_size == io->size) {
+		iov[1].iov_base = data;
+		iov[1].iov_len = io->size;
+	} else {
+		/* Records are never changed in place, so partial write rewrites the whole object */
+		buf = calloc(1, new_size ? new_size : 1);
+		if (!buf) {
+			err = -ENOMEM;
+			goto err_out_unlock;
+		}
+
+		if (exists) {
+			err = logstore_read_old(b, io->id, buf, new_size, &old_size);
+			if (err)
+				goto err_out_unlock;
+		}
+
+		if (offset < new_size)
+			memcpy(buf + offset, data, offset + io->size > new_size ? new_size - offset : io->size);
+
+		iov[1].iov_base = buf;
+		iov[1].iov_len = new_size;
+	}
+
+	/* Partial write is hashed together with the old data it is merged with */
+	if (!(io->flags & DNET_IO_FLAGS_NOCSUM)) {
+		if (new_size && !hashed) {
+			err = dnet_checksum_data(dnet_get_node_from_state(state), iov[1].iov_base, new_size,
+					rec.checksum, sizeof(rec.checksum));
+			if (err)
+				goto err_out_unlock;
+		}
+
+		rec.flags |= LOGSTORE_RECORD_CHECKSUM;
+	}
+
+	err = logstore_append(b, &rec, iov, 3, &seg, &rec_offset);
+	if (err)
+		goto err_out_unlock;
+
+	pthread_mutex_lock(&b->lock);
+	err = logstore_index_set(b, &rec.id, seg, rec_offset, rec.size, &rec.timestamp);
+	if (!err)
+		logstore_segment_get(seg);
+	pthread_mutex_unlock(&b->lock);
+	if (err)
+		goto err_out_unlock;
+
+	if (!b->commit_interval && !(io->flags & DNET_IO_FLAGS_NOSYNC)) {
+		err = fdatasync(seg->fd);
+		if (err)
+			err = -errno;
+	}
+
+	pthread_mutex_unlock(&b->write_lock);
+	free(buf);
+	buf = NULL;
+
+	if (!err && b->commit_interval && !(io->flags & DNET_IO_FLAGS_NOSYNC))
+		err = logstore_commit_wait(b, logstore_record_size(rec.size));
+
+	if (err) {
+		dnet_backend_log(DNET_LOG_ERROR, "%s: LOGSTORE: write: sync: %s %d\n",
+				dnet_dump_id_str(io->id), strerror(-err), err);
+	} else {
+		dnet_backend_log(DNET_LOG_NOTICE, "%s: LOGSTORE: write: Ok: segment: %llu, position: %llu, "
+				"offset: %llu, size: %llu, object-size: %llu.\n",
+				dnet_dump_id_str(io->id), (unsigned long long)seg->number,
+				(unsigned long long)rec_offset, (unsigned long long)offset,
+				(unsigned long long)io->size, (unsigned long long)rec.size);
+	}
+
+	/* Segment may be compacted and its descriptor closed, so reference is held till now */
+	if (!err) {
+		if (io->flags & DNET_IO_FLAGS_WRITE_NO_FILE_INFO)
+			cmd->flags |= DNET_FLAGS_NEED_ACK;
+		else
+			err = dnet_send_file_info_ts(state, cmd, seg->fd, rec_offset + sizeof(struct logstore_record),
+					rec.size, &rec.timestamp);
+	}
+
+	logstore_segment_put(b, seg);
+	return err;
+
+err_out_unlock:
+	pthread_mutex_unlock(&b->write_lock);
+	free(buf);
+err_out_exit:
+	dnet_backend_log(DNET_LOG_ERROR, "%s: LOGSTORE: write: offset: %llu, size: %llu: %s %d\n",
+			dnet_dump_id_str(io->id), (unsigned long long)io->offset,
+			(unsigned long long)io->size, strerror(-err), err);
+	return err;
+}
+
+/*
+ * Finds the object and returns duplicated descriptor of its segment and its header
+ */
+static int logstore_locate(struct logstore_backend *b, const unsigned char *id,
+		struct logstore_record *rec, uint64_t *offsetp)
+{
+	struct logstore_key *k;
+	uint64_t offset;
+	int fd, err = 0;
+
+	pthread_mutex_lock(&b->lock);
+	k = logstore_search(b, id);
+	if (!k) {
+		pthread_mutex_unlock(&b->lock);
+		return -ENOENT;
+	}
+
+	offset = k->offset;
+	fd = dup(k->segment->fd);
+	if (fd < 0)
+		err = -errno;
+	pthread_mutex_unlock(&b->lock);
+
+	if (fd < 0)
+		return err;
+
+	err = logstore_pread(fd, rec, sizeof(struct logstore_record), offset);
+	if (!err && (rec->magic != LOGSTORE_RECORD_MAGIC || memcmp(rec->id.id, id, DNET_ID_SIZE)))
+		err = -EILSEQ;
+	if (err) {
+		close(fd);
+		return err;
+	}
+
+	*offsetp = offset + sizeof(struct logstore_record);
+	return fd;
+}
+
+static int logstore_read(struct logstore_backend *b, void *state, struct dnet_cmd *cmd, void *data)
+{
+	struct dnet_io_attr *io = data;
+	struct logstore_record rec;
+	uint64_t offset;
+	int64_t size;
+	int fd, err, on_exit = DNET_IO_REQ_FLAGS_CLOSE;
+
+	dnet_convert_io_attr(io);
+
+	fd = logstore_locate(b, io->id, &rec, &offset);
+	if (fd < 0) {
+		err = fd;
+		goto err_out_exit;
+	}
+
+	size = dnet_backend_check_get_size(io, rec.size);
+	if (size < 0) {
+		err = size;
+		goto err_out_close;
+	}
+
+	io->total_size = rec.size;
+	io->size = size;
+	io->timestamp = rec.timestamp;
+	io->user_flags = rec.user_flags;
+
+	if ((io->flags & DNET_IO_FLAGS_CHECKSUM) && (rec.flags & LOGSTORE_RECORD_CHECKSUM) &&
+			!io->offset && io->size == rec.size) {
+		memcpy(io->parent, rec.checksum, DNET_ID_SIZE);
+		on_exit |= DNET_IO_REQ_FLAGS_CHECKSUM_READY;
+	}
+
+	err = dnet_send_read_data(state, cmd, io, NULL, fd, offset + io->offset, on_exit);
+	if (err)
+		goto err_out_close;
+
+	return 0;
+
+err_out_close:
+	close(fd);
+err_out_exit:
+	dnet_backend_log(err == -ENOENT ? DNET_LOG_NOTICE : DNET_LOG_ERROR,
+			"%s: LOGSTORE: read: offset: %llu, size: %llu: %s %d\n",
+			dnet_dump_id_str(io->id), (unsigned long long)io->offset,
+			(unsigned long long)io->size, strerror(-err), err);
+	return err;
+}
+
+static int logstore_lookup(struct logstore_backend *b, void *state, struct dnet_cmd *cmd)
+{
+	struct logstore_record rec;
+	uint64_t offset;
+	int fd, err;
+
+	fd = logstore_locate(b, cmd->id.id, &rec, &offset);
+	if (fd < 0)
+		return fd;
+
+	err = dnet_send_file_info_ts(state, cmd, fd, offset, rec.size, &rec.timestamp);
+	close(fd);
+	return err;
+}
+
+static int logstore_del(struct logstore_backend *b, struct dnet_cmd *cmd)
+{
+	struct logstore_segment *seg;
+	struct logstore_record rec;
+	struct logstore_key *k;
+	struct iovec iov[3];
+	uint64_t offset;
+	int err, exists;
+
+	memset(&rec, 0, sizeof(struct logstore_record));
+	rec.magic = LOGSTORE_RECORD_MAGIC;
+	memcpy(rec.id.id, cmd->id.id, DNET_ID_SIZE);
+	rec.flags = LOGSTORE_RECORD_REMOVED;
+	dnet_current_time(&rec.timestamp);
+
+	pthread_mutex_lock(&b->write_lock);
+
+	logstore_object_size(b, cmd->id.id, &exists);
+	if (!exists) {
+		err = -ENOENT;
+		goto err_out_unlock;
+	}
+
+	err = logstore_append(b, &rec, iov, 2, &seg, &offset);
+	if (err)
+		goto err_out_unlock;
+
+	pthread_mutex_lock(&b->lock);
+	k = logstore_search(b, cmd->id.id);
+	if (k)
+		logstore_index_remove(b, k);
+	seg->live += logstore_record_size(0);
+	pthread_mutex_unlock(&b->lock);
+
+	if (!b->commit_interval) {
+		err = fdatasync(seg->fd);
+		if (err)
+			err = -errno;
+	}
+
+	pthread_mutex_unlock(&b->write_lock);
+
+	if (!err && b->commit_interval)
+		err = logstore_commit_wait(b, logstore_record_size(0));
+
+	return err;
+
+err_out_unlock:
+	pthread_mutex_unlock(&b->write_lock);
+	if (err != -ENOENT)
+		dnet_backend_log(DNET_LOG_ERROR, "%s: LOGSTORE: remove: %s %d\n",
+				dnet_dump_id(&cmd->id), strerror(-err), err);
+	return err;
+}
+
+static int logstore_backend_command_handler(void *state, void *priv, struct dnet_cmd *cmd, void *data)
+{
+	struct logstore_backend *b = priv;
+	int err;
+
+	switch (cmd->cmd) {
+		case DNET_CMD_LOOKUP:
+			err = logstore_lookup(b, state, cmd);
+			break;
+		case DNET_CMD_WRITE:
+			err = logstore_write(b, state, cmd, data);
+			break;
+		case DNET_CMD_READ:
+			err = logstore_read(b, state, cmd, data);
+			break;
+		case DNET_CMD_STAT:
+			err = backend_stat(state, b->data_dir, cmd);
+			break;
+		case DNET_CMD_DEL:
+			err = logstore_del(b, cmd);
+			break;
+		default:
+			err = -ENOTSUP;
+			break;
+	}
+
+	return err;
+}
+
+static int logstore_backend_checksum(struct dnet_node *n, void *priv, struct dnet_id *id, void *csum, int *csize)
+{
+	struct logstore_backend *b = priv;
+	struct logstore_record rec;
+	uint64_t offset;
+	int fd, err = 0;
+
+	fd = logstore_locate(b, id->id, &rec, &offset);
+	if (fd < 0)
+		return fd;
+
+	if (rec.flags & LOGSTORE_RECORD_CHECKSUM)
+		memcpy(csum, rec.checksum, *csize < DNET_ID_SIZE ? *csize : DNET_ID_SIZE);
+	else if (!rec.size)
+		memset(csum, 0, *csize);
+	else
+		err = dnet_checksum_fd(n, fd, offset, rec.size, csum, *csize);
+
+	close(fd);
+	return err;
+}
+
+/*
+ * Reads footer entries of the sealed segment from the disk
+ */
+static int logstore_footer_read(struct logstore_segment *seg, uint64_t file_size,
+		struct logstore_footer_entry **entriesp, uint64_t *nump)
+{
+	struct logstore_footer_entry *entries;
+	struct logstore_footer footer;
+	uint64_t size;
+	int err;
+
+	if (file_size < sizeof(struct logstore_footer))
+		return -ENOENT;
+
+	err = logstore_pread(seg->fd, &footer, sizeof(struct logstore_footer),
+			file_size - sizeof(struct logstore_footer));
+	if (err)
+		return err;
+
+	size = footer.count * sizeof(struct logstore_footer_entry);
+	if (footer.magic != LOGSTORE_FOOTER_MAGIC || footer.version != LOGSTORE_FOOTER_VERSION ||
+			footer.offset + size + sizeof(struct logstore_footer) != file_size)
+		return -ENOENT;
+
+	entries = malloc(size + 1);
+	if (!entries)
+		return -ENOMEM;
+
+	err = logstore_pread(seg->fd, entries, size, footer.offset);
+	if (err) {
+		free(entries);
+		return err;
+	}
+
+	seg->size = footer.offset;
+	*entriesp = entries;
+	*nump = footer.count;
+	return 0;
+}
+
+/*
+ * Returns copy of the list of records of the segment
+ */
+static int logstore_segment_entries(struct logstore_backend *b, struct logstore_segment *seg,
+		struct logstore_footer_entry **entriesp, uint64_t *nump)
+{
+	struct logstore_footer_entry *entries;
+	struct stat st;
+	uint64_t num;
+
+	pthread_mutex_lock(&b->write_lock);
+	if (!seg->sealed) {
+		num = seg->footer_num;
+		entries = malloc(num * sizeof(struct logstore_footer_entry) + 1);
+		if (entries && num)
+			memcpy(entries, seg->footer, num * sizeof(struct logstore_footer_entry));
+		pthread_mutex_unlock(&b->write_lock);
+
+		if (!entries)
+			return -ENOMEM;
+
+		*entriesp = entries;
+		*nump = num;
+		return 0;
+	}
+	pthread_mutex_unlock(&b->write_lock);
+
+	if (fstat(seg->fd, &st))
+		return -errno;
+
+	return logstore_footer_read(seg, st.st_size, entriesp, nump);
+}
+
+/*
+ * Returns non-zero if index still points to the record
+ */
+static int logstore_record_live(struct logstore_backend *b, struct logstore_segment *seg,
+		const struct logstore_footer_entry *fe)
+{
+	struct logstore_key *k;
+	int live;
+
+	pthread_mutex_lock(&b->lock);
+	k = logstore_search(b, fe->id.id);
+	live = k && k->segment == seg && k->offset == fe->offset;
+	pthread_mutex_unlock(&b->lock);
+
+	return live;
+}
+
+/*
+ * Snapshot of the segments with references held
+ */
+static struct logstore_segment **logstore_segments_get(struct logstore_backend *b, int *nump)
+{
+	struct logstore_segment **segments, *seg;
+	int num = 0;
+
+	pthread_mutex_lock(&b->lock);
+	list_for_each_entry(seg, &b->segments, segment_entry)
+		num++;
+
+	segments = malloc((num + 1) * sizeof(struct logstore_segment *));
+	if (segments) {
+		num = 0;
+		list_for_each_entry(seg, &b->segments, segment_entry) {
+			logstore_segment_get(seg);
+			segments[num++] = seg;
+		}
+	}
+	pthread_mutex_unlock(&b->lock);
+
+	*nump = num;
+	return segments;
+}
+
+static void logstore_segments_put(struct logstore_backend *b, struct logstore_segment **segments, int num)
+{
+	int i;
+
+	pthread_mutex_lock(&b->lock);
+	for (i = 0; i < num; ++i)
+		logstore_segment_put_locked(segments[i]);
+	pthread_mutex_unlock(&b->lock);
+
+	free(segments);
+}
+
+/*
+ * Passes location of the record's data to the iterator instead of reading it,
+ * only header of the record is read.
+ */
+static int logstore_iterate_record_fd(struct logstore_segment *seg, struct logstore_footer_entry *entry,
+		struct dnet_iterator_ctl *ictl)
+{
+	struct logstore_record rec;
+	struct dnet_ext_list elist;
+	int fd, err;
+
+	err = logstore_pread(seg->fd, &rec, sizeof(struct logstore_record), entry->offset);
+	if (err)
+		return err;
+
+	if (rec.magic != LOGSTORE_RECORD_MAGIC || rec.size != entry->size)
+		return -EILSEQ;
+
+	fd = dup(seg->fd);
+	if (fd < 0)
+		return -errno;
+
+	dnet_ext_list_init(&elist);
+	elist.timestamp = rec.timestamp;
+	elist.flags = rec.user_flags;
+
+	err = ictl->fd_callback(ictl->callback_private, &rec.id, fd,
+			entry->offset + sizeof(struct logstore_record), rec.size, &elist);
+	dnet_ext_list_destroy(&elist);
+	return err;
+}
+
+/*
+ * Iterator position is segment number and index of the footer entry in it:
+ * footer entries are only appended, so index stays valid while segment exists.
+ */
+static int logstore_iterate_checkpoint(struct logstore_segment *seg, uint64_t entry,
+		struct dnet_iterator_ctl *ictl)
+{
+	struct dnet_iterator_position position;
+
+	if (!ictl->checkpoint)
+		return 0;
+
+	memset(&position, 0, sizeof(struct dnet_iterator_position));
+	position.pos[0] = seg->number;
+	position.pos[1] = entry;
+
+	return ictl->checkpoint(ictl->callback_private, &position);
+}
+
+/*
+ * Segments are read in disk order starting with entry @start, every live record is read with one request.
+ * Large records are sent from the segment file if iterator supports it.
+ * Objects written during iteration may be missed or returned twice.
+ */
+static int logstore_iterate_segment(struct logstore_backend *b, struct logstore_segment *seg,
+		uint64_t start, struct dnet_iterator_ctl *ictl)
+{
+	struct logstore_footer_entry *entries;
+	struct logstore_record *rec;
+	struct dnet_ext_list elist;
+	uint64_t num, i, size = 0;
+	void *buf = NULL, *tmp;
+	int err;
+
+	err = logstore_segment_entries(b, seg, &entries, &num);
+	if (err)
+		return err;
+
+	for (i = start; i < num; ++i) {
+		err = logstore_iterate_checkpoint(seg, i, ictl);
+		if (err)
+			break;
+
+		if ((entries[i].flags & LOGSTORE_RECORD_REMOVED) || !logstore_record_live(b, seg, &entries[i]))
+			continue;
+
+		if (ictl->fd_callback && entries[i].size >= LOGSTORE_ITERATE_SENDFILE_SIZE) {
+			err = logstore_iterate_record_fd(seg, &entries[i], ictl);
+			if (err)
+				break;
+			continue;
+		}
+
+		if (sizeof(struct logstore_record) + entries[i].size > size) {
+			size = sizeof(struct logstore_record) + entries[i].size;
+			tmp = realloc(buf, size);
+			if (!tmp) {
+				err = -ENOMEM;
+				break;
+			}
+			buf = tmp;
+		}
+
+		err = logstore_read_record(seg, entries[i].offset, entries[i].size, buf);
+		if (err)
+			break;
+
+		rec = buf;
+
+		dnet_ext_list_init(&elist);
+		elist.timestamp = rec->timestamp;
+		elist.flags = rec->user_flags;
+
+		err = ictl->callback(ictl->callback_private, &rec->id, rec + 1, rec->size, &elist);
+		dnet_ext_list_destroy(&elist);
+		if (err)
+			break;
+	}
+
+	free(buf);
+	free(entries);
+	return err;
+}
+
+static int logstore_backend_iterator(struct dnet_iterator_ctl *ictl)
+{
+	struct logstore_backend *b = ictl->iterate_private;
+	struct logstore_segment **segments;
+	int num, i, err = 0;
+
+	segments = logstore_segments_get(b, &num);
+	if (!segments)
+		return -ENOMEM;
+
+	/* Segments which were compacted since the checkpoint are gone, their records are in newer ones */
+	for (i = 0; i < num; ++i) {
+		if (segments[i]->number < ictl->position.pos[0])
+			continue;
+
+		err = logstore_iterate_segment(b, segments[i],
+				(segments[i]->number == ictl->position.pos[0]) ? ictl->position.pos[1] : 0, ictl);
+		if (err)
+			break;
+	}
+
+	logstore_segments_put(b, segments, num);
+	return err;
+}
+
+static int logstore_backend_storage_stat(void *priv, struct dnet_stat *st)
+{
+	struct logstore_backend *b = priv;
+	int err;
+
+	memset(st, 0, sizeof(struct dnet_stat));
+
+	err = backend_stat_low_level(b->data_dir, st);
+	if (err)
+		return err;
+
+	pthread_mutex_lock(&b->lock);
+	st->node_files = b->keys;
+	st->node_files_removed = b->compacted_segments;
+	pthread_mutex_unlock(&b->lock);
+
+	return 0;
+}
+
+/*
+ * Sleeps for @usec microseconds unless backend is stopped, returns non-zero in the latter case
+ */
+static int logstore_compaction_sleep(struct logstore_backend *b, uint64_t usec)
+{
+	struct timeval tv;
+	struct timespec ts;
+	int need_exit;
+
+	gettimeofday(&tv, NULL);
+	usec += tv.tv_usec;
+	ts.tv_sec = tv.tv_sec + usec / 1000000;
+	ts.tv_nsec = (usec % 1000000) * 1000;
+
+	pthread_mutex_lock(&b->compaction_lock);
+	if (!b->compaction_need_exit)
+		pthread_cond_timedwait(&b->compaction_wait, &b->compaction_lock, &ts);
+	need_exit = b->compaction_need_exit;
+	pthread_mutex_unlock(&b->compaction_lock);
+
+	return need_exit;
+}
+
+/*
+ * Copies record into the active segment if it is still needed, must be called with write lock held.
+ * Remove records are accounted as live and kept while older segments may contain removed key.
+ */
+static int logstore_compact_record(struct logstore_backend *b, struct logstore_segment *seg,
+		const struct logstore_footer_entry *fe, struct logstore_record *rec, int oldest)
+{
+	struct logstore_segment *new_seg = NULL;
+	struct iovec iov[3];
+	uint64_t offset;
+	int err, need, removed = fe->flags & LOGSTORE_RECORD_REMOVED;
+
+	if (removed) {
+		logstore_object_size(b, fe->id.id, &need);
+		need = !need && !oldest;
+	} else {
+		need = logstore_record_live(b, seg, fe);
+	}
+
+	if (need) {
+		iov[1].iov_base = rec + 1;
+		iov[1].iov_len = rec->size;
+
+		err = logstore_append(b, rec, iov, 3, &new_seg, &offset);
+		if (err)
+			return err;
+	}
+
+	if (!removed) {
+		if (!need)
+			return 0;
+
+		pthread_mutex_lock(&b->lock);
+		err = logstore_index_set(b, &rec->id, new_seg, offset, rec->size, &rec->timestamp);
+		pthread_mutex_unlock(&b->lock);
+		return err;
+	}
+
+	pthread_mutex_lock(&b->lock);
+	seg->live -= logstore_record_size(0);
+	if (new_seg)
+		new_seg->live += logstore_record_size(0);
+	pthread_mutex_unlock(&b->lock);
+
+	return 0;
+}
+
+/*
+ * Moves still needed records of the sealed segment into the active one and removes the segment
+ */
+static int logstore_compact_segment(struct logstore_backend *b, struct logstore_segment *seg)
+{
+	struct logstore_footer_entry *entries, *fe;
+	struct logstore_record *rec;
+	uint64_t num, i, size = 0, copied = 0, start, elapsed, expected;
+	struct timeval tv;
+	void *buf = NULL, *tmp;
+	char path[PATH_MAX];
+	int err, oldest;
+
+	err = logstore_segment_entries(b, seg, &entries, &num);
+	if (err)
+		return err;
+
+	gettimeofday(&tv, NULL);
+	start = tv.tv_sec * 1000000ULL + tv.tv_usec;
+
+	for (i = 0; i < num; ++i) {
+		fe = &entries[i];
+
+		if (!(fe->flags & LOGSTORE_RECORD_REMOVED) && !logstore_record_live(b, seg, fe))
+			continue;
+
+		if (sizeof(struct logstore_record) + fe->size > size) {
+			size = sizeof(struct logstore_record) + fe->size;
+			tmp = realloc(buf, size);
+			if (!tmp) {
+				err = -ENOMEM;
+				goto err_out_free;
+			}
+			buf = tmp;
+		}
+
+		/* Record is read without write lock, so writes are not blocked by compaction reads */
+		err = logstore_read_record(seg, fe->offset, fe->size, buf);
+		if (err)
+			goto err_out_free;
+
+		rec = buf;
+
+		pthread_mutex_lock(&b->write_lock);
+		pthread_mutex_lock(&b->lock);
+		oldest = list_first_entry(&b->segments, struct logstore_segment, segment_entry) == seg;
+		pthread_mutex_unlock(&b->lock);
+
+		err = logstore_compact_record(b, seg, fe, rec, oldest);
+		pthread_mutex_unlock(&b->write_lock);
+		if (err)
+			goto err_out_free;
+
+		/* IO budget: copied bytes are read and written once */
+		copied += logstore_record_size(fe->size);
+		if (b->compaction_rate) {
+			gettimeofday(&tv, NULL);
+			elapsed = tv.tv_sec * 1000000ULL + tv.tv_usec - start;
+			expected = copied * 1000000ULL / b->compaction_rate;
+
+			if (expected > elapsed && logstore_compaction_sleep(b, expected - elapsed)) {
+				err = -EINTR;
+				goto err_out_free;
+			}
+		}
+	}
+
+	/* Copies and segments they were written to have to reach the disk before the originals are removed */
+	err = logstore_sync(b);
+	if (!err)
+		err = logstore_sync_dir(b);
+	if (err)
+		goto err_out_free;
+
+	pthread_mutex_lock(&b->lock);
+	if (seg->live) {
+		pthread_mutex_unlock(&b->lock);
+		err = -EAGAIN;
+		goto err_out_free;
+	}
+
+	list_del(&seg->segment_entry);
+	b->compacted_segments++;
+	pthread_mutex_unlock(&b->lock);
+
+	logstore_segment_path(b, seg->number, path, sizeof(path));
+	unlink(path);
+	logstore_sync_dir(b);
+
+	dnet_backend_log(DNET_LOG_INFO, "LOGSTORE: segment %llu compacted: size: %llu, copied: %llu\n",
+			(unsigned long long)seg->number, (unsigned long long)seg->size,
+			(unsigned long long)copied);
+
+	/* Reference of the list of segments */
+	logstore_segment_put(b, seg);
+
+err_out_free:
+	free(buf);
+	free(entries);
+	return err;
+}
+
+/*
+ * Returns referenced sealed segment with the largest share of garbage above compaction ratio
+ */
+static struct logstore_segment *logstore_compaction_pick(struct logstore_backend *b)
+{
+	struct logstore_segment *seg, *picked = NULL;
+	uint64_t garbage, picked_garbage = 0;
+
+	pthread_mutex_lock(&b->lock);
+	list_for_each_entry(seg, &b->segments, segment_entry) {
+		if (!seg->sealed)
+			continue;
+
+		garbage = seg->size - seg->live;
+		if (garbage * 100 < seg->size * b->compaction_ratio)
+			continue;
+
+		if (!picked || garbage * picked->size > picked_garbage * seg->size) {
+			picked = seg;
+			picked_garbage = garbage;
+		}
+	}
+
+	if (picked)
+		logstore_segment_get(picked);
+	pthread_mutex_unlock(&b->lock);
+
+	return picked;
+}
+
+static void *logstore_compaction_thread(void *data)
+{
+	struct logstore_backend *b = data;
+	struct logstore_segment *seg;
+	int err;
+
+	while (!logstore_compaction_sleep(b, b->compaction_interval * 1000000ULL)) {
+		while ((seg = logstore_compaction_pick(b)) != NULL) {
+			err = logstore_compact_segment(b, seg);
+			logstore_segment_put(b, seg);
+
+			if (err == -EINTR)
+				return NULL;
+			if (err) {
+				dnet_backend_log(DNET_LOG_ERROR, "LOGSTORE: segment %llu: compaction failed: %s %d\n",
+						(unsigned long long)seg->number, strerror(-err), err);
+				break;
+			}
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Checks data of the scanned record against its checksum, which is computed by the default
+ * sha512 transform. Record whose data did not fully reach the disk does not match.
+ */
+static int logstore_record_verify(struct logstore_segment *seg, struct logstore_record *rec, uint64_t offset,
+		char **bufp, uint64_t *sizep)
+{
+	unsigned char csum[SHA512_DIGEST_SIZE];
+	size_t csize = sizeof(rec->checksum) < sizeof(csum) ? sizeof(rec->checksum) : sizeof(csum);
+	char *buf = *bufp;
+	int err;
+
+	if (!(rec->flags & LOGSTORE_RECORD_CHECKSUM) || !rec->size)
+		return 0;
+
+	if (rec->size > *sizep) {
+		buf = realloc(*bufp, rec->size);
+		if (!buf)
+			return -ENOMEM;
+
+		*bufp = buf;
+		*sizep = rec->size;
+	}
+
+	err = logstore_pread(seg->fd, buf, rec->size, offset + sizeof(struct logstore_record));
+	if (err)
+		return err;
+
+	sha512_buffer(buf, rec->size, csum);
+	if (memcmp(rec->checksum, csum, csize))
+		return -EILSEQ;
+
+	return 0;
+}
+
+/*
+ * Scans records of the unsealed segment, torn tail left after crash is cut off.
+ * Only header and data of the tail may be torn, so the first broken record ends the scan.
+ */
+static int logstore_segment_scan(struct logstore_segment *seg, uint64_t file_size)
+{
+	struct logstore_record rec;
+	uint64_t offset = 0, rsize, buf_size = 0;
+	char *buf = NULL;
+	int err = 0;
+
+	while (offset + sizeof(struct logstore_record) <= file_size) {
+		err = logstore_pread(seg->fd, &rec, sizeof(struct logstore_record), offset);
+		if (err)
+			goto err_out_free;
+
+		rsize = logstore_record_size(rec.size);
+		if (rec.magic != LOGSTORE_RECORD_MAGIC || rec.size > file_size || offset + rsize > file_size)
+			break;
+
+		err = logstore_record_verify(seg, &rec, offset, &buf, &buf_size);
+		if (err == -EILSEQ) {
+			dnet_backend_log(DNET_LOG_ERROR, "LOGSTORE: segment %llu: %s: checksum mismatch at %llu\n",
+					(unsigned long long)seg->number, dnet_dump_id_str(rec.id.id),
+					(unsigned long long)offset);
+			err = 0;
+			break;
+		}
+		if (err)
+			goto err_out_free;
+
+		err = logstore_footer_add(seg, &rec.id, offset, rec.size, rec.flags, &rec.timestamp);
+		if (err)
+			goto err_out_free;
+
+		offset += rsize;
+	}
+
+	if (offset != file_size) {
+		dnet_backend_log(DNET_LOG_ERROR, "LOGSTORE: segment %llu: truncating torn tail: %llu -> %llu\n",
+				(unsigned long long)seg->number, (unsigned long long)file_size,
+				(unsigned long long)offset);
+
+		err = ftruncate(seg->fd, offset);
+		if (err) {
+			err = -errno;
+			goto err_out_free;
+		}
+	}
+
+	seg->size = offset;
+
+err_out_free:
+	free(buf);
+	return err;
+}
+
+static int logstore_segment_load(struct logstore_backend *b, struct logstore_segment *seg)
+{
+	struct logstore_footer_entry *entries;
+	struct stat st;
+	uint64_t num, i;
+	int err;
+
+	if (fstat(seg->fd, &st))
+		return -errno;
+
+	err = logstore_footer_read(seg, st.st_size, &entries, &num);
+	if (!err) {
+		seg->sealed = 1;
+	} else if (err == -ENOENT) {
+		err = logstore_segment_scan(seg, st.st_size);
+		if (err)
+			return err;
+
+		entries = seg->footer;
+		num = seg->footer_num;
+	} else {
+		return err;
+	}
+
+	for (i = 0; i < num; ++i) {
+		err = logstore_index_apply(b, seg, &entries[i]);
+		if (err)
+			break;
+	}
+
+	if (seg->sealed)
+		free(entries);
+
+	dnet_backend_log(DNET_LOG_INFO, "LOGSTORE: segment %llu loaded: %s, records: %llu, size: %llu\n",
+			(unsigned long long)seg->number, seg->sealed ? "sealed" : "scanned",
+			(unsigned long long)num, (unsigned long long)seg->size);
+	return err;
+}
+
+static int logstore_number_compare(const void *p1, const void *p2)
+{
+	const uint64_t *n1 = p1, *n2 = p2;
+
+	if (*n1 < *n2)
+		return -1;
+	if (*n1 > *n2)
+		return 1;
+	return 0;
+}
+
+/*
+ * Rebuilds index from the segments of the data directory and opens the active segment
+ */
+static int logstore_load(struct logstore_backend *b)
+{
+	struct logstore_segment *seg = NULL;
+	uint64_t *numbers = NULL, *tmp, num = 0, size = 0, i;
+	unsigned long long number;
+	struct dirent *d;
+	DIR *dir;
+	int err = 0;
+
+	if (mkdir(b->data_dir, 0755) && errno != EEXIST) {
+		err = -errno;
+		dnet_backend_log(DNET_LOG_ERROR, "LOGSTORE: %s: failed to create data directory: %s %d\n",
+				b->data_dir, strerror(-err), err);
+		return err;
+	}
+
+	dir = opendir(b->data_dir);
+	if (!dir) {
+		err = -errno;
+		dnet_backend_log(DNET_LOG_ERROR, "LOGSTORE: %s: failed to open data directory: %s %d\n",
+				b->data_dir, strerror(-err), err);
+		return err;
+	}
+
+	while ((d = readdir(dir)) != NULL) {
+		if (sscanf(d->d_name, "segment-%llx", &number) != 1)
+			continue;
+
+		if (num == size) {
+			size = size ? size * 2 : 64;
+			tmp = realloc(numbers, size * sizeof(uint64_t));
+			if (!tmp) {
+				err = -ENOMEM;
+				goto err_out_close;
+			}
+			numbers = tmp;
+		}
+
+		numbers[num++] = number;
+	}
+
+	if (num)
+		qsort(numbers, num, sizeof(uint64_t), logstore_number_compare);
+
+	for (i = 0; i < num; ++i) {
+		seg = logstore_segment_open(b, numbers[i], 0, &err);
+		if (!seg)
+			goto err_out_close;
+
+		list_add_tail(&seg->segment_entry, &b->segments);
+
+		err = logstore_segment_load(b, seg);
+		if (err) {
+			dnet_backend_log(DNET_LOG_ERROR, "LOGSTORE: segment %llu: failed to load: %s %d\n",
+					(unsigned long long)seg->number, strerror(-err), err);
+			goto err_out_close;
+		}
+
+		/* Only the last segment may be left unsealed, previous one failed to seal before */
+		if (!seg->sealed && i != num - 1) {
+			err = logstore_segment_seal(seg);
+			if (err)
+				goto err_out_close;
+		}
+	}
+
+	if (seg && !seg->sealed) {
+		b->active = seg;
+	} else {
+		seg = logstore_segment_open(b, num ? numbers[num - 1] + 1 : 0, O_CREAT | O_EXCL, &err);
+		if (!seg)
+			goto err_out_close;
+
+		list_add_tail(&seg->segment_entry, &b->segments);
+		b->active = seg;
+
+		err = logstore_sync_dir(b);
+	}
+
+err_out_close:
+	free(numbers);
+	closedir(dir);
+	return err;
+}
+
+static void logstore_backend_cleanup(void *priv)
+{
+	struct logstore_backend *b = priv;
+	struct logstore_segment *seg, *tmp;
+	struct hlist_node *pos, *n;
+	uint64_t i;
+
+	if (!b->hash)
+		return;
+
+	if (b->compaction_started) {
+		pthread_mutex_lock(&b->compaction_lock);
+		b->compaction_need_exit = 1;
+		pthread_cond_signal(&b->compaction_wait);
+		pthread_mutex_unlock(&b->compaction_lock);
+
+		pthread_join(b->compaction_tid, NULL);
+		b->compaction_started = 0;
+	}
+
+	if (b->commit_started) {
+		pthread_mutex_lock(&b->commit_lock);
+		b->commit_need_exit = 1;
+		pthread_cond_signal(&b->commit_wait);
+		pthread_mutex_unlock(&b->commit_lock);
+
+		pthread_join(b->commit_tid, NULL);
+		b->commit_started = 0;
+	}
+
+	/* Sealed active segment will not have to be scanned on the next start */
+	if (b->active && b->active->size)
+		logstore_segment_seal(b->active);
+	b->active = NULL;
+
+	list_for_each_entry_safe(seg, tmp, &b->segments, segment_entry) {
+		list_del(&seg->segment_entry);
+		logstore_segment_put_locked(seg);
+	}
+
+	for (i = 0; i < b->hash_size; ++i) {
+		hlist_for_each_safe(pos, n, &b->hash[i]) {
+			free(hlist_entry(pos, struct logstore_key, hash_entry));
+		}
+	}
+
+	free(b->hash);
+	b->hash = NULL;
+
+	pthread_cond_destroy(&b->compaction_wait);
+	pthread_mutex_destroy(&b->compaction_lock);
+	pthread_cond_destroy(&b->commit_done_wait);
+	pthread_cond_destroy(&b->commit_wait);
+	pthread_mutex_destroy(&b->commit_lock);
+	pthread_mutex_destroy(&b->write_lock);
+	pthread_mutex_destroy(&b->lock);
+}
+
+static uint64_t dnet_logstore_parse_size(const char *value)
+{
+	uint64_t val = strtoull(value, NULL, 0);
+
+	if (strchr(value, 'T'))
+		val *= 1024*1024*1024*1024ULL;
+	else if (strchr(value, 'G'))
+		val *= 1024*1024*1024ULL;
+	else if (strchr(value, 'M'))
+		val *= 1024*1024;
+	else if (strchr(value, 'K'))
+		val *= 1024;
+
+	return val;
+}
+
+static int dnet_logstore_set_data(struct dnet_config_backend *b, char *key __unused, char *value)
+{
+	struct logstore_backend *l = b->data;
+
+	free(l->data_dir);
+	l->data_dir = strdup(value);
+	if (!l->data_dir)
+		return -ENOMEM;
+
+	return 0;
+}
+
+static int dnet_logstore_set_segment_size(struct dnet_config_backend *b, char *key __unused, char *value)
+{
+	struct logstore_backend *l = b->data;
+
+	l->segment_size = dnet_logstore_parse_size(value);
+	return 0;
+}
+
+static int dnet_logstore_set_commit_interval(struct dnet_config_backend *b, char *key __unused, char *value)
+{
+	struct logstore_backend *l = b->data;
+
+	l->commit_interval = atoi(value);
+	if (l->commit_interval < 0)
+		l->commit_interval = 0;
+	return 0;
+}
+
+static int dnet_logstore_set_commit_bytes(struct dnet_config_backend *b, char *key __unused, char *value)
+{
+	struct logstore_backend *l = b->data;
+
+	l->commit_bytes = dnet_logstore_parse_size(value);
+	return 0;
+}
+
+static int dnet_logstore_set_compaction_interval(struct dnet_config_backend *b, char *key __unused, char *value)
+{
+	struct logstore_backend *l = b->data;
+
+	l->compaction_interval = atoi(value);
+	return 0;
+}
+
+static int dnet_logstore_set_compaction_ratio(struct dnet_config_backend *b, char *key __unused, char *value)
+{
+	struct logstore_backend *l = b->data;
+
+	l->compaction_ratio = atoi(value);
+	return 0;
+}
+
+static int dnet_logstore_set_compaction_rate(struct dnet_config_backend *b, char *key __unused, char *value)
+{
+	struct logstore_backend *l = b->data;
+
+	l->compaction_rate = dnet_logstore_parse_size(value);
+	return 0;
+}
+
+static int dnet_logstore_set_hash_tree_depth(struct dnet_config_backend *b, char *key __unused, char *value)
+{
+	struct logstore_backend *l = b->data;
+
+	l->hash_tree_depth = atoi(value);
+	return 0;
+}
+
+static int dnet_logstore_config_init(struct dnet_config_backend *b, struct dnet_config *c)
+{
+	struct logstore_backend *l = b->data;
+	uint64_t i;
+	int err;
+
+	if (!l->data_dir) {
+		dnet_backend_log(DNET_LOG_ERROR, "LOGSTORE: data directory is not set\n");
+		err = -EINVAL;
+		goto err_out_exit;
+	}
+
+	if (!l->segment_size)
+		l->segment_size = LOGSTORE_DEFAULT_SEGMENT_SIZE;
+	if (!l->compaction_interval)
+		l->compaction_interval = LOGSTORE_DEFAULT_COMPACTION_INTERVAL;
+	if (l->compaction_ratio <= 0 || l->compaction_ratio > 100)
+		l->compaction_ratio = LOGSTORE_DEFAULT_COMPACTION_RATIO;
+	if (!l->compaction_rate)
+		l->compaction_rate = LOGSTORE_DEFAULT_COMPACTION_RATE;
+	if (!l->hash_tree_depth)
+		l->hash_tree_depth = DNET_HASH_TREE_DEFAULT_DEPTH;
+
+	/* Tree has to exist before the index is loaded */
+	if (l->hash_tree_depth > 0) {
+		l->hash_tree = dnet_hash_tree_create(l->hash_tree_depth);
+		if (!l->hash_tree) {
+			dnet_backend_log(DNET_LOG_ERROR, "LOGSTORE: failed to create hash tree of depth %d\n",
+					l->hash_tree_depth);
+			err = -EINVAL;
+			goto err_out_exit;
+		}
+	}
+
+	l->hash_size = LOGSTORE_INITIAL_HASH_SIZE;
+	l->hash = malloc(l->hash_size * sizeof(struct hlist_head));
+	if (!l->hash) {
+		err = -ENOMEM;
+		goto err_out_free_tree;
+	}
+
+	for (i = 0; i < l->hash_size; ++i)
+		INIT_HLIST_HEAD(&l->hash[i]);
+
+	pthread_mutex_init(&l->lock, NULL);
+	pthread_mutex_init(&l->write_lock, NULL);
+	pthread_mutex_init(&l->commit_lock, NULL);
+	pthread_cond_init(&l->commit_wait, NULL);
+	pthread_cond_init(&l->commit_done_wait, NULL);
+	pthread_mutex_init(&l->compaction_lock, NULL);
+	pthread_cond_init(&l->compaction_wait, NULL);
+
+	INIT_LIST_HEAD(&l->segments);
+
+	err = logstore_load(l);
+	if (err)
+		goto err_out_cleanup;
+
+	l->commit_seq = 1;
+	if (l->commit_interval) {
+		err = pthread_create(&l->commit_tid, NULL, logstore_commit_thread, l);
+		if (err) {
+			err = -err;
+			dnet_backend_log(DNET_LOG_ERROR, "LOGSTORE: failed to start commit thread: %s %d\n",
+					strerror(-err), err);
+			goto err_out_cleanup;
+		}
+		l->commit_started = 1;
+	}
+
+	if (l->compaction_interval > 0) {
+		err = pthread_create(&l->compaction_tid, NULL, logstore_compaction_thread, l);
+		if (err) {
+			err = -err;
+			dnet_backend_log(DNET_LOG_ERROR, "LOGSTORE: failed to start compaction thread: %s %d\n",
+					strerror(-err), err);
+			goto err_out_cleanup;
+		}
+		l->compaction_started = 1;
+	}
+
+	err = backend_storage_size(b, l->data_dir);
+	if (err)
+		goto err_out_cleanup;
+
+	c->cb = &b->cb;
+	c->storage_size = b->storage_size;
+	c->storage_free = b->storage_free;
+
+	b->cb.command_private = l;
+	b->cb.command_handler = logstore_backend_command_handler;
+	b->cb.checksum = logstore_backend_checksum;
+	b->cb.storage_stat = logstore_backend_storage_stat;
+	b->cb.backend_cleanup = logstore_backend_cleanup;
+	b->cb.iterator = logstore_backend_iterator;
+	b->cb.sync = logstore_sync;
+	b->cb.hash_tree = l->hash_tree;
+
+	dnet_backend_log(DNET_LOG_INFO, "LOGSTORE: %s: initialized: keys: %llu, active segment: %llu, "
+			"segment size: %llu, commit interval: %d ms, compaction: ratio: %d%%, rate: %llu, "
+			"hash tree depth: %d\n",
+			l->data_dir, (unsigned long long)l->keys, (unsigned long long)l->active->number,
+			(unsigned long long)l->segment_size, l->commit_interval, l->compaction_ratio,
+			(unsigned long long)l->compaction_rate, l->hash_tree_depth);
+
+	return 0;
+
+err_out_cleanup:
+	logstore_backend_cleanup(l);
+err_out_free_tree:
+	dnet_hash_tree_destroy(l->hash_tree);
+	l->hash_tree = NULL;
+err_out_exit:
+	return err;
+}
+
+static void dnet_logstore_config_cleanup(struct dnet_config_backend *b)
+{
+	struct logstore_backend *l = b->data;
+
+	logstore_backend_cleanup(l);
+
+	dnet_hash_tree_destroy(l->hash_tree);
+	l->hash_tree = NULL;
+
+	free(l->data_dir);
+	l->data_dir = NULL;
+}
+
+static struct dnet_config_entry dnet_cfg_entries_logstore[] = {
+	{"data", dnet_logstore_set_data},
+	{"segment_size", dnet_logstore_set_segment_size},
+	{"group_commit_interval", dnet_logstore_set_commit_interval},
+	{"group_commit_bytes", dnet_logstore_set_commit_bytes},
+	{"compaction_interval", dnet_logstore_set_compaction_interval},
+	{"compaction_ratio", dnet_logstore_set_compaction_ratio},
+	{"compaction_rate", dnet_logstore_set_compaction_rate},
+	{"hash_tree_depth", dnet_logstore_set_hash_tree_depth},
+};
+
+static struct dnet_config_backend dnet_logstore_backend = {
+	.name			= "logstore",
+	.ent			= dnet_cfg_entries_logstore,
+	.num			= ARRAY_SIZE(dnet_cfg_entries_logstore),
+	.size			= sizeof(struct logstore_backend),
+	.init			= dnet_logstore_config_init,
+	.cleanup		= dnet_logstore_config_cleanup,
+};
+
+int dnet_logstore_backend_init(void)
+{
+	return dnet_backend_register(&dnet_logstore_backend);
+}
+
+void dnet_logstore_backend_exit(void)
+{
+	/* cleanup routing will be called explicitly through backend->cleanup() callback */
+}
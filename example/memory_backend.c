@@ -0,0 +1,995 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Memory backend keeps all objects in RAM, nothing is ever written to the disk.
+ *
+ * Objects live in a hash table split into shards, every shard has its own lock,
+ * LRU list and slab allocator, so requests to different shards never contend.
+ * Small objects are allocated from per-shard slabs of power-of-two chunks,
+ * object header and data share one chunk. When memory limit is set and eviction
+ * is enabled, the least recently used objects of the shard are dropped
+ * to make room for the new ones, otherwise write fails with -ENOSPC.
+ * Object bigger than the limit of its shard is never stored, its write fails with -E2BIG.
+ * Slab page is returned to the system as soon as its last chunk is freed.
+ */
+
+#define _XOPEN_SOURCE 600
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "elliptics/packet.h"
+#include "elliptics/interface.h"
+#include "elliptics/backends.h"
+
+#include "common.h"
+
+#include "../library/list.h"
+
+#ifndef __unused
+#define __unused	__attribute__ ((unused))
+#endif
+
+#define MEMORY_SLAB_MIN_SHIFT		6	/* 64 bytes */
+#define MEMORY_SLAB_MAX_SHIFT		15	/* 32 KiB, larger objects are allocated directly */
+#define MEMORY_SLAB_CLASSES		(MEMORY_SLAB_MAX_SHIFT - MEMORY_SLAB_MIN_SHIFT + 1)
+#define MEMORY_SLAB_PAGE_SIZE		(256 * 1024)
+
+#define MEMORY_DEFAULT_SHARDS		64
+#define MEMORY_INITIAL_HASH_SIZE	256
+
+struct memory_entry {
+	struct list_head	hash_entry;
+	struct list_head	lru_entry;
+	struct dnet_raw_id	id;
+	struct dnet_time	timestamp;
+	uint64_t		user_flags;
+	unsigned char		checksum[DNET_ID_SIZE];
+	int			checksum_valid;	/* checksum is set at write or first use, reset by partial writes */
+	uint64_t		size;		/* data size */
+	uint64_t		capacity;	/* size of the chunk entry lives in, including this header */
+	unsigned char		data[];
+};
+
+/*
+ * Slab page header, chunks of one size class follow it.
+ * Pages are aligned to their size, so chunk finds its page by masking its address.
+ */
+struct memory_slab_page {
+	struct list_head	page_entry;	/* in list of pages of the class with free chunks */
+	void			*free_chunks;
+	uint32_t		used;		/* chunks given out */
+	uint32_t		cls;
+};
+
+struct memory_shard {
+	pthread_mutex_t		lock;
+
+	struct list_head	*hash;
+	uint64_t		hash_size;
+	uint64_t		entries;
+	struct list_head	lru;
+
+	uint64_t		used;		/* bytes taken by chunks of the objects */
+	uint64_t		limit;
+	uint64_t		evicted;
+
+	struct list_head	partial_pages[MEMORY_SLAB_CLASSES];
+};
+
+struct memory_backend {
+	int			shards_number;
+	uint64_t		limit;
+	int			evict;
+	int			hash_tree_depth;	/* negative if hash tree is disabled */
+
+	struct memory_shard	*shards;
+	struct dnet_hash_tree	*hash_tree;
+};
+
+static int memory_slab_class(uint64_t size)
+{
+	int shift = MEMORY_SLAB_MIN_SHIFT;
+
+	while (shift <= MEMORY_SLAB_MAX_SHIFT && (1ULL << shift) < size)
+		shift++;
+
+	return shift - MEMORY_SLAB_MIN_SHIFT;
+}
+
+/*
+ * Returns size of the chunk which fits @size bytes
+ */
+static uint64_t memory_chunk_size(uint64_t size)
+{
+	int cls = memory_slab_class(size);
+
+	if (cls < MEMORY_SLAB_CLASSES)
+		return 1ULL << (cls + MEMORY_SLAB_MIN_SHIFT);
+
+	return ALIGN(size, 4096);
+}
+
+static void *memory_chunk_alloc(struct memory_shard *s, uint64_t chunk_size)
+{
+	int cls = memory_slab_class(chunk_size);
+	struct memory_slab_page *page;
+	void *chunk;
+	char *ptr;
+
+	if (cls >= MEMORY_SLAB_CLASSES)
+		return malloc(chunk_size);
+
+	if (list_empty(&s->partial_pages[cls])) {
+		if (posix_memalign((void **)&page, MEMORY_SLAB_PAGE_SIZE, MEMORY_SLAB_PAGE_SIZE))
+			return NULL;
+
+		page->free_chunks = NULL;
+		page->used = 0;
+		page->cls = cls;
+
+		for (ptr = (char *)(page + 1); ptr + chunk_size <= (char *)page + MEMORY_SLAB_PAGE_SIZE; ptr += chunk_size) {
+			*(void **)ptr = page->free_chunks;
+			page->free_chunks = ptr;
+		}
+
+		list_add(&page->page_entry, &s->partial_pages[cls]);
+	}
+
+	page = list_first_entry(&s->partial_pages[cls], struct memory_slab_page, page_entry);
+
+	chunk = page->free_chunks;
+	page->free_chunks = *(void **)chunk;
+	page->used++;
+
+	if (!page->free_chunks)
+		list_del_init(&page->page_entry);
+
+	return chunk;
+}
+
+/*
+ * Returns chunk to its page, page which has no chunks given out is released
+ */
+static void memory_chunk_free(struct memory_shard *s, void *chunk, uint64_t chunk_size)
+{
+	int cls = memory_slab_class(chunk_size);
+	struct memory_slab_page *page;
+
+	if (cls >= MEMORY_SLAB_CLASSES) {
+		free(chunk);
+		return;
+	}
+
+	page = (struct memory_slab_page *)((unsigned long)chunk & ~(MEMORY_SLAB_PAGE_SIZE - 1UL));
+
+	if (!page->free_chunks)
+		list_add(&page->page_entry, &s->partial_pages[cls]);
+
+	*(void **)chunk = page->free_chunks;
+	page->free_chunks = chunk;
+
+	if (--page->used == 0) {
+		list_del(&page->page_entry);
+		free(page);
+	}
+}
+
+static uint64_t memory_id_hash(const unsigned char *id, int part)
+{
+	uint64_t hash;
+
+	memcpy(&hash, id + part * sizeof(uint64_t), sizeof(uint64_t));
+	return hash;
+}
+
+static struct memory_shard *memory_shard(struct memory_backend *m, const unsigned char *id)
+{
+	return &m->shards[memory_id_hash(id, 0) % m->shards_number];
+}
+
+static struct list_head *memory_bucket(struct memory_shard *s, const unsigned char *id)
+{
+	return &s->hash[memory_id_hash(id, 1) & (s->hash_size - 1)];
+}
+
+static struct memory_entry *memory_search(struct memory_shard *s, const unsigned char *id)
+{
+	struct list_head *bucket = memory_bucket(s, id);
+	struct memory_entry *e;
+
+	list_for_each_entry(e, bucket, hash_entry) {
+		if (!memcmp(e->id.id, id, DNET_ID_SIZE))
+			return e;
+	}
+
+	return NULL;
+}
+
+/*
+ * Doubles the number of buckets of the shard, failure to grow only makes chains longer
+ */
+static void memory_hash_grow(struct memory_shard *s)
+{
+	struct list_head *old = s->hash;
+	uint64_t old_size = s->hash_size, i;
+	struct memory_entry *e, *tmp;
+
+	s->hash = malloc(old_size * 2 * sizeof(struct list_head));
+	if (!s->hash) {
+		s->hash = old;
+		return;
+	}
+
+	s->hash_size = old_size * 2;
+	for (i = 0; i < s->hash_size; ++i)
+		INIT_LIST_HEAD(&s->hash[i]);
+
+	for (i = 0; i < old_size; ++i) {
+		list_for_each_entry_safe(e, tmp, &old[i], hash_entry) {
+			list_move(&e->hash_entry, memory_bucket(s, e->id.id));
+		}
+	}
+
+	free(old);
+}
+
+static void memory_entry_remove(struct memory_backend *m, struct memory_shard *s, struct memory_entry *e)
+{
+	dnet_hash_tree_update(m->hash_tree, e->id.id, &e->timestamp, NULL);
+
+	list_del(&e->hash_entry);
+	list_del(&e->lru_entry);
+
+	s->used -= e->capacity;
+	s->entries--;
+
+	memory_chunk_free(s, e, e->capacity);
+}
+
+/*
+ * Makes room for @chunk_size bytes in the shard, @keep is never evicted.
+ * Chunk bigger than the shard limit never fits, it fails with -E2BIG.
+ */
+static int memory_shard_make_room(struct memory_backend *m, struct memory_shard *s,
+		uint64_t chunk_size, struct memory_entry *keep)
+{
+	struct memory_entry *e, *tmp;
+	uint64_t kept = keep ? keep->capacity : 0;
+
+	if (!s->limit || s->used - kept + chunk_size <= s->limit)
+		return 0;
+
+	if (chunk_size > s->limit)
+		return -E2BIG;
+
+	if (!m->evict)
+		return -ENOSPC;
+
+	list_for_each_entry_safe_reverse(e, tmp, &s->lru, lru_entry) {
+		if (s->used - kept + chunk_size <= s->limit)
+			break;
+
+		if (e == keep)
+			continue;
+
+		memory_entry_remove(m, s, e);
+		s->evicted++;
+	}
+
+	return 0;
+}
+
+/*
+ * Returns entry of the object which can hold @size bytes of data, creating or growing it if needed.
+ * Data of the existing object is preserved.
+ */
+static struct memory_entry *memory_entry_reserve(struct memory_backend *m, struct memory_shard *s,
+		struct memory_entry *e, const unsigned char *id, uint64_t size, int *errp)
+{
+	uint64_t need = sizeof(struct memory_entry) + size;
+	uint64_t chunk_size;
+	struct memory_entry *n;
+	int err;
+
+	if (e && need <= e->capacity)
+		return e;
+
+	/* Appended objects grow geometrically */
+	if (e && need < e->capacity + e->capacity / 2)
+		need = e->capacity + e->capacity / 2;
+
+	chunk_size = memory_chunk_size(need);
+
+	err = memory_shard_make_room(m, s, chunk_size, e);
+	if (err) {
+		*errp = err;
+		return NULL;
+	}
+
+	n = memory_chunk_alloc(s, chunk_size);
+	if (!n) {
+		*errp = -ENOMEM;
+		return NULL;
+	}
+
+	s->used += chunk_size;
+
+	if (e) {
+		memcpy(n, e, sizeof(struct memory_entry) + e->size);
+		list_replace(&e->hash_entry, &n->hash_entry);
+		list_replace(&e->lru_entry, &n->lru_entry);
+
+		s->used -= e->capacity;
+		memory_chunk_free(s, e, e->capacity);
+	} else {
+		memset(n, 0, sizeof(struct memory_entry));
+		memcpy(n->id.id, id, DNET_ID_SIZE);
+
+		list_add(&n->hash_entry, memory_bucket(s, id));
+		list_add(&n->lru_entry, &s->lru);
+
+		if (++s->entries > s->hash_size)
+			memory_hash_grow(s);
+	}
+
+	n->capacity = chunk_size;
+	return n;
+}
+
+/*
+ * Fills checksum of the object if it is not known yet, must be called with shard lock held
+ */
+static int memory_entry_checksum(struct dnet_node *n, struct memory_entry *e)
+{
+	int err;
+
+	if (e->checksum_valid)
+		return 0;
+
+	if (!e->size) {
+		memset(e->checksum, 0, sizeof(e->checksum));
+	} else {
+		err = dnet_checksum_data(n, e->data, e->size, e->checksum, sizeof(e->checksum));
+		if (err)
+			return err;
+	}
+
+	e->checksum_valid = 1;
+	return 0;
+}
+
+static int memory_write(struct memory_backend *m, void *state, struct dnet_cmd *cmd, void *data)
+{
+	struct dnet_io_attr *io = data;
+	struct memory_shard *s;
+	struct memory_entry *e;
+	uint64_t offset, old_size, new_size, reserve;
+	int err, exists;
+
+	dnet_convert_io_attr(io);
+	data += sizeof(struct dnet_io_attr);
+
+	if (io->flags & DNET_IO_FLAGS_COMPRESS)
+		return -ENOTSUP;
+
+	s = memory_shard(m, io->id);
+
+	pthread_mutex_lock(&s->lock);
+
+	e = memory_search(s, io->id);
+	exists = !!e;
+	old_size = e ? e->size : 0;
+
+	offset = io->offset;
+	if (io->flags & DNET_IO_FLAGS_APPEND)
+		offset = old_size;
+
+	/* Like file backend, write from the beginning replaces the object unless it is a part of prepared one */
+	new_size = offset + io->size;
+	if ((offset || (io->flags & DNET_IO_FLAGS_PLAIN_WRITE)) && new_size < old_size)
+		new_size = old_size;
+
+	if ((io->flags & DNET_IO_FLAGS_COMMIT) && (io->flags & DNET_IO_FLAGS_PLAIN_WRITE))
+		new_size = io->num;
+
+	reserve = new_size;
+	if ((io->flags & DNET_IO_FLAGS_PREPARE) && reserve < io->num)
+		reserve = io->num;
+	if (reserve < offset + io->size)
+		reserve = offset + io->size;
+
+	e = memory_entry_reserve(m, s, e, io->id, reserve, &err);
+	if (!e) {
+		dnet_backend_log(DNET_LOG_ERROR, "%s: MEMORY: write: offset: %llu, size: %llu: %s %d\n",
+				dnet_dump_id_str(io->id), (unsigned long long)offset,
+				(unsigned long long)io->size, strerror(-err), err);
+		goto err_out_unlock;
+	}
+
+	/* Gaps are filled with zeroes */
+	if (offset > old_size)
+		memset(e->data + old_size, 0, offset - old_size);
+	if (new_size > offset + io->size && new_size > old_size) {
+		uint64_t start = offset + io->size > old_size ? offset + io->size : old_size;
+		memset(e->data + start, 0, new_size - start);
+	}
+
+	memcpy(e->data + offset, data, io->size);
+
+	dnet_hash_tree_update(m->hash_tree, io->id, exists ? &e->timestamp : NULL, &io->timestamp);
+
+	e->size = new_size;
+	e->timestamp = io->timestamp;
+	e->user_flags = io->user_flags;
+	list_move(&e->lru_entry, &s->lru);
+
+	/*
+	 * Checksum of the whole object is computed here while its data is hot in cache,
+	 * partial writes leave it to the first read or CAS, so appends do not rehash the object every time.
+	 */
+	e->checksum_valid = 0;
+	if (!offset && new_size == io->size && !(io->flags & DNET_IO_FLAGS_NOCSUM))
+		memory_entry_checksum(dnet_get_node_from_state(state), e);
+
+	dnet_backend_log(DNET_LOG_NOTICE, "%s: MEMORY: write: Ok: offset: %llu, size: %llu, object-size: %llu.\n",
+			dnet_dump_id_str(io->id), (unsigned long long)offset,
+			(unsigned long long)io->size, (unsigned long long)e->size);
+
+	if (io->flags & DNET_IO_FLAGS_WRITE_NO_FILE_INFO) {
+		cmd->flags |= DNET_FLAGS_NEED_ACK;
+		err = 0;
+		goto err_out_unlock;
+	}
+
+	err = dnet_send_file_info_ts_without_fd(state, cmd, e->data, e->size, &e->timestamp);
+
+err_out_unlock:
+	pthread_mutex_unlock(&s->lock);
+	return err;
+}
+
+/*
+ * Sends object's data, must be called with shard lock held, data is copied into the reply
+ */
+static int memory_send(struct memory_shard *s, void *state, struct dnet_cmd *cmd, struct dnet_io_attr *io)
+{
+	struct memory_entry *e;
+	int64_t size;
+	int on_exit = 0;
+
+	e = memory_search(s, io->id);
+	if (!e)
+		return -ENOENT;
+
+	size = dnet_backend_check_get_size(io, e->size);
+	if (size < 0)
+		return size;
+
+	list_move(&e->lru_entry, &s->lru);
+
+	io->total_size = e->size;
+	io->size = size;
+	io->timestamp = e->timestamp;
+	io->user_flags = e->user_flags;
+
+	if ((io->flags & DNET_IO_FLAGS_CHECKSUM) && !io->offset && io->size == e->size &&
+			!memory_entry_checksum(dnet_get_node_from_state(state), e)) {
+		memcpy(io->parent, e->checksum, DNET_ID_SIZE);
+		on_exit = DNET_IO_REQ_FLAGS_CHECKSUM_READY;
+	}
+
+	return dnet_send_read_data(state, cmd, io, e->data + io->offset, -1, io->offset, on_exit);
+}
+
+static int memory_read(struct memory_backend *m, void *state, struct dnet_cmd *cmd, void *data)
+{
+	struct dnet_io_attr *io = data;
+	struct memory_shard *s;
+	int err;
+
+	dnet_convert_io_attr(io);
+
+	s = memory_shard(m, io->id);
+
+	pthread_mutex_lock(&s->lock);
+	err = memory_send(s, state, cmd, io);
+	pthread_mutex_unlock(&s->lock);
+
+	if (err)
+		dnet_backend_log(err == -ENOENT ? DNET_LOG_NOTICE : DNET_LOG_ERROR,
+				"%s: MEMORY: read: offset: %llu, size: %llu: %s %d\n",
+				dnet_dump_id_str(io->id), (unsigned long long)io->offset,
+				(unsigned long long)io->size, strerror(-err), err);
+
+	return err;
+}
+
+/*
+ * Every object is sent as a separate READ reply, failed ones as an empty reply with error status
+ */
+static int memory_bulk_read(struct memory_backend *m, void *state, struct dnet_cmd *cmd, void *data)
+{
+	struct dnet_io_attr *io = data;
+	struct dnet_io_attr *ios = io + 1;
+	struct memory_shard *s;
+	struct dnet_cmd read_cmd;
+	uint64_t count, sent = 0, i;
+	int err = 0, ret;
+
+	dnet_convert_io_attr(io);
+	count = io->size / sizeof(struct dnet_io_attr);
+
+	if (!count || cmd->size < sizeof(struct dnet_io_attr) * (count + 1))
+		return -EINVAL;
+
+	read_cmd = *cmd;
+	read_cmd.cmd = DNET_CMD_READ;
+	read_cmd.size = sizeof(struct dnet_io_attr);
+	read_cmd.flags |= DNET_FLAGS_MORE;
+	read_cmd.flags &= ~DNET_FLAGS_NEED_ACK;
+
+	for (i = 0; i < count; ++i) {
+		dnet_convert_io_attr(&ios[i]);
+
+		s = memory_shard(m, ios[i].id);
+
+		pthread_mutex_lock(&s->lock);
+		ret = memory_send(s, state, &read_cmd, &ios[i]);
+		pthread_mutex_unlock(&s->lock);
+
+		if (!ret) {
+			sent++;
+			continue;
+		}
+
+		read_cmd.status = ret;
+		dnet_send_reply(state, &read_cmd, NULL, 0, 1);
+		read_cmd.status = 0;
+
+		if (!err)
+			err = ret;
+	}
+
+	return sent ? 0 : err;
+}
+
+static int memory_lookup(struct memory_backend *m, void *state, struct dnet_cmd *cmd)
+{
+	struct memory_shard *s = memory_shard(m, cmd->id.id);
+	struct memory_entry *e;
+	int err;
+
+	pthread_mutex_lock(&s->lock);
+
+	e = memory_search(s, cmd->id.id);
+	if (!e) {
+		err = -ENOENT;
+		goto err_out_unlock;
+	}
+
+	err = dnet_send_file_info_ts_without_fd(state, cmd, e->data, e->size, &e->timestamp);
+
+err_out_unlock:
+	pthread_mutex_unlock(&s->lock);
+	return err;
+}
+
+static int memory_del(struct memory_backend *m, struct dnet_cmd *cmd)
+{
+	struct memory_shard *s = memory_shard(m, cmd->id.id);
+	struct memory_entry *e;
+	int err = -ENOENT;
+
+	pthread_mutex_lock(&s->lock);
+
+	e = memory_search(s, cmd->id.id);
+	if (e) {
+		memory_entry_remove(m, s, e);
+		err = 0;
+	}
+
+	pthread_mutex_unlock(&s->lock);
+	return err;
+}
+
+static int memory_backend_command_handler(void *state, void *priv, struct dnet_cmd *cmd, void *data)
+{
+	struct memory_backend *m = priv;
+	int err;
+
+	switch (cmd->cmd) {
+		case DNET_CMD_LOOKUP:
+			err = memory_lookup(m, state, cmd);
+			break;
+		case DNET_CMD_WRITE:
+			err = memory_write(m, state, cmd, data);
+			break;
+		case DNET_CMD_READ:
+			err = memory_read(m, state, cmd, data);
+			break;
+		case DNET_CMD_BULK_READ:
+			err = memory_bulk_read(m, state, cmd, data);
+			break;
+		case DNET_CMD_STAT:
+			err = backend_stat(state, NULL, cmd);
+			break;
+		case DNET_CMD_DEL:
+			err = memory_del(m, cmd);
+			break;
+		default:
+			err = -ENOTSUP;
+			break;
+	}
+
+	return err;
+}
+
+static int memory_backend_checksum(struct dnet_node *n, void *priv, struct dnet_id *id, void *csum, int *csize)
+{
+	struct memory_backend *m = priv;
+	struct memory_shard *s = memory_shard(m, id->id);
+	struct memory_entry *e;
+	int err = 0;
+
+	pthread_mutex_lock(&s->lock);
+
+	e = memory_search(s, id->id);
+	if (!e)
+		err = -ENOENT;
+	else
+		err = memory_entry_checksum(n, e);
+
+	if (!err)
+		memcpy(csum, e->checksum, *csize < DNET_ID_SIZE ? *csize : DNET_ID_SIZE);
+
+	pthread_mutex_unlock(&s->lock);
+	return err;
+}
+
+/*
+ * Objects are copied one by one, so callback runs without shard lock held
+ * and concurrent requests are not blocked. Objects written during iteration may be missed.
+ */
+static int memory_iterate_shard(struct memory_shard *s, struct dnet_iterator_ctl *ictl)
+{
+	struct dnet_raw_id *ids;
+	struct memory_entry *e;
+	struct dnet_ext_list elist;
+	uint64_t count = 0, i, dsize, size = 0;
+	void *data = NULL, *tmp;
+	int err = 0;
+
+	pthread_mutex_lock(&s->lock);
+	ids = malloc((s->entries + 1) * sizeof(struct dnet_raw_id));
+	if (ids) {
+		list_for_each_entry(e, &s->lru, lru_entry) {
+			ids[count++] = e->id;
+		}
+	}
+	pthread_mutex_unlock(&s->lock);
+
+	if (!ids)
+		return -ENOMEM;
+
+	for (i = 0; i < count; ++i) {
+		pthread_mutex_lock(&s->lock);
+
+		e = memory_search(s, ids[i].id);
+		if (!e) {
+			pthread_mutex_unlock(&s->lock);
+			continue;
+		}
+
+		if (e->size > size) {
+			tmp = realloc(data, e->size);
+			if (!tmp) {
+				pthread_mutex_unlock(&s->lock);
+				err = -ENOMEM;
+				break;
+			}
+
+			data = tmp;
+			size = e->size;
+		}
+
+		dnet_ext_list_init(&elist);
+		elist.timestamp = e->timestamp;
+		elist.flags = e->user_flags;
+
+		dsize = e->size;
+		memcpy(data, e->data, dsize);
+
+		pthread_mutex_unlock(&s->lock);
+
+		err = ictl->callback(ictl->callback_private, &ids[i], data, dsize, &elist);
+		dnet_ext_list_destroy(&elist);
+		if (err)
+			break;
+	}
+
+	free(data);
+	free(ids);
+	return err;
+}
+
+/*
+ * Iterator position is the shard number, resumed iteration starts the shard from the beginning
+ */
+static int memory_backend_iterator(struct dnet_iterator_ctl *ictl)
+{
+	struct memory_backend *m = ictl->iterate_private;
+	struct dnet_iterator_position position;
+	int i, err = 0;
+
+	for (i = 0; i < m->shards_number; ++i) {
+		if ((uint64_t)i < ictl->position.pos[0])
+			continue;
+
+		if (ictl->checkpoint) {
+			memset(&position, 0, sizeof(struct dnet_iterator_position));
+			position.pos[0] = i;
+
+			err = ictl->checkpoint(ictl->callback_private, &position);
+			if (err)
+				break;
+		}
+
+		err = memory_iterate_shard(&m->shards[i], ictl);
+		if (err)
+			break;
+	}
+
+	return err;
+}
+
+static int memory_backend_storage_stat(void *priv, struct dnet_stat *st)
+{
+	struct memory_backend *m = priv;
+	struct memory_shard *s;
+	int err, i;
+
+	memset(st, 0, sizeof(struct dnet_stat));
+
+	err = backend_stat_low_level(".", st);
+	if (err)
+		return err;
+
+	for (i = 0; i < m->shards_number; ++i) {
+		s = &m->shards[i];
+
+		pthread_mutex_lock(&s->lock);
+		st->node_files += s->entries;
+		st->node_files_removed += s->evicted;
+		pthread_mutex_unlock(&s->lock);
+	}
+
+	return 0;
+}
+
+static void memory_shard_cleanup(struct memory_shard *s)
+{
+	struct memory_entry *e, *tmp;
+
+	/* Page is released together with its last chunk */
+	list_for_each_entry_safe(e, tmp, &s->lru, lru_entry)
+		memory_chunk_free(s, e, e->capacity);
+
+	free(s->hash);
+	pthread_mutex_destroy(&s->lock);
+}
+
+static void memory_backend_cleanup(void *priv)
+{
+	struct memory_backend *m = priv;
+	int i;
+
+	if (!m->shards)
+		return;
+
+	for (i = 0; i < m->shards_number; ++i)
+		memory_shard_cleanup(&m->shards[i]);
+
+	free(m->shards);
+	m->shards = NULL;
+
+	dnet_hash_tree_destroy(m->hash_tree);
+	m->hash_tree = NULL;
+}
+
+static int memory_shard_init(struct memory_shard *s, uint64_t limit)
+{
+	uint64_t i;
+	int err;
+
+	memset(s, 0, sizeof(struct memory_shard));
+
+	s->hash_size = MEMORY_INITIAL_HASH_SIZE;
+	s->hash = malloc(s->hash_size * sizeof(struct list_head));
+	if (!s->hash)
+		return -ENOMEM;
+
+	for (i = 0; i < s->hash_size; ++i)
+		INIT_LIST_HEAD(&s->hash[i]);
+
+	INIT_LIST_HEAD(&s->lru);
+	s->limit = limit;
+
+	for (i = 0; i < MEMORY_SLAB_CLASSES; ++i)
+		INIT_LIST_HEAD(&s->partial_pages[i]);
+
+	err = pthread_mutex_init(&s->lock, NULL);
+	if (err) {
+		free(s->hash);
+		return -err;
+	}
+
+	return 0;
+}
+
+static int dnet_memory_set_shards(struct dnet_config_backend *b, char *key __unused, char *value)
+{
+	struct memory_backend *m = b->data;
+
+	m->shards_number = atoi(value);
+	return 0;
+}
+
+static int dnet_memory_set_limit(struct dnet_config_backend *b, char *key __unused, char *value)
+{
+	struct memory_backend *m = b->data;
+	uint64_t val = strtoull(value, NULL, 0);
+
+	if (strchr(value, 'T'))
+		val *= 1024*1024*1024*1024ULL;
+	else if (strchr(value, 'G'))
+		val *= 1024*1024*1024ULL;
+	else if (strchr(value, 'M'))
+		val *= 1024*1024;
+	else if (strchr(value, 'K'))
+		val *= 1024;
+
+	m->limit = val;
+	return 0;
+}
+
+static int dnet_memory_set_evict(struct dnet_config_backend *b, char *key __unused, char *value)
+{
+	struct memory_backend *m = b->data;
+
+	m->evict = atoi(value);
+	return 0;
+}
+
+/*
+ * Negative depth disables hash tree
+ */
+static int dnet_memory_set_hash_tree_depth(struct dnet_config_backend *b, char *key __unused, char *value)
+{
+	struct memory_backend *m = b->data;
+
+	m->hash_tree_depth = atoi(value);
+	return 0;
+}
+
+static int dnet_memory_config_init(struct dnet_config_backend *b, struct dnet_config *c)
+{
+	struct memory_backend *m = b->data;
+	int err, i;
+
+	if (m->shards_number <= 0)
+		m->shards_number = MEMORY_DEFAULT_SHARDS;
+	if (!m->hash_tree_depth)
+		m->hash_tree_depth = DNET_HASH_TREE_DEFAULT_DEPTH;
+
+	if (m->hash_tree_depth > 0) {
+		m->hash_tree = dnet_hash_tree_create(m->hash_tree_depth);
+		if (!m->hash_tree) {
+			dnet_backend_log(DNET_LOG_ERROR, "MEMORY: failed to create hash tree of depth %d\n",
+					m->hash_tree_depth);
+			err = -EINVAL;
+			goto err_out_exit;
+		}
+	}
+
+	m->shards = malloc(m->shards_number * sizeof(struct memory_shard));
+	if (!m->shards) {
+		err = -ENOMEM;
+		goto err_out_free_tree;
+	}
+
+	for (i = 0; i < m->shards_number; ++i) {
+		err = memory_shard_init(&m->shards[i], m->limit / m->shards_number);
+		if (err) {
+			dnet_backend_log(DNET_LOG_ERROR, "MEMORY: failed to initialize shard %d: %s %d\n",
+					i, strerror(-err), err);
+			goto err_out_cleanup;
+		}
+	}
+
+	b->storage_size = m->limit;
+	b->storage_free = m->limit;
+
+	c->cb = &b->cb;
+	c->storage_size = b->storage_size;
+	c->storage_free = b->storage_free;
+
+	b->cb.command_private = m;
+	b->cb.command_handler = memory_backend_command_handler;
+	b->cb.checksum = memory_backend_checksum;
+	b->cb.storage_stat = memory_backend_storage_stat;
+	b->cb.backend_cleanup = memory_backend_cleanup;
+	b->cb.iterator = memory_backend_iterator;
+	b->cb.hash_tree = m->hash_tree;
+
+	dnet_backend_log(DNET_LOG_INFO, "MEMORY: initialized: shards: %d, limit: %llu, evict: %d, hash tree depth: %d\n",
+			m->shards_number, (unsigned long long)m->limit, m->evict, m->hash_tree_depth);
+
+	return 0;
+
+err_out_cleanup:
+	while (--i >= 0)
+		memory_shard_cleanup(&m->shards[i]);
+	free(m->shards);
+	m->shards = NULL;
+err_out_free_tree:
+	dnet_hash_tree_destroy(m->hash_tree);
+	m->hash_tree = NULL;
+err_out_exit:
+	return err;
+}
+
+static void dnet_memory_config_cleanup(struct dnet_config_backend *b)
+{
+	struct memory_backend *m = b->data;
+
+	memory_backend_cleanup(m);
+}
+
+static struct dnet_config_entry dnet_cfg_entries_memory[] = {
+	{"shards", dnet_memory_set_shards},
+	{"memory_limit", dnet_memory_set_limit},
+	{"evict", dnet_memory_set_evict},
+	{"hash_tree_depth", dnet_memory_set_hash_tree_depth},
+};
+
+static struct dnet_config_backend dnet_memory_backend = {
+	.name			= "memory",
+	.ent			= dnet_cfg_entries_memory,
+	.num			= ARRAY_SIZE(dnet_cfg_entries_memory),
+	.size			= sizeof(struct memory_backend),
+	.init			= dnet_memory_config_init,
+	.cleanup		= dnet_memory_config_cleanup,
+};
+
+int dnet_memory_backend_init(void)
+{
+	return dnet_backend_register(&dnet_memory_backend);
+}
+
+void dnet_memory_backend_exit(void)
+{
+	/* cleanup routing will be called explicitly through backend->cleanup() callback */
+}
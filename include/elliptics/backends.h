@@ -141,6 +141,12 @@ void dnet_module_backend_exit(void);
 int dnet_eblob_backend_init(void);
 void dnet_eblob_backend_exit(void);
 
+int dnet_memory_backend_init(void);
+void dnet_memory_backend_exit(void);
+
+int dnet_logstore_backend_init(void);
+void dnet_logstore_backend_exit(void);
+
 int backend_storage_size(struct dnet_config_backend *b, const char *root);
 
 int dnet_backend_check_log_level(int level);
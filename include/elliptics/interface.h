@@ -163,6 +163,12 @@ int dnet_search_range(struct dnet_node *n, struct dnet_id *id,
 #define DNET_IO_REQ_FLAGS_CLOSE			(1<<0)	/* close fd */
 #define DNET_IO_REQ_FLAGS_CACHE_FORGET		(1<<1)	/* try to remove read data from page cache using fadvice */
 
+/*
+ * Passed to dnet_send_read_data() when backend has already put checksum of the sent data
+ * into io->parent (stored at write time), so it is not computed again
+ */
+#define DNET_IO_REQ_FLAGS_CHECKSUM_READY	(1<<2)
+
 int __attribute__((weak)) dnet_send_read_data(void *state, struct dnet_cmd *cmd, struct dnet_io_attr *io,
 		void *data, int fd, uint64_t offset, int on_exit);
 
@@ -224,6 +230,10 @@ enum dnet_log_level {
 #define DNET_CFG_RANDOMIZE_STATES	(1<<5)		/* randomize states for read requests */
 #define DNET_CFG_KEEPS_IDS_IN_CLUSTER	(1<<6)		/* keeps ids in elliptics cluster */
 
+/* cfg->cache_admission */
+#define DNET_CACHE_ADMISSION_ALL	0		/* every object read from the disk is put into the cache */
+#define DNET_CACHE_ADMISSION_TINYLFU	1		/* only objects more popular than evicted ones are put into the cache */
+
 struct dnet_log {
 	/*
 	 * Logging parameters.
@@ -244,6 +254,21 @@ struct dnet_iterator_ctl {
 	void				*callback_private;
 	int				(* callback)(void *priv, struct dnet_raw_id *key,
 			void *data, uint64_t dsize, struct dnet_ext_list *elist);
+	/*
+	 * Optional, may be NULL. Backend which keeps object in a file may pass
+	 * location of its data instead of reading it, data will be sent with sendfile().
+	 * Callback takes ownership of @fd and closes it when data is sent.
+	 */
+	int				(* fd_callback)(void *priv, struct dnet_raw_id *key,
+			int fd, uint64_t offset, uint64_t dsize, struct dnet_ext_list *elist);
+	/*
+	 * Optional, may be NULL. Backend which can resume iteration reports positions
+	 * where all records before them have been passed to the callbacks.
+	 * Iteration started with such @position continues after those records,
+	 * backend which does not report positions ignores @position.
+	 */
+	int				(* checkpoint)(void *priv, struct dnet_iterator_position *position);
+	struct dnet_iterator_position	position;
 };
 
 /*
@@ -256,6 +281,24 @@ int dnet_iterator_response_container_read(int fd, uint64_t pos,
 		struct dnet_iterator_response *response);
 int64_t dnet_iterator_response_container_diff(int diff_fd, int left_fd, uint64_t left_size,
 		int right_fd, uint64_t right_size);
+int dnet_iterator_response_container_merge_sort(int fd, uint64_t size, int out_fd,
+		int (* progress)(void *priv), void *priv);
+
+/*
+ * Hash tree of the stored keys, see struct dnet_hash_tree_request.
+ * Backend updates it on every change of the key: @old_ts is NULL for the new key,
+ * @new_ts is NULL for the removed one. Updates are lock-free and may run concurrently.
+ */
+#define DNET_HASH_TREE_DEFAULT_DEPTH	16
+#define DNET_HASH_TREE_MAX_DEPTH	24
+
+struct dnet_hash_tree;
+
+struct dnet_hash_tree *dnet_hash_tree_create(int depth);
+void dnet_hash_tree_destroy(struct dnet_hash_tree *tree);
+uint64_t dnet_hash_tree_key(const unsigned char *id, const struct dnet_time *ts);
+void dnet_hash_tree_update(struct dnet_hash_tree *tree, const unsigned char *id,
+		const struct dnet_time *old_ts, const struct dnet_time *new_ts);
 
 struct dnet_backend_callbacks {
 	/* command handler processes DNET_CMD_* commands */
@@ -287,6 +330,24 @@ struct dnet_backend_callbacks {
 	 * Returns dir used by backend
 	 */
 	char *			(* dir)(void);
+
+	/*
+	 * Flushes data written with DNET_IO_FLAGS_NOSYNC to the disk.
+	 * May be NULL if backend syncs data by itself.
+	 */
+	int			(* sync)(void *priv);
+
+	/*
+	 * Returns backend specific statistics as json object in malloc'ed string,
+	 * which is reported by the monitor and freed by the caller. May be NULL.
+	 */
+	char *			(* stat_json)(void *priv);
+
+	/*
+	 * Hash tree of the stored keys maintained by backend,
+	 * NULL if backend does not support it.
+	 */
+	struct dnet_hash_tree	*hash_tree;
 };
 
 /*
@@ -410,6 +471,44 @@ struct dnet_config
 	/* Cache pages proportions */
 	unsigned int*	cache_pages_proportions;
 
+	/* Back cache memory with hugepages */
+	int			cache_hugepages;
+
+	/*
+	 * Cache content is saved into this file on shutdown and every
+	 * cache_snapshot_interval seconds and is loaded back on start
+	 */
+	char			cache_snapshot[1024];
+	int			cache_snapshot_interval;
+
+	/* Which objects read from the disk are put into the cache, DNET_CACHE_ADMISSION_* */
+	int			cache_admission;
+
+	/* If not zero, ranged reads cache chunks of this size instead of whole objects */
+	unsigned int		cache_chunk_size;
+
+	/* Maximum number of caches writing dirty objects back to the disk simultaneously */
+	int			cache_sync_concurrency;
+
+	/*
+	 * Ids not found by the backend are remembered for cache_negative_ttl milliseconds,
+	 * at most cache_negative_size of them, repeated reads and lookups of them are answered by the cache
+	 */
+	unsigned int		cache_negative_size;
+	unsigned int		cache_negative_ttl;
+
+	/*
+	 * If not zero, capacity is moved between the last cache page and the others
+	 * according to hits of recently evicted objects instead of fixed cache_pages_proportions
+	 */
+	int			cache_adaptive;
+
+	/*
+	 * If not zero, accesses of one of cache_mrc_sampling ids are tracked
+	 * to estimate hit ratio of bigger and smaller caches, it is reported in cache statistics
+	 */
+	unsigned int		cache_mrc_sampling;
+
 	/*
 	 * Monitor socket port
 	 */
@@ -802,6 +901,10 @@ int dnet_fill_addr(struct dnet_addr *addr, const char *saddr, const int port, co
 /* Change node status on given address or ID */
 int dnet_update_status(struct dnet_session *s, struct dnet_addr *addr, struct dnet_id *id, struct dnet_node_status *status);
 
+/* Change node status and cache settings, both structures are filled with current values on return */
+int dnet_update_cache(struct dnet_session *s, struct dnet_addr *addr, struct dnet_id *id,
+		struct dnet_node_status *status, struct dnet_cache_control *cache);
+
 /*
  * Remove object by @id
  * If callback is provided, it will be invoked on completion, otherwise
@@ -835,6 +938,14 @@ int __attribute__((weak)) dnet_transform_node(struct dnet_node *n, const void *s
 		unsigned char *csum, int csize);
 int dnet_transform_raw(struct dnet_session *s, const void *src, uint64_t size, char *csum, unsigned int csize);
 
+/*
+ * Transforms @num buffers at once, id of @src[i] of @size[i] bytes is written to @ids[i].
+ * Multi-buffer hashing is used when it is supported, so it is much faster
+ * than transforming large number of keys one by one.
+ */
+int dnet_transform_batch(struct dnet_session *s, const void * const *src, const uint64_t *size, int num,
+		struct dnet_raw_id *ids);
+
 /*
  * Transformation implementation, currently it's sha512 hash.
  * It calculates checksum for @src of @size and writes it to @id.
@@ -845,6 +956,11 @@ int dnet_digest_transform(const void *src, uint64_t size, struct dnet_id *id);
  * Writes most of @csum_size bytes to @csum.
  */
 int dnet_digest_transform_raw(const void *src, uint64_t size, void *csum, int csum_size);
+/*
+ * Batch version of @dnet_digest_transform_raw.
+ * Hashes @num buffers, @csum_size bytes of result for @src[i] are written to @csum + i * @csum_size.
+ */
+int dnet_digest_transform_batch_raw(const void * const *src, const uint64_t *size, int num, void *csum, int csum_size);
 
 /*
  * Calculates message autherization code based on digest_transformation.
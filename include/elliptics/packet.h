@@ -65,6 +65,7 @@ enum dnet_commands {
 	DNET_CMD_INDEXES_UPDATE,		/* Update secondary indexes for id */
 	DNET_CMD_INDEXES_INTERNAL,		/* Update identificators table for certain secondary index. Internal usage only */
 	DNET_CMD_INDEXES_FIND,		/* Find all objects by indexes */
+	DNET_CMD_HASH_TREE,			/* Read level of the hash tree of stored keys */
 	DNET_CMD_UNKNOWN,			/* This slot is allocated for statistics gathered for unknown commands */
 	__DNET_CMD_MAX,
 };
@@ -343,6 +344,14 @@ static inline void dnet_convert_list(struct dnet_list *l)
  */
 #define DNET_IO_FLAGS_WRITE_NO_FILE_INFO	(1<<14)
 
+/*
+ * DNET_IO_FLAGS_NOSYNC
+ *
+ * Backend may skip syncing written data to the disk,
+ * caller syncs the whole batch of writes via backend sync callback.
+ */
+#define DNET_IO_FLAGS_NOSYNC		(1<<15)
+
 /*
  * DNET_INDEXES_FLAGS_INTERSECT
  *
@@ -763,6 +772,24 @@ static inline void dnet_convert_node_status(struct dnet_node_status *st)
 	st->log_level = dnet_bswap32(st->log_level);
 }
 
+/*
+ * Optional cache control sent after dnet_node_status in DNET_CMD_STATUS,
+ * reply contains both structures with current cache settings
+ */
+struct dnet_cache_control {
+	uint64_t		size;		/* new cache size in bytes split between the existing shards, 0 keeps current one */
+	int			adaptive;	/* 1 - adaptive page proportions, 0 - fixed ones, -1 keeps current mode */
+	uint32_t		pages_number;	/* filled in reply */
+	uint64_t		reserved[4];
+} __attribute__ ((packed));
+
+static inline void dnet_convert_cache_control(struct dnet_cache_control *ctl)
+{
+	ctl->size = dnet_bswap64(ctl->size);
+	ctl->adaptive = dnet_bswap32(ctl->adaptive);
+	ctl->pages_number = dnet_bswap32(ctl->pages_number);
+}
+
 #define DNET_AUTH_COOKIE_SIZE	32
 
 struct dnet_auth {
@@ -833,17 +860,49 @@ enum {
 #define DNET_IFLAGS_KEY_RANGE		(1<<1)
 /* When set timestamp range is used */
 #define DNET_IFLAGS_TS_RANGE		(1<<2)
+/*
+ * When set network iterator packs many responses into one reply,
+ * see struct dnet_iterator_batch
+ */
+#define DNET_IFLAGS_BATCH		(1<<3)
+/*
+ * When set ranges are followed by struct dnet_iterator_predicate,
+ * only records which match all its terms are sent
+ */
+#define DNET_IFLAGS_PREDICATE		(1<<4)
+/*
+ * When set responses contain only fields set in request's @fields,
+ * see dnet_iterator_response_pack(). Data size is needed to find the data,
+ * so DNET_IFIELD_SIZE is always sent together with DNET_IFLAGS_DATA.
+ */
+#define DNET_IFLAGS_PROJECTION		(1<<5)
+/*
+ * When set network iterator periodically sends checkpoint responses,
+ * see DNET_ITERATOR_STATUS_CHECKPOINT
+ */
+#define DNET_IFLAGS_CHECKPOINT		(1<<6)
 /* Sanity */
 #define DNET_IFLAGS_ALL			(DNET_IFLAGS_DATA	\
-		| DNET_IFLAGS_KEY_RANGE | DNET_IFLAGS_TS_RANGE)
+		| DNET_IFLAGS_KEY_RANGE | DNET_IFLAGS_TS_RANGE	\
+		| DNET_IFLAGS_BATCH | DNET_IFLAGS_PREDICATE	\
+		| DNET_IFLAGS_PROJECTION | DNET_IFLAGS_CHECKPOINT)
+
+/* Fields of the iterator response used by predicate terms and projection */
+#define DNET_IFIELD_KEY			(1<<0)
+#define DNET_IFIELD_TIMESTAMP		(1<<1)
+#define DNET_IFIELD_USER_FLAGS		(1<<2)
+#define DNET_IFIELD_SIZE		(1<<3)
+#define DNET_IFIELD_ALL			(DNET_IFIELD_KEY	\
+		| DNET_IFIELD_TIMESTAMP | DNET_IFIELD_USER_FLAGS	\
+		| DNET_IFIELD_SIZE)
 
 enum dnet_iterator_types {
 	DNET_ITYPE_FIRST,		/* Sanity */
 	DNET_ITYPE_DISK,		/*
-					 * Iterator saves data chunks
-					 * (index/metadata + (optionally) data)
-					 * locally on server to $root/iter/$id
-					 * instead of sending chunks to client
+					 * Iterator saves responses sorted by key
+					 * locally on server to $history/iter/$id
+					 * instead of sending them to client,
+					 * data is not supported
 					 */
 	DNET_ITYPE_NETWORK,		/* iterator sends data chunks to client */
 	DNET_ITYPE_LAST,		/* Sanity */
@@ -856,6 +915,9 @@ enum dnet_iterator_action {
 	DNET_ITERATOR_ACTION_PAUSE,	/* Pause iterator */
 	DNET_ITERATOR_ACTION_CONTINUE,	/* Continue previously paused iterator */
 	DNET_ITERATOR_ACTION_CANCEL,	/* Cancel running or paused iterator */
+	DNET_ITERATOR_ACTION_READ,	/* Read result of disk iterator, optionally by key ranges */
+	DNET_ITERATOR_ACTION_REMOVE,	/* Remove result of disk iterator */
+	DNET_ITERATOR_ACTION_RESUME,	/* Start iterator from checkpoint token */
 	DNET_ITERATOR_ACTION_LAST,	/* Sanity */
 };
 
@@ -877,12 +939,14 @@ struct dnet_iterator_request
 	struct dnet_time		time_end;	/* End time */
 	uint32_t			itype;		/* Callback to use: Net/File, XXX: enum */
 	uint64_t			flags;		/* DNET_IFLAGS_* */
-	uint64_t			reserved[5];
+	uint64_t			fields;		/* DNET_IFIELD_* to send if DNET_IFLAGS_PROJECTION is set */
+	uint64_t			reserved[4];
 } __attribute__ ((packed));
 
 static inline void dnet_convert_iterator_request(struct dnet_iterator_request *r)
 {
 	r->flags = dnet_bswap64(r->flags);
+	r->fields = dnet_bswap64(r->fields);
 	r->id = dnet_bswap64(r->id);
 	r->itype = dnet_bswap32(r->itype);
 	r->action = dnet_bswap32(r->action);
@@ -891,6 +955,60 @@ static inline void dnet_convert_iterator_request(struct dnet_iterator_request *r
 	dnet_convert_time(&r->time_end);
 }
 
+/* Operations of the iterator predicate terms */
+enum dnet_iterator_predicate_op {
+	DNET_IOP_FIRST,			/* Sanity */
+	DNET_IOP_EQ,			/* Field is equal to the value */
+	DNET_IOP_NE,			/* Field is not equal to the value */
+	DNET_IOP_LT,			/* Field is less than the value */
+	DNET_IOP_LE,			/* Field is less than or equal to the value */
+	DNET_IOP_GT,			/* Field is greater than the value */
+	DNET_IOP_GE,			/* Field is greater than or equal to the value */
+	DNET_IOP_ALL,			/* All bits of the value are set in user flags */
+	DNET_IOP_ANY,			/* Any bit of the value is set in user flags */
+	DNET_IOP_NONE,			/* No bits of the value are set in user flags */
+	DNET_IOP_PREFIX,		/* First @value bits of key are equal to the term's key */
+	DNET_IOP_LAST,			/* Sanity */
+};
+
+/*
+ * Term of the iterator predicate: @field is compared with @value,
+ * @time or @key depending on the field
+ */
+struct dnet_iterator_predicate_term
+{
+	uint32_t			field;		/* One of DNET_IFIELD_* */
+	uint32_t			op;		/* One of DNET_IOP_* */
+	uint64_t			value;		/* Size, user flags or key prefix length in bits */
+	struct dnet_time		time;		/* Timestamp */
+	struct dnet_raw_id		key;		/* Key prefix */
+	uint64_t			reserved[2];
+} __attribute__ ((packed));
+
+static inline void dnet_convert_iterator_predicate_term(struct dnet_iterator_predicate_term *t)
+{
+	t->field = dnet_bswap32(t->field);
+	t->op = dnet_bswap32(t->op);
+	t->value = dnet_bswap64(t->value);
+	dnet_convert_time(&t->time);
+}
+
+/*
+ * Iterator predicate, it follows ranges in the request.
+ * Record matches predicate if it matches all @num terms.
+ */
+struct dnet_iterator_predicate
+{
+	uint64_t			num;		/* Number of terms */
+	uint64_t			reserved[3];
+	struct dnet_iterator_predicate_term	terms[0];
+} __attribute__ ((packed));
+
+static inline void dnet_convert_iterator_predicate(struct dnet_iterator_predicate *p)
+{
+	p->num = dnet_bswap64(p->num);
+}
+
 /*
  * Iterator response
  * TODO: Maybe it's better to include whole ehdr in response
@@ -913,6 +1031,134 @@ static inline void dnet_convert_iterator_response(struct dnet_iterator_response
 	dnet_convert_time(&r->timestamp);
 }
 
+/*
+ * Opaque backend-specific position of the iterator, zeroed position is the beginning
+ */
+struct dnet_iterator_position
+{
+	uint64_t			pos[4];
+} __attribute__ ((packed));
+
+/*
+ * Checkpoint of the iterator.
+ *
+ * Iterator started with DNET_IFLAGS_CHECKPOINT periodically sends response
+ * with DNET_ITERATOR_STATUS_CHECKPOINT status followed by response->size bytes of token:
+ * original request (request, ranges and predicate) with DNET_ITERATOR_ACTION_RESUME action
+ * and this structure at its end. All records which precede checkpoint in the stream
+ * have been sent before it, so token is sent back as is to resume iteration.
+ */
+struct dnet_iterator_checkpoint
+{
+	struct dnet_iterator_position	position;	/* Backend position */
+	uint64_t			records;	/* Number of records iterated before checkpoint */
+	uint64_t			reserved[3];
+} __attribute__ ((packed));
+
+#define DNET_ITERATOR_STATUS_CHECKPOINT	1
+
+static inline void dnet_convert_iterator_checkpoint(struct dnet_iterator_checkpoint *c)
+{
+	int i;
+
+	for (i = 0; i < 4; ++i)
+		c->position.pos[i] = dnet_bswap64(c->position.pos[i]);
+	c->records = dnet_bswap64(c->records);
+}
+
+/*
+ * Size of the response which contains only @fields
+ */
+static inline uint64_t dnet_iterator_response_packed_size(uint64_t fields)
+{
+	uint64_t size = 0;
+
+	if (fields & DNET_IFIELD_KEY)
+		size += sizeof(struct dnet_raw_id);
+	if (fields & DNET_IFIELD_TIMESTAMP)
+		size += sizeof(struct dnet_time);
+	if (fields & DNET_IFIELD_USER_FLAGS)
+		size += sizeof(uint64_t);
+	if (fields & DNET_IFIELD_SIZE)
+		size += sizeof(uint64_t);
+
+	return size;
+}
+
+/*
+ * Packs @fields of the response to @dst one after another in the order of DNET_IFIELD_* bits,
+ * returns packed size
+ */
+static inline uint64_t dnet_iterator_response_pack(void *dst, const struct dnet_iterator_response *r,
+		uint64_t fields)
+{
+	unsigned char *p = (unsigned char *)dst;
+
+	if (fields & DNET_IFIELD_KEY) {
+		memcpy(p, &r->key, sizeof(struct dnet_raw_id));
+		p += sizeof(struct dnet_raw_id);
+	}
+	if (fields & DNET_IFIELD_TIMESTAMP) {
+		memcpy(p, &r->timestamp, sizeof(struct dnet_time));
+		p += sizeof(struct dnet_time);
+	}
+	if (fields & DNET_IFIELD_USER_FLAGS) {
+		memcpy(p, &r->user_flags, sizeof(uint64_t));
+		p += sizeof(uint64_t);
+	}
+	if (fields & DNET_IFIELD_SIZE) {
+		memcpy(p, &r->size, sizeof(uint64_t));
+		p += sizeof(uint64_t);
+	}
+
+	return p - (unsigned char *)dst;
+}
+
+/*
+ * Restores response packed by dnet_iterator_response_pack(), fields which were not sent are zeroed
+ */
+static inline void dnet_iterator_response_unpack(struct dnet_iterator_response *r, const void *src,
+		uint64_t fields)
+{
+	const unsigned char *p = (const unsigned char *)src;
+
+	memset(r, 0, sizeof(struct dnet_iterator_response));
+
+	if (fields & DNET_IFIELD_KEY) {
+		memcpy(&r->key, p, sizeof(struct dnet_raw_id));
+		p += sizeof(struct dnet_raw_id);
+	}
+	if (fields & DNET_IFIELD_TIMESTAMP) {
+		memcpy(&r->timestamp, p, sizeof(struct dnet_time));
+		p += sizeof(struct dnet_time);
+	}
+	if (fields & DNET_IFIELD_USER_FLAGS) {
+		memcpy(&r->user_flags, p, sizeof(uint64_t));
+		p += sizeof(uint64_t);
+	}
+	if (fields & DNET_IFIELD_SIZE)
+		memcpy(&r->size, p, sizeof(uint64_t));
+}
+
+/*
+ * Header of the batched iterator reply.
+ * It is followed by @num records: struct dnet_iterator_response (or its packed fields
+ * if DNET_IFLAGS_PROJECTION is set in the request) and,
+ * if DNET_IFLAGS_DATA is set in @flags, response->size bytes of object's data.
+ */
+struct dnet_iterator_batch
+{
+	uint64_t			num;		/* Number of records */
+	uint64_t			flags;		/* DNET_IFLAGS_DATA and DNET_IFLAGS_PROJECTION */
+	uint64_t			reserved[2];
+} __attribute__ ((packed));
+
+static inline void dnet_convert_iterator_batch(struct dnet_iterator_batch *b)
+{
+	b->num = dnet_bswap64(b->num);
+	b->flags = dnet_bswap64(b->flags);
+}
+
 /*
  * Indexes request entry
  */
@@ -981,6 +1227,53 @@ static inline void dnet_convert_defrag_ctl(struct dnet_defrag_ctl *ctl)
 	ctl->total = dnet_bswap64(ctl->total);
 }
 
+/*
+ * Hash tree of the keys stored on the node.
+ *
+ * Level @l of the tree has 2^l nodes, node @i of the level covers IDs whose first @l bits equal to @i,
+ * leaves are at the level @depth. Hash of the node is XOR of dnet_hash_tree_key() of all keys
+ * (and their timestamps) it covers, so replicas which store the same versions of the same keys
+ * have equal hashes, while subtree without keys has zero hash.
+ *
+ * Request asks for hashes of all nodes of the @level which cover IDs from @start to @end inclusive,
+ * level is limited by the depth of the tree.
+ */
+struct dnet_hash_tree_request
+{
+	struct dnet_raw_id		start;
+	struct dnet_raw_id		end;
+	uint32_t			level;
+	uint32_t			flags;
+	uint64_t			reserved[3];
+} __attribute__ ((packed));
+
+static inline void dnet_convert_hash_tree_request(struct dnet_hash_tree_request *r)
+{
+	r->level = dnet_bswap32(r->level);
+	r->flags = dnet_bswap32(r->flags);
+}
+
+/*
+ * Hash tree reply, @num hashes of the nodes starting with @first one follow it
+ */
+struct dnet_hash_tree_reply
+{
+	uint32_t			depth;		/* Level of the leaves */
+	uint32_t			level;		/* Level of the nodes */
+	uint64_t			first;		/* Index of the first node at the level */
+	uint64_t			num;		/* Number of hashes */
+	uint64_t			reserved[3];
+	uint64_t			hashes[0];
+} __attribute__ ((packed));
+
+static inline void dnet_convert_hash_tree_reply(struct dnet_hash_tree_reply *r)
+{
+	r->depth = dnet_bswap32(r->depth);
+	r->level = dnet_bswap32(r->level);
+	r->first = dnet_bswap64(r->first);
+	r->num = dnet_bswap64(r->num);
+}
+
 #ifdef __cplusplus
 }
 #endif
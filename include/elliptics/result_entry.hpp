@@ -196,6 +196,20 @@ class iterator_result_entry : public callback_result_entry
 		uint64_t id() const;
 };
 
+class hash_tree_result_entry : public callback_result_entry
+{
+	public:
+		hash_tree_result_entry();
+		hash_tree_result_entry(const hash_tree_result_entry &other);
+		~hash_tree_result_entry();
+
+		hash_tree_result_entry &operator =(const hash_tree_result_entry &other);
+
+		dnet_hash_tree_reply *reply() const;
+		// Hashes of reply()->num nodes starting with reply()->first
+		uint64_t *hashes() const;
+};
+
 // Container for iterator results
 class iterator_result_container
 {
@@ -261,6 +275,9 @@ typedef std::vector<stat_count_result_entry> sync_stat_count_result;
 typedef async_result<iterator_result_entry> async_iterator_result;
 typedef std::vector<iterator_result_entry> sync_iterator_result;
 
+typedef async_result<hash_tree_result_entry> async_hash_tree_result;
+typedef std::vector<hash_tree_result_entry> sync_hash_tree_result;
+
 typedef async_result<exec_result_entry> async_exec_result;
 typedef std::vector<exec_result_entry> sync_exec_result;
 typedef async_result<exec_result_entry> async_push_result;
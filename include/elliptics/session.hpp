@@ -239,6 +239,11 @@ class session
 		 * \overload transform()
 		 */
 		void			transform(const data_pointer &data, struct dnet_id &id) const;
+		/*!
+		 * Converts strings \a data to \a ids at once.
+		 * Keys are hashed in parallel, so it is much faster than converting them one by one.
+		 */
+		void			transform(const std::vector<std::string> &data, std::vector<dnet_raw_id> &ids) const;
 		/*!
 		 * Makes dnet_id be accessible by key::id() in the key \a id.
 		 */
@@ -577,6 +582,12 @@ class session
 		 * Changes node \a status on key \a id.
 		 */
 		void			update_status(const key &id, struct dnet_node_status *status);
+		/*!
+		 * Changes node \a status and \a cache settings on given \a address, \a port and network \a family.
+		 * Both structures are filled with current values of the node.
+		 */
+		void			update_status(const char *addr, const int port, const int family,
+						struct dnet_node_status *status, struct dnet_cache_control *cache);
 
 		/*!
 		 * Reads data in range specified in \a io at group \a group_id.
@@ -610,9 +621,43 @@ class session
 								uint32_t type, uint64_t flags,
 								const dnet_time& time_begin = dnet_time(),
 								const dnet_time& time_end = dnet_time());
+		/*!
+		 * Starts iterator which sends only records that match all terms of \a predicate.
+		 * If DNET_IFLAGS_PROJECTION is set in \a flags, only DNET_IFIELD_* \a fields
+		 * of the records are sent, the rest of the response is zeroed.
+		 */
+		async_iterator_result start_iterator(const key &id, const std::vector<dnet_iterator_range>& ranges,
+								const std::vector<dnet_iterator_predicate_term> &predicate,
+								uint64_t fields, uint32_t type, uint64_t flags,
+								const dnet_time& time_begin = dnet_time(),
+								const dnet_time& time_end = dnet_time());
 		async_iterator_result pause_iterator(const key &id, uint64_t iterator_id);
 		async_iterator_result continue_iterator(const key &id, uint64_t iterator_id);
 		async_iterator_result cancel_iterator(const key &id, uint64_t iterator_id);
+		/*!
+		 * Reads result \a result_id of disk iterator from the node specified by \a id.
+		 * Result is sorted by key, only keys within \a ranges are read if they are not empty.
+		 */
+		async_iterator_result read_iterator_result(const key &id, uint64_t result_id,
+								const std::vector<dnet_iterator_range> &ranges = std::vector<dnet_iterator_range>());
+		/*!
+		 * Removes result \a result_id of disk iterator from the node specified by \a id.
+		 */
+		async_iterator_result remove_iterator_result(const key &id, uint64_t result_id);
+		/*!
+		 * Resumes iterator on the node specified by \a id from the checkpoint \a token.
+		 * Token is the data of the entry with DNET_ITERATOR_STATUS_CHECKPOINT status
+		 * sent by iterator started with DNET_IFLAGS_CHECKPOINT.
+		 */
+		async_iterator_result resume_iterator(const key &id, const data_pointer &token);
+
+		/*!
+		 * Reads hashes of the \a level of the hash tree of the keys stored on the node
+		 * specified by \a id. Only nodes covering keys from \a start to \a end are read,
+		 * level deeper than the tree is cut to its depth.
+		 */
+		async_hash_tree_result hash_tree(const key &id, const dnet_raw_id &start, const dnet_raw_id &end,
+								uint32_t level);
 
 		/*!
 		 * Starts execution for \a id of the given \a event with \a data.
@@ -84,6 +84,12 @@ data_pointer local_session::read(const dnet_id &id, int *errp)
 }
 
 data_pointer local_session::read(const dnet_id &id, uint64_t *user_flags, dnet_time *timestamp, int *errp)
+{
+	return read(id, 0, 0, user_flags, timestamp, NULL, errp);
+}
+
+data_pointer local_session::read(const dnet_id &id, uint64_t offset, uint64_t size,
+		uint64_t *user_flags, dnet_time *timestamp, uint64_t *total_size, int *errp)
 {
 	dnet_io_attr io;
 	memset(&io, 0, sizeof(io));
@@ -93,6 +99,8 @@ data_pointer local_session::read(const dnet_id &id, uint64_t *user_flags, dnet_t
 	memcpy(io.parent, id.id, DNET_ID_SIZE);
 
 	io.flags = DNET_IO_FLAGS_NOCSUM | m_ioflags;
+	io.offset = offset;
+	io.size = size;
 
 	dnet_cmd cmd;
 	memset(&cmd, 0, sizeof(cmd));
@@ -129,6 +137,8 @@ data_pointer local_session::read(const dnet_id &id, uint64_t *user_flags, dnet_t
 				*user_flags = req_io->user_flags;
 			if (timestamp)
 				*timestamp = req_io->timestamp;
+			if (total_size)
+				*total_size = req_io->total_size;
 
 			dnet_log(m_state->n, DNET_LOG_DEBUG, "entry in list, size: %llu\n",
 				static_cast<unsigned long long>(req_io->size));
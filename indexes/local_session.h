@@ -38,6 +38,8 @@ class local_session
 
 		ioremap::elliptics::data_pointer read(const dnet_id &id, int *errp);
 		ioremap::elliptics::data_pointer read(const dnet_id &id, uint64_t *user_flags, dnet_time *timestamp, int *errp);
+		ioremap::elliptics::data_pointer read(const dnet_id &id, uint64_t offset, uint64_t size,
+				uint64_t *user_flags, dnet_time *timestamp, uint64_t *total_size, int *errp);
 		int write(const dnet_id &id, const ioremap::elliptics::data_pointer &data);
 		int write(const dnet_id &id, const char *data, size_t size);
 		int write(const dnet_id &id, const char *data, size_t size, uint64_t user_flags, const dnet_time &timestamp);
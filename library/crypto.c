@@ -28,6 +28,10 @@
 #include "elliptics/interface.h"
 
 #include "crypto/sha512.h"
+#include "crypto/sha512_mb.h"
+
+/* Number of keys hashed by one call of multi-buffer hashing */
+#define DNET_TRANSFORM_BATCH_SIZE	128
 
 static void dnet_transform_final(void *dst, const void *src, unsigned int *rsize, unsigned int rs)
 {
@@ -66,6 +70,55 @@ static int dnet_local_digest_transform(void *priv __unused, struct dnet_session
 	return 0;
 }
 
+/*
+ * Hashes keys in parallel by multi-buffer SHA-512, results are the same as of dnet_local_digest_transform()
+ */
+static int dnet_local_digest_transform_batch(void *priv __unused, struct dnet_session *s,
+		const void * const *src, const uint64_t *size, int num,
+		void *dst, unsigned int dsize, unsigned int flags __unused)
+{
+	struct sha512_mb_job jobs[DNET_TRANSFORM_BATCH_SIZE];
+	unsigned char hash[DNET_TRANSFORM_BATCH_SIZE][SHA512_DIGEST_SIZE];
+	char *prefix = NULL;
+	size_t prefix_size = 0;
+	unsigned int rs;
+	int i, j, count;
+
+	if (s && s->ns && s->nsize) {
+		prefix = malloc(s->nsize + 1);
+		if (!prefix)
+			return -ENOMEM;
+
+		memcpy(prefix, s->ns, s->nsize);
+		prefix[s->nsize] = '\0';
+		prefix_size = s->nsize + 1;
+	}
+
+	for (i = 0; i < num; i += count) {
+		count = num - i;
+		if (count > DNET_TRANSFORM_BATCH_SIZE)
+			count = DNET_TRANSFORM_BATCH_SIZE;
+
+		for (j = 0; j < count; ++j) {
+			jobs[j].prefix = prefix;
+			jobs[j].prefix_size = prefix_size;
+			jobs[j].data = src[i + j];
+			jobs[j].size = size[i + j];
+			jobs[j].digest = hash[j];
+		}
+
+		sha512_mb(jobs, count);
+
+		for (j = 0; j < count; ++j) {
+			rs = SHA512_DIGEST_SIZE;
+			dnet_transform_final((char *)dst + (i + j) * dsize, hash[j], &rs, dsize);
+		}
+	}
+
+	free(prefix);
+	return 0;
+}
+
 int dnet_digest_transform(const void *src, uint64_t size, struct dnet_id *id)
 {
 	return dnet_digest_transform_raw(src, size, id->id, DNET_ID_SIZE);
@@ -77,6 +130,11 @@ int dnet_digest_transform_raw(const void *src, uint64_t size, void *csum, int cs
 	return dnet_local_digest_transform(NULL, NULL, src, size, csum, &id_size, 0);
 }
 
+int dnet_digest_transform_batch_raw(const void * const *src, const uint64_t *size, int num, void *csum, int csum_size)
+{
+	return dnet_local_digest_transform_batch(NULL, NULL, src, size, num, csum, csum_size, 0);
+}
+
 int dnet_digest_auth_transform(const void *src, uint64_t size, const void *key, uint64_t key_size, struct dnet_id *id)
 {
 	return dnet_digest_auth_transform_raw(src, size, key, key_size, id->id, DNET_ID_SIZE);
@@ -139,6 +197,7 @@ int dnet_crypto_init(struct dnet_node *n)
 	struct dnet_transform *t = &n->transform;
 
 	t->transform = dnet_local_digest_transform;
+	t->transform_batch = dnet_local_digest_transform_batch;
 	t->priv = NULL;
 
 	return 0;
@@ -0,0 +1,302 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include "sha512.h"
+#include "sha512_mb.h"
+
+#define SHA512_MB_MAX_LANES	8
+
+const uint64_t sha512_mb_k[80] = {
+	0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+	0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+	0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+	0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+	0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+	0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+	0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+	0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+	0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+	0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+	0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+	0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+	0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+	0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+	0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+	0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+	0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+	0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+	0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+	0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL,
+};
+
+#if defined(HAVE_AVX2_SUPPORT) || defined(HAVE_AVX512_SUPPORT)
+static const uint64_t sha512_mb_iv[8] = {
+	0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+	0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL,
+};
+
+typedef void (* sha512_mb_compress_t)(uint64_t *state, const unsigned char * const *blocks);
+
+struct sha512_mb_lane {
+	struct sha512_mb_job	*job;
+	uint64_t		block;
+	uint64_t		blocks;
+	uint64_t		buf[SHA512_MB_BLOCK_SIZE / sizeof(uint64_t)];
+};
+
+static void sha512_mb_store_be64(unsigned char *p, uint64_t v)
+{
+	int i;
+
+	for (i = 7; i >= 0; --i) {
+		p[i] = v;
+		v >>= 8;
+	}
+}
+
+/*
+ * Number of blocks of the padded message: data, 0x80 byte and 128 bit length in bits
+ */
+static uint64_t sha512_mb_blocks(const struct sha512_mb_job *job)
+{
+	return (job->prefix_size + job->size + 1 + 16 + SHA512_MB_BLOCK_SIZE - 1) / SHA512_MB_BLOCK_SIZE;
+}
+
+/*
+ * Returns @block-th block of the padded message of @job.
+ * Blocks which lie completely within job's data are not copied,
+ * the rest are assembled in @buf.
+ */
+static const unsigned char *sha512_mb_block(const struct sha512_mb_job *job, uint64_t block, uint64_t blocks,
+		unsigned char *buf)
+{
+	const unsigned char *prefix = job->prefix, *data = job->data;
+	uint64_t start = block * SHA512_MB_BLOCK_SIZE;
+	uint64_t total = job->prefix_size + job->size;
+	uint64_t pos = 0, len;
+
+	if (start >= job->prefix_size && start + SHA512_MB_BLOCK_SIZE <= total)
+		return data + start - job->prefix_size;
+
+	memset(buf, 0, SHA512_MB_BLOCK_SIZE);
+
+	if (start < job->prefix_size) {
+		len = job->prefix_size - start;
+		if (len > SHA512_MB_BLOCK_SIZE)
+			len = SHA512_MB_BLOCK_SIZE;
+
+		memcpy(buf, prefix + start, len);
+		pos = len;
+	}
+
+	if (pos < SHA512_MB_BLOCK_SIZE && start + pos < total) {
+		len = total - start - pos;
+		if (len > SHA512_MB_BLOCK_SIZE - pos)
+			len = SHA512_MB_BLOCK_SIZE - pos;
+
+		memcpy(buf + pos, data + start + pos - job->prefix_size, len);
+	}
+
+	if (total >= start && total < start + SHA512_MB_BLOCK_SIZE)
+		buf[total - start] = 0x80;
+
+	if (block == blocks - 1) {
+		sha512_mb_store_be64(buf + SHA512_MB_BLOCK_SIZE - 16, total >> 61);
+		sha512_mb_store_be64(buf + SHA512_MB_BLOCK_SIZE - 8, total << 3);
+	}
+
+	return buf;
+}
+
+/*
+ * Hashes the rest of the job's message starting with @block from the given @state with scalar code
+ */
+static void sha512_mb_finish_scalar(struct sha512_mb_job *job, const uint64_t *state, uint64_t block)
+{
+	uint64_t blocks = sha512_mb_blocks(job);
+	uint64_t buf[SHA512_MB_BLOCK_SIZE / sizeof(uint64_t)];
+	const unsigned char *p;
+	struct sha512_ctx ctx;
+	int i;
+
+	sha512_init_ctx(&ctx);
+	for (i = 0; i < 8; ++i)
+		ctx.state[i] = state[i];
+
+	for (; block < blocks; ++block) {
+		p = sha512_mb_block(job, block, blocks, (unsigned char *)buf);
+
+		/* sha512_process_block() wants aligned words */
+		if (p != (unsigned char *)buf)
+			memcpy(buf, p, SHA512_MB_BLOCK_SIZE);
+
+		sha512_process_block(buf, SHA512_MB_BLOCK_SIZE, &ctx);
+	}
+
+	for (i = 0; i < 8; ++i)
+		sha512_mb_store_be64(job->digest + i * 8, ctx.state[i]);
+}
+
+static void sha512_mb_run(struct sha512_mb_job *jobs, size_t num, int lanes, sha512_mb_compress_t compress)
+{
+	static const unsigned char idle[SHA512_MB_BLOCK_SIZE];
+	struct sha512_mb_lane lane[SHA512_MB_MAX_LANES];
+	const unsigned char *blocks[SHA512_MB_MAX_LANES];
+	uint64_t state[8 * SHA512_MB_MAX_LANES];
+	uint64_t words[8];
+	size_t next = 0;
+	int i, w, active;
+
+	memset(lane, 0, sizeof(lane));
+
+	while (1) {
+		active = 0;
+
+		for (i = 0; i < lanes; ++i) {
+			if (!lane[i].job && next < num) {
+				lane[i].job = &jobs[next++];
+				lane[i].block = 0;
+				lane[i].blocks = sha512_mb_blocks(lane[i].job);
+
+				for (w = 0; w < 8; ++w)
+					state[w * lanes + i] = sha512_mb_iv[w];
+			}
+
+			if (lane[i].job)
+				active++;
+		}
+
+		if (!active)
+			break;
+
+		/*
+		 * Tail of the batch (or a long message left alone) would mostly hash idle lanes,
+		 * scalar code is faster there
+		 */
+		if (next == num && active * 2 < lanes) {
+			for (i = 0; i < lanes; ++i) {
+				if (!lane[i].job)
+					continue;
+
+				for (w = 0; w < 8; ++w)
+					words[w] = state[w * lanes + i];
+
+				sha512_mb_finish_scalar(lane[i].job, words, lane[i].block);
+			}
+			break;
+		}
+
+		for (i = 0; i < lanes; ++i) {
+			if (lane[i].job)
+				blocks[i] = sha512_mb_block(lane[i].job, lane[i].block, lane[i].blocks,
+						(unsigned char *)lane[i].buf);
+			else
+				blocks[i] = idle;
+		}
+
+		compress(state, blocks);
+
+		for (i = 0; i < lanes; ++i) {
+			if (!lane[i].job || ++lane[i].block != lane[i].blocks)
+				continue;
+
+			for (w = 0; w < 8; ++w)
+				sha512_mb_store_be64(lane[i].job->digest + w * 8, state[w * lanes + i]);
+
+			lane[i].job = NULL;
+		}
+	}
+}
+
+#endif
+
+#if defined(HAVE_AVX512_SUPPORT)
+static int sha512_mb_have_avx512(void)
+{
+	return __builtin_cpu_supports("avx512f");
+}
+#else
+static int sha512_mb_have_avx512(void)
+{
+	return 0;
+}
+#endif
+
+#if defined(HAVE_AVX2_SUPPORT)
+static int sha512_mb_have_avx2(void)
+{
+	return __builtin_cpu_supports("avx2");
+}
+#else
+static int sha512_mb_have_avx2(void)
+{
+	return 0;
+}
+#endif
+
+const char *sha512_mb_implementation(void)
+{
+	if (sha512_mb_have_avx512())
+		return "avx512";
+	if (sha512_mb_have_avx2())
+		return "avx2";
+	return "scalar";
+}
+
+static void sha512_mb_scalar(struct sha512_mb_job *jobs, size_t num)
+{
+	size_t i;
+
+	for (i = 0; i < num; ++i) {
+		struct sha512_ctx ctx;
+
+		sha512_init_ctx(&ctx);
+		sha512_process_bytes(jobs[i].prefix, jobs[i].prefix_size, &ctx);
+		sha512_process_bytes(jobs[i].data, jobs[i].size, &ctx);
+		sha512_finish_ctx(&ctx, jobs[i].digest);
+	}
+}
+
+int sha512_mb_with(const char *implementation, struct sha512_mb_job *jobs, size_t num)
+{
+#if defined(HAVE_AVX512_SUPPORT)
+	if (!strcmp(implementation, "avx512") && sha512_mb_have_avx512()) {
+		sha512_mb_run(jobs, num, 8, sha512_mb_compress_avx512);
+		return 0;
+	}
+#endif
+#if defined(HAVE_AVX2_SUPPORT)
+	if (!strcmp(implementation, "avx2") && sha512_mb_have_avx2()) {
+		sha512_mb_run(jobs, num, 4, sha512_mb_compress_avx2);
+		return 0;
+	}
+#endif
+	if (!strcmp(implementation, "scalar")) {
+		sha512_mb_scalar(jobs, num);
+		return 0;
+	}
+
+	return -ENOTSUP;
+}
+
+void sha512_mb(struct sha512_mb_job *jobs, size_t num)
+{
+	sha512_mb_with(sha512_mb_implementation(), jobs, num);
+}
@@ -0,0 +1,89 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __DNET_SHA512_MB_H
+#define __DNET_SHA512_MB_H
+
+#include <stddef.h>
+#include <string.h>
+
+#include <elliptics/typedefs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Multi-buffer SHA-512.
+ *
+ * Independent messages are hashed in parallel, every lane of the vector register
+ * carries state of its own message. When a message is finished, next one takes its lane.
+ * Implementation is selected at runtime: AVX-512 (8 lanes), AVX2 (4 lanes) or scalar one.
+ *
+ * Message of the job is @prefix followed by @data, its 64 bytes digest is written to @digest.
+ */
+struct sha512_mb_job {
+	const void		*prefix;
+	size_t			prefix_size;
+	const void		*data;
+	size_t			size;
+	unsigned char		*digest;
+};
+
+void sha512_mb(struct sha512_mb_job *jobs, size_t num);
+
+/*
+ * Returns name of the implementation used by sha512_mb(): "avx512", "avx2" or "scalar"
+ */
+const char *sha512_mb_implementation(void);
+
+/*
+ * Hashes @jobs with the given implementation instead of the best one, so every one can be tested.
+ * Returns -ENOTSUP if the implementation is not built in or not supported by CPU.
+ */
+int sha512_mb_with(const char *implementation, struct sha512_mb_job *jobs, size_t num);
+
+/*
+ * Everything below is shared between driver and vector implementations.
+ *
+ * Compression function processes one 128 bytes block of every lane,
+ * @state holds 8 words of every lane: word @w of lane @l is state[w * lanes + l].
+ */
+#define SHA512_MB_BLOCK_SIZE	128
+
+extern const uint64_t sha512_mb_k[80];
+
+void sha512_mb_compress_avx2(uint64_t *state, const unsigned char * const *blocks);
+void sha512_mb_compress_avx512(uint64_t *state, const unsigned char * const *blocks);
+
+static inline uint64_t sha512_mb_load_be64(const unsigned char *p)
+{
+	uint64_t v;
+
+	memcpy(&v, p, sizeof(v));
+#if BYTEORDER == 4321
+	return v;
+#else
+	return __builtin_bswap64(v);
+#endif
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DNET_SHA512_MB_H */
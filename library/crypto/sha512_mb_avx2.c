@@ -0,0 +1,104 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * SHA-512 compression of 4 messages at once, built with -mavx2
+ * and called only when CPU supports it.
+ */
+
+#include <immintrin.h>
+
+#include "sha512_mb.h"
+
+#define ROR(x, n)	_mm256_or_si256(_mm256_srli_epi64(x, n), _mm256_slli_epi64(x, 64 - (n)))
+#define XOR3(x, y, z)	_mm256_xor_si256(_mm256_xor_si256(x, y), z)
+#define ADD(x, y)	_mm256_add_epi64(x, y)
+
+#define S0(x)		XOR3(ROR(x, 28), ROR(x, 34), ROR(x, 39))
+#define S1(x)		XOR3(ROR(x, 14), ROR(x, 18), ROR(x, 41))
+#define s0(x)		XOR3(ROR(x, 1), ROR(x, 8), _mm256_srli_epi64(x, 7))
+#define s1(x)		XOR3(ROR(x, 19), ROR(x, 61), _mm256_srli_epi64(x, 6))
+#define CH(x, y, z)	_mm256_xor_si256(_mm256_and_si256(x, y), _mm256_andnot_si256(x, z))
+#define MAJ(x, y, z)	_mm256_or_si256(_mm256_and_si256(x, y), _mm256_and_si256(z, _mm256_or_si256(x, y)))
+
+void sha512_mb_compress_avx2(uint64_t *state, const unsigned char * const *blocks)
+{
+	const __m256i bswap = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+			7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+	__m256i w[80], r0, r1, r2, r3, t0, t1, t2, t3;
+	__m256i v[8], a, b, c, d, e, f, g, h, x, y;
+	int t;
+
+	/* Load big-endian words of 4 blocks and transpose them, so every register holds one word of all lanes */
+	for (t = 0; t < 16; t += 4) {
+		r0 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(blocks[0] + t * 8)), bswap);
+		r1 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(blocks[1] + t * 8)), bswap);
+		r2 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(blocks[2] + t * 8)), bswap);
+		r3 = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)(blocks[3] + t * 8)), bswap);
+
+		t0 = _mm256_unpacklo_epi64(r0, r1);
+		t1 = _mm256_unpackhi_epi64(r0, r1);
+		t2 = _mm256_unpacklo_epi64(r2, r3);
+		t3 = _mm256_unpackhi_epi64(r2, r3);
+
+		w[t + 0] = _mm256_permute2x128_si256(t0, t2, 0x20);
+		w[t + 1] = _mm256_permute2x128_si256(t1, t3, 0x20);
+		w[t + 2] = _mm256_permute2x128_si256(t0, t2, 0x31);
+		w[t + 3] = _mm256_permute2x128_si256(t1, t3, 0x31);
+	}
+
+	for (t = 16; t < 80; ++t)
+		w[t] = ADD(ADD(s1(w[t - 2]), w[t - 7]), ADD(s0(w[t - 15]), w[t - 16]));
+
+	for (t = 0; t < 8; ++t)
+		v[t] = _mm256_loadu_si256((const __m256i *)(state + t * 4));
+
+	a = v[0];
+	b = v[1];
+	c = v[2];
+	d = v[3];
+	e = v[4];
+	f = v[5];
+	g = v[6];
+	h = v[7];
+
+	for (t = 0; t < 80; ++t) {
+		x = ADD(ADD(h, S1(e)), ADD(CH(e, f, g), ADD(_mm256_set1_epi64x(sha512_mb_k[t]), w[t])));
+		y = ADD(S0(a), MAJ(a, b, c));
+
+		h = g;
+		g = f;
+		f = e;
+		e = ADD(d, x);
+		d = c;
+		c = b;
+		b = a;
+		a = ADD(x, y);
+	}
+
+	v[0] = ADD(v[0], a);
+	v[1] = ADD(v[1], b);
+	v[2] = ADD(v[2], c);
+	v[3] = ADD(v[3], d);
+	v[4] = ADD(v[4], e);
+	v[5] = ADD(v[5], f);
+	v[6] = ADD(v[6], g);
+	v[7] = ADD(v[7], h);
+
+	for (t = 0; t < 8; ++t)
+		_mm256_storeu_si256((__m256i *)(state + t * 4), v[t]);
+}
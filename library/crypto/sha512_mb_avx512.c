@@ -0,0 +1,95 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * SHA-512 compression of 8 messages at once, built with -mavx512f
+ * and called only when CPU supports it.
+ */
+
+#include <immintrin.h>
+
+#include "sha512_mb.h"
+
+#define ROR(x, n)	_mm512_ror_epi64(x, n)
+#define XOR3(x, y, z)	_mm512_ternarylogic_epi64(x, y, z, 0x96)
+#define ADD(x, y)	_mm512_add_epi64(x, y)
+
+#define S0(x)		XOR3(ROR(x, 28), ROR(x, 34), ROR(x, 39))
+#define S1(x)		XOR3(ROR(x, 14), ROR(x, 18), ROR(x, 41))
+#define s0(x)		XOR3(ROR(x, 1), ROR(x, 8), _mm512_srli_epi64(x, 7))
+#define s1(x)		XOR3(ROR(x, 19), ROR(x, 61), _mm512_srli_epi64(x, 6))
+#define CH(x, y, z)	_mm512_ternarylogic_epi64(x, y, z, 0xca)
+#define MAJ(x, y, z)	_mm512_ternarylogic_epi64(x, y, z, 0xe8)
+
+void sha512_mb_compress_avx512(uint64_t *state, const unsigned char * const *blocks)
+{
+	uint64_t words[16 * 8] __attribute__ ((aligned (64)));
+	__m512i w[80], v[8], a, b, c, d, e, f, g, h, x, y;
+	int t, l;
+
+	/*
+	 * Byte shuffle needs AVX512BW, so words are swapped and transposed by scalar code,
+	 * it is a small part of the work compared to 80 rounds
+	 */
+	for (t = 0; t < 16; ++t)
+		for (l = 0; l < 8; ++l)
+			words[t * 8 + l] = sha512_mb_load_be64(blocks[l] + t * 8);
+
+	for (t = 0; t < 16; ++t)
+		w[t] = _mm512_load_si512((const void *)(words + t * 8));
+
+	for (t = 16; t < 80; ++t)
+		w[t] = ADD(ADD(s1(w[t - 2]), w[t - 7]), ADD(s0(w[t - 15]), w[t - 16]));
+
+	for (t = 0; t < 8; ++t)
+		v[t] = _mm512_loadu_si512((const void *)(state + t * 8));
+
+	a = v[0];
+	b = v[1];
+	c = v[2];
+	d = v[3];
+	e = v[4];
+	f = v[5];
+	g = v[6];
+	h = v[7];
+
+	for (t = 0; t < 80; ++t) {
+		x = ADD(ADD(h, S1(e)), ADD(CH(e, f, g), ADD(_mm512_set1_epi64(sha512_mb_k[t]), w[t])));
+		y = ADD(S0(a), MAJ(a, b, c));
+
+		h = g;
+		g = f;
+		f = e;
+		e = ADD(d, x);
+		d = c;
+		c = b;
+		b = a;
+		a = ADD(x, y);
+	}
+
+	v[0] = ADD(v[0], a);
+	v[1] = ADD(v[1], b);
+	v[2] = ADD(v[2], c);
+	v[3] = ADD(v[3], d);
+	v[4] = ADD(v[4], e);
+	v[5] = ADD(v[5], f);
+	v[6] = ADD(v[6], g);
+	v[7] = ADD(v[7], h);
+
+	for (t = 0; t < 8; ++t)
+		_mm512_storeu_si512((void *)(state + t * 8), v[t]);
+}
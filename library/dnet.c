@@ -31,6 +31,7 @@
 #include <fcntl.h>
 #include <inttypes.h>
 #include <limits.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -521,6 +522,11 @@ static int dnet_cmd_status(struct dnet_net_state *orig, struct dnet_cmd *cmd __u
 {
 	struct dnet_node *n = orig->n;
 	struct dnet_node_status *st = data;
+	struct dnet_cache_control *cache = NULL;
+	int err;
+
+	if (cmd->size >= sizeof(struct dnet_node_status) + sizeof(struct dnet_cache_control))
+		cache = (struct dnet_cache_control *)(st + 1);
 
 	dnet_convert_node_status(st);
 
@@ -559,6 +565,18 @@ static int dnet_cmd_status(struct dnet_net_state *orig, struct dnet_cmd *cmd __u
 
 	dnet_convert_node_status(st);
 
+	if (cache) {
+		dnet_convert_cache_control(cache);
+
+		err = dnet_cache_control(n, cache);
+		if (err)
+			return err;
+
+		dnet_convert_cache_control(cache);
+
+		return dnet_send_reply(orig, cmd, st, sizeof(struct dnet_node_status) + sizeof(struct dnet_cache_control), 1);
+	}
+
 	return dnet_send_reply(orig, cmd, st, sizeof(struct dnet_node_status), 1);
 }
 
@@ -615,40 +633,504 @@ int dnet_send_ack(struct dnet_net_state *st, struct dnet_cmd *cmd, int err, int
 }
 
 /*!
- * Internal callback that writes result to \a fd opened in append mode
+ * Fills reply header for \a size bytes of iterator results
  */
-static int dnet_iterator_callback_file(void *priv, void *data, uint64_t dsize)
+static void dnet_iterator_reply_header(struct dnet_cmd *reply, struct dnet_cmd *cmd, uint64_t size)
 {
-	struct dnet_iterator_file_private *file = priv;
-	ssize_t err;
+	*reply = *cmd;
+	reply->flags |= DNET_FLAGS_MORE;
+	reply->size = size;
+	reply->trans |= DNET_TRANS_REPLY;
+	dnet_convert_cmd(reply);
+}
 
-	err = write(file->fd, data, dsize);
-	if (err == -1)
-		return -errno;
-	if (err != (ssize_t)dsize)
+/*!
+ * If need_exit is set - sending reply should be skipped and -EINTR returned
+ * to interrupt execution of current iterator
+ */
+static int dnet_iterator_check_state(struct dnet_net_state *st, struct dnet_cmd *cmd)
+{
+	if (st->__need_exit) {
+		dnet_log(st->n, DNET_LOG_ERROR,
+				"%s: Interrupting iterator because peer has been disconnected\n",
+				dnet_dump_id(&cmd->id));
 		return -EINTR;
+	}
+
+	return 0;
+}
+
+/*
+ * Disk iterator buffers this many bytes of responses before writing them,
+ * time to send progress reply is checked every DNET_ITERATOR_FILE_PROGRESS_RECORDS records.
+ */
+#define DNET_ITERATOR_FILE_BUFFER		(1024 * 1024)
+#define DNET_ITERATOR_FILE_PROGRESS_RECORDS	1024
+
+/*!
+ * Fills \a path of disk iterator result \a id
+ */
+static int dnet_iterator_file_path(struct dnet_node *n, uint64_t id, char *path, size_t size)
+{
+	if (!n->iterator_dir[0])
+		return -ENOTSUP;
+
+	snprintf(path, size, "%s/%016llx", n->iterator_dir, (unsigned long long)id);
+	return 0;
+}
+
+static int dnet_iterator_file_write(int fd, const void *data, uint64_t size)
+{
+	ssize_t err;
+
+	while (size) {
+		err = write(fd, data, size);
+		if (err == -1) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		if (err == 0)
+			return -ENOSPC;
+
+		data += err;
+		size -= err;
+	}
+
+	return 0;
+}
+
+/*!
+ * Writes buffered responses to the file
+ */
+static int dnet_iterator_file_flush(void *priv)
+{
+	struct dnet_iterator_file_private *file = priv;
+	int err;
+
+	err = dnet_iterator_file_write(file->fd, file->buf, file->buf_size);
+	if (err)
+		return err;
+
+	file->size += file->buf_size;
+	file->buf_size = 0;
+	return 0;
+}
+
+/*!
+ * Sends response which tells client id of the result and its current size.
+ * Status of the response is -EINPROGRESS until result is ready.
+ */
+static int dnet_iterator_file_reply(struct dnet_iterator_file_private *file, int status)
+{
+	struct {
+		struct dnet_cmd			cmd;
+		struct dnet_iterator_response	response;
+	} __attribute__ ((packed)) header;
+	int err;
+
+	file->progress_time = time(NULL);
+
+	err = dnet_iterator_check_state(file->st, file->cmd);
+	if (err || file->st == file->st->n->st)
+		return err;
+
+	dnet_iterator_reply_header(&header.cmd, file->cmd, sizeof(struct dnet_iterator_response));
+
+	memset(&header.response, 0, sizeof(struct dnet_iterator_response));
+	header.response.id = file->id;
+	header.response.status = status;
+	header.response.size = file->size + file->buf_size;
+	dnet_convert_iterator_response(&header.response);
+
+	return dnet_send(file->st, &header, sizeof(header));
+}
+
+/*!
+ * Progress callback of the result sorting, it also stops sorting of canceled iterator
+ */
+static int dnet_iterator_file_sort_progress(void *priv)
+{
+	struct dnet_iterator_file_private *file = priv;
+	int err = 0;
+
+	pthread_mutex_lock(&file->it->lock);
+	if (file->it->state == DNET_ITERATOR_ACTION_CANCEL)
+		err = -ENOEXEC;
+	pthread_mutex_unlock(&file->it->lock);
+
+	if (err)
+		return err;
+
+	if (time(NULL) == file->progress_time)
+		return 0;
+
+	return dnet_iterator_file_reply(file, -EINPROGRESS);
+}
+
+/*!
+ * Internal callback that buffers result and writes it to the file
+ */
+static int dnet_iterator_callback_file(void *priv, struct dnet_iterator_response *response,
+		void *data, uint64_t dsize)
+{
+	struct dnet_iterator_file_private *file = priv;
+	const uint64_t size = sizeof(struct dnet_iterator_response);
+	int err;
+
+	/* Disk iterator does not store data, records should be sortable */
+	if (data || dsize)
+		return -ENOTSUP;
+
+	if (file->buf_size + size > DNET_ITERATOR_FILE_BUFFER) {
+		err = dnet_iterator_file_flush(file);
+		if (err)
+			return err;
+	}
+
+	memcpy(file->buf + file->buf_size, response, size);
+	file->buf_size += size;
+
+	if (++file->num % DNET_ITERATOR_FILE_PROGRESS_RECORDS == 0 && time(NULL) != file->progress_time)
+		return dnet_iterator_file_reply(file, -EINPROGRESS);
+
 	return 0;
 }
 
+/*!
+ * Creates result file with a new id and temporary file for unsorted responses.
+ * Temporary file is unlinked right away, it is only referenced by descriptor.
+ */
+static int dnet_iterator_file_create(struct dnet_node *n, struct dnet_iterator_file_private *file,
+		char *path, size_t path_size)
+{
+	char tmp_path[sizeof(n->iterator_dir) + 32];
+	uint64_t base = (uint64_t)time(NULL) << 16;
+	int fd = -1, err, i;
+
+	if (!n->iterator_dir[0])
+		return -ENOTSUP;
+
+	if (mkdir(n->iterator_dir, 0755) && errno != EEXIST) {
+		err = -errno;
+		dnet_log_err(n, "%s: failed to create iterator directory", n->iterator_dir);
+		return err;
+	}
+
+	for (i = 0; i <= 0xffff; ++i) {
+		file->id = base | i;
+		dnet_iterator_file_path(n, file->id, path, path_size);
+
+		fd = open(path, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+		if (fd >= 0 || errno != EEXIST)
+			break;
+	}
+	if (fd < 0) {
+		err = (i > 0xffff) ? -EEXIST : -errno;
+		goto err_out_exit;
+	}
+
+	snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+	file->fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (file->fd < 0) {
+		err = -errno;
+		goto err_out_unlink;
+	}
+	unlink(tmp_path);
+
+	file->buf = malloc(DNET_ITERATOR_FILE_BUFFER);
+	if (!file->buf) {
+		err = -ENOMEM;
+		goto err_out_close_tmp;
+	}
+
+	return fd;
+
+err_out_close_tmp:
+	close(file->fd);
+	file->fd = -1;
+err_out_unlink:
+	unlink(path);
+	close(fd);
+err_out_exit:
+	dnet_log(n, DNET_LOG_ERROR, "%s: failed to create iterator result file: %d\n", path, err);
+	return err;
+}
+
+/*!
+ * Copies \a response to \a dst, only requested fields if DNET_IFLAGS_PROJECTION is set in \a flags.
+ * Returns number of copied bytes.
+ */
+static uint64_t dnet_iterator_response_copy(void *dst, struct dnet_iterator_response *response,
+		uint64_t flags, uint64_t fields)
+{
+	if (flags & DNET_IFLAGS_PROJECTION)
+		return dnet_iterator_response_pack(dst, response, fields);
+
+	memcpy(dst, response, sizeof(struct dnet_iterator_response));
+	return sizeof(struct dnet_iterator_response);
+}
+
 /*!
  * Internal callback that sends result to state \a st
  */
-static int dnet_iterator_callback_send(void *priv, void *data, uint64_t dsize)
+static int dnet_iterator_callback_send(void *priv, struct dnet_iterator_response *response,
+		void *data, uint64_t dsize)
 {
 	struct dnet_iterator_send_private *send = priv;
+	struct {
+		struct dnet_cmd			cmd;
+		struct dnet_iterator_response	response;
+	} __attribute__ ((packed)) header;
+	uint64_t size;
+	int err;
 
-	/*
-	 * If need_exit is set - skips sending reply and return -EINTR to
-	 * interrupt execution of current iterator
-	 */
-	if (send->st->__need_exit) {
-		dnet_log(send->st->n, DNET_LOG_ERROR,
-				"%s: Interrupting iterator because peer has been disconnected\n",
-				dnet_dump_id(&send->cmd->id));
-		return -EINTR;
+	err = dnet_iterator_check_state(send->st, send->cmd);
+	if (err || send->st == send->st->n->st)
+		return err;
+
+	size = dnet_iterator_response_copy(&header.response, response, send->flags, send->fields);
+	dnet_iterator_reply_header(&header.cmd, send->cmd, size + dsize);
+
+	err = dnet_send_data(send->st, &header, sizeof(struct dnet_cmd) + size, data, dsize);
+	if (err)
+		return err;
+
+	dnet_send_wait_threshold(send->st, 1);
+	return 0;
+}
+
+/*!
+ * Same as dnet_iterator_callback_send() but data is sent from \a fd
+ */
+static int dnet_iterator_callback_send_fd(void *priv, struct dnet_iterator_response *response,
+		int fd, uint64_t offset, uint64_t dsize)
+{
+	struct dnet_iterator_send_private *send = priv;
+	struct {
+		struct dnet_cmd			cmd;
+		struct dnet_iterator_response	response;
+	} __attribute__ ((packed)) header;
+	uint64_t size;
+	int err;
+
+	err = dnet_iterator_check_state(send->st, send->cmd);
+	if (err || send->st == send->st->n->st || !dsize)
+		goto err_out_close;
+
+	size = dnet_iterator_response_copy(&header.response, response, send->flags, send->fields);
+	dnet_iterator_reply_header(&header.cmd, send->cmd, size + dsize);
+
+	err = dnet_send_fd(send->st, &header, sizeof(struct dnet_cmd) + size, fd, offset, dsize,
+			DNET_IO_REQ_FLAGS_CLOSE);
+	if (err)
+		goto err_out_close;
+
+	dnet_send_wait_threshold(send->st, 1);
+	return 0;
+
+err_out_close:
+	close(fd);
+	return err;
+}
+
+/*
+ * Batched replies are flushed when frame grows over DNET_ITERATOR_BATCH_SIZE bytes.
+ * First chunk of the frame is allocated for the whole frame, chunks which follow
+ * data sent from file start smaller, most of the time they hold a few records.
+ */
+#define DNET_ITERATOR_BATCH_SIZE	(1024 * 1024)
+#define DNET_ITERATOR_BATCH_CHUNK	(4 * 1024)
+
+/*!
+ * Makes sure current chunk has room for \a size more bytes
+ */
+static int dnet_iterator_batch_reserve(struct dnet_iterator_batch_private *batch, uint64_t size)
+{
+	struct dnet_io_req *r = batch->chunk;
+	uint64_t used = r ? r->dsize : 0;
+	uint64_t capacity;
+
+	if (r && used + size <= batch->capacity)
+		return 0;
+
+	if (r)
+		capacity = batch->capacity * 2;
+	else if (list_empty(&batch->chunks))
+		capacity = DNET_ITERATOR_BATCH_SIZE;
+	else
+		capacity = DNET_ITERATOR_BATCH_CHUNK;
+
+	while (capacity < used + size)
+		capacity *= 2;
+
+	r = realloc(r, sizeof(struct dnet_io_req) + capacity);
+	if (!r)
+		return -ENOMEM;
+
+	if (!batch->chunk) {
+		memset(r, 0, sizeof(struct dnet_io_req));
+		r->fd = -1;
+	}
+	r->data = r + 1;
+
+	batch->chunk = r;
+	batch->capacity = capacity;
+	return 0;
+}
+
+/*!
+ * Moves current chunk to the list of filled ones
+ */
+static void dnet_iterator_batch_close_chunk(struct dnet_iterator_batch_private *batch)
+{
+	list_add_tail(&batch->chunk->req_entry, &batch->chunks);
+	batch->chunk = NULL;
+}
+
+/*!
+ * Copies response and \a dsize bytes of \a data into current chunk,
+ * frame header is reserved in front of the first record.
+ */
+static int dnet_iterator_batch_copy(struct dnet_iterator_batch_private *batch,
+		struct dnet_iterator_response *response, void *data, uint64_t dsize)
+{
+	static const uint64_t frame_header_size = sizeof(struct dnet_cmd) + sizeof(struct dnet_iterator_batch);
+	uint64_t header_size = batch->num ? 0 : frame_header_size;
+	unsigned char *position;
+	uint64_t size;
+	int err;
+
+	err = dnet_iterator_batch_reserve(batch, header_size + sizeof(struct dnet_iterator_response) + dsize);
+	if (err)
+		return err;
+
+	/* Frame header is filled when frame is sent */
+	if (header_size) {
+		batch->chunk->dsize += header_size;
+		batch->size += sizeof(struct dnet_iterator_batch);
+	}
+
+	position = batch->chunk->data + batch->chunk->dsize;
+	size = dnet_iterator_response_copy(position, response, batch->flags, batch->fields);
+	if (dsize)
+		memcpy(position + size, data, dsize);
+
+	batch->chunk->dsize += size + dsize;
+	batch->chunk->queue_weight++;
+	batch->size += size + dsize;
+	batch->num++;
+	return 0;
+}
+
+/*!
+ * Frees frame which has not been sent
+ */
+static void dnet_iterator_batch_cleanup(struct dnet_iterator_batch_private *batch)
+{
+	struct dnet_io_req *r, *tmp;
+
+	list_for_each_entry_safe(r, tmp, &batch->chunks, req_entry) {
+		list_del(&r->req_entry);
+		dnet_io_req_free(r);
 	}
 
-	return dnet_send_reply_threshold(send->st, send->cmd, data, dsize, 1);
+	free(batch->chunk);
+	batch->chunk = NULL;
+}
+
+/*!
+ * Queues current frame without copying it
+ */
+static int dnet_iterator_batch_flush(void *priv)
+{
+	struct dnet_iterator_batch_private *batch = priv;
+	struct dnet_iterator_batch *header;
+	struct dnet_io_req *first;
+	uint64_t num;
+	int err;
+
+	if (!batch->num)
+		return 0;
+
+	if (batch->chunk)
+		dnet_iterator_batch_close_chunk(batch);
+
+	first = list_first_entry(&batch->chunks, struct dnet_io_req, req_entry);
+	dnet_iterator_reply_header(first->data, batch->cmd, batch->size);
+
+	header = first->data + sizeof(struct dnet_cmd);
+	memset(header, 0, sizeof(struct dnet_iterator_batch));
+	header->num = batch->num;
+	header->flags = batch->flags;
+	dnet_convert_iterator_batch(header);
+
+	num = batch->num;
+	batch->size = 0;
+	batch->num = 0;
+
+	err = dnet_iterator_check_state(batch->st, batch->cmd);
+	if (err || batch->st == batch->st->n->st) {
+		dnet_iterator_batch_cleanup(batch);
+		return err;
+	}
+
+	err = dnet_io_req_queue_list(batch->st, &batch->chunks);
+	if (err)
+		return err;
+
+	/* Chunks account for the records they carry, as if they were sent one by one */
+	dnet_send_wait_threshold(batch->st, num);
+	return 0;
+}
+
+/*!
+ * Internal callback that packs result into the frame and sends the frame when it is full
+ */
+static int dnet_iterator_callback_batch(void *priv, struct dnet_iterator_response *response,
+		void *data, uint64_t dsize)
+{
+	struct dnet_iterator_batch_private *batch = priv;
+	int err;
+
+	err = dnet_iterator_batch_copy(batch, response, data, dsize);
+	if (err)
+		return err;
+
+	if (batch->size >= DNET_ITERATOR_BATCH_SIZE)
+		return dnet_iterator_batch_flush(batch);
+	return 0;
+}
+
+/*!
+ * Same as dnet_iterator_callback_batch() but data is referenced by \a fd:
+ * chunk is closed with the data, so it is sent from file without copying
+ */
+static int dnet_iterator_callback_batch_fd(void *priv, struct dnet_iterator_response *response,
+		int fd, uint64_t offset, uint64_t dsize)
+{
+	struct dnet_iterator_batch_private *batch = priv;
+	int err;
+
+	err = dnet_iterator_batch_copy(batch, response, NULL, 0);
+	if (err || !dsize)
+		goto err_out_close;
+
+	batch->chunk->fd = fd;
+	batch->chunk->local_offset = offset;
+	batch->chunk->fsize = dsize;
+	batch->chunk->on_exit = DNET_IO_REQ_FLAGS_CLOSE;
+	dnet_iterator_batch_close_chunk(batch);
+
+	batch->size += dsize;
+
+	if (batch->size >= DNET_ITERATOR_BATCH_SIZE)
+		return dnet_iterator_batch_flush(batch);
+	return 0;
+
+err_out_close:
+	close(fd);
+	return err;
 }
 
 /*!
@@ -659,7 +1141,20 @@ static int dnet_iterator_callback_send(void *priv, void *data, uint64_t dsize)
  */
 static int dnet_iterator_flow_control(struct dnet_iterator_common_private *ipriv)
 {
-	int err = 0;
+	int err = 0, paused;
+
+	/* Accumulated results are sent before pause, client should not wait for them */
+	if (ipriv->flush_callback) {
+		pthread_mutex_lock(&ipriv->it->lock);
+		paused = (ipriv->it->state == DNET_ITERATOR_ACTION_PAUSE);
+		pthread_mutex_unlock(&ipriv->it->lock);
+
+		if (paused) {
+			err = ipriv->flush_callback(ipriv->next_private);
+			if (err)
+				return err;
+		}
+	}
 
 	pthread_mutex_lock(&ipriv->it->lock);
 	while (ipriv->it->state == DNET_ITERATOR_ACTION_PAUSE)
@@ -672,26 +1167,176 @@ static int dnet_iterator_flow_control(struct dnet_iterator_common_private *ipriv
 }
 
 /*!
- * Common callback part that is run by all iterator types.
- * It's responsible for sanity checks and flow control.
- *
- * Also now it "prepares" data for next callback by combining data itself with
- * fixed-size response header.
+ * Returns 1 if result \a cmp of comparison of field with the value satisfies \a op
  */
-static int dnet_iterator_callback_common(void *priv, struct dnet_raw_id *key,
-		void *data, uint64_t dsize, struct dnet_ext_list *elist)
+static inline int dnet_iterator_match_cmp(int op, int cmp)
 {
-	struct dnet_iterator_common_private *ipriv = priv;
-	struct dnet_iterator_response *response;
-	static const uint64_t response_size = sizeof(struct dnet_iterator_response);
-	uint64_t size;
-	const uint64_t fsize = dsize;
-	unsigned char *combined = NULL, *position;
-	int err = 0;
+	switch (op) {
+	case DNET_IOP_EQ:
+		return cmp == 0;
+	case DNET_IOP_NE:
+		return cmp != 0;
+	case DNET_IOP_LT:
+		return cmp < 0;
+	case DNET_IOP_LE:
+		return cmp <= 0;
+	case DNET_IOP_GT:
+		return cmp > 0;
+	case DNET_IOP_GE:
+		return cmp >= 0;
+	default:
+		return 0;
+	}
+}
 
-	/* Sanity */
-	if (ipriv == NULL || key == NULL || data == NULL || elist == NULL)
+static int dnet_iterator_match_key(const struct dnet_iterator_condition *c, const struct dnet_raw_id *key,
+		uint64_t size __unused, const struct dnet_ext_list *elist __unused)
+{
+	if (memcmp(key->id, c->key.id, c->prefix_bytes))
+		return 0;
+
+	return !c->prefix_mask || ((key->id[c->prefix_bytes] ^ c->key.id[c->prefix_bytes]) & c->prefix_mask) == 0;
+}
+
+static int dnet_iterator_match_timestamp(const struct dnet_iterator_condition *c, const struct dnet_raw_id *key __unused,
+		uint64_t size __unused, const struct dnet_ext_list *elist)
+{
+	return dnet_iterator_match_cmp(c->op, dnet_time_cmp(&elist->timestamp, &c->time));
+}
+
+static int dnet_iterator_match_user_flags(const struct dnet_iterator_condition *c, const struct dnet_raw_id *key __unused,
+		uint64_t size __unused, const struct dnet_ext_list *elist)
+{
+	switch (c->op) {
+	case DNET_IOP_ALL:
+		return (elist->flags & c->value) == c->value;
+	case DNET_IOP_ANY:
+		return (elist->flags & c->value) != 0;
+	case DNET_IOP_NONE:
+		return (elist->flags & c->value) == 0;
+	default:
+		return dnet_iterator_match_cmp(c->op, (elist->flags > c->value) - (elist->flags < c->value));
+	}
+}
+
+static int dnet_iterator_match_size(const struct dnet_iterator_condition *c, const struct dnet_raw_id *key __unused,
+		uint64_t size, const struct dnet_ext_list *elist __unused)
+{
+	return dnet_iterator_match_cmp(c->op, (size > c->value) - (size < c->value));
+}
+
+/*!
+ * Checks predicate term \a t and compiles it into \a c
+ */
+static int dnet_iterator_condition_compile(struct dnet_iterator_condition *c,
+		struct dnet_iterator_predicate_term *t)
+{
+	int compare = (t->op >= DNET_IOP_EQ && t->op <= DNET_IOP_GE);
+	int bits = (t->op >= DNET_IOP_ALL && t->op <= DNET_IOP_NONE);
+
+	memset(c, 0, sizeof(struct dnet_iterator_condition));
+	c->op = t->op;
+	c->value = t->value;
+	c->time = t->time;
+
+	switch (t->field) {
+	case DNET_IFIELD_KEY:
+		if (t->op != DNET_IOP_PREFIX || t->value > DNET_ID_SIZE * 8)
+			return -EINVAL;
+
+		c->match = dnet_iterator_match_key;
+		c->key = t->key;
+		c->prefix_bytes = t->value / 8;
+		c->prefix_mask = (0xff00 >> (t->value % 8)) & 0xff;
+		break;
+	case DNET_IFIELD_TIMESTAMP:
+		if (!compare)
+			return -EINVAL;
+		c->match = dnet_iterator_match_timestamp;
+		break;
+	case DNET_IFIELD_USER_FLAGS:
+		if (!compare && !bits)
+			return -EINVAL;
+		c->match = dnet_iterator_match_user_flags;
+		break;
+	case DNET_IFIELD_SIZE:
+		if (!compare)
+			return -EINVAL;
+		c->match = dnet_iterator_match_size;
+		break;
+	default:
 		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/*!
+ * Compiles predicate which follows ranges of \a ireq into \a ipriv->conditions
+ */
+static int dnet_iterator_predicate_compile(struct dnet_net_state *st, struct dnet_cmd *cmd,
+		struct dnet_iterator_request *ireq, struct dnet_iterator_common_private *ipriv)
+{
+	struct dnet_iterator_predicate *predicate;
+	uint64_t offset, i;
+	int err;
+
+	if (!(ireq->flags & DNET_IFLAGS_PREDICATE))
+		return 0;
+
+	/* Predicate follows request and ranges */
+	if (ireq->range_num > cmd->size / sizeof(struct dnet_iterator_range))
+		goto err_out_size;
+	offset = sizeof(struct dnet_iterator_request) + ireq->range_num * sizeof(struct dnet_iterator_range);
+	if (offset + sizeof(struct dnet_iterator_predicate) > cmd->size)
+		goto err_out_size;
+
+	predicate = (void *)ireq + offset;
+	dnet_convert_iterator_predicate(predicate);
+
+	offset += sizeof(struct dnet_iterator_predicate);
+	if (predicate->num > (cmd->size - offset) / sizeof(struct dnet_iterator_predicate_term))
+		goto err_out_size;
+
+	if (!predicate->num)
+		return 0;
+
+	ipriv->conditions = calloc(predicate->num, sizeof(struct dnet_iterator_condition));
+	if (!ipriv->conditions)
+		return -ENOMEM;
+
+	for (i = 0; i < predicate->num; ++i) {
+		dnet_convert_iterator_predicate_term(&predicate->terms[i]);
+
+		err = dnet_iterator_condition_compile(&ipriv->conditions[i], &predicate->terms[i]);
+		if (err) {
+			dnet_log(st->n, DNET_LOG_ERROR, "%s: invalid predicate term %" PRIu64 ": field: %u, op: %u\n",
+					dnet_dump_id(&cmd->id), i, predicate->terms[i].field, predicate->terms[i].op);
+			free(ipriv->conditions);
+			ipriv->conditions = NULL;
+			return err;
+		}
+	}
+	ipriv->conditions_num = predicate->num;
+
+	dnet_log(st->n, DNET_LOG_NOTICE, "%s: using predicate of %" PRIu64 " terms\n",
+			dnet_dump_id(&cmd->id), ipriv->conditions_num);
+	return 0;
+
+err_out_size:
+	dnet_log(st->n, DNET_LOG_ERROR, "%s: iterator predicate does not fit into request: size: %" PRIu64 "\n",
+			dnet_dump_id(&cmd->id), cmd->size);
+	return -EINVAL;
+}
+
+/*!
+ * Returns 1 if key or its timestamp are out of requested ranges
+ * or record of \a size bytes does not match predicate
+ */
+static int dnet_iterator_skip(struct dnet_iterator_common_private *ipriv, struct dnet_raw_id *key,
+		uint64_t size, struct dnet_ext_list *elist)
+{
+	struct dnet_iterator_condition *c;
 
 	/* If DNET_IFLAGS_KEY_RANGE is set... */
 	if (ipriv->req->flags & DNET_IFLAGS_KEY_RANGE) {
@@ -704,58 +1349,226 @@ static int dnet_iterator_callback_common(void *priv, struct dnet_raw_id *key,
 				goto key_range_found;
 		}
 		/* no range contains the key */
-		goto err_out_exit;
+		return 1;
 	}
 
-key_range_found:
+key_range_found:
+
+	/* If DNET_IFLAGS_TS_RANGE is set... */
+	if (ipriv->req->flags & DNET_IFLAGS_TS_RANGE)
+		/* ...skip ts not in ts range */
+			if (dnet_time_cmp(&elist->timestamp, &ipriv->req->time_begin) < 0
+					|| dnet_time_cmp(&elist->timestamp, &ipriv->req->time_end) > 0)
+				return 1;
+
+	for (c = ipriv->conditions; c < ipriv->conditions + ipriv->conditions_num; ++c)
+		if (!c->match(c, key, size, elist))
+			return 1;
+
+	return 0;
+}
+
+static void dnet_iterator_fill_response(struct dnet_iterator_response *response, struct dnet_raw_id *key,
+		uint64_t fsize, struct dnet_ext_list *elist)
+{
+	memset(response, 0, sizeof(struct dnet_iterator_response));
+	response->key = *key;
+	response->timestamp = elist->timestamp;
+	response->user_flags = elist->flags;
+	response->size = fsize;
+	dnet_convert_iterator_response(response);
+}
+
+/*
+ * Checkpoint is sent at most once per DNET_ITERATOR_CHECKPOINT_INTERVAL seconds
+ */
+#define DNET_ITERATOR_CHECKPOINT_INTERVAL	10
+
+/*!
+ * Prepares checkpoint token: copy of the first \a request_size bytes of the request
+ * in network byte order with DNET_ITERATOR_ACTION_RESUME action
+ */
+static int dnet_iterator_checkpoint_init(struct dnet_iterator_common_private *ipriv, uint64_t request_size)
+{
+	struct dnet_iterator_predicate *predicate;
+	struct dnet_iterator_request *req;
+	uint64_t i;
+
+	ipriv->token_size = request_size + sizeof(struct dnet_iterator_checkpoint);
+	ipriv->token = malloc(ipriv->token_size);
+	if (!ipriv->token)
+		return -ENOMEM;
+
+	memcpy(ipriv->token, ipriv->req, request_size);
+
+	req = ipriv->token;
+	req->action = DNET_ITERATOR_ACTION_RESUME;
+
+	/* Predicate has been converted when it was compiled */
+	if (req->flags & DNET_IFLAGS_PREDICATE) {
+		predicate = ipriv->token + sizeof(struct dnet_iterator_request)
+			+ req->range_num * sizeof(struct dnet_iterator_range);
+
+		for (i = 0; i < predicate->num; ++i)
+			dnet_convert_iterator_predicate_term(&predicate->terms[i]);
+		dnet_convert_iterator_predicate(predicate);
+	}
+
+	dnet_convert_iterator_request(req);
+
+	ipriv->checkpoint_time = time(NULL);
+	return 0;
+}
+
+/*!
+ * Backend callback which sends checkpoint at \a position if it is time to.
+ * Accumulated records are flushed first, so they precede checkpoint in the stream.
+ */
+static int dnet_iterator_checkpoint(void *priv, struct dnet_iterator_position *position)
+{
+	struct dnet_iterator_common_private *ipriv = priv;
+	struct dnet_net_state *st = ipriv->st;
+	struct dnet_iterator_checkpoint *checkpoint;
+	struct dnet_iterator_response response;
+	struct {
+		struct dnet_cmd			cmd;
+		struct dnet_iterator_batch	batch;
+		struct dnet_iterator_response	response;
+	} __attribute__ ((packed)) batch_header;
+	struct {
+		struct dnet_cmd			cmd;
+		struct dnet_iterator_response	response;
+	} __attribute__ ((packed)) header;
+	time_t now = time(NULL);
+	int err;
+
+	if (now < ipriv->checkpoint_time + DNET_ITERATOR_CHECKPOINT_INTERVAL)
+		return 0;
+	ipriv->checkpoint_time = now;
+
+	if (ipriv->flush_callback) {
+		err = ipriv->flush_callback(ipriv->next_private);
+		if (err)
+			return err;
+	}
+
+	err = dnet_iterator_check_state(st, ipriv->cmd);
+	if (err || st == st->n->st)
+		return err;
+
+	checkpoint = ipriv->token + ipriv->token_size - sizeof(struct dnet_iterator_checkpoint);
+	memset(checkpoint, 0, sizeof(struct dnet_iterator_checkpoint));
+	checkpoint->position = *position;
+	checkpoint->records = ipriv->records;
+	dnet_convert_iterator_checkpoint(checkpoint);
+
+	memset(&response, 0, sizeof(struct dnet_iterator_response));
+	response.id = ipriv->it->id;
+	response.status = DNET_ITERATOR_STATUS_CHECKPOINT;
+	response.size = ipriv->token_size;
+	dnet_convert_iterator_response(&response);
+
+	/* Checkpoint is sent as a full response with data, even if records are projected */
+	if (ipriv->req->flags & DNET_IFLAGS_BATCH) {
+		dnet_iterator_reply_header(&batch_header.cmd, ipriv->cmd, sizeof(struct dnet_iterator_batch)
+				+ sizeof(struct dnet_iterator_response) + ipriv->token_size);
+
+		memset(&batch_header.batch, 0, sizeof(struct dnet_iterator_batch));
+		batch_header.batch.num = 1;
+		batch_header.batch.flags = DNET_IFLAGS_DATA;
+		dnet_convert_iterator_batch(&batch_header.batch);
+		batch_header.response = response;
+
+		err = dnet_send_data(st, &batch_header, sizeof(batch_header), ipriv->token, ipriv->token_size);
+	} else {
+		dnet_iterator_reply_header(&header.cmd, ipriv->cmd,
+				sizeof(struct dnet_iterator_response) + ipriv->token_size);
+		header.response = response;
+
+		err = dnet_send_data(st, &header, sizeof(header), ipriv->token, ipriv->token_size);
+	}
+	if (err)
+		return err;
+
+	dnet_send_wait_threshold(st, 1);
+
+	dnet_log(st->n, DNET_LOG_INFO, "%s: iterator %" PRIu64 ": checkpoint: records: %" PRIu64 "\n",
+			dnet_dump_id(&ipriv->cmd->id), ipriv->it->id, ipriv->records);
+	return 0;
+}
+
+/*!
+ * Common callback part that is run by all iterator types.
+ * It's responsible for sanity checks and flow control.
+ *
+ * Also now it "prepares" data for next callback by filling
+ * fixed-size response header which precedes data.
+ */
+static int dnet_iterator_callback_common(void *priv, struct dnet_raw_id *key,
+		void *data, uint64_t dsize, struct dnet_ext_list *elist)
+{
+	struct dnet_iterator_common_private *ipriv = priv;
+	struct dnet_iterator_response response;
+	const uint64_t fsize = dsize;
+	int err;
+
+	/* Sanity */
+	if (ipriv == NULL || key == NULL || data == NULL || elist == NULL)
+		return -EINVAL;
 
-	/* If DNET_IFLAGS_TS_RANGE is set... */
-	if (ipriv->req->flags & DNET_IFLAGS_TS_RANGE)
-		/* ...skip ts not in ts range */
-			if (dnet_time_cmp(&elist->timestamp, &ipriv->req->time_begin) < 0
-					|| dnet_time_cmp(&elist->timestamp, &ipriv->req->time_end) > 0)
-				goto err_out_exit;
+	ipriv->records++;
+
+	if (dnet_iterator_skip(ipriv, key, fsize, elist))
+		return 0;
 
 	/* Set data to NULL in case it's not requested */
 	if (!(ipriv->req->flags & DNET_IFLAGS_DATA)) {
 		data = NULL;
 		dsize = 0;
 	}
-	size = response_size + dsize;
 
-	/* Prepare combined buffer */
-	position = combined = malloc(size);
-	if (combined == NULL) {
-		err = -ENOMEM;
-		goto err_out_exit;
+	dnet_iterator_fill_response(&response, key, fsize, elist);
+
+	/* Finally run next callback */
+	err = ipriv->next_callback(ipriv->next_private, &response, data, dsize);
+	if (err)
+		return err;
+
+	/* Check that we are allowed to run */
+	return dnet_iterator_flow_control(ipriv);
+}
+
+/*!
+ * Same as dnet_iterator_callback_common() for data which is stored at \a offset of \a fd.
+ * It is set only when data is requested and takes ownership of \a fd.
+ */
+static int dnet_iterator_callback_common_fd(void *priv, struct dnet_raw_id *key,
+		int fd, uint64_t offset, uint64_t dsize, struct dnet_ext_list *elist)
+{
+	struct dnet_iterator_common_private *ipriv = priv;
+	struct dnet_iterator_response response;
+	int err;
+
+	/* Sanity */
+	if (ipriv == NULL || key == NULL || elist == NULL) {
+		close(fd);
+		return -EINVAL;
 	}
 
-	/* Response */
-	response = (struct dnet_iterator_response *)combined;
-	memset(response, 0, response_size);
-	response->key = *key;
-	response->timestamp = elist->timestamp;
-	response->user_flags = elist->flags;
-	response->size = fsize;
-	dnet_convert_iterator_response(response);
+	ipriv->records++;
 
-	/* Data */
-	if (data) {
-		position += response_size;
-		memcpy(position, data, dsize);
+	if (dnet_iterator_skip(ipriv, key, dsize, elist)) {
+		close(fd);
+		return 0;
 	}
 
-	/* Finally run next callback */
-	err = ipriv->next_callback(ipriv->next_private, combined, size);
-	if (err)
-		goto err_out_exit;
+	dnet_iterator_fill_response(&response, key, dsize, elist);
 
-	/* Check that we are allowed to run */
-	err = dnet_iterator_flow_control(ipriv);
+	err = ipriv->next_fd_callback(ipriv->next_private, &response, fd, offset, dsize);
+	if (err)
+		return err;
 
-err_out_exit:
-	free(combined);
-	return err;
+	return dnet_iterator_flow_control(ipriv);
 }
 
 static int dnet_iterator_check_key_range(struct dnet_net_state *st, struct dnet_cmd *cmd,
@@ -832,9 +1645,13 @@ static int dnet_iterator_check_ts_range(struct dnet_net_state *st, struct dnet_c
 	return 0;
 }
 
+/*!
+ * Starts iterator, \a checkpoint is not NULL if it is resumed
+ */
 static int dnet_iterator_start(struct dnet_net_state *st, struct dnet_cmd *cmd,
 		struct dnet_iterator_request *ireq,
-		struct dnet_iterator_range *irange)
+		struct dnet_iterator_range *irange,
+		struct dnet_iterator_checkpoint *checkpoint)
 {
 	struct dnet_iterator_common_private cpriv = {
 		.req = ireq,
@@ -846,7 +1663,10 @@ static int dnet_iterator_start(struct dnet_net_state *st, struct dnet_cmd *cmd,
 		.callback_private = &cpriv,
 	};
 	struct dnet_iterator_send_private spriv;
+	struct dnet_iterator_batch_private bpriv;
 	struct dnet_iterator_file_private fpriv;
+	char path[sizeof(st->n->iterator_dir) + 32];
+	int result_fd = -1;
 	int err;
 
 	/* Check flags */
@@ -863,48 +1683,341 @@ static int dnet_iterator_start(struct dnet_net_state *st, struct dnet_cmd *cmd,
 	if ((err = dnet_iterator_check_key_range(st, cmd, ireq, irange)) ||
 			(err = dnet_iterator_check_ts_range(st, cmd, ireq)))
 		goto err_out_exit;
+	/* Check projection */
+	if ((ireq->flags & DNET_IFLAGS_PROJECTION) && (ireq->fields & ~DNET_IFIELD_ALL)) {
+		err = -ENOTSUP;
+		goto err_out_exit;
+	}
+	/* Data can not be found without its size */
+	if (ireq->flags & DNET_IFLAGS_DATA)
+		ireq->fields |= DNET_IFIELD_SIZE;
+
+	err = dnet_iterator_predicate_compile(st, cmd, ireq, &cpriv);
+	if (err)
+		goto err_out_exit;
+
+	/* Checkpoint token repeats request, resumed request is ended by the previous checkpoint */
+	if (ireq->flags & DNET_IFLAGS_CHECKPOINT) {
+		cpriv.st = st;
+		cpriv.cmd = cmd;
+
+		err = dnet_iterator_checkpoint_init(&cpriv,
+				cmd->size - (checkpoint ? sizeof(struct dnet_iterator_checkpoint) : 0));
+		if (err)
+			goto err_out_free_conditions;
+
+		ictl.checkpoint = dnet_iterator_checkpoint;
+	}
+	if (checkpoint) {
+		ictl.position = checkpoint->position;
+		cpriv.records = checkpoint->records;
+	}
+
+	memset(&bpriv, 0, sizeof(struct dnet_iterator_batch_private));
+	INIT_LIST_HEAD(&bpriv.chunks);
+	memset(&fpriv, 0, sizeof(struct dnet_iterator_file_private));
+	fpriv.fd = -1;
 
 	switch (ireq->itype) {
 	case DNET_ITYPE_NETWORK:
+		/* Checkpoint can not be told from projected record without batch header */
+		if ((ireq->flags & (DNET_IFLAGS_CHECKPOINT | DNET_IFLAGS_PROJECTION | DNET_IFLAGS_BATCH))
+				== (DNET_IFLAGS_CHECKPOINT | DNET_IFLAGS_PROJECTION)) {
+			err = -ENOTSUP;
+			goto err_out_free_conditions;
+		}
+
+		if (ireq->flags & DNET_IFLAGS_BATCH) {
+			bpriv.st = st;
+			bpriv.cmd = cmd;
+			bpriv.flags = ireq->flags & (DNET_IFLAGS_DATA | DNET_IFLAGS_PROJECTION);
+			bpriv.fields = ireq->fields;
+
+			cpriv.next_callback = dnet_iterator_callback_batch;
+			cpriv.next_fd_callback = dnet_iterator_callback_batch_fd;
+			cpriv.flush_callback = dnet_iterator_batch_flush;
+			cpriv.next_private = &bpriv;
+			break;
+		}
+
 		memset(&spriv, 0, sizeof(struct dnet_iterator_send_private));
 
 		spriv.st = st;
 		spriv.cmd = cmd;
+		spriv.flags = ireq->flags & DNET_IFLAGS_PROJECTION;
+		spriv.fields = ireq->fields;
 
 		cpriv.next_callback = dnet_iterator_callback_send;
+		cpriv.next_fd_callback = dnet_iterator_callback_send_fd;
 		cpriv.next_private = &spriv;
 		break;
 	case DNET_ITYPE_DISK:
-		memset(&fpriv, 0, sizeof(struct dnet_iterator_file_private));
+		/* Result is sorted in place, so it consists of fixed-size responses only */
+		if (ireq->flags & (DNET_IFLAGS_DATA | DNET_IFLAGS_BATCH | DNET_IFLAGS_PROJECTION
+					| DNET_IFLAGS_CHECKPOINT)) {
+			err = -ENOTSUP;
+			goto err_out_free_conditions;
+		}
+
+		fpriv.st = st;
+		fpriv.cmd = cmd;
+
+		result_fd = dnet_iterator_file_create(st->n, &fpriv, path, sizeof(path));
+		if (result_fd < 0) {
+			err = result_fd;
+			goto err_out_free_conditions;
+		}
+
 		cpriv.next_callback = dnet_iterator_callback_file;
+		cpriv.flush_callback = dnet_iterator_file_flush;
 		cpriv.next_private = &fpriv;
-		/* TODO: Implement local file-based iterators */
-		err = -ENOTSUP;
-		goto err_out_exit;
+		break;
 	default:
 		err = -EINVAL;
-		goto err_out_exit;
+		goto err_out_free_conditions;
 	}
 
 	/* Create iterator */
 	cpriv.it = dnet_iterator_create(st->n);
 	if (cpriv.it == NULL) {
 		err = -ENOMEM;
-		goto err_out_exit;
+		goto err_out_close_result;
 	}
+	fpriv.it = cpriv.it;
+
+	/* Backend may pass file location of the data only if data is requested */
+	if ((ireq->flags & DNET_IFLAGS_DATA) && cpriv.next_fd_callback)
+		ictl.fd_callback = dnet_iterator_callback_common_fd;
 
 	/* Run iterator */
 	err = st->n->cb->iterator(&ictl);
+	if (!err && cpriv.flush_callback)
+		err = cpriv.flush_callback(cpriv.next_private);
+	dnet_iterator_batch_cleanup(&bpriv);
+
+	/* Sort disk iterator result, so it can be read by key ranges */
+	if (!err && result_fd >= 0) {
+		err = dnet_iterator_response_container_merge_sort(fpriv.fd, fpriv.size, result_fd,
+				dnet_iterator_file_sort_progress, &fpriv);
+		if (!err)
+			err = dnet_iterator_file_reply(&fpriv, 0);
+	}
 
 	/* Remove iterator */
 	dnet_iterator_destroy(st->n, cpriv.it);
 
+err_out_close_result:
+	if (result_fd >= 0) {
+		if (err)
+			unlink(path);
+		close(result_fd);
+		close(fpriv.fd);
+		free(fpriv.buf);
+	}
+err_out_free_conditions:
+	free(cpriv.token);
+	free(cpriv.conditions);
 err_out_exit:
 	dnet_log(st->n, DNET_LOG_NOTICE, "%s: %s: iteration finished: err: %d\n",
 			__func__, dnet_dump_id(&cmd->id), err);
 	return err;
 }
 
+/*!
+ * Returns index of the first record of sorted result \a fd whose key is not less than \a key
+ */
+static int64_t dnet_iterator_result_lower_bound(int fd, uint64_t num, struct dnet_raw_id *key)
+{
+	const uint64_t resp_size = sizeof(struct dnet_iterator_response);
+	struct dnet_raw_id current;
+	uint64_t begin = 0, end = num, middle;
+	ssize_t err;
+
+	while (begin < end) {
+		middle = begin + (end - begin) / 2;
+
+		err = pread(fd, &current, sizeof(struct dnet_raw_id),
+				middle * resp_size + offsetof(struct dnet_iterator_response, key));
+		if (err != sizeof(struct dnet_raw_id))
+			return (err == -1) ? -errno : -EINTR;
+
+		if (dnet_id_cmp_str(current.id, key->id) < 0)
+			begin = middle + 1;
+		else
+			end = middle;
+	}
+
+	return begin;
+}
+
+/*!
+ * Sends records [\a begin, \a end) of result \a fd in batched replies.
+ * Records are sent from file, frames account for their records in send queue.
+ */
+static int dnet_iterator_result_send(struct dnet_net_state *st, struct dnet_cmd *cmd, int fd,
+		uint64_t begin, uint64_t end)
+{
+	const uint64_t resp_size = sizeof(struct dnet_iterator_response);
+	const uint64_t frame_num = DNET_ITERATOR_BATCH_SIZE / resp_size;
+	struct dnet_iterator_batch *header;
+	struct dnet_io_req *r;
+	LIST_HEAD(frame);
+	uint64_t num;
+	int err;
+
+	for (; begin < end; begin += num) {
+		num = end - begin;
+		if (num > frame_num)
+			num = frame_num;
+
+		err = dnet_iterator_check_state(st, cmd);
+		if (err)
+			return err;
+
+		r = calloc(1, sizeof(struct dnet_io_req) + sizeof(struct dnet_cmd) + sizeof(struct dnet_iterator_batch));
+		if (!r)
+			return -ENOMEM;
+
+		r->fd = dup(fd);
+		if (r->fd < 0) {
+			err = -errno;
+			free(r);
+			return err;
+		}
+
+		r->header = r + 1;
+		r->hsize = sizeof(struct dnet_cmd) + sizeof(struct dnet_iterator_batch);
+		r->local_offset = begin * resp_size;
+		r->fsize = num * resp_size;
+		r->on_exit = DNET_IO_REQ_FLAGS_CLOSE;
+		r->queue_weight = num;
+
+		dnet_iterator_reply_header(r->header, cmd, sizeof(struct dnet_iterator_batch) + r->fsize);
+		header = r->header + sizeof(struct dnet_cmd);
+		header->num = num;
+		dnet_convert_iterator_batch(header);
+
+		list_add_tail(&r->req_entry, &frame);
+		err = dnet_io_req_queue_list(st, &frame);
+		if (err)
+			return err;
+
+		dnet_send_wait_threshold(st, num);
+	}
+
+	return 0;
+}
+
+/*!
+ * Sends result of disk iterator \a ireq->id, whole or only records within key ranges
+ */
+static int dnet_iterator_result_read(struct dnet_net_state *st, struct dnet_cmd *cmd,
+		struct dnet_iterator_request *ireq,
+		struct dnet_iterator_range *irange)
+{
+	const uint64_t resp_size = sizeof(struct dnet_iterator_response);
+	char path[sizeof(st->n->iterator_dir) + 32];
+	struct stat stat;
+	int64_t begin, end;
+	uint64_t i, num;
+	int fd, err;
+
+	if (st == st->n->st)
+		return -ENOTSUP;
+
+	err = dnet_iterator_check_key_range(st, cmd, ireq, irange);
+	if (err)
+		return err;
+
+	err = dnet_iterator_file_path(st->n, ireq->id, path, sizeof(path));
+	if (err)
+		return err;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		err = -errno;
+		goto err_out_exit;
+	}
+
+	if (fstat(fd, &stat)) {
+		err = -errno;
+		goto err_out_close;
+	}
+
+	if (stat.st_size % resp_size) {
+		err = -EINVAL;
+		goto err_out_close;
+	}
+	num = stat.st_size / resp_size;
+
+	if (!(ireq->flags & DNET_IFLAGS_KEY_RANGE)) {
+		err = dnet_iterator_result_send(st, cmd, fd, 0, num);
+		goto err_out_close;
+	}
+
+	for (i = 0; i < ireq->range_num; ++i) {
+		begin = dnet_iterator_result_lower_bound(fd, num, &irange[i].key_begin);
+		end = dnet_iterator_result_lower_bound(fd, num, &irange[i].key_end);
+		if (begin < 0 || end < 0) {
+			err = (begin < 0) ? begin : end;
+			goto err_out_close;
+		}
+
+		err = dnet_iterator_result_send(st, cmd, fd, begin, end);
+		if (err)
+			goto err_out_close;
+	}
+
+err_out_close:
+	close(fd);
+err_out_exit:
+	dnet_log(st->n, DNET_LOG_NOTICE, "%s: %s: read iterator result: %s, err: %d\n",
+			__func__, dnet_dump_id(&cmd->id), path, err);
+	return err;
+}
+
+/*!
+ * Removes result of disk iterator \a id
+ */
+static int dnet_iterator_result_remove(struct dnet_net_state *st, struct dnet_cmd *cmd, uint64_t id)
+{
+	char path[sizeof(st->n->iterator_dir) + 32];
+	int err;
+
+	err = dnet_iterator_file_path(st->n, id, path, sizeof(path));
+	if (err)
+		return err;
+
+	if (unlink(path))
+		err = -errno;
+
+	dnet_log(st->n, DNET_LOG_NOTICE, "%s: %s: removed iterator result: %s, err: %d\n",
+			__func__, dnet_dump_id(&cmd->id), path, err);
+	return err;
+}
+
+/*!
+ * Starts iterator from the checkpoint token, which is ended by struct dnet_iterator_checkpoint
+ */
+static int dnet_iterator_resume(struct dnet_net_state *st, struct dnet_cmd *cmd,
+		struct dnet_iterator_request *ireq,
+		struct dnet_iterator_range *irange)
+{
+	struct dnet_iterator_checkpoint checkpoint;
+
+	if (cmd->size < sizeof(struct dnet_iterator_request) + sizeof(struct dnet_iterator_checkpoint))
+		return -EINVAL;
+
+	memcpy(&checkpoint, (void *)ireq + cmd->size - sizeof(struct dnet_iterator_checkpoint),
+			sizeof(struct dnet_iterator_checkpoint));
+	dnet_convert_iterator_checkpoint(&checkpoint);
+
+	dnet_log(st->n, DNET_LOG_NOTICE, "%s: resuming iterator after %" PRIu64 " records\n",
+			dnet_dump_id(&cmd->id), checkpoint.records);
+
+	return dnet_iterator_start(st, cmd, ireq, irange, &checkpoint);
+}
+
 /*!
  * Starts low-level backend iterator and passes data to network or file
  */
@@ -930,16 +2043,27 @@ static int dnet_cmd_iterator(struct dnet_net_state *st, struct dnet_cmd *cmd, vo
 	 * On pause, find in list and mark as stopped
 	 * On cont, find in list and mark as running, broadcast condition variable.
 	 * On start, (surprise!) create and start iterator.
+	 * On read/remove, send or remove result file of disk iterator.
+	 * On resume, start iterator from the checkpoint.
 	 */
 	switch (ireq->action) {
 	case DNET_ITERATOR_ACTION_START:
-		err = dnet_iterator_start(st, cmd, ireq, irange);
+		err = dnet_iterator_start(st, cmd, ireq, irange, NULL);
+		break;
+	case DNET_ITERATOR_ACTION_RESUME:
+		err = dnet_iterator_resume(st, cmd, ireq, irange);
 		break;
 	case DNET_ITERATOR_ACTION_PAUSE:
 	case DNET_ITERATOR_ACTION_CONTINUE:
 	case DNET_ITERATOR_ACTION_CANCEL:
 		err = dnet_iterator_set_state(st->n, ireq->action, ireq->id);
 		break;
+	case DNET_ITERATOR_ACTION_READ:
+		err = dnet_iterator_result_read(st, cmd, ireq, irange);
+		break;
+	case DNET_ITERATOR_ACTION_REMOVE:
+		err = dnet_iterator_result_remove(st, cmd, ireq->id);
+		break;
 	default:
 		err = -EINVAL;
 		goto err_out_exit;
@@ -952,12 +2076,55 @@ err_out_exit:
 	return err;
 }
 
+/*
+ * Sends object from the cache if it is there.
+ * Returns -ENOTSUP if object should be read from the backend, otherwise the reply has been sent.
+ */
+static int dnet_bulk_read_cache(struct dnet_net_state *st, struct dnet_cmd *cmd, struct dnet_io_attr *io)
+{
+	struct dnet_node *n = st->n;
+	struct dnet_cmd read_cmd = *cmd;
+	struct timeval start;
+	int err;
+
+	if (!n->cache || (io->flags & DNET_IO_FLAGS_NOCACHE))
+		return -ENOTSUP;
+
+	if (dnet_cache_check_missing(n, io->id)) {
+		err = -ENOENT;
+	} else {
+		gettimeofday(&start, NULL);
+
+		err = dnet_cmd_cache_io(st, &read_cmd, io, NULL);
+		if (err == -ENOTSUP)
+			return err;
+
+		if (err == -ENOENT && !(io->flags & DNET_IO_FLAGS_CACHE_ONLY))
+			dnet_cache_insert_missing(n, io->id, &start);
+	}
+
+	dnet_send_ack(st, &read_cmd, err, 1);
+	return err;
+}
+
+/*
+ * Bulk read succeeds if at least one object was read, otherwise it returns the first error
+ */
+static void dnet_bulk_read_status(int *err, int ret)
+{
+	if (!ret)
+		*err = 0;
+	else if (*err == -1)
+		*err = ret;
+}
+
 static int dnet_cmd_bulk_read(struct dnet_net_state *st, struct dnet_cmd *cmd, void *data)
 {
+	struct dnet_node *n = st->n;
 	int err = -1, ret;
 	struct dnet_io_attr *io = data;
 	struct dnet_io_attr *ios = io + 1;
-	uint64_t count = 0;
+	uint64_t count = 0, backend_count = 0;
 	uint64_t i;
 
 	struct dnet_cmd read_cmd = *cmd;
@@ -965,9 +2132,21 @@ static int dnet_cmd_bulk_read(struct dnet_net_state *st, struct dnet_cmd *cmd, v
 	read_cmd.cmd = DNET_CMD_READ;
 	read_cmd.flags |= DNET_FLAGS_MORE;
 
+	if (cmd->size < sizeof(struct dnet_io_attr)) {
+		dnet_log(n, DNET_LOG_ERROR, "%s: invalid BULK_READ size: %llu\n",
+			dnet_dump_id(&cmd->id), (unsigned long long)cmd->size);
+		return -EINVAL;
+	}
+
 	dnet_convert_io_attr(io);
 	count = io->size / sizeof(struct dnet_io_attr);
 
+	if (cmd->size < sizeof(struct dnet_io_attr) * (count + 1)) {
+		dnet_log(n, DNET_LOG_ERROR, "%s: invalid BULK_READ size: %llu, commands: %llu\n",
+			dnet_dump_id(&cmd->id), (unsigned long long)cmd->size, (unsigned long long)count);
+		return -EINVAL;
+	}
+
 	if (count > 0) {
 		cmd->flags &= ~DNET_FLAGS_NEED_ACK;
 	}
@@ -977,28 +2156,62 @@ static int dnet_cmd_bulk_read(struct dnet_net_state *st, struct dnet_cmd *cmd, v
 	 * Lock will be taken again after loop has been finished
 	 */
 	if (!(cmd->flags & DNET_FLAGS_NOLOCK)) {
-		dnet_opunlock(st->n, &cmd->id);
+		dnet_opunlock(n, &cmd->id);
 	}
 
-	dnet_log(st->n, DNET_LOG_NOTICE, "%s: starting BULK_READ for %d commands\n",
+	dnet_log(n, DNET_LOG_NOTICE, "%s: starting BULK_READ for %d commands\n",
 		dnet_dump_id(&cmd->id), (int) count);
 
+	/*
+	 * Cached objects are sent right away, the rest are moved to the beginning of the array,
+	 * so the backend gets a bulk request of its own and can read them in the order it likes.
+	 */
 	for (i = 0; i < count; i++) {
-		ret = dnet_process_cmd_raw(st, &read_cmd, &ios[i], 1);
-		dnet_log(st->n, DNET_LOG_NOTICE, "%s: processing BULK_READ.READ for %d/%d command, err: %d\n",
-			dnet_dump_id(&cmd->id), (int) i, (int) count, ret);
+		dnet_convert_io_attr(&ios[i]);
+
+		if (n->flags & DNET_CFG_NO_CSUM)
+			ios[i].flags |= DNET_IO_FLAGS_NOCSUM;
+
+		ret = dnet_bulk_read_cache(st, &read_cmd, &ios[i]);
+		if (ret == -ENOTSUP) {
+			dnet_convert_io_attr(&ios[i]);
+			ios[backend_count++] = ios[i];
+			continue;
+		}
+
+		dnet_bulk_read_status(&err, ret);
+	}
+
+	if (backend_count) {
+		struct dnet_cmd bulk_cmd = *cmd;
+
+		io->size = backend_count * sizeof(struct dnet_io_attr);
+		bulk_cmd.size = sizeof(struct dnet_io_attr) + io->size;
+		dnet_convert_io_attr(io);
+
+		ret = n->cb->command_handler(st, n->cb->command_private, &bulk_cmd, data);
+		if (ret != -ENOTSUP) {
+			dnet_log(n, DNET_LOG_NOTICE, "%s: backend processed BULK_READ for %d/%d commands, err: %d\n",
+				dnet_dump_id(&cmd->id), (int) backend_count, (int) count, ret);
 
-		if (i + 1 == count)
-			cmd->flags |= DNET_FLAGS_NEED_ACK;
+			dnet_bulk_read_status(&err, ret);
+		} else {
+			for (i = 0; i < backend_count; i++) {
+				ret = dnet_process_cmd_raw(st, &read_cmd, &ios[i], 1);
+				dnet_log(n, DNET_LOG_NOTICE, "%s: processing BULK_READ.READ for %d/%d command, err: %d\n",
+					dnet_dump_id(&cmd->id), (int) i, (int) backend_count, ret);
+
+				dnet_bulk_read_status(&err, ret);
+			}
+		}
+	}
 
-		if (!ret)
-			err = 0;
-		else if (err == -1)
-			err = ret;
+	if (count > 0) {
+		cmd->flags |= DNET_FLAGS_NEED_ACK;
 	}
 
 	if (!(cmd->flags & DNET_FLAGS_NOLOCK)) {
-		dnet_oplock(st->n, &cmd->id);
+		dnet_oplock(n, &cmd->id);
 	}
 
 	return err;
@@ -1057,9 +2270,7 @@ int dnet_process_cmd_raw(struct dnet_net_state *st, struct dnet_cmd *cmd, void *
 	struct dnet_node *n = st->n;
 	unsigned long long tid = cmd->trans & ~DNET_TRANS_REPLY;
 	struct dnet_io_attr *io = NULL;
-#if 0
 	struct dnet_indexes_request *indexes_request;
-#endif
 	struct timeval start, end;
 	char time_str[64];
 	struct tm io_tm;
@@ -1098,18 +2309,21 @@ int dnet_process_cmd_raw(struct dnet_net_state *st, struct dnet_cmd *cmd, void *
 		case DNET_CMD_ITERATOR:
 			err = dnet_cmd_iterator(st, cmd, data);
 			break;
+		case DNET_CMD_HASH_TREE:
+			err = dnet_cmd_hash_tree(st, cmd, data);
+			break;
 		case DNET_CMD_INDEXES_UPDATE:
 		case DNET_CMD_INDEXES_INTERNAL:
 		case DNET_CMD_INDEXES_FIND:
-#if 0 // We don't want specially process this commands yet
 			indexes_request = (struct dnet_indexes_request*)data;
 			if (!(indexes_request->flags & DNET_IO_FLAGS_NOCACHE)) {
 				err = dnet_cmd_cache_indexes(st, cmd, indexes_request);
 
-				if (err != -ENOTSUP)
-					return err;
+				if (err != -ENOTSUP) {
+					handled_in_cache = 1;
+					break;
+				}
 			}
-#endif
 
 			err = dnet_process_indexes(st, cmd, data);
 			break;
@@ -1134,11 +2348,7 @@ int dnet_process_cmd_raw(struct dnet_net_state *st, struct dnet_cmd *cmd, void *
 				err = dnet_notify_remove(st, cmd);
 			break;
 		case DNET_CMD_BULK_READ:
-			err = n->cb->command_handler(st, n->cb->command_private, cmd, data);
-
-			if (err == -ENOTSUP) {
-				err = dnet_cmd_bulk_read(st, cmd, data);
-			}
+			err = dnet_cmd_bulk_read(st, cmd, data);
 			break;
 		case DNET_CMD_READ:
 		case DNET_CMD_WRITE:
@@ -1183,10 +2393,25 @@ int dnet_process_cmd_raw(struct dnet_net_state *st, struct dnet_cmd *cmd, void *
 			if (n->flags & DNET_CFG_NO_CSUM)
 				io->flags |= DNET_IO_FLAGS_NOCSUM;
 
+			/* Every write forgets that object was missing, even if it goes directly to the backend */
+			if (cmd->cmd == DNET_CMD_WRITE) {
+				dnet_cache_remove_missing(n, io->id);
+			}
+
 			if (!(io->flags & DNET_IO_FLAGS_NOCACHE)) {
+				if (cmd->cmd == DNET_CMD_READ && dnet_cache_check_missing(n, io->id)) {
+					err = -ENOENT;
+					handled_in_cache = 1;
+					break;
+				}
+
 				err = dnet_cmd_cache_io(st, cmd, io, data + sizeof(struct dnet_io_attr));
 
 				if (err != -ENOTSUP) {
+					/* Cache returns -ENOENT only if its backend read missed or object was removed meanwhile */
+					if (err == -ENOENT && cmd->cmd == DNET_CMD_READ && !(io->flags & DNET_IO_FLAGS_CACHE_ONLY))
+						dnet_cache_insert_missing(n, io->id, &start);
+
 					handled_in_cache = 1;
 					break;
 				}
@@ -1202,6 +2427,12 @@ int dnet_process_cmd_raw(struct dnet_net_state *st, struct dnet_cmd *cmd, void *
 			dnet_convert_io_attr(io);
 		default:
 			if (cmd->cmd == DNET_CMD_LOOKUP && !(cmd->flags & DNET_FLAGS_NOCACHE)) {
+				if (dnet_cache_check_missing(n, cmd->id.id)) {
+					err = -ENOENT;
+					handled_in_cache = 1;
+					break;
+				}
+
 				err = dnet_cmd_cache_lookup(st, cmd);
 
 				if (err != -ENOTSUP) {
@@ -1228,6 +2459,18 @@ int dnet_process_cmd_raw(struct dnet_net_state *st, struct dnet_cmd *cmd, void *
 			if (!err && (cmd->cmd == DNET_CMD_WRITE)) {
 				dnet_update_notify(st, cmd, data);
 			}
+
+			/*
+			 * Backend request started before any write which could race with it, so its miss is still valid.
+			 * NOCACHE requests are issued by the cache itself, e.g. lookup of dirty object
+			 * which is not on the disk yet, their misses are not remembered.
+			 */
+			if (err == -ENOENT) {
+				if (cmd->cmd == DNET_CMD_READ && !(io->flags & DNET_IO_FLAGS_NOCACHE))
+					dnet_cache_insert_missing(n, io->id, &start);
+				else if (cmd->cmd == DNET_CMD_LOOKUP && !(cmd->flags & DNET_FLAGS_NOCACHE))
+					dnet_cache_insert_missing(n, cmd->id.id, &start);
+			}
 			break;
 	}
 
@@ -1442,7 +2685,7 @@ int dnet_send_read_data(void *state, struct dnet_cmd *cmd, struct dnet_io_attr *
 	dnet_convert_cmd(c);
 	dnet_convert_io_attr(rio);
 
-	if (io->flags & DNET_IO_FLAGS_CHECKSUM) {
+	if ((io->flags & DNET_IO_FLAGS_CHECKSUM) && !(on_exit & DNET_IO_REQ_FLAGS_CHECKSUM_READY)) {
 		if (data) {
 			err = dnet_checksum_data(n, data, rio->size, rio->parent, sizeof(rio->parent));
 		} else {
@@ -1458,7 +2701,7 @@ int dnet_send_read_data(void *state, struct dnet_cmd *cmd, struct dnet_io_attr *
 	if (data)
 		err = dnet_send_data(st, c, hsize, data, rio->size);
 	else
-		err = dnet_send_fd(st, c, hsize, fd, offset, rio->size, on_exit);
+		err = dnet_send_fd(st, c, hsize, fd, offset, rio->size, on_exit & ~DNET_IO_REQ_FLAGS_CHECKSUM_READY);
 
 	gettimeofday(&send_tv, NULL);
 
@@ -61,6 +61,25 @@ int dnet_transform(struct dnet_session *s, const void *src, uint64_t size, struc
 	return dnet_transform_raw(s, src, size, (char *)id->id, sizeof(id->id));
 }
 
+int dnet_transform_batch(struct dnet_session *s, const void * const *src, const uint64_t *size, int num,
+		struct dnet_raw_id *ids)
+{
+	struct dnet_node *n = s->node;
+	struct dnet_transform *t = &n->transform;
+	int i, err;
+
+	if (t->transform_batch)
+		return t->transform_batch(t->priv, s, src, size, num, ids, sizeof(ids->id), 0);
+
+	for (i = 0; i < num; ++i) {
+		err = dnet_transform_raw(s, src[i], size[i], (char *)ids[i].id, sizeof(ids[i].id));
+		if (err)
+			return err;
+	}
+
+	return 0;
+}
+
 static void dnet_indexes_transform_id(struct dnet_node *node, const uint8_t *src, uint8_t *id,
 				      const char *suffix, int suffix_len)
 {
@@ -153,6 +172,7 @@ static char *dnet_cmd_strings[] = {
 	[DNET_CMD_INDEXES_UPDATE] = "INDEXES_UPDATE",
 	[DNET_CMD_INDEXES_INTERNAL] = "INDEXES_INTERNAL",
 	[DNET_CMD_INDEXES_FIND] = "INDEXES_FIND",
+	[DNET_CMD_HASH_TREE] = "HASH_TREE",
 	[DNET_CMD_UNKNOWN] = "UNKNOWN",
 };
 
@@ -1782,6 +1802,7 @@ err_out_exit:
 struct dnet_update_status_priv {
 	struct dnet_wait *w;
 	struct dnet_node_status status;
+	struct dnet_cache_control cache;
 	atomic_t refcnt;
 };
 
@@ -1808,14 +1829,22 @@ static int dnet_update_status_complete(struct dnet_net_state *state, struct dnet
 		return 0;
 	}
 
+	if (cmd->size == sizeof(struct dnet_node_status) + sizeof(struct dnet_cache_control)) {
+		memcpy(&p->status, cmd + 1, sizeof(struct dnet_node_status));
+		memcpy(&p->cache, (char *)(cmd + 1) + sizeof(struct dnet_node_status), sizeof(struct dnet_cache_control));
+		return 0;
+	}
+
 	return -ENOENT;
 }
 
-int dnet_update_status(struct dnet_session *s, struct dnet_addr *addr, struct dnet_id *id, struct dnet_node_status *status)
+static int dnet_update_status_raw(struct dnet_session *s, struct dnet_addr *addr, struct dnet_id *id,
+		struct dnet_node_status *status, struct dnet_cache_control *cache)
 {
 	int err;
 	struct dnet_update_status_priv *priv;
 	struct dnet_trans_control ctl;
+	char request[sizeof(struct dnet_node_status) + sizeof(struct dnet_cache_control)];
 
 	if (!id && !addr) {
 		err = -EINVAL;
@@ -1845,6 +1874,9 @@ int dnet_update_status(struct dnet_session *s, struct dnet_addr *addr, struct dn
 		goto err_out_exit;
 	}
 
+	/* Nodes which do not know cache control reply with status only, pages_number stays zero then */
+	memset(priv, 0, sizeof(struct dnet_update_status_priv));
+
 	atomic_init(&priv->refcnt, 1);
 
 	priv->w = dnet_wait_alloc(0);
@@ -1860,6 +1892,14 @@ int dnet_update_status(struct dnet_session *s, struct dnet_addr *addr, struct dn
 	ctl.size = sizeof(struct dnet_node_status);
 	ctl.data = status;
 
+	if (cache) {
+		memcpy(request, status, sizeof(struct dnet_node_status));
+		memcpy(request + sizeof(struct dnet_node_status), cache, sizeof(struct dnet_cache_control));
+
+		ctl.size = sizeof(request);
+		ctl.data = request;
+	}
+
 	dnet_wait_get(priv->w);
 	atomic_inc(&priv->refcnt);
 
@@ -1869,6 +1909,8 @@ int dnet_update_status(struct dnet_session *s, struct dnet_addr *addr, struct dn
 	dnet_wait_put(priv->w);
 	if (!err && priv) {
 		memcpy(status, &priv->status, sizeof(struct dnet_node_status));
+		if (cache)
+			memcpy(cache, &priv->cache, sizeof(struct dnet_cache_control));
 	}
 
 err_out_free:
@@ -1879,6 +1921,17 @@ err_out_exit:
 	return err;
 }
 
+int dnet_update_status(struct dnet_session *s, struct dnet_addr *addr, struct dnet_id *id, struct dnet_node_status *status)
+{
+	return dnet_update_status_raw(s, addr, id, status, NULL);
+}
+
+int dnet_update_cache(struct dnet_session *s, struct dnet_addr *addr, struct dnet_id *id,
+		struct dnet_node_status *status, struct dnet_cache_control *cache)
+{
+	return dnet_update_status_raw(s, addr, id, status, cache);
+}
+
 static int dnet_remove_object_raw(struct dnet_session *s, struct dnet_id *id,
 	int (* complete)(struct dnet_net_state *state,
 			struct dnet_cmd *cmd,
@@ -2571,6 +2624,335 @@ err:
 	return err ? err : diff_offset;
 }
 
+/*
+ * External sort of the responses: container is split into runs which are sorted
+ * in place by several threads, then runs are merged into the output file.
+ */
+#define DNET_ITERATOR_SORT_RUN_SIZE	(16 * 1024 * 1024)
+#define DNET_ITERATOR_SORT_MAX_THREADS	8
+#define DNET_ITERATOR_MERGE_BUFFER	(64 * 1024)
+#define DNET_ITERATOR_MERGE_PROGRESS	(64 * 1024)	/* records merged between progress calls */
+
+struct dnet_iterator_sort_ctl {
+	int			fd;
+	uint64_t		size;
+	uint64_t		run_size;
+	uint64_t		runs;
+
+	pthread_mutex_t		lock;
+	pthread_cond_t		wait;
+	uint64_t		next;		/* next run to sort */
+	uint64_t		done;		/* number of sorted runs */
+	int			err;
+};
+
+static int dnet_iterator_sort_run(struct dnet_iterator_sort_ctl *ctl, uint64_t run, void *buf)
+{
+	const ssize_t resp_size = sizeof(struct dnet_iterator_response);
+	uint64_t offset = run * ctl->run_size;
+	uint64_t size = ctl->run_size;
+	ssize_t err;
+
+	if (offset + size > ctl->size)
+		size = ctl->size - offset;
+
+	if ((err = pread(ctl->fd, buf, size, offset)) != (ssize_t)size)
+		return (err == -1) ? -errno : -EINTR;
+
+	qsort(buf, size / resp_size, resp_size, dnet_iterator_response_cmp);
+
+	if ((err = pwrite(ctl->fd, buf, size, offset)) != (ssize_t)size)
+		return (err == -1) ? -errno : -EINTR;
+
+	return 0;
+}
+
+static void *dnet_iterator_sort_thread(void *priv)
+{
+	struct dnet_iterator_sort_ctl *ctl = priv;
+	void *buf;
+	uint64_t run;
+	int err;
+
+	buf = malloc(ctl->run_size);
+
+	pthread_mutex_lock(&ctl->lock);
+	while (!ctl->err && ctl->next < ctl->runs) {
+		run = ctl->next++;
+		pthread_mutex_unlock(&ctl->lock);
+
+		err = buf ? dnet_iterator_sort_run(ctl, run, buf) : -ENOMEM;
+
+		pthread_mutex_lock(&ctl->lock);
+		if (err && !ctl->err)
+			ctl->err = err;
+		ctl->done++;
+		pthread_cond_broadcast(&ctl->wait);
+	}
+	pthread_mutex_unlock(&ctl->lock);
+
+	free(buf);
+	return NULL;
+}
+
+/*!
+ * Sorts runs of \a ctl in parallel, \a progress is called about once a second
+ */
+static int dnet_iterator_sort_runs(struct dnet_iterator_sort_ctl *ctl,
+		int (* progress)(void *priv), void *priv)
+{
+	pthread_t threads[DNET_ITERATOR_SORT_MAX_THREADS];
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	int i, num = 0, err;
+
+	if (cpus < 1)
+		cpus = 1;
+	if (cpus > DNET_ITERATOR_SORT_MAX_THREADS)
+		cpus = DNET_ITERATOR_SORT_MAX_THREADS;
+	if ((uint64_t)cpus > ctl->runs)
+		cpus = ctl->runs;
+
+	for (i = 0; i < cpus; ++i) {
+		if (pthread_create(&threads[num], NULL, dnet_iterator_sort_thread, ctl))
+			break;
+		num++;
+	}
+
+	/* No threads - sort everything here */
+	if (!num)
+		dnet_iterator_sort_thread(ctl);
+
+	pthread_mutex_lock(&ctl->lock);
+	while (!ctl->err && ctl->done < ctl->runs) {
+		struct timespec ts;
+		struct timeval tv;
+
+		gettimeofday(&tv, NULL);
+		ts.tv_sec = tv.tv_sec + 1;
+		ts.tv_nsec = tv.tv_usec * 1000;
+		pthread_cond_timedwait(&ctl->wait, &ctl->lock, &ts);
+
+		if (progress) {
+			pthread_mutex_unlock(&ctl->lock);
+			err = progress(priv);
+			pthread_mutex_lock(&ctl->lock);
+
+			if (err && !ctl->err)
+				ctl->err = err;
+		}
+	}
+	pthread_mutex_unlock(&ctl->lock);
+
+	for (i = 0; i < num; ++i)
+		pthread_join(threads[i], NULL);
+
+	return ctl->err;
+}
+
+struct dnet_iterator_merge_run {
+	uint64_t			offset;		/* file position of the next record to read */
+	uint64_t			end;		/* end of the run in file */
+	struct dnet_iterator_response	*buf;
+	uint64_t			pos;		/* current record in buf */
+	uint64_t			num;		/* number of records in buf */
+};
+
+static int dnet_iterator_merge_fill(int fd, struct dnet_iterator_merge_run *r, uint64_t buf_num)
+{
+	const ssize_t resp_size = sizeof(struct dnet_iterator_response);
+	uint64_t size = buf_num * resp_size;
+	ssize_t err;
+
+	if (size > r->end - r->offset)
+		size = r->end - r->offset;
+
+	if ((err = pread(fd, r->buf, size, r->offset)) != (ssize_t)size)
+		return (err == -1) ? -errno : -EINTR;
+
+	r->offset += size;
+	r->pos = 0;
+	r->num = size / resp_size;
+	return 0;
+}
+
+static inline int dnet_iterator_merge_cmp(struct dnet_iterator_merge_run *a, struct dnet_iterator_merge_run *b)
+{
+	return dnet_iterator_response_cmp(a->buf + a->pos, b->buf + b->pos);
+}
+
+/*!
+ * Restores heap property of \a heap starting from \a i-th element
+ */
+static void dnet_iterator_merge_sift(struct dnet_iterator_merge_run **heap, uint64_t num, uint64_t i)
+{
+	struct dnet_iterator_merge_run *tmp;
+	uint64_t smallest, left, right;
+
+	while (1) {
+		smallest = i;
+		left = 2 * i + 1;
+		right = left + 1;
+
+		if (left < num && dnet_iterator_merge_cmp(heap[left], heap[smallest]) < 0)
+			smallest = left;
+		if (right < num && dnet_iterator_merge_cmp(heap[right], heap[smallest]) < 0)
+			smallest = right;
+		if (smallest == i)
+			break;
+
+		tmp = heap[i];
+		heap[i] = heap[smallest];
+		heap[smallest] = tmp;
+		i = smallest;
+	}
+}
+
+/*!
+ * Merges sorted runs of \a ctl into \a out_fd
+ */
+static int dnet_iterator_merge_runs(struct dnet_iterator_sort_ctl *ctl, int out_fd,
+		int (* progress)(void *priv), void *priv)
+{
+	const ssize_t resp_size = sizeof(struct dnet_iterator_response);
+	const uint64_t buf_num = DNET_ITERATOR_MERGE_BUFFER / resp_size;
+	struct dnet_iterator_merge_run *runs, **heap, *top;
+	struct dnet_iterator_response *out;
+	uint64_t i, heap_num = 0, out_num = 0, out_offset = 0, merged = 0;
+	ssize_t written;
+	int err = -ENOMEM;
+
+	runs = calloc(ctl->runs, sizeof(struct dnet_iterator_merge_run));
+	heap = calloc(ctl->runs, sizeof(struct dnet_iterator_merge_run *));
+	out = malloc(buf_num * resp_size);
+	if (!runs || !heap || !out)
+		goto err_out_free;
+
+	for (i = 0; i < ctl->runs; ++i) {
+		runs[i].offset = i * ctl->run_size;
+		runs[i].end = runs[i].offset + ctl->run_size;
+		if (runs[i].end > ctl->size)
+			runs[i].end = ctl->size;
+
+		runs[i].buf = malloc(buf_num * resp_size);
+		if (!runs[i].buf) {
+			err = -ENOMEM;
+			goto err_out_free;
+		}
+
+		err = dnet_iterator_merge_fill(ctl->fd, &runs[i], buf_num);
+		if (err)
+			goto err_out_free;
+
+		heap[heap_num++] = &runs[i];
+	}
+
+	for (i = heap_num / 2; i > 0; --i)
+		dnet_iterator_merge_sift(heap, heap_num, i - 1);
+
+	err = 0;
+	while (heap_num) {
+		top = heap[0];
+		out[out_num++] = top->buf[top->pos++];
+
+		if (out_num == buf_num) {
+			if ((written = pwrite(out_fd, out, out_num * resp_size, out_offset)) != (ssize_t)(out_num * resp_size)) {
+				err = (written == -1) ? -errno : -EINTR;
+				goto err_out_free;
+			}
+			out_offset += out_num * resp_size;
+			out_num = 0;
+		}
+
+		if (top->pos == top->num) {
+			if (top->offset < top->end) {
+				err = dnet_iterator_merge_fill(ctl->fd, top, buf_num);
+				if (err)
+					goto err_out_free;
+			} else {
+				heap[0] = heap[--heap_num];
+			}
+		}
+		dnet_iterator_merge_sift(heap, heap_num, 0);
+
+		if (progress && ++merged % DNET_ITERATOR_MERGE_PROGRESS == 0) {
+			err = progress(priv);
+			if (err)
+				goto err_out_free;
+		}
+	}
+
+	if (out_num) {
+		if ((written = pwrite(out_fd, out, out_num * resp_size, out_offset)) != (ssize_t)(out_num * resp_size)) {
+			err = (written == -1) ? -errno : -EINTR;
+			goto err_out_free;
+		}
+	}
+
+err_out_free:
+	if (runs) {
+		for (i = 0; i < ctl->runs; ++i)
+			free(runs[i].buf);
+	}
+	free(runs);
+	free(heap);
+	free(out);
+	return err;
+}
+
+/*!
+ * Sorts responses from \a fd into \a out_fd using \fn dnet_iterator_response_cmp.
+ *
+ * Unlike \fn dnet_iterator_response_container_sort it does not need the whole container
+ * in memory: runs of \a fd are sorted in place by several threads and then merged.
+ * \a progress may be NULL, it is called periodically and its error stops sorting.
+ */
+int dnet_iterator_response_container_merge_sort(int fd, uint64_t size, int out_fd,
+		int (* progress)(void *priv), void *priv)
+{
+	const ssize_t resp_size = sizeof(struct dnet_iterator_response);
+	struct dnet_iterator_sort_ctl ctl;
+	int err;
+
+	/* Sanity */
+	if (fd < 0 || out_fd < 0)
+		return -EINVAL;
+	if (size % resp_size != 0)
+		return -EINVAL;
+
+	if (size == 0)
+		return 0;
+
+	memset(&ctl, 0, sizeof(struct dnet_iterator_sort_ctl));
+	ctl.fd = fd;
+	ctl.size = size;
+	ctl.run_size = DNET_ITERATOR_SORT_RUN_SIZE / resp_size * resp_size;
+	ctl.runs = (size + ctl.run_size - 1) / ctl.run_size;
+
+	err = pthread_mutex_init(&ctl.lock, NULL);
+	if (err)
+		return -err;
+
+	err = pthread_cond_init(&ctl.wait, NULL);
+	if (err) {
+		err = -err;
+		goto err_out_mutex_destroy;
+	}
+
+	err = dnet_iterator_sort_runs(&ctl, progress, priv);
+	if (err)
+		goto err_out_cond_destroy;
+
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+	err = dnet_iterator_merge_runs(&ctl, out_fd, progress, priv);
+
+err_out_cond_destroy:
+	pthread_cond_destroy(&ctl.wait);
+err_out_mutex_destroy:
+	pthread_mutex_destroy(&ctl.lock);
+	return err;
+}
+
 int dnet_parse_numeric_id(const char *value, unsigned char *id)
 {
 	unsigned char ch[5];
@@ -47,6 +47,7 @@ typedef unsigned short u_short;
 
 #include "atomic.h"
 #include "lock.h"
+#include "lock_profile.h"
 
 #include "elliptics/packet.h"
 #include "elliptics/interface.h"
@@ -87,6 +88,9 @@ struct dnet_io_req {
 	int			fd;
 	off_t			local_offset;
 	size_t			fsize;
+
+	/* Number of replies request accounts for in send queue size, 0 means 1 */
+	int			queue_weight;
 };
 
 /*
@@ -303,6 +307,8 @@ int dnet_notify_remove(struct dnet_net_state *st, struct dnet_cmd *cmd);
 int dnet_notify_init(struct dnet_node *n);
 void dnet_notify_exit(struct dnet_node *n);
 
+int dnet_cmd_hash_tree(struct dnet_net_state *st, struct dnet_cmd *cmd, void *data);
+
 struct dnet_group
 {
 	struct list_head	group_entry;
@@ -336,6 +342,13 @@ struct dnet_transform
 
 	int 			(* transform)(void *priv, struct dnet_session *s, const void *src, uint64_t size,
 					void *dst, unsigned int *dsize, unsigned int flags);
+
+	/*
+	 * Transforms @num buffers at once, result for @src[i] is written to @dst + i * @dsize.
+	 * Optional, dnet_transform_batch() calls transform() for every buffer if it is not set.
+	 */
+	int			(* transform_batch)(void *priv, struct dnet_session *s, const void * const *src,
+					const uint64_t *size, int num, void *dst, unsigned int dsize, unsigned int flags);
 };
 
 int dnet_crypto_init(struct dnet_node *n);
@@ -428,6 +441,8 @@ int dnet_io_init(struct dnet_node *n, struct dnet_config *cfg);
 void dnet_io_exit(struct dnet_node *n);
 
 void dnet_io_req_free(struct dnet_io_req *r);
+int dnet_io_req_queue_list(struct dnet_net_state *st, struct list_head *head);
+void dnet_send_wait_threshold(struct dnet_net_state *st, int num);
 
 struct dnet_locks_entry {
 	struct rb_node		lock_tree_entry;
@@ -436,6 +451,8 @@ struct dnet_locks_entry {
 	pthread_cond_t		wait;
 	struct dnet_raw_id	id;
 	int			locked;
+	/* Time oplock was taken at if its hold time is measured, see lock_profile.h */
+	uint64_t		locked_at;
 	atomic_t		refcnt;
 };
 
@@ -556,11 +573,25 @@ struct dnet_node
 	 * Lock used for list management
 	 */
 	pthread_mutex_t		iterator_lock;
+	/*
+	 * Directory of disk iterator results, empty if there is no history directory
+	 */
+	char			iterator_dir[1024];
 
 	size_t			cache_size;
 	size_t			caches_number;
 	size_t			cache_pages_number;
 	unsigned int	*cache_pages_proportions;
+	int			cache_hugepages;
+	char			cache_snapshot[1024];
+	int			cache_snapshot_interval;
+	int			cache_admission;
+	size_t			cache_chunk_size;
+	int			cache_sync_concurrency;
+	size_t			cache_negative_size;
+	size_t			cache_negative_ttl;
+	int			cache_adaptive;
+	size_t			cache_mrc_sampling;
 	void			*cache;
 
 	void			*monitor;
@@ -771,6 +802,19 @@ int dnet_cmd_cache_io(struct dnet_net_state *st, struct dnet_cmd *cmd, struct dn
 int dnet_cmd_cache_indexes(struct dnet_net_state *st, struct dnet_cmd *cmd, struct dnet_indexes_request *request);
 int dnet_cmd_cache_lookup(struct dnet_net_state *st, struct dnet_cmd *cmd);
 
+/*
+ * Applies @ctl to the cache and fills it with current settings, returns -ENOTSUP if there is no cache
+ */
+int dnet_cache_control(struct dnet_node *n, struct dnet_cache_control *ctl);
+
+/*
+ * Negative cache of ids recently not found by the backend, functions do nothing if it is disabled.
+ * @start is the time backend request was started at.
+ */
+int dnet_cache_check_missing(struct dnet_node *n, const unsigned char *id);
+void dnet_cache_insert_missing(struct dnet_node *n, const unsigned char *id, const struct timeval *start);
+void dnet_cache_remove_missing(struct dnet_node *n, const unsigned char *id);
+
 int dnet_indexes_init(struct dnet_node *, struct dnet_config *);
 void dnet_indexes_cleanup(struct dnet_node *);
 int dnet_process_indexes(struct dnet_net_state *st, struct dnet_cmd *cmd, void *data);
@@ -818,6 +862,22 @@ int dnet_iterator_list_remove(struct dnet_node *n, uint64_t id);
 /* Misc routines */
 uint64_t dnet_iterator_list_next_id_nolock(struct dnet_node *n);
 
+/*
+ * Predicate term compiled from struct dnet_iterator_predicate_term:
+ * it is checked and converted once per request, key prefix is split
+ * into whole bytes and mask of the last byte.
+ */
+struct dnet_iterator_condition {
+	int				(*match)(const struct dnet_iterator_condition *c, const struct dnet_raw_id *key,
+			uint64_t size, const struct dnet_ext_list *elist);
+	int				op;		/* DNET_IOP_* */
+	uint64_t			value;		/* Size or user flags */
+	struct dnet_time		time;		/* Timestamp */
+	struct dnet_raw_id		key;		/* Key prefix */
+	unsigned int			prefix_bytes;	/* Whole bytes of the prefix */
+	unsigned char			prefix_mask;	/* Mask of the last partial byte of the prefix */
+};
+
 /*
  * Common private data:
  * Request + next callback and it's argument.
@@ -826,8 +886,25 @@ struct dnet_iterator_common_private {
 	struct dnet_iterator_request	*req;		/* Original request */
 	struct dnet_iterator_range		*range;		/* Original ranges */
 	struct dnet_iterator		*it;		/* Iterator control structure */
-	int				(*next_callback)(void *priv, void *data, uint64_t dsize);
+	struct dnet_iterator_condition	*conditions;	/* Compiled predicate, all conditions should match */
+	uint64_t			conditions_num;
+	/* @response is already in network byte order, @data follows it */
+	int				(*next_callback)(void *priv, struct dnet_iterator_response *response,
+			void *data, uint64_t dsize);
+	/* Optional: data is @dsize bytes at @offset of @fd, callback owns @fd */
+	int				(*next_fd_callback)(void *priv, struct dnet_iterator_response *response,
+			int fd, uint64_t offset, uint64_t dsize);
+	/* Optional: sends responses accumulated by the callbacks */
+	int				(*flush_callback)(void *priv);
 	void				*next_private;	/* One of predefined callbacks */
+
+	/* Checkpoints are sent to @st if DNET_IFLAGS_CHECKPOINT is set */
+	struct dnet_net_state		*st;
+	struct dnet_cmd			*cmd;
+	void				*token;		/* Resume request ended by dnet_iterator_checkpoint */
+	uint64_t			token_size;
+	uint64_t			records;	/* Records passed by backend, including resumed ones */
+	time_t				checkpoint_time;	/* Time of the last checkpoint */
 };
 
 /*
@@ -836,13 +913,47 @@ struct dnet_iterator_common_private {
 struct dnet_iterator_send_private {
 	struct dnet_net_state		*st;		/* State to send data to */
 	struct dnet_cmd			*cmd;		/* Command */
+	uint64_t			flags;		/* DNET_IFLAGS_PROJECTION or 0 */
+	uint64_t			fields;		/* DNET_IFIELD_* to send with projection */
+};
+
+/*
+ * Batched send over network callback private.
+ *
+ * Responses are packed into frames: dnet_cmd, dnet_iterator_batch and records.
+ * Frame is built of chunks - requests which are filled in place and queued without copying.
+ * Every chunk except the last one may end with data referenced by file descriptor.
+ */
+struct dnet_iterator_batch_private {
+	struct dnet_net_state		*st;		/* State to send data to */
+	struct dnet_cmd			*cmd;		/* Command */
+	uint64_t			flags;		/* DNET_IFLAGS_DATA and DNET_IFLAGS_PROJECTION */
+	uint64_t			fields;		/* DNET_IFIELD_* to send with projection */
+	struct list_head		chunks;		/* Filled chunks of the current frame */
+	struct dnet_io_req		*chunk;		/* Chunk being filled, its data follows it */
+	uint64_t			capacity;	/* Allocated size of the chunk's data */
+	uint64_t			size;		/* Frame size without dnet_cmd */
+	uint64_t			num;		/* Number of records in the frame */
 };
 
 /*
  * Save to file callback private.
+ *
+ * Responses are buffered and appended to temporary file, which is sorted
+ * into the result file when iteration is over. Client gets progress replies
+ * while iterator runs, they keep its transaction alive.
  */
 struct dnet_iterator_file_private {
-	int				fd;		/* Append mode file descriptor */
+	int				fd;		/* Temporary file descriptor */
+	struct dnet_iterator		*it;		/* Iterator, sorting stops when it is canceled */
+	struct dnet_net_state		*st;		/* State to send progress to */
+	struct dnet_cmd			*cmd;		/* Command */
+	uint64_t			id;		/* Result file id */
+	uint64_t			size;		/* Bytes written to the file */
+	void				*buf;		/* Buffer of responses not written yet */
+	uint64_t			buf_size;	/* Number of buffered bytes */
+	uint64_t			num;		/* Number of records */
+	time_t				progress_time;	/* Time of the last progress reply */
 };
 
 #ifndef CONFIG_ELLIPTICS_VERSION_0
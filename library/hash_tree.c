@@ -0,0 +1,202 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Hash tree of the stored keys used by recovery to find ranges where replicas differ.
+ *
+ * Tree is a complete binary tree over the first @depth bits of the ID kept in one array,
+ * level by level. Hash of every node is XOR of the hashes of keys under it, so update
+ * of one key is XOR of the same delta into one node of every level, which needs neither
+ * old state of the tree nor locks, and updates commute.
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "elliptics.h"
+
+#include "elliptics/packet.h"
+#include "elliptics/interface.h"
+
+/* Reply is limited to 8 MB of hashes, larger levels are read range by range */
+#define DNET_HASH_TREE_MAX_REPLY	(1ULL << 20)
+
+struct dnet_hash_tree {
+	uint32_t		depth;
+	uint64_t		nodes[0];
+};
+
+static uint64_t *dnet_hash_tree_level(struct dnet_hash_tree *tree, uint32_t level)
+{
+	return tree->nodes + (1ULL << level) - 1;
+}
+
+/*
+ * Index of the node of the @level which covers @id
+ */
+static uint64_t dnet_hash_tree_index(const unsigned char *id, uint32_t level)
+{
+	uint64_t prefix = 0;
+	int i;
+
+	if (!level)
+		return 0;
+
+	for (i = 0; i < 8; ++i)
+		prefix = (prefix << 8) | id[i];
+
+	return prefix >> (64 - level);
+}
+
+struct dnet_hash_tree *dnet_hash_tree_create(int depth)
+{
+	struct dnet_hash_tree *tree;
+
+	if (depth <= 0 || depth > DNET_HASH_TREE_MAX_DEPTH)
+		return NULL;
+
+	tree = calloc(1, sizeof(struct dnet_hash_tree) + ((2ULL << depth) - 1) * sizeof(uint64_t));
+	if (!tree)
+		return NULL;
+
+	tree->depth = depth;
+	return tree;
+}
+
+void dnet_hash_tree_destroy(struct dnet_hash_tree *tree)
+{
+	free(tree);
+}
+
+/* Finalizer of MurmurHash3 */
+static uint64_t dnet_hash_tree_mix(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+
+	return h;
+}
+
+/*
+ * Hash of the key with its timestamp, it does not depend on byte order,
+ * so nodes of different architectures build the same trees
+ */
+uint64_t dnet_hash_tree_key(const unsigned char *id, const struct dnet_time *ts)
+{
+	uint64_t h = 0x9e3779b97f4a7c15ULL, word = 0;
+	int i;
+
+	for (i = 0; i < DNET_ID_SIZE; ++i) {
+		word = (word << 8) | id[i];
+
+		if ((i & 7) == 7) {
+			h = dnet_hash_tree_mix(h ^ word);
+			word = 0;
+		}
+	}
+
+	if (DNET_ID_SIZE & 7)
+		h = dnet_hash_tree_mix(h ^ word);
+
+	h = dnet_hash_tree_mix(h ^ ts->tsec);
+	return dnet_hash_tree_mix(h ^ ts->tnsec);
+}
+
+void dnet_hash_tree_update(struct dnet_hash_tree *tree, const unsigned char *id,
+		const struct dnet_time *old_ts, const struct dnet_time *new_ts)
+{
+	uint64_t delta = 0, leaf;
+	int level;
+
+	if (!tree)
+		return;
+
+	if (old_ts)
+		delta ^= dnet_hash_tree_key(id, old_ts);
+	if (new_ts)
+		delta ^= dnet_hash_tree_key(id, new_ts);
+
+	if (!delta)
+		return;
+
+	leaf = dnet_hash_tree_index(id, tree->depth);
+	for (level = tree->depth; level >= 0; --level)
+		__sync_fetch_and_xor(&dnet_hash_tree_level(tree, level)[leaf >> (tree->depth - level)], delta);
+}
+
+/*
+ * Sends hashes of the requested level, nodes are read without synchronization,
+ * so concurrent update may be seen partially, which looks like any other write racing with the request
+ */
+int dnet_cmd_hash_tree(struct dnet_net_state *st, struct dnet_cmd *cmd, void *data)
+{
+	struct dnet_node *n = st->n;
+	struct dnet_hash_tree *tree = n->cb ? n->cb->hash_tree : NULL;
+	struct dnet_hash_tree_request *req = data;
+	struct dnet_hash_tree_reply *reply;
+	volatile uint64_t *nodes;
+	uint64_t first, last, num, i, size;
+	uint32_t level;
+	int err;
+
+	if (!tree)
+		return -ENOTSUP;
+
+	if (cmd->size < sizeof(struct dnet_hash_tree_request))
+		return -EINVAL;
+
+	dnet_convert_hash_tree_request(req);
+
+	level = req->level < tree->depth ? req->level : tree->depth;
+	first = dnet_hash_tree_index(req->start.id, level);
+	last = dnet_hash_tree_index(req->end.id, level);
+	if (first > last)
+		return -EINVAL;
+
+	num = last - first + 1;
+	if (num > DNET_HASH_TREE_MAX_REPLY)
+		return -E2BIG;
+
+	size = sizeof(struct dnet_hash_tree_reply) + num * sizeof(uint64_t);
+	reply = malloc(size);
+	if (!reply)
+		return -ENOMEM;
+
+	memset(reply, 0, sizeof(struct dnet_hash_tree_reply));
+	reply->depth = tree->depth;
+	reply->level = level;
+	reply->first = first;
+	reply->num = num;
+
+	nodes = dnet_hash_tree_level(tree, level) + first;
+	for (i = 0; i < num; ++i)
+		reply->hashes[i] = dnet_bswap64(nodes[i]);
+
+	dnet_log(n, DNET_LOG_NOTICE, "%s: hash tree: depth: %u, level: %u, first: %llu, num: %llu\n",
+			dnet_dump_id(&cmd->id), reply->depth, reply->level,
+			(unsigned long long)first, (unsigned long long)num);
+
+	dnet_convert_hash_tree_reply(reply);
+
+	err = dnet_send_reply(st, cmd, reply, size, 1);
+	free(reply);
+	return err;
+}
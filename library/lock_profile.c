@@ -0,0 +1,112 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <time.h>
+
+#include "lock_profile.h"
+
+static struct dnet_lock_site *dnet_lock_sites_head;
+
+/* Acquisitions left till the next sampled one in this thread */
+static __thread unsigned int dnet_lock_countdown;
+
+uint64_t dnet_lock_profile_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+uint64_t dnet_lock_profile_coarse_time(void)
+{
+#ifdef CLOCK_MONOTONIC_COARSE
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+#else
+	return dnet_lock_profile_time();
+#endif
+}
+
+static void dnet_lock_site_register(struct dnet_lock_site *site)
+{
+	struct dnet_lock_site *head;
+
+	if (!__sync_bool_compare_and_swap(&site->registered, 0, 1))
+		return;
+
+	/* Sites are never removed, so the list is only pushed to */
+	do {
+		head = dnet_lock_sites_head;
+		site->next = head;
+	} while (!__sync_bool_compare_and_swap(&dnet_lock_sites_head, head, site));
+}
+
+static int dnet_lock_bucket(uint64_t time)
+{
+	int bucket = time ? 64 - __builtin_clzll(time) : 0;
+
+	if (bucket >= DNET_LOCK_HISTOGRAM_SIZE)
+		bucket = DNET_LOCK_HISTOGRAM_SIZE - 1;
+
+	return bucket;
+}
+
+int dnet_lock_profile_sample(struct dnet_lock_site *site)
+{
+	if (dnet_lock_countdown) {
+		--dnet_lock_countdown;
+		return 0;
+	}
+
+	if (!site->registered)
+		dnet_lock_site_register(site);
+
+	dnet_lock_countdown = DNET_LOCK_SAMPLE_RATE - 1;
+	__sync_fetch_and_add(&site->acquisitions, DNET_LOCK_SAMPLE_RATE);
+	__sync_fetch_and_add(&site->sampled, 1);
+	return 1;
+}
+
+uint64_t dnet_lock_profile_wait(struct dnet_lock_site *site, uint64_t start)
+{
+	uint64_t now = dnet_lock_profile_time();
+
+	if (!site->registered)
+		dnet_lock_site_register(site);
+
+	__sync_fetch_and_add(&site->contended, 1);
+	__sync_fetch_and_add(&site->wait[dnet_lock_bucket(now - start)], 1);
+
+	return now;
+}
+
+uint64_t dnet_lock_profile_hold(struct dnet_lock_site *site, uint64_t locked_at)
+{
+	uint64_t hold = dnet_lock_profile_time() - locked_at;
+
+	__sync_fetch_and_add(&site->hold[dnet_lock_bucket(hold)], 1);
+
+	return hold;
+}
+
+struct dnet_lock_site *dnet_lock_sites(void)
+{
+	return dnet_lock_sites_head;
+}
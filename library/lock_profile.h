@@ -0,0 +1,130 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __DNET_LOCK_PROFILE_H
+#define __DNET_LOCK_PROFILE_H
+
+#include <pthread.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Lock contention profiler.
+ *
+ * Every place where a lock is taken is a lock site with its own counters.
+ * Only one of DNET_LOCK_SAMPLE_RATE acquisitions in every thread is sampled: it adds
+ * DNET_LOCK_SAMPLE_RATE to the acquisitions estimation and its hold time goes into hold histogram,
+ * so uncontended locks do not touch shared counters most of the time.
+ * Contended acquisitions (lock was busy) are always counted and timed,
+ * their wait time goes into wait histogram.
+ *
+ * Histograms are logarithmic: bucket i counts times in [2^(i-1), 2^i) microseconds,
+ * the last one counts everything longer.
+ */
+#define DNET_LOCK_SAMPLE_RATE		64
+#define DNET_LOCK_HISTOGRAM_SIZE	24
+
+struct dnet_lock_site {
+	const char		*name;
+	struct dnet_lock_site	*next;
+	int			registered;
+
+	uint64_t		acquisitions;
+	uint64_t		contended;
+	uint64_t		sampled;
+	uint64_t		wait[DNET_LOCK_HISTOGRAM_SIZE];
+	uint64_t		hold[DNET_LOCK_HISTOGRAM_SIZE];
+};
+
+#define DNET_LOCK_SITE_INIT(site_name) { site_name, NULL, 0, 0, 0, 0, {0}, {0} }
+
+/*
+ * Returns pointer to the lock site named @site_name which is static to the place where macro is used
+ */
+#define DNET_LOCK_SITE(site_name) (__extension__ ({					\
+	static struct dnet_lock_site __dnet_lock_site = DNET_LOCK_SITE_INIT(site_name);	\
+	&__dnet_lock_site;								\
+}))
+
+/*
+ * Monotonic time in microseconds
+ */
+uint64_t dnet_lock_profile_time(void);
+
+/*
+ * Cheap monotonic time in microseconds, its resolution is a few milliseconds.
+ * It is enough to catch locks held for too long without sampling.
+ */
+uint64_t dnet_lock_profile_coarse_time(void);
+
+/*
+ * Decides whether acquisition of the lock at @site is sampled and counts it if it is,
+ * returns non-zero if its hold time should be recorded by dnet_lock_profile_hold()
+ */
+int dnet_lock_profile_sample(struct dnet_lock_site *site);
+
+/*
+ * Records wait of the contended acquisition started at @start, returns current time
+ */
+uint64_t dnet_lock_profile_wait(struct dnet_lock_site *site, uint64_t start);
+
+/*
+ * Records lock hold time since @locked_at, returns it
+ */
+uint64_t dnet_lock_profile_hold(struct dnet_lock_site *site, uint64_t locked_at);
+
+/*
+ * Returns the list of all lock sites which have been used, linked by ->next
+ */
+struct dnet_lock_site *dnet_lock_sites(void);
+
+/*
+ * Takes @lock accounting it to @site.
+ * Returns time lock was taken at if its hold time should be measured and zero otherwise,
+ * it should be passed to dnet_mutex_unlock_profiled().
+ */
+static inline uint64_t dnet_mutex_lock_profiled(pthread_mutex_t *lock, struct dnet_lock_site *site)
+{
+	int sampled = dnet_lock_profile_sample(site);
+	uint64_t start;
+
+	if (!pthread_mutex_trylock(lock))
+		return sampled ? dnet_lock_profile_time() : 0;
+
+	start = dnet_lock_profile_time();
+	pthread_mutex_lock(lock);
+	start = dnet_lock_profile_wait(site, start);
+
+	return sampled ? start : 0;
+}
+
+static inline void dnet_mutex_unlock_profiled(pthread_mutex_t *lock, struct dnet_lock_site *site, uint64_t locked_at)
+{
+	pthread_mutex_unlock(lock);
+
+	if (locked_at)
+		dnet_lock_profile_hold(site, locked_at);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __DNET_LOCK_PROFILE_H */
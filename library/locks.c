@@ -27,6 +27,8 @@
 
 #include "elliptics.h"
 
+static struct dnet_lock_site dnet_oplock_site = DNET_LOCK_SITE_INIT("oplock");
+
 void dnet_locks_destroy(struct dnet_node *n)
 {
 	struct dnet_locks_entry *r, *tmp;
@@ -74,6 +76,7 @@ int dnet_locks_init(struct dnet_node *n, int num)
 
 	for (i = 0; i < num; ++i, ++entry) {
 		entry->locked = 0;
+		entry->locked_at = 0;
 
 		err = pthread_mutex_init(&entry->lock, NULL);
 		if (err) {
@@ -182,6 +185,7 @@ static struct dnet_locks_entry *dnet_oplock_ensure(struct dnet_node *n, struct d
 		list_del(&entry->lock_list_entry);
 
 		entry->locked = 0;
+		entry->locked_at = 0;
 		atomic_init(&entry->refcnt, 1);
 
 		memcpy(entry->id.id, id->id, sizeof(entry->id.id));
@@ -196,7 +200,7 @@ static struct dnet_locks_entry *dnet_oplock_ensure(struct dnet_node *n, struct d
 	return entry;
 }
 
-static struct dnet_locks_entry *dnet_oplock_take(struct dnet_node *n, struct dnet_id *id)
+static struct dnet_locks_entry *dnet_oplock_take(struct dnet_node *n, struct dnet_id *id, uint64_t *locked_at)
 {
 	struct dnet_locks_entry *entry = NULL;
 
@@ -209,6 +213,9 @@ static struct dnet_locks_entry *dnet_oplock_take(struct dnet_node *n, struct dne
 		goto err_out_complete;
 	}
 
+	/* Entry may be reused as soon as it is released, only its holder changes this field */
+	*locked_at = entry->locked_at;
+
 	if (entry && atomic_dec_and_test(&entry->refcnt)) {
 		dnet_oplock_remove_nolock(n, entry);
 		list_add_tail(&entry->lock_list_entry, &n->locks->lock_list);
@@ -226,25 +233,42 @@ err_out_complete:
 void dnet_oplock(struct dnet_node *n, struct dnet_id *key)
 {
 	struct dnet_locks_entry *entry = dnet_oplock_ensure(n, key);
+	int sampled;
+	uint64_t now = 0;
 
 	if (!entry) {
 		return;
 	}
 
+	sampled = dnet_lock_profile_sample(&dnet_oplock_site);
+
 	pthread_mutex_lock(&entry->lock);
 
-	while (entry->locked) {
-		pthread_cond_wait(&entry->wait, &entry->lock);
+	if (entry->locked) {
+		uint64_t start = dnet_lock_profile_time();
+
+		while (entry->locked) {
+			pthread_cond_wait(&entry->wait, &entry->lock);
+		}
+
+		now = dnet_lock_profile_wait(&dnet_oplock_site, start);
 	}
 
 	entry->locked = 1;
+	entry->locked_at = 0;
+	if (sampled)
+		entry->locked_at = now ? now : dnet_lock_profile_time();
 
 	pthread_mutex_unlock(&entry->lock);
 }
 
 void dnet_opunlock(struct dnet_node *n, struct dnet_id *key)
 {
-	struct dnet_locks_entry *entry = dnet_oplock_take(n, key);
+	uint64_t locked_at = 0;
+	struct dnet_locks_entry *entry = dnet_oplock_take(n, key, &locked_at);
+
+	if (locked_at)
+		dnet_lock_profile_hold(&dnet_oplock_site, locked_at);
 
 	if (!entry) {
 		return;
@@ -270,10 +294,14 @@ int dnet_optrylock(struct dnet_node *n, struct dnet_id *key)
 
 	pthread_mutex_lock(&entry->lock);
 
-	if (entry->locked)
+	if (entry->locked) {
 		err = -EBUSY;
-	else
+	} else {
 		entry->locked = 1;
+		entry->locked_at = 0;
+		if (dnet_lock_profile_sample(&dnet_oplock_site))
+			entry->locked_at = dnet_lock_profile_time();
+	}
 
 	pthread_mutex_unlock(&entry->lock);
 
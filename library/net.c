@@ -287,6 +287,8 @@ static int dnet_io_req_queue(struct dnet_net_state *st, struct dnet_io_req *orig
 	struct dnet_io_req *r;
 	int offset = 0;
 	int err = 0;
+	struct dnet_lock_site *site;
+	uint64_t locked_at;
 
 	buf = r = malloc(sizeof(struct dnet_io_req) + orig->dsize + orig->hsize);
 	if (!r) {
@@ -319,17 +321,40 @@ static int dnet_io_req_queue(struct dnet_net_state *st, struct dnet_io_req *orig
 		r->fsize = orig->fsize;
 	}
 
-	pthread_mutex_lock(&st->send_lock);
+	site = DNET_LOCK_SITE("state: send queue");
+	locked_at = dnet_mutex_lock_profiled(&st->send_lock, site);
 	list_add_tail(&r->req_entry, &st->send_list);
 
 	if (!st->__need_exit)
 		dnet_schedule_send(st);
-	pthread_mutex_unlock(&st->send_lock);
+	dnet_mutex_unlock_profiled(&st->send_lock, site, locked_at);
 
 err_out_exit:
 	return err;
 }
 
+/*
+ * Queues requests from @head without copying them, they are sent one after another
+ * and freed with dnet_io_req_free(), so their header and data should be allocated together with them.
+ */
+int dnet_io_req_queue_list(struct dnet_net_state *st, struct list_head *head)
+{
+	struct dnet_io_req *r, *tmp;
+	struct dnet_lock_site *site;
+	uint64_t locked_at;
+
+	site = DNET_LOCK_SITE("state: send queue");
+	locked_at = dnet_mutex_lock_profiled(&st->send_lock, site);
+	list_for_each_entry_safe(r, tmp, head, req_entry)
+		list_move_tail(&r->req_entry, &st->send_list);
+
+	if (!st->__need_exit)
+		dnet_schedule_send(st);
+	dnet_mutex_unlock_profiled(&st->send_lock, site, locked_at);
+
+	return 0;
+}
+
 void dnet_io_req_free(struct dnet_io_req *r)
 {
 	if (r->fd >= 0 && r->fsize) {
@@ -503,15 +528,18 @@ static void dnet_trans_timestamp(struct dnet_net_state *st, struct dnet_trans *t
 int dnet_trans_send(struct dnet_trans *t, struct dnet_io_req *req)
 {
 	struct dnet_net_state *st = req->st;
+	struct dnet_lock_site *site;
+	uint64_t locked_at;
 	int err;
 
 	dnet_trans_get(t);
 
-	pthread_mutex_lock(&st->trans_lock);
+	site = DNET_LOCK_SITE("state: trans insert");
+	locked_at = dnet_mutex_lock_profiled(&st->trans_lock, site);
 	err = dnet_trans_insert_nolock(&st->trans_root, t);
 	if (!err)
 		dnet_trans_timestamp(st, t);
-	pthread_mutex_unlock(&st->trans_lock);
+	dnet_mutex_unlock_profiled(&st->trans_lock, site, locked_at);
 	if (err)
 		goto err_out_put;
 
@@ -687,11 +715,14 @@ int dnet_process_recv(struct dnet_net_state *st, struct dnet_io_req *r)
 	struct dnet_node *n = st->n;
 	struct dnet_net_state *forward_state;
 	struct dnet_cmd *cmd = r->header;
+	struct dnet_lock_site *site;
+	uint64_t locked_at;
 
 	if (cmd->trans & DNET_TRANS_REPLY) {
 		uint64_t tid = cmd->trans & ~DNET_TRANS_REPLY;
 
-		pthread_mutex_lock(&st->trans_lock);
+		site = DNET_LOCK_SITE("state: trans reply");
+		locked_at = dnet_mutex_lock_profiled(&st->trans_lock, site);
 		t = dnet_trans_search(&st->trans_root, tid);
 		if (t) {
 			if (!(cmd->flags & DNET_FLAGS_MORE)) {
@@ -707,7 +738,7 @@ int dnet_process_recv(struct dnet_net_state *st, struct dnet_io_req *r)
 			 */
 			list_del_init(&t->trans_list_entry);
 		}
-		pthread_mutex_unlock(&st->trans_lock);
+		dnet_mutex_unlock_profiled(&st->trans_lock, site, locked_at);
 
 		if (!t) {
 			dnet_log(n, DNET_LOG_ERROR, "%s: could not find transaction for reply: trans %llu.\n",
@@ -1204,25 +1235,36 @@ int dnet_send_reply_threshold(void *state, struct dnet_cmd *cmd,
 	err = dnet_send_reply(state, cmd, odata, size, more);
 	if (err == 0)
 		/* If send succeeded then we should increase queue size */
-		if (atomic_inc(&st->send_queue_size) > DNET_SEND_WATERMARK_HIGH) {
-			/* If high watermark is reached we should sleep */
-			dnet_log(st->n, DNET_LOG_DEBUG,
-					"State high_watermark reached: %s: %d, sleeping\n",
-					dnet_server_convert_dnet_addr(&st->addr),
-					atomic_read(&st->send_queue_size));
-
-			pthread_mutex_lock(&st->send_lock);
-			pthread_cond_wait(&st->send_wait, &st->send_lock);
-			pthread_mutex_unlock(&st->send_lock);
-
-			dnet_log(st->n, DNET_LOG_DEBUG, "State woken up: %s: %d",
-					dnet_server_convert_dnet_addr(&st->addr),
-					atomic_read(&st->send_queue_size));
-		}
+		dnet_send_wait_threshold(st, 1);
 
 	return err;
 }
 
+/*
+ * Accounts @num requests queued into send queue of @st,
+ * sleeps if high watermark is reached.
+ */
+void dnet_send_wait_threshold(struct dnet_net_state *st, int num)
+{
+	atomic_add(&st->send_queue_size, num);
+
+	if (atomic_read(&st->send_queue_size) > DNET_SEND_WATERMARK_HIGH) {
+		/* If high watermark is reached we should sleep */
+		dnet_log(st->n, DNET_LOG_DEBUG,
+				"State high_watermark reached: %s: %d, sleeping\n",
+				dnet_server_convert_dnet_addr(&st->addr),
+				atomic_read(&st->send_queue_size));
+
+		pthread_mutex_lock(&st->send_lock);
+		pthread_cond_wait(&st->send_wait, &st->send_lock);
+		pthread_mutex_unlock(&st->send_lock);
+
+		dnet_log(st->n, DNET_LOG_DEBUG, "State woken up: %s: %d",
+				dnet_server_convert_dnet_addr(&st->addr),
+				atomic_read(&st->send_queue_size));
+	}
+}
+
 int dnet_send_reply(void *state, struct dnet_cmd *cmd, void *odata, unsigned int size, int more)
 {
 	struct dnet_net_state *st = state;
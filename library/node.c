@@ -560,6 +560,18 @@ struct dnet_node *dnet_node_create(struct dnet_config *cfg)
 	n->caches_number = cfg->caches_number;
 	n->cache_pages_number = cfg->cache_pages_number;
 	n->cache_pages_proportions = cfg->cache_pages_proportions;
+	n->cache_hugepages = cfg->cache_hugepages;
+	memcpy(n->cache_snapshot, cfg->cache_snapshot, sizeof(n->cache_snapshot));
+	n->cache_snapshot_interval = cfg->cache_snapshot_interval;
+	if (cfg->history_env[0])
+		snprintf(n->iterator_dir, sizeof(n->iterator_dir), "%s/iter", cfg->history_env);
+	n->cache_admission = cfg->cache_admission;
+	n->cache_chunk_size = cfg->cache_chunk_size;
+	n->cache_sync_concurrency = cfg->cache_sync_concurrency;
+	n->cache_negative_size = cfg->cache_negative_size;
+	n->cache_negative_ttl = cfg->cache_negative_ttl;
+	n->cache_adaptive = cfg->cache_adaptive;
+	n->cache_mrc_sampling = cfg->cache_mrc_sampling;
 	n->indexes_shard_count = cfg->indexes_shard_count;
 
 	if (!n->log)
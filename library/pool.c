@@ -189,6 +189,8 @@ static void dnet_schedule_io(struct dnet_node *n, struct dnet_io_req *r)
 	struct dnet_work_pool *pool = io->recv_pool;
 	struct dnet_cmd *cmd = r->header;
 	int nonblocking = !!(cmd->flags & DNET_FLAGS_NOLOCK);
+	struct dnet_lock_site *site;
+	uint64_t locked_at;
 
 	if (cmd->size > 0) {
 		dnet_log(r->st->n, DNET_LOG_DEBUG, "%s: %s: RECV cmd: %s: cmd-size: %llu, nonblocking: %d\n",
@@ -209,12 +211,13 @@ static void dnet_schedule_io(struct dnet_node *n, struct dnet_io_req *r)
 	if (nonblocking)
 		pool = io->recv_pool_nb;
 
-	pthread_mutex_lock(&pool->lock);
+	site = DNET_LOCK_SITE("pool: schedule io");
+	locked_at = dnet_mutex_lock_profiled(&pool->lock, site);
 	list_add_tail(&r->req_entry, &pool->list);
 	list_stat_size_increase(&pool->list_stats, 1);
 	list_stat_log(&pool->list_stats, r->st->n, "input io queue");
 	pthread_cond_signal(&pool->wait);
-	pthread_mutex_unlock(&pool->lock);
+	dnet_mutex_unlock_profiled(&pool->lock, site, locked_at);
 }
 
 
@@ -472,14 +475,21 @@ static int dnet_process_send_single(struct dnet_net_state *st)
 			list_del(&r->req_entry);
 			pthread_mutex_unlock(&st->send_lock);
 
-			if (atomic_read(&st->send_queue_size) > 0)
-				if (atomic_dec(&st->send_queue_size) == DNET_SEND_WATERMARK_LOW) {
+			if (atomic_read(&st->send_queue_size) > 0) {
+				int weight = r->queue_weight ? r->queue_weight : 1;
+				int size;
+
+				atomic_sub(&st->send_queue_size, weight);
+				size = atomic_read(&st->send_queue_size);
+
+				if (size <= DNET_SEND_WATERMARK_LOW && size + weight > DNET_SEND_WATERMARK_LOW) {
 					dnet_log(st->n, DNET_LOG_DEBUG,
 							"State low_watermark reached: %s: %d, waking up\n",
 							dnet_server_convert_dnet_addr(&st->addr),
-							atomic_read(&st->send_queue_size));
+							size);
 					pthread_cond_broadcast(&st->send_wait);
 				}
+			}
 
 			dnet_io_req_free(r);
 			st->send_offset = 0;
@@ -723,7 +733,8 @@ static void *dnet_io_process(void *data_)
 		ts.tv_sec = tv.tv_sec + 1;
 		ts.tv_nsec = tv.tv_usec * 1000;
 
-		pthread_mutex_lock(&pool->lock);
+		/* Waiting for new requests is not a contention, hold time is not measured here */
+		dnet_mutex_lock_profiled(&pool->lock, DNET_LOCK_SITE("pool: take request"));
 
 		pool->trans[wio->thread_index] = -1;
 
@@ -108,11 +108,13 @@ void dnet_trans_remove_nolock(struct rb_root *root, struct dnet_trans *t)
 void dnet_trans_remove(struct dnet_trans *t)
 {
 	struct dnet_net_state *st = t->st;
+	struct dnet_lock_site *site = DNET_LOCK_SITE("state: trans remove");
+	uint64_t locked_at;
 
-	pthread_mutex_lock(&st->trans_lock);
+	locked_at = dnet_mutex_lock_profiled(&st->trans_lock, site);
 	dnet_trans_remove_nolock(&st->trans_root, t);
 	list_del_init(&t->trans_list_entry);
-	pthread_mutex_unlock(&st->trans_lock);
+	dnet_mutex_unlock_profiled(&st->trans_lock, site, locked_at);
 }
 
 struct dnet_trans *dnet_trans_alloc(struct dnet_node *n __unused, uint64_t size)
@@ -313,10 +315,12 @@ int dnet_trans_iterate_move_transaction(struct dnet_net_state *st, struct list_h
 	int trans_moved = 0;
 	char str[64];
 	struct tm tm;
+	struct dnet_lock_site *site = DNET_LOCK_SITE("state: stall check");
+	uint64_t locked_at;
 
 	gettimeofday(&tv, NULL);
 
-	pthread_mutex_lock(&st->trans_lock);
+	locked_at = dnet_mutex_lock_profiled(&st->trans_lock, site);
 	list_for_each_entry_safe(t, tmp, &st->trans_list, trans_list_entry) {
 		if ((t->time.tv_sec >= tv.tv_sec) && !st->__need_exit)
 			break;
@@ -343,7 +347,7 @@ int dnet_trans_iterate_move_transaction(struct dnet_net_state *st, struct list_h
 		dnet_trans_remove_nolock(&st->trans_root, t);
 		list_move(&t->trans_list_entry, head);
 	}
-	pthread_mutex_unlock(&st->trans_lock);
+	dnet_mutex_unlock_profiled(&st->trans_lock, site, locked_at);
 
 	dnet_log(st->n, DNET_LOG_DEBUG, "stall check: state: %s, st: %p, transactions-moved: %d\n", dnet_state_dump_addr(st), st, trans_moved);
 
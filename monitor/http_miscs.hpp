@@ -47,6 +47,8 @@ const std::string list = "<html>"
 	"GET <a href='/io_queue'>/io_queue</a> - Retrieves statistics about io queue<br/>"
 	"GET <a href='/commands'>/commands</a> - Retrieves statistics about commands<br/>"
 	"GET <a href='/io_histograms'>/io_histograms</a> - Retrieves statistics about io histograms<br/>"
+	"GET <a href='/locks'>/locks</a> - Retrieves statistics about lock contention<br/>"
+	"GET <a href='/backend'>/backend</a> - Retrieves backend specific statistics<br/>"
 	"</body>"
 	"</html>";
 }
@@ -56,7 +58,9 @@ const std::map<std::string, int> handlers = {{"/list", DNET_MONITOR_LIST},
 	{"/cache", DNET_MONITOR_CACHE},
 	{"/io_queue", DNET_MONITOR_IO_QUEUE},
 	{"/commands", DNET_MONITOR_COMMANDS},
-	{"/io_histograms", DNET_MONITOR_IO_HISTOGRAMS}};
+	{"/io_histograms", DNET_MONITOR_IO_HISTOGRAMS},
+	{"/locks", DNET_MONITOR_LOCKS},
+	{"/backend", DNET_MONITOR_BACKEND}};
 
 /*!
  * Generates HTTP response for @req category with @content
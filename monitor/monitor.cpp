@@ -21,11 +21,36 @@
 #include "monitor.hpp"
 
 #include <exception>
+#include <stdlib.h>
 
 #include "../library/elliptics.h"
 
 namespace ioremap { namespace monitor {
 
+class backend_stat_provider : public stat_provider {
+public:
+	backend_stat_provider(struct dnet_backend_callbacks *cb)
+	: m_cb(cb)
+	{}
+
+	virtual std::string json() const {
+		char *json = m_cb->stat_json(m_cb->command_private);
+		if (!json)
+			return "{}";
+
+		std::string ret(json);
+		free(json);
+		return ret;
+	}
+
+	virtual bool check_category(int category) const {
+		return category == DNET_MONITOR_BACKEND || category == DNET_MONITOR_ALL;
+	}
+
+private:
+	struct dnet_backend_callbacks	*m_cb;
+};
+
 monitor::monitor(struct dnet_node *n, struct dnet_config *cfg)
 : m_node(n)
 , m_server(*this, cfg->monitor_port)
@@ -46,7 +71,11 @@ int dnet_monitor_init(struct dnet_node *n, struct dnet_config *cfg) {
 	}
 
 	try {
-		n->monitor = static_cast<void*>(new ioremap::monitor::monitor(n, cfg));
+		auto real_monitor = new ioremap::monitor::monitor(n, cfg);
+		n->monitor = static_cast<void*>(real_monitor);
+
+		if (n->cb && n->cb->stat_json)
+			real_monitor->get_statistics().add_provider(new ioremap::monitor::backend_stat_provider(n->cb), "backend");
 	} catch (const std::exception &e) {
 		dnet_log(n, DNET_LOG_ERROR, "Could not create monitor: %s\n", e.what());
 		return -ENOMEM;
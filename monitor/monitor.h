@@ -78,6 +78,18 @@ extern "C" {
  * Category for IO hisograms statistics
  */
 #define DNET_MONITOR_IO_HISTOGRAMS	4
+/*!
+ * \internal
+ *
+ * Category for lock contention statistics
+ */
+#define DNET_MONITOR_LOCKS			5
+/*!
+ * \internal
+ *
+ * Category for backend specific statistics
+ */
+#define DNET_MONITOR_BACKEND		6
 
 struct dnet_node;
 struct dnet_config;
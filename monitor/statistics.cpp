@@ -162,6 +162,11 @@ std::string statistics::report(int category) {
 		report.AddMember("histogram", histogram_report(histogram_value, allocator), allocator);
 	}
 
+	if (category == DNET_MONITOR_ALL || category == DNET_MONITOR_LOCKS) {
+		rapidjson::Value locks_value(rapidjson::kObjectType);
+		report.AddMember("locks", locks_report(locks_value, allocator), allocator);
+	}
+
 	std::unique_lock<std::mutex> guard(m_provider_mutex);
 	for (auto it = m_stat_providers.cbegin(), end = m_stat_providers.cend(); it != end; ++it) {
 		if (!it->first->check_category(category))
@@ -339,4 +344,41 @@ rapidjson::Value& statistics::histogram_report(rapidjson::Value &stat_value, rap
 	return stat_value;
 }
 
+inline rapidjson::Value& lock_histogram_print(rapidjson::Value &stat_value,
+                                              rapidjson::Document::AllocatorType &allocator,
+                                              const uint64_t *counters) {
+	for (size_t i = 0; i < DNET_LOCK_HISTOGRAM_SIZE; ++i) {
+		stat_value.PushBack(counters[i], allocator);
+	}
+	return stat_value;
+}
+
+rapidjson::Value& statistics::locks_report(rapidjson::Value &stat_value, rapidjson::Document::AllocatorType &allocator) {
+	// Upper bounds of histogram buckets in microseconds, the last bucket is unbounded
+	rapidjson::Value bounds(rapidjson::kArrayType);
+	for (size_t i = 0; i < DNET_LOCK_HISTOGRAM_SIZE - 1; ++i) {
+		bounds.PushBack(uint64_t(1) << i, allocator);
+	}
+
+	rapidjson::Value sites(rapidjson::kObjectType);
+	for (auto site = dnet_lock_sites(); site; site = site->next) {
+		rapidjson::Value site_value(rapidjson::kObjectType);
+		rapidjson::Value wait_value(rapidjson::kArrayType);
+		rapidjson::Value hold_value(rapidjson::kArrayType);
+
+		site_value.AddMember("acquisitions", site->acquisitions, allocator)
+		          .AddMember("contended", site->contended, allocator)
+		          .AddMember("sampled", site->sampled, allocator)
+		          .AddMember("wait", lock_histogram_print(wait_value, allocator, site->wait), allocator)
+		          .AddMember("hold", lock_histogram_print(hold_value, allocator, site->hold), allocator);
+
+		sites.AddMember(site->name, site_value, allocator);
+	}
+
+	stat_value.AddMember("sample_rate", DNET_LOCK_SAMPLE_RATE, allocator)
+	          .AddMember("histogram_bounds_us", bounds, allocator)
+	          .AddMember("sites", sites, allocator);
+	return stat_value;
+}
+
 }} /* namespace ioremap::monitor */
@@ -408,6 +408,15 @@ private:
 	rapidjson::Value& histogram_report(rapidjson::Value &stat_value,
 	                                   rapidjson::Document::AllocatorType &allocator);
 
+	/*!
+	 * \internal
+	 *
+	 * Fills \a stat_value by lock contention statistics of every lock site and returns it
+	 * \a allocator - document allocator that is required by rapidjson
+	 */
+	rapidjson::Value& locks_report(rapidjson::Value &stat_value,
+	                               rapidjson::Document::AllocatorType &allocator);
+
 	/*!
 	 * \internal
 	 *
@@ -0,0 +1,224 @@
+# =============================================================================
+# All rights reserved.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# =============================================================================
+
+"""
+Hash tree routines
+
+Every node keeps hash tree of stored keys: level l splits key space into 2^l
+nodes by the first l bits of the key and hash of the node is XOR of hashes of
+its keys with their timestamps. Nodes of replicas with equal hashes store the
+same keys, so only ranges covered by differing nodes have to be iterated.
+
+Route ranges start and stop anywhere, while nodes of the tree cover aligned
+prefixes. Node which crosses the boundary of the range hashes keys of the
+neighbour range too, so every range is split into the largest nodes which lie
+inside it and the slivers at its ends which are smaller than a leaf. Only the
+former are compared, the latter are always iterated.
+
+Nodes which do not maintain the tree (old servers, backends without support)
+fail the request, their ranges are returned untouched.
+"""
+
+import sys
+
+from .range import IdRange
+
+sys.path.insert(0, "bindings/python/") # XXX
+import elliptics
+
+# Hashes are compared starting with START_LEVEL and then every LEVEL_STEP levels deeper
+START_LEVEL = 8
+LEVEL_STEP = 8
+# Deeper level is not used if it splits range into more runs, each of them becomes iterator range
+MAX_RUNS = 256
+
+
+def node_range(index, level, group_id):
+    """
+    Range of keys covered by node @index of @level
+    """
+    shift = 64 - level
+    first = index << shift
+    last = ((index + 1) << shift) - 1
+
+    start = [(first >> (56 - 8 * i)) & 0xff for i in xrange(8)] + [0] * 56
+    stop = [(last >> (56 - 8 * i)) & 0xff for i in xrange(8)] + [255] * 56
+    return IdRange(elliptics.Id(start, group_id), elliptics.Id(stop, group_id))
+
+
+def prefix(eid):
+    """
+    First 64 bits of the key, node of level l covers keys with the same first l of them
+    """
+    result = 0
+    for byte in list(eid)[:8]:
+        result = (result << 8) | byte
+    return result
+
+
+def align(bounds, depth):
+    """
+    Splits @bounds into (nodes, slivers): nodes are (level, index) of the largest
+    tree nodes which lie inside @bounds, slivers are the parts of @bounds
+    which cover only a part of a leaf
+    """
+    group_id = bounds.start.group_id
+    first = prefix(bounds.start) >> (64 - depth)
+    last = prefix(bounds.stop) >> (64 - depth)
+    slivers = []
+
+    if node_range(first, depth, group_id).start < bounds.start:
+        slivers.append(clip(node_range(first, depth, group_id), bounds))
+        first += 1
+    if node_range(last, depth, group_id).stop > bounds.stop:
+        if last >= first:
+            slivers.append(clip(node_range(last, depth, group_id), bounds))
+        last -= 1
+
+    nodes = []
+    while first <= last:
+        size = 0
+        while size < depth and first % (2 << size) == 0 and first + (2 << size) - 1 <= last:
+            size += 1
+        nodes.append((depth - size, first >> size))
+        first += 1 << size
+
+    return nodes, slivers
+
+
+def clip(id_range, bounds):
+    """
+    Intersection of @id_range with @bounds or None if they do not intersect
+    """
+    start = max(id_range.start, bounds.start)
+    stop = min(id_range.stop, bounds.stop)
+    if start > stop:
+        return None
+    return IdRange(start, stop)
+
+
+def join(indexes):
+    """
+    Merges sorted list of node indexes into (first, last) runs of adjacent ones
+    """
+    runs = []
+    for index in indexes:
+        if runs and runs[-1][1] + 1 == index:
+            runs[-1] = (runs[-1][0], index)
+        else:
+            runs.append((index, index))
+    return runs
+
+
+class HashTree(object):
+    """
+    Hash tree of the node specified by @eid
+    """
+    def __init__(self, node, eid):
+        self.session = elliptics.Session(node)
+        self.session.groups = [eid.group_id]
+        self.eid = eid
+
+    def level(self, level, start, stop):
+        """
+        Returns dict of hashes of nodes of @level covering keys from @start to @stop
+        """
+        results = self.session.hash_tree(self.eid, start, stop, level).get()
+        if len(results) != 1:
+            raise RuntimeError("Unexpected number of hash tree replies: {0}".format(len(results)))
+
+        result = results[0]
+        if result.level != level:
+            raise RuntimeError("Level {0} was requested, {1} received".format(level, result.level))
+
+        return dict((result.first + i, h) for i, h in enumerate(result.hashes))
+
+    def depth(self):
+        """
+        Depth of the tree, level 0 is read only to find it out
+        """
+        results = self.session.hash_tree(self.eid, IdRange.ID_MIN, IdRange.ID_MIN, 0).get()
+        if len(results) != 1:
+            raise RuntimeError("Unexpected number of hash tree replies: {0}".format(len(results)))
+        return results[0].depth
+
+
+def descend(trees, ranges, select):
+    """
+    Walks @trees down within @ranges and returns subranges of @ranges covered by
+    the deepest nodes for which select(hashes, index) is true, @hashes is the list
+    of dicts of hashes of the level read from every tree.
+    Subtree of not selected node is never read.
+    """
+    depth = min(tree.depth() for tree in trees)
+    result = []
+    aligned = []
+
+    for id_range in ranges:
+        nodes, slivers = align(id_range, depth)
+        result.extend(slivers)
+        aligned.extend((level, node_range(index, level, id_range.start.group_id)) for level, index in nodes)
+
+    for start_level, bounds in aligned:
+        group_id = bounds.start.group_id
+        level = min(max(START_LEVEL, start_level), depth)
+        runs = [bounds]
+        previous = None
+
+        while True:
+            selected = set()
+            for run in runs:
+                hashes = [tree.level(level, run.start, run.stop) for tree in trees]
+                selected.update(i for i in hashes[0] if select(hashes, i))
+
+            selected = join(sorted(selected))
+            if previous and len(selected) > MAX_RUNS:
+                level, selected = previous
+                break
+
+            if level == depth or not selected:
+                break
+
+            runs = []
+            for first, last in selected:
+                run = clip(IdRange(node_range(first, level, group_id).start,
+                                   node_range(last, level, group_id).stop), bounds)
+                if run is not None:
+                    runs.append(run)
+
+            previous = level, selected
+            level = min(level + LEVEL_STEP, depth)
+
+        for first, last in selected:
+            run = clip(IdRange(node_range(first, level, group_id).start,
+                               node_range(last, level, group_id).stop), bounds)
+            if run is not None:
+                result.append(run)
+
+    return result
+
+
+def differ(trees, ranges):
+    """
+    Returns subranges of @ranges where at least one of @trees differs from the others
+    """
+    return descend(trees, ranges,
+                   lambda hashes, i: any(h.get(i) != hashes[0][i] for h in hashes[1:]))
+
+
+def nonempty(tree, ranges):
+    """
+    Returns subranges of @ranges where @tree has keys
+    """
+    return descend([tree], ranges, lambda hashes, i: hashes[0][i] != 0)
@@ -218,7 +218,7 @@ class Iterator(object):
     def start(self,
               eid=IdRange.ID_MIN,
               itype=elliptics.iterator_types.network,
-              flags=elliptics.iterator_flags.key_range | elliptics.iterator_flags.ts_range,
+              flags=elliptics.iterator_flags.key_range | elliptics.iterator_flags.ts_range | elliptics.iterator_flags.batch,
               key_ranges=(IdRange(IdRange.ID_MIN, IdRange.ID_MAX),),
               timestamp_range=(Time.time_min().to_etime(), Time.time_max().to_etime()),
               tmp_dir='/var/tmp',
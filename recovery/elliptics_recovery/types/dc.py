@@ -18,6 +18,7 @@
 Data Center recovery type - recovers keys at the expense of keys from other group.
 
  * Find ranges that host is responsible for now.
+ * Narrow them to subranges where hash trees of local and remote hosts differ.
  * Start metadata-only iterator for the found ranges on local and remote hosts (from non-local groups).
  * Sort iterators' outputs.
  * Computes diff between local and remote iterator.
@@ -33,6 +34,8 @@ from multiprocessing import Pool
 
 from ..iterator import Iterator, IteratorResult
 from ..etime import Time
+from ..range import AddressRanges, IdRange
+from ..hash_tree import HashTree, differ
 from ..utils.misc import elliptics_create_node, elliptics_create_session, worker_init, mk_container_name
 
 # XXX: change me before BETA
@@ -341,6 +344,50 @@ def process_diff((local, remote)):
     return (diff_result.address, diff_result.filename)
 
 
+def union(ranges):
+    """
+    Merges overlapping ranges
+    """
+    result = []
+    for r in sorted(ranges, key=lambda r: r.start):
+        if result and r.start <= result[-1].stop:
+            result[-1] = IdRange(result[-1].start, max(result[-1].stop, r.stop))
+        else:
+            result.append(r)
+    return result
+
+
+def narrow_ranges(ctx, local_ranges, remote_ranges):
+    """
+    Leaves only subranges where hash trees of remote nodes differ from the local one.
+    Ranges of the node which tree can't be read are left untouched.
+    Local node iterates all ranges left for remote nodes.
+    """
+    node = elliptics_create_node(address=ctx.address, elog=ctx.elog, wait_timeout=ctx.wait_timeout)
+    local_tree = HashTree(node, local_ranges.eid)
+
+    result = []
+    for r in remote_ranges:
+        try:
+            id_ranges = differ([local_tree, HashTree(node, r.eid)], r.id_ranges)
+        except Exception as e:
+            log.warning("Hash trees of {0} and {1} can't be compared, iterating whole ranges: {2}"
+                        .format(ctx.address, r.address, repr(e)))
+            id_ranges = r.id_ranges
+
+        ctx.monitor.stats.counter('hash_tree_narrowed_ranges', len(id_ranges))
+        if len(id_ranges) == 0:
+            log.info("Hash trees of {0} and {1} are equal, skipping".format(ctx.address, r.address))
+            continue
+
+        result.append(AddressRanges(address=r.address, eid=r.eid, id_ranges=id_ranges))
+
+    local_ranges = AddressRanges(address=local_ranges.address,
+                                 eid=local_ranges.eid,
+                                 id_ranges=union(i for r in result for i in r.id_ranges))
+    return local_ranges, result
+
+
 def main(ctx):
     global g_ctx
     g_ctx = ctx
@@ -358,18 +405,28 @@ def main(ctx):
 
     log.debug("Processing nodes: {0}".format([str(r.address) for r in all_ranges]))
 
-    processes = min(g_ctx.nprocess, len(all_ranges))
+    local_ranges = next((r for r in all_ranges if r.address == g_ctx.address), None)
+    assert local_ranges, 'Local ranges is absent in route table'
+    remote_ranges = [range for range in all_ranges
+                     if range.address != g_ctx.address and
+                        range.address.group_id in g_ctx.groups]
+
+    if g_ctx.hash_tree:
+        log.warning("Comparing hash trees")
+        g_ctx.monitor.stats.timer('main', 'hash_tree')
+        local_ranges, remote_ranges = narrow_ranges(g_ctx, local_ranges, remote_ranges)
+        if len(remote_ranges) == 0:
+            log.warning("Local node has up-to-date data")
+            g_ctx.monitor.stats.timer('main', 'finished')
+            return True
+
+    processes = min(g_ctx.nprocess, len(remote_ranges) + 1)
     log.info("Creating pool of processes: {0}".format(processes))
     pool = Pool(processes=processes, initializer=worker_init)
 
-    local_ranges = next((r for r in all_ranges if r.address == g_ctx.address), None)
-    assert local_ranges, 'Local ranges is absent in route table'
-    ctx.monitor.stats.counter('iterations', len(all_ranges))
+    ctx.monitor.stats.counter('iterations', len(remote_ranges) + 1)
 
     local_iter_result = pool.apply_async(iterate_node, (local_ranges, ))
-    remote_ranges = (range for range in all_ranges
-                     if range.address != g_ctx.address and
-                        range.address.group_id in g_ctx.groups)
     iter_result = pool.imap_unordered(iterate_node, remote_ranges)
 
     try:
@@ -17,7 +17,8 @@
 Deep Merge recovery type - recovers keys in one hash ring (aka group)
 by placing them to the node where they belong.
 
- * Iterate all node in the group for ranges which are not belong to it.
+ * Iterate all node in the group for ranges which are not belong to it,
+ * ranges where hash tree of the node is empty are skipped.
  * Get all keys which shouldn't be on the node:
  * Looks up keys meta info on the proper node
  * If the key on the proper node is missed or older
@@ -36,6 +37,7 @@ from ..utils.misc import elliptics_create_node, worker_init
 from ..route import RouteList
 from ..iterator import Iterator
 from ..range import IdRange
+from ..hash_tree import HashTree, nonempty
 
 import errno
 
@@ -425,6 +427,20 @@ def recover(ctx, address, group, node, results, stats):
     return ret
 
 
+def narrow_ranges(node, eid, ranges):
+    """
+    Leaves only subranges of @ranges where node has keys according to its hash tree.
+    Ranges are left untouched if the tree can't be read.
+    """
+    try:
+        id_ranges = nonempty(HashTree(node, eid), [IdRange(r[0], r[1]) for r in ranges])
+        return [(r.start, r.stop) for r in id_ranges]
+    except Exception as e:
+        log.warning("Hash tree of {0} can't be read, iterating whole ranges: {1}"
+                    .format(eid, repr(e)))
+        return ranges
+
+
 def process_node(address, group, ranges):
     log.debug("Processing node: {0} from group: {1} for ranges: {2}"
               .format(address, group, ranges))
@@ -436,13 +452,23 @@ def process_node(address, group, ranges):
                                  elog=ctx.elog,
                                  wait_timeout=ctx.wait_timeout)
     s = elliptics.Session(node)
+    eid = s.routes.get_address_eid(address)
+
+    if ctx.hash_tree:
+        stats.timer('process', 'hash_tree')
+        ranges = narrow_ranges(node, eid, ranges)
+        stats.counter('hash_tree_narrowed_ranges', len(ranges))
+        if len(ranges) == 0:
+            log.info("Node {0} has no keys in foreign ranges, skipping".format(address))
+            stats.timer('process', 'finished')
+            return True
 
     stats.timer('process', 'iterate')
     results = iterate_node(ctx=ctx,
                            node=node,
                            address=address,
                            ranges=ranges,
-                           eid=s.routes.get_address_eid(address),
+                           eid=eid,
                            stats=stats)
     if results is None or len(results) == 0:
         log.warning('Iterator result is empty, skipping')
@@ -0,0 +1,613 @@
+/*
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ */
+
+#include "test_base.hpp"
+#include "../library/elliptics.h"
+
+#define BOOST_TEST_NO_MAIN
+#include <boost/test/included/unit_test.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <map>
+#include <set>
+
+using namespace ioremap::elliptics;
+using namespace boost::unit_test;
+
+namespace tests {
+
+/*
+ * Every backend is started by its own node in its own group
+ */
+enum {
+	memory_group = 1,
+	logstore_group,
+	eblob_group
+};
+
+/* Position of the node of every group in the nodes started by configure_nodes */
+static const size_t eblob_node = eblob_group - 1;
+
+/* Every shard of the memory backend may take 16 KB only */
+static const int memory_shards = 64;
+static const int memory_limit = memory_shards * 16 * 1024;
+
+/* Small segments make logstore rotate them many times */
+static const int logstore_segment_size = 64 * 1024;
+
+/* Reads of eblob objects spread over more than this are too big for the page cache */
+static const int eblob_readahead_cache_size = 1024 * 1024;
+static const int eblob_readahead_object_size = 64 * 1024;
+
+static std::shared_ptr<nodes_data> global_data;
+
+static void destroy_global_data()
+{
+	global_data.reset();
+}
+
+static void configure_nodes(const std::string &path)
+{
+	global_data = start_nodes(results_reporter::get_stream(), std::vector<config_data>({
+		config_data::default_value()
+			("group", memory_group)
+			("backend", "memory")
+			("shards", memory_shards)
+			("memory_limit", memory_limit)
+			("evict", 1),
+		config_data::default_value()
+			("group", logstore_group)
+			("backend", "logstore")
+			("segment_size", logstore_segment_size),
+		config_data::default_value()
+			("group", eblob_group)
+			("readahead_cache_size", eblob_readahead_cache_size)
+	}), path);
+}
+
+static void test_write_read_remove(session &sess, const std::string &id)
+{
+	const std::string data = "some data of " + id;
+
+	ELLIPTICS_REQUIRE(write_result, sess.write_data(id, data, 0));
+	ELLIPTICS_COMPARE_REQUIRE(read_result, sess.read_data(id, 0, 0), data);
+
+	ELLIPTICS_REQUIRE(remove_result, sess.remove(id));
+	ELLIPTICS_REQUIRE_ERROR(removed_read_result, sess.read_data(id, 0, 0), -ENOENT);
+}
+
+/*
+ * Object bigger than the limit of its shard fails with -E2BIG and does not evict anything,
+ * object which fits into the shard is still stored
+ */
+static void test_memory_oversized_object(session &sess)
+{
+	const std::string small(memory_limit / memory_shards / 4, 'a');
+
+	ELLIPTICS_REQUIRE(small_write_result, sess.write_data(std::string("oversized object 1"), small, 0));
+
+	const std::string shard_sized(memory_limit / memory_shards * 2, 'b');
+
+	ELLIPTICS_REQUIRE_ERROR(shard_write_result, sess.write_data(std::string("oversized object 2"), shard_sized, 0), -E2BIG);
+	ELLIPTICS_REQUIRE_ERROR(shard_read_result, sess.read_data(std::string("oversized object 2"), 0, 0), -ENOENT);
+
+	const std::string huge(memory_limit * 2, 'c');
+
+	ELLIPTICS_REQUIRE_ERROR(huge_write_result, sess.write_data(std::string("oversized object 3"), huge, 0), -E2BIG);
+	ELLIPTICS_REQUIRE_ERROR(huge_read_result, sess.read_data(std::string("oversized object 3"), 0, 0), -ENOENT);
+
+	ELLIPTICS_COMPARE_REQUIRE(small_read_result, sess.read_data(std::string("oversized object 1"), 0, 0), small);
+}
+
+/*
+ * Objects written to many segments are read back from the sealed ones and the active one
+ */
+static void test_logstore_rotation(session &sess)
+{
+	const int count = logstore_segment_size / 1024;
+	std::vector<std::string> data;
+
+	for (int i = 0; i < count; ++i) {
+		const std::string id = "logstore rotation " + boost::lexical_cast<std::string>(i);
+
+		data.push_back(std::string(logstore_segment_size / 8, 'a' + i % 26));
+		ELLIPTICS_REQUIRE(write_result, sess.write_data(id, data.back(), 0));
+	}
+
+	for (int i = 0; i < count; ++i) {
+		const std::string id = "logstore rotation " + boost::lexical_cast<std::string>(i);
+
+		ELLIPTICS_COMPARE_REQUIRE(read_result, sess.read_data(id, 0, 0), data[i]);
+	}
+}
+
+/* Readahead policy eblob backend currently applies to its only blob file */
+static std::string eblob_readahead_policy()
+{
+	dnet_node *n = global_data->nodes[eblob_node].get_native();
+	char *json = n->cb->stat_json(n->cb->command_private);
+
+	BOOST_REQUIRE(json != NULL);
+
+	const std::string stat(json);
+	free(json);
+
+	const std::string prefix = "\"policy\":\"";
+	const size_t begin = stat.find(prefix);
+	BOOST_REQUIRE(begin != std::string::npos);
+
+	const size_t end = stat.find('"', begin + prefix.size());
+	BOOST_REQUIRE(end != std::string::npos);
+
+	return stat.substr(begin + prefix.size(), end - begin - prefix.size());
+}
+
+/*
+ * Every 64 reads of a blob file switch its readahead policy: in-order reads are sequential,
+ * reads jumping over more than the page cache are random, jumping over a few objects is normal
+ */
+static void test_eblob_readahead_policy(session &sess)
+{
+	const int count = 64;
+	const std::string data(eblob_readahead_object_size, 'r');
+
+	std::vector<std::string> ids;
+	for (int i = 0; i < count; ++i) {
+		ids.push_back("eblob readahead " + boost::lexical_cast<std::string>(i));
+		ELLIPTICS_REQUIRE(write_result, sess.write_data(ids.back(), data, 0));
+	}
+
+	BOOST_REQUIRE(count * eblob_readahead_object_size > eblob_readahead_cache_size);
+
+	for (int i = 0; i < count; ++i) {
+		ELLIPTICS_COMPARE_REQUIRE(read_result, sess.read_data(ids[i], 0, 0), data);
+	}
+
+	BOOST_REQUIRE_EQUAL(eblob_readahead_policy(), "sequential");
+
+	for (int i = count - 1; i >= 0; --i) {
+		ELLIPTICS_COMPARE_REQUIRE(read_result, sess.read_data(ids[i], 0, 0), data);
+	}
+
+	BOOST_REQUIRE_EQUAL(eblob_readahead_policy(), "random");
+
+	// Backward reads of the first four objects only never leave the page cache
+	for (int i = 0; i < count; ++i) {
+		ELLIPTICS_COMPARE_REQUIRE(read_result, sess.read_data(ids[3 - i % 4], 0, 0), data);
+	}
+
+	BOOST_REQUIRE_EQUAL(eblob_readahead_policy(), "normal");
+}
+
+/* Hash of the root of the hash tree of the node serving @id */
+static uint64_t hash_tree_root(session &sess, const std::string &id)
+{
+	dnet_raw_id start, end;
+	memset(start.id, 0, DNET_ID_SIZE);
+	memset(end.id, 0xff, DNET_ID_SIZE);
+
+	ELLIPTICS_REQUIRE(result, sess.hash_tree(id, start, end, 0));
+
+	const sync_hash_tree_result entries = result.get();
+	BOOST_REQUIRE_EQUAL(entries.size(), 1);
+	BOOST_REQUIRE_EQUAL(entries[0].reply()->num, 1);
+
+	return entries[0].hashes()[0];
+}
+
+/*
+ * Eblob hash tree built on start follows writes and removes, removed object leaves no trace in it
+ */
+static void test_eblob_hash_tree(session &sess)
+{
+	const std::string id = "eblob hash tree";
+
+	const uint64_t before = hash_tree_root(sess, id);
+
+	ELLIPTICS_REQUIRE(write_result, sess.write_data(id, std::string("first"), 0));
+	const uint64_t written = hash_tree_root(sess, id);
+	BOOST_REQUIRE_NE(written, before);
+
+	ELLIPTICS_REQUIRE(rewrite_result, sess.write_data(id, std::string("second"), 0));
+	BOOST_REQUIRE_NE(hash_tree_root(sess, id), before);
+
+	ELLIPTICS_REQUIRE(remove_result, sess.remove(id));
+	BOOST_REQUIRE_EQUAL(hash_tree_root(sess, id), before);
+}
+
+/* Objects written by iterator tests: their data by raw id of the key */
+typedef std::map<std::string, std::string> iterator_objects;
+
+/* Iterator requests are sent by this key, there is one node in every group */
+static const std::string iterator_key = "iterator";
+
+static std::string iterator_raw_id(const dnet_raw_id &id)
+{
+	return std::string(reinterpret_cast<const char *>(id.id), DNET_ID_SIZE);
+}
+
+/*
+ * Writes @count objects named by @prefix, their sizes grow up to @max_size
+ */
+static iterator_objects write_iterator_objects(session &sess, const std::string &prefix, size_t count, size_t max_size)
+{
+	iterator_objects objects;
+
+	for (size_t i = 0; i < count; ++i) {
+		const std::string id = prefix + " " + boost::lexical_cast<std::string>(i);
+		std::string data(max_size * (i + 1) / count, '\0');
+
+		for (size_t j = 0; j < data.size(); ++j)
+			data[j] = static_cast<char>((i + j * 131) & 0xff);
+
+		ELLIPTICS_REQUIRE(write_result, sess.write_data(id, data, 0));
+
+		key k(id);
+		k.transform(sess);
+		objects[iterator_raw_id(k.raw_id())] = data;
+	}
+
+	return objects;
+}
+
+/*
+ * Runs network iterator with @flags, @predicate and @fields over the whole backend of the session's group,
+ * returns records of @objects in the order they were received
+ */
+static std::vector<iterator_result_entry> iterate_objects(session &sess, const iterator_objects &objects, uint64_t flags,
+		const std::vector<dnet_iterator_predicate_term> &predicate = std::vector<dnet_iterator_predicate_term>(),
+		uint64_t fields = DNET_IFIELD_ALL)
+{
+	std::vector<iterator_result_entry> records;
+
+	ELLIPTICS_REQUIRE(result, sess.start_iterator(iterator_key, std::vector<dnet_iterator_range>(),
+				predicate, fields, DNET_ITYPE_NETWORK, flags));
+
+	const std::vector<iterator_result_entry> entries = result.get();
+	for (auto it = entries.begin(); it != entries.end(); ++it) {
+		if (it->reply()->status == 0 && objects.count(iterator_raw_id(it->reply()->key)))
+			records.push_back(*it);
+	}
+
+	return records;
+}
+
+/*
+ * Every object is returned once with its data both in plain and in batched replies,
+ * logstore sends objects of 64 KB and larger from the segment file instead of copying them
+ */
+static void test_iterator_batch(session &sess, const std::string &prefix, size_t max_size)
+{
+	const iterator_objects objects = write_iterator_objects(sess, prefix, 32, max_size);
+	const uint64_t flags[] = { DNET_IFLAGS_DATA, DNET_IFLAGS_DATA | DNET_IFLAGS_BATCH };
+
+	for (size_t f = 0; f < sizeof(flags) / sizeof(flags[0]); ++f) {
+		const std::vector<iterator_result_entry> records = iterate_objects(sess, objects, flags[f]);
+		std::set<std::string> keys;
+
+		BOOST_TEST_CHECKPOINT("flags: " << flags[f]);
+		BOOST_REQUIRE_EQUAL(records.size(), objects.size());
+
+		for (auto it = records.begin(); it != records.end(); ++it) {
+			const std::string &data = objects.find(iterator_raw_id(it->reply()->key))->second;
+
+			BOOST_REQUIRE(keys.insert(iterator_raw_id(it->reply()->key)).second);
+			BOOST_REQUIRE_EQUAL(it->reply()->size, data.size());
+			BOOST_REQUIRE(it->reply_data().to_string() == data);
+		}
+	}
+}
+
+/*
+ * Disk iterator result is sorted by key, it is read whole or by key ranges and is gone after removal
+ */
+static void test_iterator_disk(session &sess)
+{
+	const iterator_objects objects = write_iterator_objects(sess, "disk iterator", 64, 256);
+
+	ELLIPTICS_REQUIRE(start_result, sess.start_iterator(iterator_key, std::vector<dnet_iterator_range>(),
+				DNET_ITYPE_DISK, 0));
+
+	// Progress replies have -EINPROGRESS status, the last one tells that result is ready
+	const std::vector<iterator_result_entry> progress = start_result.get();
+	BOOST_REQUIRE(!progress.empty());
+	BOOST_REQUIRE_EQUAL(progress.back().reply()->status, 0);
+
+	const uint64_t result_id = progress.back().reply()->id;
+	const uint64_t result_size = progress.back().reply()->size;
+
+	ELLIPTICS_REQUIRE(read_result, sess.read_iterator_result(iterator_key, result_id));
+
+	const std::vector<iterator_result_entry> records = read_result.get();
+	std::vector<std::string> keys;
+
+	BOOST_REQUIRE_EQUAL(records.size() * sizeof(dnet_iterator_response), result_size);
+
+	for (auto it = records.begin(); it != records.end(); ++it) {
+		const std::string id = iterator_raw_id(it->reply()->key);
+
+		BOOST_REQUIRE(keys.empty() || keys.back() <= id);
+		BOOST_REQUIRE_EQUAL(it->reply_data().size(), 0);
+		keys.push_back(id);
+
+		auto object = objects.find(id);
+		if (object != objects.end())
+			BOOST_REQUIRE_EQUAL(it->reply()->size, object->second.size());
+	}
+
+	for (auto it = objects.begin(); it != objects.end(); ++it)
+		BOOST_REQUIRE(std::binary_search(keys.begin(), keys.end(), it->first));
+
+	// Range takes keys from its begin up to but not including its end
+	std::vector<std::string> sorted;
+	for (auto it = objects.begin(); it != objects.end(); ++it)
+		sorted.push_back(it->first);
+
+	dnet_iterator_range range;
+	memcpy(range.key_begin.id, sorted[sorted.size() / 4].data(), DNET_ID_SIZE);
+	memcpy(range.key_end.id, sorted[sorted.size() * 3 / 4].data(), DNET_ID_SIZE);
+
+	ELLIPTICS_REQUIRE(range_result, sess.read_iterator_result(iterator_key, result_id,
+				std::vector<dnet_iterator_range>(1, range)));
+
+	const std::vector<iterator_result_entry> range_records = range_result.get();
+	const auto range_begin = std::lower_bound(keys.begin(), keys.end(), sorted[sorted.size() / 4]);
+	const auto range_end = std::lower_bound(keys.begin(), keys.end(), sorted[sorted.size() * 3 / 4]);
+
+	BOOST_REQUIRE_EQUAL(range_records.size(), range_end - range_begin);
+	for (size_t i = 0; i < range_records.size(); ++i)
+		BOOST_REQUIRE(iterator_raw_id(range_records[i].reply()->key) == *(range_begin + i));
+
+	ELLIPTICS_REQUIRE(remove_result, sess.remove_iterator_result(iterator_key, result_id));
+	ELLIPTICS_REQUIRE_ERROR(removed_read_result, sess.read_iterator_result(iterator_key, result_id), -ENOENT);
+}
+
+static dnet_iterator_predicate_term iterator_term(uint32_t field, uint32_t op, uint64_t value)
+{
+	dnet_iterator_predicate_term term;
+
+	memset(&term, 0, sizeof(term));
+	term.field = field;
+	term.op = op;
+	term.value = value;
+
+	return term;
+}
+
+/*
+ * Only records which match all predicate terms are sent,
+ * projected records carry only requested fields and the rest of the response is zeroed
+ */
+static void test_iterator_predicate(session &sess, const std::string &prefix)
+{
+	const size_t count = 32;
+	iterator_objects objects;
+	std::map<std::string, uint64_t> user_flags;
+
+	// Object i has i + 1 bytes and user flags i
+	session flags_sess = sess.clone();
+	for (size_t i = 0; i < count; ++i) {
+		flags_sess.set_user_flags(i);
+
+		const iterator_objects object = write_iterator_objects(flags_sess,
+				prefix + " " + boost::lexical_cast<std::string>(i), 1, i + 1);
+		objects.insert(object.begin(), object.end());
+		user_flags[object.begin()->first] = i;
+	}
+
+	{
+		const std::vector<dnet_iterator_predicate_term> predicate = {
+			iterator_term(DNET_IFIELD_SIZE, DNET_IOP_GE, 16),
+			iterator_term(DNET_IFIELD_USER_FLAGS, DNET_IOP_ANY, 1)
+		};
+		const std::vector<iterator_result_entry> records = iterate_objects(sess, objects, 0, predicate);
+
+		size_t expected = 0;
+		for (auto it = objects.begin(); it != objects.end(); ++it)
+			expected += (it->second.size() >= 16 && (user_flags[it->first] & 1));
+
+		BOOST_REQUIRE_EQUAL(records.size(), expected);
+		for (auto it = records.begin(); it != records.end(); ++it) {
+			BOOST_REQUIRE_GE(it->reply()->size, 16);
+			BOOST_REQUIRE_EQUAL(it->reply()->user_flags & 1, 1);
+			BOOST_REQUIRE_EQUAL(it->reply()->user_flags, user_flags[iterator_raw_id(it->reply()->key)]);
+		}
+	}
+
+	{
+		// Prefix is not a whole number of bytes
+		const std::string &first = objects.begin()->first;
+		const size_t prefix_bits = 12;
+
+		dnet_iterator_predicate_term term = iterator_term(DNET_IFIELD_KEY, DNET_IOP_PREFIX, prefix_bits);
+		memcpy(term.key.id, first.data(), DNET_ID_SIZE);
+
+		const std::vector<iterator_result_entry> records = iterate_objects(sess, objects, 0,
+				std::vector<dnet_iterator_predicate_term>(1, term));
+
+		size_t expected = 0;
+		for (auto it = objects.begin(); it != objects.end(); ++it)
+			expected += (it->first[0] == first[0] && ((it->first[1] ^ first[1]) & 0xf0) == 0);
+
+		BOOST_REQUIRE_GE(expected, 1);
+		BOOST_REQUIRE_EQUAL(records.size(), expected);
+		for (auto it = records.begin(); it != records.end(); ++it) {
+			BOOST_REQUIRE_EQUAL(it->reply()->key.id[0], static_cast<unsigned char>(first[0]));
+			BOOST_REQUIRE_EQUAL(it->reply()->key.id[1] & 0xf0, static_cast<unsigned char>(first[1]) & 0xf0);
+		}
+	}
+
+	// Bit tests are not defined for sizes
+	ELLIPTICS_REQUIRE_ERROR(invalid_result, sess.start_iterator(iterator_key, std::vector<dnet_iterator_range>(),
+				std::vector<dnet_iterator_predicate_term>(1, iterator_term(DNET_IFIELD_SIZE, DNET_IOP_ALL, 1)),
+				DNET_IFIELD_ALL, DNET_ITYPE_NETWORK, 0), -EINVAL);
+
+	const uint64_t flags[] = { DNET_IFLAGS_PROJECTION, DNET_IFLAGS_PROJECTION | DNET_IFLAGS_BATCH };
+
+	for (size_t f = 0; f < sizeof(flags) / sizeof(flags[0]); ++f) {
+		const std::vector<iterator_result_entry> records = iterate_objects(sess, objects, flags[f],
+				std::vector<dnet_iterator_predicate_term>(), DNET_IFIELD_KEY | DNET_IFIELD_USER_FLAGS);
+
+		BOOST_TEST_CHECKPOINT("flags: " << flags[f]);
+		BOOST_REQUIRE_EQUAL(records.size(), objects.size());
+
+		for (auto it = records.begin(); it != records.end(); ++it) {
+			BOOST_REQUIRE_EQUAL(it->reply()->user_flags, user_flags[iterator_raw_id(it->reply()->key)]);
+			BOOST_REQUIRE_EQUAL(it->reply()->timestamp.tsec, 0);
+			BOOST_REQUIRE_EQUAL(it->reply()->timestamp.tnsec, 0);
+			BOOST_REQUIRE_EQUAL(it->reply()->size, 0);
+		}
+	}
+
+	{
+		// Size is sent with data even if it is not requested
+		const std::vector<iterator_result_entry> records = iterate_objects(sess, objects,
+				DNET_IFLAGS_DATA | DNET_IFLAGS_PROJECTION | DNET_IFLAGS_BATCH,
+				std::vector<dnet_iterator_predicate_term>(), DNET_IFIELD_KEY);
+
+		BOOST_REQUIRE_EQUAL(records.size(), objects.size());
+		for (auto it = records.begin(); it != records.end(); ++it) {
+			const std::string &data = objects.find(iterator_raw_id(it->reply()->key))->second;
+
+			BOOST_REQUIRE_EQUAL(it->reply()->user_flags, 0);
+			BOOST_REQUIRE_EQUAL(it->reply()->size, data.size());
+			BOOST_REQUIRE(it->reply_data().to_string() == data);
+		}
+	}
+}
+
+/* Server sends checkpoint at most once per this number of seconds */
+static const int iterator_checkpoint_interval = 10;
+
+/*
+ * Iterator is paused long enough to send checkpoint right after it is continued.
+ * Logstore position is exact, so iterator resumed from the checkpoint returns
+ * exactly the records which followed it and none of those which preceded it.
+ */
+static void test_iterator_checkpoint(session &sess)
+{
+	const iterator_objects objects = write_iterator_objects(sess, "iterator checkpoint", 4096, 4096);
+	std::vector<std::string> before, after, resumed;
+	data_pointer token;
+	bool paused = false;
+
+	sess.set_timeout(iterator_checkpoint_interval * 6);
+
+	async_iterator_result result = sess.start_iterator(iterator_key, std::vector<dnet_iterator_range>(),
+			DNET_ITYPE_NETWORK, DNET_IFLAGS_CHECKPOINT);
+
+	for (auto it = result.begin(); it != result.end(); ++it) {
+		const dnet_iterator_response *response = it->reply();
+
+		if (response->status == DNET_ITERATOR_STATUS_CHECKPOINT) {
+			// Only the first checkpoint is used
+			if (token.empty())
+				token = data_pointer::copy(it->reply_data().data(), it->reply_data().size());
+			continue;
+		}
+
+		const std::string id = iterator_raw_id(response->key);
+		if (!objects.count(id))
+			continue;
+
+		(token.empty() ? before : after).push_back(id);
+
+		if (!paused) {
+			ELLIPTICS_REQUIRE(pause_result, sess.pause_iterator(iterator_key, response->id));
+			sleep(iterator_checkpoint_interval + 1);
+			ELLIPTICS_REQUIRE(continue_result, sess.continue_iterator(iterator_key, response->id));
+			paused = true;
+		}
+	}
+
+	BOOST_REQUIRE_MESSAGE(!result.error(), result.error().message());
+	BOOST_REQUIRE(!token.empty());
+	BOOST_REQUIRE_EQUAL(before.size() + after.size(), objects.size());
+
+	ELLIPTICS_REQUIRE(resume_result, sess.resume_iterator(iterator_key, token));
+
+	const std::vector<iterator_result_entry> entries = resume_result.get();
+	for (auto it = entries.begin(); it != entries.end(); ++it) {
+		const std::string id = iterator_raw_id(it->reply()->key);
+
+		if (it->reply()->status == 0 && objects.count(id))
+			resumed.push_back(id);
+	}
+
+	const std::set<std::string> preceding(before.begin(), before.end());
+	for (auto it = resumed.begin(); it != resumed.end(); ++it)
+		BOOST_REQUIRE(!preceding.count(*it));
+
+	BOOST_REQUIRE(resumed == after);
+}
+
+bool register_tests(test_suite *suite, node n)
+{
+	ELLIPTICS_TEST_CASE(test_write_read_remove, create_session(n, { memory_group }, 0, 0), "memory object");
+	ELLIPTICS_TEST_CASE(test_memory_oversized_object, create_session(n, { memory_group }, 0, 0));
+	ELLIPTICS_TEST_CASE(test_write_read_remove, create_session(n, { logstore_group }, 0, 0), "logstore object");
+	ELLIPTICS_TEST_CASE(test_logstore_rotation, create_session(n, { logstore_group }, 0, 0));
+	ELLIPTICS_TEST_CASE(test_iterator_batch, create_session(n, { memory_group }, 0, 0), "memory iterator batch", 256);
+	ELLIPTICS_TEST_CASE(test_iterator_batch, create_session(n, { logstore_group }, 0, 0), "logstore iterator batch", 128 * 1024);
+	ELLIPTICS_TEST_CASE(test_iterator_disk, create_session(n, { memory_group }, 0, 0));
+	ELLIPTICS_TEST_CASE(test_iterator_predicate, create_session(n, { memory_group }, 0, 0), "memory iterator predicate");
+	ELLIPTICS_TEST_CASE(test_iterator_predicate, create_session(n, { logstore_group }, 0, 0), "logstore iterator predicate");
+	ELLIPTICS_TEST_CASE(test_iterator_checkpoint, create_session(n, { logstore_group }, 0, 0));
+	ELLIPTICS_TEST_CASE(test_eblob_readahead_policy, create_session(n, { eblob_group }, 0, 0));
+	ELLIPTICS_TEST_CASE(test_eblob_hash_tree, create_session(n, { eblob_group }, 0, 0));
+
+	return true;
+}
+
+boost::unit_test::test_suite *register_tests(int argc, char *argv[])
+{
+	namespace bpo = boost::program_options;
+
+	bpo::variables_map vm;
+	bpo::options_description generic("Test options");
+
+	std::string path;
+
+	generic.add_options()
+			("help", "This help message")
+			("path", bpo::value(&path), "Path where to store everything")
+			;
+
+	bpo::store(bpo::parse_command_line(argc, argv, generic), vm);
+	bpo::notify(vm);
+
+	if (vm.count("help")) {
+		std::cerr << generic;
+		return NULL;
+	}
+
+	test_suite *suite = new test_suite("Local Test Suite");
+
+	configure_nodes(path);
+
+	register_tests(suite, *global_data->node);
+
+	return suite;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+	atexit(tests::destroy_global_data);
+	srand(time(0));
+	return unit_test_main(tests::register_tests, argc, argv);
+}
@@ -27,6 +27,12 @@ using namespace boost::unit_test;
 
 namespace tests {
 
+/* Ranged reads of the objects bigger than this cache only chunks they cover */
+static const int cache_chunk_size = 4096;
+
+/* Dirty objects are written back to the disk this many seconds after their change */
+static const int cache_sync_timeout = 1;
+
 static std::shared_ptr<nodes_data> global_data;
 
 static void destroy_global_data()
@@ -41,6 +47,11 @@ static void configure_nodes(const std::string &path)
 			("group", 5)
 			("cache_size", 100000)
 			("caches_number", 1)
+			("cache_chunk_size", cache_chunk_size)
+			("cache_sync_timeout", cache_sync_timeout)
+			("cache_negative_size", 1024)
+			("cache_negative_ttl", 60000)
+			("cache_snapshot", (path.empty() ? std::string(".") : path) + "/cache.snapshot")
 	}), path);
 }
 
@@ -108,6 +119,552 @@ static void test_cache_overflow(session &sess)
 	}
 }
 
+static void test_cache_resize(session &sess)
+{
+	ioremap::cache::cache_manager *cache = (ioremap::cache::cache_manager*) global_data->nodes[0].get_native()->cache;
+	const size_t cache_size = cache->cache_size();
+	argument_data data("0");
+
+	cache->clear();
+	for (size_t id = 0; id < 1000; ++id) {
+		ELLIPTICS_REQUIRE(write_result, sess.write_cache(key(boost::lexical_cast<std::string>(id)), data, 3000));
+	}
+
+	cache->resize(cache_size / 2);
+	{
+		const auto& stats = cache->get_total_cache_stats();
+		BOOST_REQUIRE_EQUAL(cache->cache_size(), cache_size / 2);
+
+		for (size_t i = 0; i < stats.pages_sizes.size(); ++i) {
+			BOOST_REQUIRE_LE(stats.pages_sizes[i], stats.pages_max_sizes[i]);
+		}
+	}
+
+	cache->set_adaptive(true);
+	for (size_t id = 0; id < 1000; ++id) {
+		ELLIPTICS_REQUIRE(write_result, sess.write_cache(key(boost::lexical_cast<std::string>(id % 100)), data, 3000));
+	}
+
+	{
+		const auto& stats = cache->get_total_cache_stats();
+
+		size_t total_pages_max_sizes = 0;
+		for (size_t i = 0; i < stats.pages_sizes.size(); ++i) {
+			total_pages_max_sizes += stats.pages_max_sizes[i];
+			BOOST_REQUIRE_LE(stats.pages_sizes[i], stats.pages_max_sizes[i]);
+		}
+
+		BOOST_REQUIRE_LE(total_pages_max_sizes, cache_size / 2);
+	}
+
+	cache->set_adaptive(false);
+	cache->resize(cache_size);
+	BOOST_REQUIRE_EQUAL(cache->cache_size(), cache_size);
+}
+
+struct hash_table_test_node {
+	const dnet_raw_id &id() const {
+		return m_id;
+	}
+
+	dnet_raw_id m_id;
+};
+
+/*
+ * Ids share few prefixes, so slots collide and clusters wrap around the table,
+ * elements left after removal in random order have to stay reachable
+ */
+static void test_cache_hash_table()
+{
+	typedef ioremap::cache::hash_table<hash_table_test_node> table_t;
+
+	const size_t nodes_number = 1000;
+	const size_t prefixes_number = 7;
+	std::vector<hash_table_test_node> nodes(nodes_number);
+	table_t table;
+
+	const size_t empty_memory_usage = table.memory_usage();
+
+	for (size_t i = 0; i < nodes_number; ++i) {
+		// Prefix with all low bits set lands to the last slot and its cluster wraps
+		const uint64_t prefix = (i % prefixes_number) ? i % prefixes_number : ~0ULL;
+
+		memset(&nodes[i].m_id, 0, sizeof(dnet_raw_id));
+		memcpy(nodes[i].m_id.id, &prefix, sizeof(prefix));
+		memcpy(nodes[i].m_id.id + sizeof(prefix), &i, sizeof(i));
+
+		table.insert(&nodes[i]);
+	}
+
+	BOOST_REQUIRE_EQUAL(table.size(), nodes_number);
+	BOOST_REQUIRE_GT(table.memory_usage(), empty_memory_usage);
+
+	for (size_t i = 0; i < nodes_number; ++i) {
+		BOOST_REQUIRE(table.find(nodes[i].m_id.id) == &nodes[i]);
+	}
+
+	// Id with the same prefix but different tail is not found
+	dnet_raw_id missing = nodes[0].m_id;
+	missing.id[DNET_ID_SIZE - 1] = 1;
+	BOOST_REQUIRE(table.find(missing.id) == NULL);
+
+	std::vector<size_t> order(nodes_number);
+	for (size_t i = 0; i < nodes_number; ++i) {
+		order[i] = i;
+	}
+	std::random_shuffle(order.begin(), order.end());
+
+	std::vector<bool> erased(nodes_number, false);
+	for (size_t i = 0; i < nodes_number / 2; ++i) {
+		table.erase(&nodes[order[i]]);
+		erased[order[i]] = true;
+	}
+
+	BOOST_REQUIRE_EQUAL(table.size(), nodes_number - nodes_number / 2);
+
+	for (size_t i = 0; i < nodes_number; ++i) {
+		BOOST_REQUIRE(table.find(nodes[i].m_id.id) == (erased[i] ? NULL : &nodes[i]));
+	}
+
+	for (size_t i = nodes_number / 2; i < nodes_number; ++i) {
+		table.erase(&nodes[order[i]]);
+	}
+
+	BOOST_REQUIRE(table.empty());
+	BOOST_REQUIRE_EQUAL(table.memory_usage(), empty_memory_usage);
+	BOOST_REQUIRE_THROW(table.erase(&nodes[0]), std::logic_error);
+}
+
+/*
+ * Chunks of filled slabs do not overlap, full slab is charged at least its whole size,
+ * and released slabs are returned to the system except the spare one
+ */
+static void test_cache_slab_allocator()
+{
+	typedef ioremap::cache::slab_allocator allocator_t;
+
+	const size_t object_size = 100;
+	const size_t chunk_size = allocator_t::allocated_size(object_size);
+	const size_t slab_chunks = allocator_t::slab_size / chunk_size;
+	const size_t objects_number = slab_chunks * 3;
+
+	allocator_t allocator(false);
+	std::vector<char *> objects(objects_number);
+
+	for (size_t i = 0; i < objects_number; ++i) {
+		objects[i] = static_cast<char *>(allocator.allocate(object_size));
+		memset(objects[i], i & 0xff, object_size);
+	}
+
+	BOOST_REQUIRE_GE(chunk_size, object_size);
+	BOOST_REQUIRE_EQUAL(allocator.used_size(), objects_number * chunk_size);
+	BOOST_REQUIRE_GE(allocator.mapped_size(), 3 * allocator_t::slab_size);
+
+	for (size_t i = 0; i < objects_number; ++i) {
+		BOOST_REQUIRE_EQUAL(std::string(objects[i], object_size), std::string(object_size, i & 0xff));
+	}
+
+	// Chunks which fit into the slab are charged for the header and the tail too
+	const size_t charged_size = allocator_t::charged_size(object_size);
+	BOOST_REQUIRE_GE(charged_size, chunk_size);
+	BOOST_REQUIRE_GE(charged_size * ((allocator_t::slab_size - 1) / chunk_size), allocator_t::slab_size);
+
+	// Moving to a larger size class keeps the data
+	objects[0] = static_cast<char *>(allocator.reallocate(objects[0], object_size, object_size * 4));
+	BOOST_REQUIRE_EQUAL(std::string(objects[0], object_size), std::string(object_size, 0));
+	allocator.deallocate(objects[0], object_size * 4);
+
+	for (size_t i = 1; i < objects_number; ++i) {
+		allocator.deallocate(objects[i], object_size);
+	}
+
+	BOOST_REQUIRE_EQUAL(allocator.used_size(), 0);
+	BOOST_REQUIRE_EQUAL(allocator.mapped_size(), allocator_t::slab_size);
+
+	// Large objects are mapped directly and remapped keeping the data
+	const size_t large_size = allocator_t::max_chunk_size + 1;
+	char *large = static_cast<char *>(allocator.allocate(large_size));
+	memset(large, 'l', large_size);
+	BOOST_REQUIRE_EQUAL(allocator.used_size(), allocator_t::allocated_size(large_size));
+	BOOST_REQUIRE_EQUAL(allocator_t::charged_size(large_size), allocator_t::allocated_size(large_size));
+
+	large = static_cast<char *>(allocator.reallocate(large, large_size, large_size * 2));
+	BOOST_REQUIRE_EQUAL(std::string(large, large_size), std::string(large_size, 'l'));
+	BOOST_REQUIRE_EQUAL(allocator.used_size(), allocator_t::allocated_size(large_size * 2));
+
+	allocator.deallocate(large, large_size * 2);
+	BOOST_REQUIRE_EQUAL(allocator.used_size(), 0);
+	BOOST_REQUIRE_EQUAL(allocator.mapped_size(), allocator_t::slab_size);
+}
+
+/*
+ * Partly used slabs and the spare slab are charged as a whole: charges of live objects
+ * plus slack of the allocator are exactly the slab pages it holds
+ */
+static void test_cache_slab_fragmentation()
+{
+	typedef ioremap::cache::slab_allocator allocator_t;
+
+	const size_t object_size = 100;
+	const size_t objects_number = allocator_t::slab_size / allocator_t::allocated_size(object_size) * 3;
+
+	allocator_t allocator(false);
+	std::vector<void *> objects(objects_number);
+
+	objects[0] = allocator.allocate(object_size);
+	BOOST_REQUIRE_EQUAL(allocator.mapped_size(), allocator_t::slab_size);
+	BOOST_REQUIRE_EQUAL(allocator.slack_size(), allocator_t::slab_size - allocator_t::charged_size(object_size));
+
+	for (size_t i = 1; i < objects_number; ++i) {
+		objects[i] = allocator.allocate(object_size);
+	}
+
+	// Every slab keeps half of its chunks, so none of them is released
+	const size_t mapped_size = allocator.mapped_size();
+	for (size_t i = 0; i < objects_number; i += 2) {
+		allocator.deallocate(objects[i], object_size);
+	}
+
+	const size_t live_objects = objects_number / 2;
+	BOOST_REQUIRE_EQUAL(allocator.mapped_size(), mapped_size);
+	BOOST_REQUIRE_EQUAL(allocator.mapped_size() % allocator_t::slab_size, 0);
+	BOOST_REQUIRE_EQUAL(live_objects * allocator_t::charged_size(object_size) + allocator.slack_size(), allocator.mapped_size());
+	BOOST_REQUIRE_GE(allocator.slack_size(), allocator.mapped_size() / 3);
+
+	for (size_t i = 1; i < objects_number; i += 2) {
+		allocator.deallocate(objects[i], object_size);
+	}
+
+	// Only the spare slab is left and it is slack as a whole
+	BOOST_REQUIRE_EQUAL(allocator.mapped_size(), allocator_t::slab_size);
+	BOOST_REQUIRE_EQUAL(allocator.slack_size(), allocator_t::slab_size);
+	BOOST_REQUIRE_GE(allocator_t::min_slab_limit(), 2 * allocator_t::slab_size);
+}
+
+typedef boost::intrusive::list_base_hook<boost::intrusive::link_mode<boost::intrusive::auto_unlink> > timer_test_hook_t;
+
+struct timer_test_node : public timer_test_hook_t {
+	timer_test_node() : m_deadline(0), m_expired(false) {}
+
+	uint64_t timer_deadline() const {
+		return m_deadline;
+	}
+
+	void set_timer_deadline(uint64_t deadline) {
+		m_deadline = deadline;
+	}
+
+	uint64_t m_deadline;
+	bool m_expired;
+};
+
+/*
+ * Nodes of every level are taken when their deadline is reached, never before it and never
+ * later than a tick after it, and wheel never asks to be advanced later than the nearest deadline
+ */
+static void test_cache_timer_wheel()
+{
+	typedef ioremap::cache::timer_wheel<timer_test_node, timer_test_hook_t> wheel_t;
+
+	const uint64_t start = 1000000;
+	const uint64_t deadlines[] = {
+		start, start + 5, start + 10, start + 15, start + 639, start + 641,
+		start + 5000, start + 41000, start + 41001, start + 300000
+	};
+	const size_t nodes_number = sizeof(deadlines) / sizeof(deadlines[0]);
+
+	wheel_t wheel(start);
+	std::vector<timer_test_node> nodes(nodes_number + 2);
+
+	for (size_t i = 0; i < nodes_number; ++i) {
+		wheel.insert(&nodes[i], deadlines[i]);
+	}
+
+	// Node erased before its deadline is never taken, the one beyond the wheel range waits in it
+	timer_test_node &erased = nodes[nodes_number];
+	timer_test_node &far = nodes[nodes_number + 1];
+	wheel.insert(&erased, start + 100);
+	wheel.insert(&far, start + (uint64_t(wheel_t::tick) << (wheel_t::slot_bits * wheel_t::levels_number + 1)));
+	wheel.erase(&erased);
+
+	BOOST_REQUIRE_EQUAL(wheel.size(), nodes_number + 1);
+
+	std::vector<timer_test_node *> expired;
+	size_t expired_number = 0;
+
+	for (uint64_t now = start; now <= start + 310000; now += 7) {
+		expired.clear();
+		while (wheel.advance(now, expired, 2)) {
+			BOOST_REQUIRE_EQUAL(expired.size(), 2);
+			expired_number += expired.size();
+			for (auto it = expired.begin(); it != expired.end(); ++it)
+				(*it)->m_expired = true;
+			expired.clear();
+		}
+
+		for (auto it = expired.begin(); it != expired.end(); ++it) {
+			BOOST_REQUIRE((*it)->m_expired == false);
+			(*it)->m_expired = true;
+		}
+		expired_number += expired.size();
+
+		for (size_t i = 0; i < nodes_number + 2; ++i) {
+			BOOST_REQUIRE(!nodes[i].m_expired || nodes[i].m_deadline <= now);
+			BOOST_REQUIRE(nodes[i].m_expired || nodes[i].m_deadline + wheel_t::tick > now || &nodes[i] == &erased);
+
+			// Next deadline is never later than the nearest pending one rounded up to the tick
+			if (!nodes[i].m_expired && &nodes[i] != &erased) {
+				const uint64_t deadline = (nodes[i].m_deadline + wheel_t::tick - 1) / wheel_t::tick * wheel_t::tick;
+				BOOST_REQUIRE_LE(wheel.next_deadline(), std::max(deadline, now));
+			}
+		}
+	}
+
+	BOOST_REQUIRE_EQUAL(expired_number, nodes_number);
+	BOOST_REQUIRE(!erased.m_expired);
+	BOOST_REQUIRE(!far.m_expired);
+	BOOST_REQUIRE_EQUAL(wheel.size(), 1);
+
+	wheel.erase(&far);
+	BOOST_REQUIRE(wheel.empty());
+	BOOST_REQUIRE_EQUAL(wheel.next_deadline(), std::numeric_limits<uint64_t>::max());
+}
+
+static dnet_raw_id make_test_id(uint64_t number)
+{
+	dnet_raw_id id;
+
+	memset(&id, 0, sizeof(id));
+	for (size_t i = 0; i < DNET_ID_SIZE / sizeof(uint64_t); ++i) {
+		const uint64_t word = number * (2 * i + 1) + i;
+		memcpy(id.id + i * sizeof(uint64_t), &word, sizeof(word));
+	}
+
+	return id;
+}
+
+/*
+ * First access is only remembered by the doorkeeper, counters saturate at max_frequency,
+ * and after sample period frequencies are halved and the doorkeeper is cleared
+ */
+static void test_cache_frequency_sketch()
+{
+	typedef ioremap::cache::frequency_sketch sketch_t;
+
+	const size_t capacity = sketch_t::min_width;
+	const size_t sample_size = 10 * capacity;
+	sketch_t sketch(capacity);
+
+	const dnet_raw_id hot = make_test_id(0);
+
+	BOOST_REQUIRE_EQUAL(sketch.estimate(hot.id), 0);
+
+	sketch.increment(hot.id);
+	BOOST_REQUIRE_EQUAL(sketch.estimate(hot.id), 1);
+
+	for (size_t i = 1; i < sketch_t::max_frequency * 2; ++i) {
+		sketch.increment(hot.id);
+	}
+	BOOST_REQUIRE_EQUAL(sketch.estimate(hot.id), sketch_t::max_frequency + 1);
+
+	// Keys seen once are less frequent than the hot one
+	size_t additions = sketch_t::max_frequency * 2;
+	for (uint64_t i = 1; additions < sample_size - 1; ++i, ++additions) {
+		const dnet_raw_id cold = make_test_id(i);
+
+		sketch.increment(cold.id);
+
+		if (i < 100) {
+			BOOST_REQUIRE_LT(sketch.estimate(cold.id), sketch.estimate(hot.id));
+		}
+	}
+
+	BOOST_REQUIRE_EQUAL(sketch.estimate(hot.id), sketch_t::max_frequency + 1);
+
+	// This addition completes the sample period
+	const dnet_raw_id last = make_test_id(sample_size);
+	sketch.increment(last.id);
+
+	BOOST_REQUIRE_EQUAL(sketch.estimate(hot.id), sketch_t::max_frequency / 2);
+}
+
+/*
+ * Remembered miss expires after ttl and is forgotten on write, miss of the request which started
+ * before the write is not remembered, and the oldest id of the full set is replaced
+ */
+static void test_cache_negative_cache()
+{
+	typedef ioremap::cache::negative_cache negative_cache_t;
+
+	const size_t sets_number = 16;
+	const uint64_t ttl = 200;
+	negative_cache_t cache(sets_number * negative_cache_t::ways_number, ttl);
+
+	const dnet_raw_id id = make_test_id(1);
+
+	BOOST_REQUIRE(!cache.contains(id.id));
+
+	cache.insert(id.id, negative_cache_t::current_time());
+	BOOST_REQUIRE(cache.contains(id.id));
+
+	// Read which started before the write must not hide the written object
+	const uint64_t start = negative_cache_t::current_time();
+	usleep(1000);
+	cache.remove(id.id);
+	BOOST_REQUIRE(!cache.contains(id.id));
+
+	cache.insert(id.id, start);
+	BOOST_REQUIRE(!cache.contains(id.id));
+
+	usleep(1000);
+	cache.insert(id.id, negative_cache_t::current_time());
+	BOOST_REQUIRE(cache.contains(id.id));
+
+	usleep((ttl + 50) * 1000);
+	BOOST_REQUIRE(!cache.contains(id.id));
+
+	// Ids differing only after the prefix share the set, the first one is replaced by the last
+	std::vector<dnet_raw_id> ids(negative_cache_t::ways_number + 1, id);
+	for (size_t i = 0; i < ids.size(); ++i) {
+		ids[i].id[DNET_ID_SIZE - 1] = i + 1;
+		cache.insert(ids[i].id, negative_cache_t::current_time());
+		usleep(1000);
+	}
+
+	BOOST_REQUIRE(!cache.contains(ids[0].id));
+	for (size_t i = 1; i < ids.size(); ++i) {
+		BOOST_REQUIRE(cache.contains(ids[i].id));
+	}
+}
+
+/*
+ * Backend miss is remembered by the node and forgotten by the write of the object
+ */
+static void test_cache_negative_lookup(session &sess)
+{
+	ioremap::cache::cache_manager *cache = (ioremap::cache::cache_manager*) global_data->nodes[0].get_native()->cache;
+	key object_key(std::string("negative cache object"));
+	object_key.transform(sess);
+
+	ELLIPTICS_REQUIRE_ERROR(missing_read_result, sess.read_data(object_key, 0, 0), -ENOENT);
+	BOOST_REQUIRE(cache->check_missing(object_key.raw_id().id));
+
+	ELLIPTICS_REQUIRE_ERROR(remembered_read_result, sess.read_data(object_key, 0, 0), -ENOENT);
+
+	ELLIPTICS_REQUIRE(write_result, sess.write_data(object_key, std::string("negative cache data"), 0));
+	BOOST_REQUIRE(!cache->check_missing(object_key.raw_id().id));
+	ELLIPTICS_COMPARE_REQUIRE(read_result, sess.read_data(object_key, 0, 0), "negative cache data");
+}
+
+/*
+ * Object which is only in the cache is looked up on the disk by the cache itself,
+ * that miss does not make it missing for later reads
+ */
+static void test_cache_negative_cached_object(session &sess, session &cache_only_sess)
+{
+	ioremap::cache::cache_manager *cache = (ioremap::cache::cache_manager*) global_data->nodes[0].get_native()->cache;
+	key object_key(std::string("negative cache cached object"));
+	object_key.transform(sess);
+
+	ELLIPTICS_REQUIRE(write_result, cache_only_sess.write_data(object_key, std::string("cached only data"), 0));
+
+	ELLIPTICS_REQUIRE(lookup_result, sess.lookup(object_key));
+	BOOST_REQUIRE(!cache->check_missing(object_key.raw_id().id));
+
+	struct timeval start;
+	gettimeofday(&start, NULL);
+	cache->insert_missing(object_key.raw_id().id, start.tv_sec * 1000000ULL + start.tv_usec);
+	BOOST_REQUIRE(!cache->check_missing(object_key.raw_id().id));
+
+	ELLIPTICS_COMPARE_REQUIRE(read_result, cache_only_sess.read_data(object_key, 0, 0), "cached only data");
+}
+
+/*
+ * Loop over objects hits LRU cache which holds all of them and misses the smaller one,
+ * and the estimation stays right when there are more ids than can be tracked and sampling grows
+ */
+static void test_cache_miss_ratio_curve()
+{
+	typedef ioremap::cache::miss_ratio_curve curve_t;
+
+	{
+		const size_t objects_number = 10, object_size = 100, rounds = 10;
+		curve_t curve(1);
+
+		for (size_t round = 0; round < rounds; ++round) {
+			for (size_t i = 0; i < objects_number; ++i) {
+				const dnet_raw_id id = make_test_id(i);
+				curve.access(id.id, object_size);
+			}
+		}
+
+		BOOST_REQUIRE_EQUAL(curve.sampling(), 1);
+		BOOST_REQUIRE_EQUAL(curve.sampled_accesses(), objects_number * rounds);
+		BOOST_REQUIRE_CLOSE(curve.hit_ratio(objects_number * object_size * 4), 0.9, 0.001);
+		BOOST_REQUIRE_EQUAL(curve.hit_ratio(objects_number * object_size / 2), 0);
+
+		// Next access of the removed object is a cold miss
+		const dnet_raw_id removed = make_test_id(0);
+		curve.remove(removed.id);
+		curve.access(removed.id, object_size);
+
+		BOOST_REQUIRE_CLOSE(curve.hit_ratio(objects_number * object_size * 4), 90.0 / 101, 0.001);
+	}
+
+	{
+		const size_t objects_number = curve_t::max_keys * 3, rounds = 3;
+		curve_t curve(1);
+
+		for (size_t round = 0; round < rounds; ++round) {
+			for (size_t i = 0; i < objects_number; ++i) {
+				const dnet_raw_id id = make_test_id(i);
+				curve.access(id.id, 1);
+			}
+		}
+
+		BOOST_REQUIRE_GE(curve.sampling(), 2);
+		BOOST_REQUIRE_CLOSE(curve.hit_ratio(objects_number * 2), 2.0 / 3, 5);
+		BOOST_REQUIRE_LT(curve.hit_ratio(objects_number / 2), 0.05);
+	}
+}
+
+/*
+ * Only objects whose disk copy is still the one they were cached from are restored from the snapshot:
+ * clean copy of the object rewritten on the disk after the snapshot is dropped, dirty copy newer than
+ * the disk one is kept.
+ */
+static void test_cache_snapshot(session &disk_sess, session &cache_sess, session &cache_only_sess)
+{
+	ioremap::cache::cache_manager *cache = (ioremap::cache::cache_manager*) global_data->nodes[0].get_native()->cache;
+	const std::string clean_id = "snapshot clean object";
+	const std::string stale_id = "snapshot stale object";
+	const std::string dirty_id = "snapshot dirty object";
+
+	cache->clear();
+
+	ELLIPTICS_REQUIRE(clean_write_result, disk_sess.write_data(clean_id, std::string("clean"), 0));
+	ELLIPTICS_REQUIRE(stale_write_result, disk_sess.write_data(stale_id, std::string("stale"), 0));
+	ELLIPTICS_REQUIRE(dirty_disk_write_result, disk_sess.write_data(dirty_id, std::string("old dirty"), 0));
+
+	// Reads through the cache put clean copies of disk objects into it
+	ELLIPTICS_COMPARE_REQUIRE(clean_read_result, cache_sess.read_data(clean_id, 0, 0), "clean");
+	ELLIPTICS_COMPARE_REQUIRE(stale_read_result, cache_sess.read_data(stale_id, 0, 0), "stale");
+	ELLIPTICS_REQUIRE(dirty_write_result, cache_sess.write_data(dirty_id, std::string("new dirty"), 0));
+
+	cache->save_snapshot();
+	cache->clear();
+
+	ELLIPTICS_REQUIRE(stale_rewrite_result, disk_sess.write_data(stale_id, std::string("rewritten"), 0));
+
+	cache->load_snapshot();
+
+	ELLIPTICS_COMPARE_REQUIRE(clean_restored_result, cache_only_sess.read_data(clean_id, 0, 0), "clean");
+	ELLIPTICS_COMPARE_REQUIRE(dirty_restored_result, cache_only_sess.read_data(dirty_id, 0, 0), "new dirty");
+	ELLIPTICS_REQUIRE_ERROR(stale_restored_result, cache_only_sess.read_data(stale_id, 0, 0), -ENOENT);
+
+	cache->clear();
+}
+
 std::string generate_data(size_t length)
 {
 	std::string data;
@@ -118,11 +675,217 @@ std::string generate_data(size_t length)
 	return data;
 }
 
+/*
+ * Every byte depends on its offset, so data read from the wrong chunk or offset differs
+ */
+static std::string chunked_test_data(size_t size, size_t seed)
+{
+	std::string data(size, '\0');
+
+	for (size_t i = 0; i < size; ++i) {
+		data[i] = 'a' + (i * 7 + i / cache_chunk_size + seed) % 26;
+	}
+
+	return data;
+}
+
+/*
+ * Ranged reads through the cache return the same bytes as the disk object, whether their chunks
+ * are read from the disk or are already cached, and rewritten object is never read from stale chunks
+ */
+static void test_cache_chunked_read(session &disk_sess, session &cache_sess)
+{
+	ioremap::cache::cache_manager *cache = (ioremap::cache::cache_manager*) global_data->nodes[0].get_native()->cache;
+	const std::string id = "chunked object";
+	const size_t chunk = cache_chunk_size;
+	std::string data = chunked_test_data(chunk * 5 + 100, 0);
+
+	cache->clear();
+
+	ELLIPTICS_REQUIRE(write_result, disk_sess.write_data(id, data, 0));
+
+	ELLIPTICS_COMPARE_REQUIRE(inner_read_result, cache_sess.read_data(id, chunk + 10, 100), data.substr(chunk + 10, 100));
+	key object_key(id);
+	object_key.transform(cache_sess);
+	BOOST_REQUIRE(cache->chunked(object_key.raw_id().id));
+
+	// Range covers cached chunk and the ones around it
+	ELLIPTICS_COMPARE_REQUIRE(spanning_read_result, cache_sess.read_data(id, chunk - 50, chunk * 2),
+			data.substr(chunk - 50, chunk * 2));
+	ELLIPTICS_COMPARE_REQUIRE(cached_read_result, cache_sess.read_data(id, chunk + 10, 100), data.substr(chunk + 10, 100));
+	ELLIPTICS_COMPARE_REQUIRE(tail_read_result, cache_sess.read_data(id, chunk * 5 + 50, 50), data.substr(chunk * 5 + 50, 50));
+	ELLIPTICS_COMPARE_REQUIRE(whole_read_result, cache_sess.read_data(id, 0, 0), data);
+
+	data = chunked_test_data(chunk * 3, 1);
+	ELLIPTICS_REQUIRE(rewrite_result, cache_sess.write_data(id, data, 0));
+
+	ELLIPTICS_COMPARE_REQUIRE(rewritten_read_result, cache_sess.read_data(id, chunk + 10, 100), data.substr(chunk + 10, 100));
+	ELLIPTICS_COMPARE_REQUIRE(rewritten_whole_read_result, cache_sess.read_data(id, 0, 0), data);
+
+	cache->clear();
+}
+
+/*
+ * Read of a range is routed by its size against the object and the chunk size: prefix of a big object
+ * is cached by chunks, object of a single chunk and a range covering the whole object are cached whole
+ */
+static void test_cache_chunked_routing(session &disk_sess, session &cache_sess)
+{
+	ioremap::cache::cache_manager *cache = (ioremap::cache::cache_manager*) global_data->nodes[0].get_native()->cache;
+	const size_t chunk = cache_chunk_size;
+	const std::string big_id = "chunked routing big object";
+	const std::string small_id = "chunked routing small object";
+	const std::string big = chunked_test_data(chunk * 4, 2);
+	const std::string small = chunked_test_data(chunk / 2, 3);
+
+	cache->clear();
+
+	ELLIPTICS_REQUIRE(big_write_result, disk_sess.write_data(big_id, big, 0));
+	ELLIPTICS_REQUIRE(small_write_result, disk_sess.write_data(small_id, small, 0));
+
+	key big_key(big_id);
+	big_key.transform(cache_sess);
+	key small_key(small_id);
+	small_key.transform(cache_sess);
+
+	ELLIPTICS_COMPARE_REQUIRE(prefix_read_result, cache_sess.read_data(big_id, 0, 100), big.substr(0, 100));
+	BOOST_REQUIRE(cache->chunked(big_key.raw_id().id));
+
+	ELLIPTICS_COMPARE_REQUIRE(covering_read_result, cache_sess.read_data(big_id, 0, big.size()), big);
+	BOOST_REQUIRE(!cache->chunked(big_key.raw_id().id));
+
+	// Size of the small object is unknown until its first read
+	ELLIPTICS_COMPARE_REQUIRE(small_read_result, cache_sess.read_data(small_id, 10, 20), small.substr(10, 20));
+	BOOST_REQUIRE(cache->chunked(small_key.raw_id().id));
+
+	ELLIPTICS_COMPARE_REQUIRE(small_reread_result, cache_sess.read_data(small_id, 10, 20), small.substr(10, 20));
+	BOOST_REQUIRE(!cache->chunked(small_key.raw_id().id));
+
+	cache->clear();
+}
+
+/*
+ * Objects written only to the cache reach the disk in write-back batches, the latest version of
+ * every object is written even if it was changed again while waiting for the batch
+ */
+static void test_cache_writeback(session &disk_sess, session &cache_sess)
+{
+	ioremap::cache::cache_manager *cache = (ioremap::cache::cache_manager*) global_data->nodes[0].get_native()->cache;
+	const size_t objects_number = 32;
+
+	cache->clear();
+
+	for (size_t i = 0; i < objects_number; ++i) {
+		const std::string id = "writeback object " + boost::lexical_cast<std::string>(i);
+
+		ELLIPTICS_REQUIRE(write_result, cache_sess.write_data(id, "first " + id, 0));
+	}
+
+	for (size_t i = 0; i < objects_number; i += 2) {
+		const std::string id = "writeback object " + boost::lexical_cast<std::string>(i);
+
+		ELLIPTICS_REQUIRE(rewrite_result, cache_sess.write_data(id, "second " + id, 0));
+	}
+
+	// Write-back is scheduled by the cache sync timeout, so it has to be done long before this deadline
+	const time_t deadline = time(NULL) + cache_sync_timeout + 10;
+	size_t written = 0;
+
+	while (written < objects_number && time(NULL) < deadline) {
+		sleep(1);
+
+		written = 0;
+		for (size_t i = 0; i < objects_number; ++i) {
+			const std::string id = "writeback object " + boost::lexical_cast<std::string>(i);
+			const std::string expected = (i % 2 ? "first " : "second ") + id;
+
+			auto result = disk_sess.read_data(id, 0, 0);
+			result.wait();
+
+			if (!result.error() && result.get_one().file().to_string() == expected)
+				++written;
+		}
+	}
+
+	BOOST_REQUIRE_EQUAL(written, objects_number);
+
+	cache->clear();
+}
+
+/*
+ * Index tables changed by internal index commands are kept decoded in the cache, finds see every change
+ * before and after the tables are written back and dropped from the cache
+ */
+static void test_cache_indexes(session &sess)
+{
+	ioremap::cache::cache_manager *cache = (ioremap::cache::cache_manager*) global_data->nodes[0].get_native()->cache;
+	const std::string first_key = "cache indexes first";
+	const std::string second_key = "cache indexes second";
+	const std::vector<std::string> common_indexes = { "cache_index_2", "cache_index_3" };
+
+	cache->clear();
+
+	ELLIPTICS_REQUIRE(first_set_result, sess.set_indexes(first_key,
+			std::vector<std::string>({ "cache_index_1", "cache_index_2", "cache_index_3" }),
+			std::vector<data_pointer>(3, data_pointer::copy("1", 1))));
+	ELLIPTICS_REQUIRE(second_set_result, sess.set_indexes(second_key, common_indexes,
+			std::vector<data_pointer>(2, data_pointer::copy("2", 1))));
+
+	BOOST_REQUIRE_GT(cache->get_total_cache_stats().number_of_objects, 0);
+
+	ELLIPTICS_REQUIRE(all_result, sess.find_all_indexes(common_indexes));
+	BOOST_REQUIRE_EQUAL(all_result.get().size(), 2);
+
+	ELLIPTICS_REQUIRE(update_result, sess.update_indexes(first_key,
+			std::vector<std::string>({ "cache_index_4" }), std::vector<data_pointer>(1, data_pointer::copy("4", 1))));
+	ELLIPTICS_REQUIRE(remove_result, sess.remove_indexes(second_key, std::vector<std::string>({ "cache_index_3" })));
+
+	for (int pass = 0; pass < 2; ++pass) {
+		ELLIPTICS_REQUIRE(updated_all_result, sess.find_all_indexes(common_indexes));
+		sync_find_indexes_result updated_all = updated_all_result.get();
+		BOOST_REQUIRE_EQUAL(updated_all.size(), 1);
+		BOOST_REQUIRE_EQUAL(updated_all[0].indexes.size(), 2);
+
+		ELLIPTICS_REQUIRE(updated_any_result, sess.find_any_indexes(std::vector<std::string>({ "cache_index_4" })));
+		sync_find_indexes_result updated_any = updated_any_result.get();
+		BOOST_REQUIRE_EQUAL(updated_any.size(), 1);
+		BOOST_REQUIRE_EQUAL(updated_any[0].indexes.size(), 1);
+		BOOST_REQUIRE_EQUAL(updated_any[0].indexes[0].data.to_string(), "4");
+
+		ELLIPTICS_REQUIRE(second_any_result, sess.find_any_indexes(common_indexes));
+		BOOST_REQUIRE_EQUAL(second_any_result.get().size(), 2);
+
+		// Dirty tables are written back when they are dropped, next pass reads them from the disk
+		cache->clear();
+	}
+}
+
 bool register_tests(test_suite *suite, node n)
 {
 	ELLIPTICS_TEST_CASE(test_cache_records_sizes, create_session(n, { 5 }, 0, DNET_IO_FLAGS_CACHE | DNET_IO_FLAGS_CACHE_ONLY));
 	ELLIPTICS_TEST_CASE(test_cache_overflow, create_session(n, { 5 }, 0, DNET_IO_FLAGS_CACHE | DNET_IO_FLAGS_CACHE_ONLY));
 	ELLIPTICS_TEST_CASE(test_cache_overflow, create_session(n, { 5 }, 0, DNET_IO_FLAGS_CACHE));
+	ELLIPTICS_TEST_CASE(test_cache_resize, create_session(n, { 5 }, 0, DNET_IO_FLAGS_CACHE | DNET_IO_FLAGS_CACHE_ONLY));
+	ELLIPTICS_TEST_CASE_NOARGS(test_cache_hash_table);
+	ELLIPTICS_TEST_CASE_NOARGS(test_cache_slab_allocator);
+	ELLIPTICS_TEST_CASE_NOARGS(test_cache_slab_fragmentation);
+	ELLIPTICS_TEST_CASE_NOARGS(test_cache_frequency_sketch);
+	ELLIPTICS_TEST_CASE_NOARGS(test_cache_timer_wheel);
+	ELLIPTICS_TEST_CASE_NOARGS(test_cache_negative_cache);
+	ELLIPTICS_TEST_CASE(test_cache_negative_lookup, create_session(n, { 5 }, 0, 0));
+	ELLIPTICS_TEST_CASE(test_cache_negative_cached_object, create_session(n, { 5 }, 0, 0),
+		create_session(n, { 5 }, 0, DNET_IO_FLAGS_CACHE | DNET_IO_FLAGS_CACHE_ONLY));
+	ELLIPTICS_TEST_CASE_NOARGS(test_cache_miss_ratio_curve);
+	ELLIPTICS_TEST_CASE(test_cache_chunked_read, create_session(n, { 5 }, 0, 0),
+			create_session(n, { 5 }, 0, DNET_IO_FLAGS_CACHE));
+	ELLIPTICS_TEST_CASE(test_cache_chunked_routing, create_session(n, { 5 }, 0, 0),
+			create_session(n, { 5 }, 0, DNET_IO_FLAGS_CACHE));
+	ELLIPTICS_TEST_CASE(test_cache_writeback, create_session(n, { 5 }, 0, DNET_IO_FLAGS_NOCACHE),
+			create_session(n, { 5 }, 0, DNET_IO_FLAGS_CACHE));
+	ELLIPTICS_TEST_CASE(test_cache_indexes, create_session(n, { 5 }, 0, 0));
+	ELLIPTICS_TEST_CASE(test_cache_snapshot, create_session(n, { 5 }, 0, 0),
+			create_session(n, { 5 }, 0, DNET_IO_FLAGS_CACHE),
+			create_session(n, { 5 }, 0, DNET_IO_FLAGS_CACHE | DNET_IO_FLAGS_CACHE_ONLY));
 
 	return true;
 }
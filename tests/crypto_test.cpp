@@ -0,0 +1,186 @@
+/*
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ */
+
+#include "test_base.hpp"
+#include "../library/crypto/sha512.h"
+#include "../library/crypto/sha512_mb.h"
+
+#define BOOST_TEST_NO_MAIN
+#include <boost/test/included/unit_test.hpp>
+
+#include <boost/program_options.hpp>
+
+#include <errno.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace boost::unit_test;
+
+namespace tests {
+
+/*
+ * Lengths around the block size and the 112 bytes boundary after which
+ * the length field does not fit into the last block and padding takes one more block
+ */
+static const size_t sha512_sizes[] = {
+	0, 1, 63, 64, 65, 110, 111, 112, 113, 127, 128, 129,
+	239, 240, 241, 255, 256, 257, 1000, 4096 + 111
+};
+
+/* Prefix moves the padding edges of the whole message */
+static const size_t sha512_prefix_sizes[] = { 0, 1, 16, 111, 112, 128 };
+
+static std::string sha512_scalar(const std::string &prefix, const std::string &data)
+{
+	const std::string message = prefix + data;
+	unsigned char digest[SHA512_DIGEST_SIZE];
+
+	sha512_buffer(message.data(), message.size(), digest);
+	return std::string(reinterpret_cast<char *>(digest), sizeof(digest));
+}
+
+static std::string sha512_pattern(size_t size, size_t seed)
+{
+	std::string data(size, '\0');
+
+	for (size_t i = 0; i < size; ++i)
+		data[i] = static_cast<char>((i * 131 + seed * 7) & 0xff);
+
+	return data;
+}
+
+/*
+ * Every message is hashed by @implementation in one batch, which is larger than the number of lanes,
+ * so lanes are refilled with messages of different lengths and the tail is finished by scalar code
+ */
+static void test_sha512_mb(const std::string &implementation)
+{
+	std::vector<std::string> prefixes, data;
+
+	for (size_t p = 0; p < sizeof(sha512_prefix_sizes) / sizeof(sha512_prefix_sizes[0]); ++p) {
+		for (size_t s = 0; s < sizeof(sha512_sizes) / sizeof(sha512_sizes[0]); ++s) {
+			prefixes.push_back(sha512_pattern(sha512_prefix_sizes[p], s));
+			data.push_back(sha512_pattern(sha512_sizes[s], p + 1));
+		}
+	}
+
+	std::vector<sha512_mb_job> jobs(data.size());
+	std::vector<std::string> digests(data.size(), std::string(SHA512_DIGEST_SIZE, '\0'));
+
+	for (size_t i = 0; i < jobs.size(); ++i) {
+		jobs[i].prefix = prefixes[i].data();
+		jobs[i].prefix_size = prefixes[i].size();
+		jobs[i].data = data[i].data();
+		jobs[i].size = data[i].size();
+		jobs[i].digest = reinterpret_cast<unsigned char *>(&digests[i][0]);
+	}
+
+	int err = sha512_mb_with(implementation.c_str(), jobs.data(), jobs.size());
+	if (err == -ENOTSUP) {
+		BOOST_TEST_MESSAGE("sha512 " << implementation << " implementation is not supported, skipped");
+		return;
+	}
+
+	BOOST_REQUIRE_EQUAL(err, 0);
+
+	for (size_t i = 0; i < jobs.size(); ++i) {
+		BOOST_TEST_CHECKPOINT("prefix: " << prefixes[i].size() << ", size: " << data[i].size());
+		BOOST_REQUIRE(digests[i] == sha512_scalar(prefixes[i], data[i]));
+	}
+}
+
+/*
+ * Lone message is finished by scalar code, so every length is also hashed in all lanes at once
+ */
+static void test_sha512_mb_single(const std::string &implementation)
+{
+	for (size_t s = 0; s < sizeof(sha512_sizes) / sizeof(sha512_sizes[0]); ++s) {
+		const std::string prefix = sha512_pattern(16, s);
+		std::vector<std::string> data(8, sha512_pattern(sha512_sizes[s], s));
+		std::vector<sha512_mb_job> jobs(data.size());
+		std::vector<std::string> digests(data.size(), std::string(SHA512_DIGEST_SIZE, '\0'));
+
+		for (size_t i = 0; i < jobs.size(); ++i) {
+			jobs[i].prefix = prefix.data();
+			jobs[i].prefix_size = prefix.size();
+			jobs[i].data = data[i].data();
+			jobs[i].size = data[i].size();
+			jobs[i].digest = reinterpret_cast<unsigned char *>(&digests[i][0]);
+		}
+
+		int err = sha512_mb_with(implementation.c_str(), jobs.data(), jobs.size());
+		if (err == -ENOTSUP)
+			return;
+
+		BOOST_REQUIRE_EQUAL(err, 0);
+
+		const std::string expected = sha512_scalar(prefix, data[0]);
+		for (size_t i = 0; i < jobs.size(); ++i) {
+			BOOST_TEST_CHECKPOINT("size: " << data[i].size() << ", job: " << i);
+			BOOST_REQUIRE(digests[i] == expected);
+		}
+	}
+}
+
+bool register_tests(test_suite *suite)
+{
+	ELLIPTICS_TEST_CASE(test_sha512_mb, "scalar");
+	ELLIPTICS_TEST_CASE(test_sha512_mb, "avx2");
+	ELLIPTICS_TEST_CASE(test_sha512_mb, "avx512");
+	ELLIPTICS_TEST_CASE(test_sha512_mb_single, "scalar");
+	ELLIPTICS_TEST_CASE(test_sha512_mb_single, "avx2");
+	ELLIPTICS_TEST_CASE(test_sha512_mb_single, "avx512");
+
+	return true;
+}
+
+boost::unit_test::test_suite *register_tests(int argc, char *argv[])
+{
+	namespace bpo = boost::program_options;
+
+	bpo::variables_map vm;
+	bpo::options_description generic("Test options");
+
+	std::string path;
+
+	generic.add_options()
+			("help", "This help message")
+			("path", bpo::value(&path), "Path where to store everything")
+			;
+
+	bpo::store(bpo::parse_command_line(argc, argv, generic), vm);
+	bpo::notify(vm);
+
+	if (vm.count("help")) {
+		std::cerr << generic;
+		return NULL;
+	}
+
+	test_suite *suite = new test_suite("Local Test Suite");
+
+	std::cerr << "sha512 multi-buffer implementation: " << sha512_mb_implementation() << std::endl;
+
+	register_tests(suite);
+
+	return suite;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+	return unit_test_main(tests::register_tests, argc, argv);
+}
@@ -0,0 +1,135 @@
+/*
+ * This file is part of Elliptics.
+ *
+ * Elliptics is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Elliptics is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Elliptics.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Microbenchmark of key transformation: keys are hashed one by one
+ * and by batch (multi-buffer) transformation, results are compared.
+ */
+
+#include <sys/time.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "elliptics/interface.h"
+
+static void transform_bench_usage(char *p)
+{
+	fprintf(stderr, "Usage: %s <options>\n"
+			"  -n num                    - number of keys (default: 100000)\n"
+			"  -s size                   - key size (default: 32)\n"
+			"  -i num                    - number of iterations (default: 10)\n"
+			"  -h                        - this help\n"
+			, p);
+	exit(-1);
+}
+
+static double transform_bench_time(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+int main(int argc, char *argv[])
+{
+	int ch, num = 100000, key_size = 32, iterations = 10, i, j, err;
+	unsigned char *single, *batch;
+	const void **src;
+	uint64_t *size;
+	char *keys;
+	double start, single_time, batch_time;
+
+	while ((ch = getopt(argc, argv, "n:s:i:h")) != -1) {
+		switch (ch) {
+			case 'n':
+				num = atoi(optarg);
+				break;
+			case 's':
+				key_size = atoi(optarg);
+				break;
+			case 'i':
+				iterations = atoi(optarg);
+				break;
+			case 'h':
+			default:
+				transform_bench_usage(argv[0]);
+		}
+	}
+
+	if (num <= 0 || key_size <= 0 || iterations <= 0)
+		transform_bench_usage(argv[0]);
+
+	keys = malloc((size_t)num * key_size);
+	src = malloc(num * sizeof(void *));
+	size = malloc(num * sizeof(uint64_t));
+	single = malloc((size_t)num * DNET_ID_SIZE);
+	batch = malloc((size_t)num * DNET_ID_SIZE);
+	if (!keys || !src || !size || !single || !batch) {
+		fprintf(stderr, "Failed to allocate %d keys\n", num);
+		return -ENOMEM;
+	}
+
+	/* Keys look like the usual string keys and have different lengths */
+	for (i = 0; i < num; ++i) {
+		char *key = keys + (size_t)i * key_size;
+
+		for (j = 0; j < key_size; ++j)
+			key[j] = 'a' + (i + j) % 26;
+
+		src[i] = key;
+		size[i] = key_size - i % (key_size / 4 + 1);
+	}
+
+	start = transform_bench_time();
+	for (j = 0; j < iterations; ++j) {
+		for (i = 0; i < num; ++i)
+			dnet_digest_transform_raw(src[i], size[i], single + (size_t)i * DNET_ID_SIZE, DNET_ID_SIZE);
+	}
+	single_time = transform_bench_time() - start;
+
+	start = transform_bench_time();
+	for (j = 0; j < iterations; ++j) {
+		err = dnet_digest_transform_batch_raw(src, size, num, batch, DNET_ID_SIZE);
+		if (err) {
+			fprintf(stderr, "Batch transformation failed: %d\n", err);
+			return err;
+		}
+	}
+	batch_time = transform_bench_time() - start;
+
+	if (memcmp(single, batch, (size_t)num * DNET_ID_SIZE)) {
+		fprintf(stderr, "Batch transformation results differ from single ones\n");
+		return -EINVAL;
+	}
+
+	printf("keys: %d, key size: %d, iterations: %d\n", num, key_size, iterations);
+	printf("single: %.3f sec, %.0f keys/sec\n", single_time, num * iterations / single_time);
+	printf("batch:  %.3f sec, %.0f keys/sec, speedup: %.2f\n", batch_time, num * iterations / batch_time,
+			single_time / batch_time);
+
+	free(batch);
+	free(single);
+	free(size);
+	free(src);
+	free(keys);
+	return 0;
+}